@@ -21,6 +21,8 @@
 #include <sys/shm.h>
 #include <sys/socket.h>
 #include <sys/poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/un.h>
 #include <sys/uio.h>
 #include <stdio.h>
@@ -32,6 +34,8 @@
 #include <netdb.h>
 #include <limits.h>
 #include <signal.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "aserver.h"
 
@@ -106,45 +110,61 @@ static int make_inet_socket(int port)
 	return sock;
 }
 
-struct pollfd *pollfds;
-unsigned int pollfds_count = 0;
 typedef struct waiter waiter_t;
-typedef int (*waiter_handler_t)(waiter_t *waiter, unsigned short events);
+typedef struct worker worker_t;
+typedef int (*waiter_handler_t)(waiter_t *waiter, unsigned int events);
 struct waiter {
 	int fd;
 	void *private_data;
 	waiter_handler_t handler;
+	worker_t *worker;
 };
-waiter_t *waiters;
 
-static void add_waiter(int fd, unsigned short events, waiter_handler_t handler,
-		void *data)
+/* one epoll loop; the listener accepts and opens clients, workers serve them */
+struct worker {
+	int epfd;
+	pthread_t thread;
+	unsigned int clients;
+	struct list_head dead;
+	struct list_head outgoing;	/* listener: opened clients to hand over */
+	pthread_mutex_t lock;		/* protects incoming */
+	struct list_head incoming;	/* worker: clients handed over */
+	int wakefd;
+	waiter_t wake_waiter;
+};
+
+static worker_t listener;
+static worker_t *workers;
+static unsigned int workers_count = 1;
+static int verbose;
+static pthread_mutex_t clients_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int add_waiter(worker_t *worker, waiter_t *w, int fd, unsigned int events,
+		      waiter_handler_t handler, void *data)
 {
-	waiter_t *w = &waiters[fd];
-	struct pollfd *pfd = &pollfds[pollfds_count];
+	struct epoll_event ev;
 	assert(!w->handler);
-	pfd->fd = fd;
-	pfd->events = events;
-	pfd->revents = 0;
 	w->fd = fd;
 	w->private_data = data;
 	w->handler = handler;
-	pollfds_count++;
+	w->worker = worker;
+	ev.events = events;
+	ev.data.ptr = w;
+	if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		int result = -errno;
+		SYSERROR("epoll_ctl failed");
+		w->handler = 0;
+		return result;
+	}
+	return 0;
 }
 
-static void del_waiter(int fd)
+static void del_waiter(waiter_t *w)
 {
-	waiter_t *w = &waiters[fd];
-	unsigned int k;
 	assert(w->handler);
 	w->handler = 0;
-	for (k = 0; k < pollfds_count; ++k) {
-		if (pollfds[k].fd == fd)
-			break;
-	}
-	assert(k < pollfds_count);
-	pollfds_count--;
-	memmove(&pollfds[k], &pollfds[k + 1], pollfds_count - k);
+	if (epoll_ctl(w->worker->epfd, EPOLL_CTL_DEL, w->fd, NULL) < 0)
+		SYSERROR("epoll_ctl failed");
 }
 
 typedef struct client client_t;
@@ -195,6 +215,7 @@ struct client {
 	} device;
 	int polling;
 	int open;
+	int dead;
 	int cookie;
 	union {
 		struct {
@@ -202,6 +223,17 @@ struct client {
 			void *ctrl;
 		} shm;
 	} transport;
+	worker_t *worker;
+	struct list_head handoff;
+	waiter_t ctrl_waiter;
+	waiter_t poll_waiter;
+	waiter_t dev_waiter;
+	struct {
+		unsigned long cmds;
+		unsigned long errors;
+		unsigned long long busy_us;
+		unsigned long max_us;
+	} stats;
 };
 
 LIST_HEAD(clients);
@@ -210,11 +242,12 @@ typedef struct {
 	struct list_head list;
 	int fd;
 	uint32_t cookie;
+	waiter_t waiter;
 } inet_pending_t;
 LIST_HEAD(inet_pendings);
 
 #if 0
-static int pcm_handler(waiter_t *waiter, unsigned short events)
+static int pcm_handler(waiter_t *waiter, unsigned int events)
 {
 	client_t *client = waiter->private_data;
 	char buf[1];
@@ -232,7 +265,7 @@ static int pcm_handler(waiter_t *waiter, unsigned short events)
 			return -errno;
 		}
 	}
-	del_waiter(waiter->fd);
+	del_waiter(waiter);
 	client->polling = 0;
 	return 0;
 }
@@ -320,7 +353,7 @@ static int pcm_shm_close(client_t *client)
 	int err;
 	snd_pcm_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
 	if (client->polling) {
-		del_waiter(client->device.pcm.fd);
+		del_waiter(&client->dev_waiter);
 		client->polling = 0;
 	}
 	err = snd_pcm_close(client->device.pcm.handle);
@@ -523,7 +556,7 @@ transport_ops_t pcm_shm_ops = {
 	.close	= pcm_shm_close,
 };
 
-static int ctl_handler(waiter_t *waiter, unsigned short events)
+static int ctl_handler(waiter_t *waiter, unsigned int events)
 {
 	client_t *client = waiter->private_data;
 	char buf[1];
@@ -535,7 +568,7 @@ static int ctl_handler(waiter_t *waiter, unsigned short events)
 			return -errno;
 		}
 	}
-	del_waiter(waiter->fd);
+	del_waiter(waiter);
 	client->polling = 0;
 	return 0;
 }
@@ -567,8 +600,6 @@ static int ctl_shm_open(client_t *client, int *cookie)
 		goto _err;
 	}
 	*cookie = shmid;
-	add_waiter(client->device.ctl.fd, POLLIN, ctl_handler, client);
-	client->polling = 1;
 	return 0;
 
  _err:
@@ -582,7 +613,7 @@ static int ctl_shm_close(client_t *client)
 	int err;
 	snd_ctl_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
 	if (client->polling) {
-		del_waiter(client->device.ctl.fd);
+		del_waiter(&client->dev_waiter);
 		client->polling = 0;
 	}
 	err = snd_ctl_close(client->device.ctl.handle);
@@ -659,6 +690,30 @@ static int ctl_shm_cmd(client_t *client)
 	case SNDRV_CTL_IOCTL_ELEM_WRITE:
 		ctrl->result = snd_ctl_elem_write(ctl, &ctrl->u.element_write);
 		break;
+	case SND_CTL_IOCTL_ELEMS_READ:
+	case SND_CTL_IOCTL_ELEMS_WRITE:
+	{
+		snd_ctl_elem_value_t *buf = (snd_ctl_elem_value_t *) ctrl->data;
+		unsigned int i, count = ctrl->u.elems.count;
+		if (count > CTL_SHM_DATA_MAXLEN / sizeof(*buf)) {
+			ctrl->u.elems.done = 0;
+			ctrl->result = -EINVAL;
+			break;
+		}
+		ctrl->result = 0;
+		for (i = 0; i < count; i++) {
+			if (cmd == SND_CTL_IOCTL_ELEMS_READ)
+				err = snd_ctl_elem_read(ctl, &buf[i]);
+			else
+				err = snd_ctl_elem_write(ctl, &buf[i]);
+			if (err < 0) {
+				ctrl->result = err;
+				break;
+			}
+		}
+		ctrl->u.elems.done = i;
+		break;
+	}
 	case SNDRV_CTL_IOCTL_ELEM_LOCK:
 		ctrl->result = snd_ctl_elem_lock(ctl, &ctrl->u.element_lock);
 		break;
@@ -717,6 +772,139 @@ transport_ops_t ctl_shm_ops = {
 	.close	= ctl_shm_close,
 };
 
+static int client_card(client_t *client)
+{
+	switch (client->dev_type) {
+	case SND_DEV_TYPE_PCM:
+	{
+		snd_pcm_info_t *info;
+		snd_pcm_info_alloca(&info);
+		if (snd_pcm_info(client->device.pcm.handle, info) < 0)
+			return -1;
+		return snd_pcm_info_get_card(info);
+	}
+	case SND_DEV_TYPE_CONTROL:
+	{
+		snd_ctl_card_info_t *info;
+		snd_ctl_card_info_alloca(&info);
+		if (snd_ctl_card_info(client->device.ctl.handle, info) < 0)
+			return -1;
+		return snd_ctl_card_info_get_card(info);
+	}
+	default:
+		return -1;
+	}
+}
+
+/* Clients of one card always land on the same worker, the others
+   on the least loaded one */
+static worker_t *client_pick_worker(client_t *client)
+{
+	int card = client_card(client);
+	worker_t *worker;
+	unsigned int k;
+	pthread_mutex_lock(&clients_mutex);
+	if (card >= 0) {
+		worker = &workers[card % workers_count];
+	} else {
+		worker = &workers[0];
+		for (k = 1; k < workers_count; ++k) {
+			if (workers[k].clients < worker->clients)
+				worker = &workers[k];
+		}
+	}
+	worker->clients++;
+	pthread_mutex_unlock(&clients_mutex);
+	return worker;
+}
+
+static int client_ctrl_handler(waiter_t *waiter, unsigned int events);
+static int client_poll_handler(waiter_t *waiter, unsigned int events);
+
+/* Detach an opened client from the listener; it is queued to its
+   worker once the current batch is dispatched, so that no pending
+   listener event refers to it when the worker takes it over */
+static int client_attach(client_t *client)
+{
+	del_waiter(&client->ctrl_waiter);
+	if (client->poll_waiter.handler)
+		del_waiter(&client->poll_waiter);
+	client->worker = client_pick_worker(client);
+	list_add_tail(&client->handoff, &listener.outgoing);
+	return 0;
+}
+
+/* Called by the owning worker only */
+static int client_register(client_t *client)
+{
+	worker_t *worker = client->worker;
+	int err;
+	err = add_waiter(worker, &client->ctrl_waiter, client->ctrl_fd,
+			 EPOLLIN | EPOLLHUP, client_ctrl_handler, client);
+	if (err < 0)
+		return err;
+	if (!client->local) {
+		err = add_waiter(worker, &client->poll_waiter, client->poll_fd,
+				 EPOLLHUP, client_poll_handler, client);
+		if (err < 0)
+			return err;
+	}
+	if (client->dev_type == SND_DEV_TYPE_CONTROL) {
+		err = add_waiter(worker, &client->dev_waiter, client->device.ctl.fd,
+				 EPOLLIN, ctl_handler, client);
+		if (err < 0)
+			return err;
+		client->polling = 1;
+	}
+	return 0;
+}
+
+static void client_release(client_t *client)
+{
+	worker_t *worker = client->worker;
+	if (client->open)
+		client->ops->close(client);
+	if (client->poll_waiter.handler)
+		del_waiter(&client->poll_waiter);
+	if (!client->local)
+		close(client->poll_fd);
+	if (client->ctrl_waiter.handler)
+		del_waiter(&client->ctrl_waiter);
+	close(client->ctrl_fd);
+	if (verbose)
+		fprintf(stderr, "%s: client %s: %lu cmds, %lu errors, %llu us busy, %lu us max\n",
+			command, client->name, client->stats.cmds,
+			client->stats.errors, client->stats.busy_us,
+			client->stats.max_us);
+	pthread_mutex_lock(&clients_mutex);
+	list_del(&client->list);
+	if (worker != &listener)
+		worker->clients--;
+	pthread_mutex_unlock(&clients_mutex);
+	/* freed once the current batch of events is dispatched */
+	client->dead = 1;
+	list_add_tail(&client->list, &worker->dead);
+}
+
+static int client_cmd(client_t *client)
+{
+	struct timespec begin, end;
+	unsigned long us;
+	int err;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	err = client->ops->cmd(client);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	us = (end.tv_sec - begin.tv_sec) * 1000000 +
+		(end.tv_nsec - begin.tv_nsec) / 1000;
+	client->stats.cmds++;
+	if (err < 0)
+		client->stats.errors++;
+	client->stats.busy_us += us;
+	if (us > client->stats.max_us)
+		client->stats.max_us = us;
+	return err;
+}
+
 static int snd_client_open(client_t *client)
 {
 	int err;
@@ -770,6 +958,7 @@ static int snd_client_open(client_t *client)
 	name[req.namelen] = '\0';
 
 	client->transport_type = req.transport_type;
+	client->dev_type = req.dev_type;
 	strcpy(client->name, name);
 	client->stream = req.stream;
 	client->mode = req.mode;
@@ -788,42 +977,32 @@ static int snd_client_open(client_t *client)
 		SYSERROR("write failed");
 		exit(1);
 	}
+	if (client->open)
+		return client_attach(client);
 	return 0;
 }
 
-static int client_poll_handler(waiter_t *waiter, unsigned short events ATTRIBUTE_UNUSED)
+static int client_poll_handler(waiter_t *waiter, unsigned int events ATTRIBUTE_UNUSED)
 {
 	client_t *client = waiter->private_data;
-	if (client->open)
-		client->ops->close(client);
-	close(client->poll_fd);
-	close(client->ctrl_fd);
-	del_waiter(client->poll_fd);
-	del_waiter(client->ctrl_fd);
-	list_del(&client->list);
-	free(client);
+	client_release(client);
 	return 0;
 }
 
-static int client_ctrl_handler(waiter_t *waiter, unsigned short events)
+static int client_ctrl_handler(waiter_t *waiter, unsigned int events)
 {
 	client_t *client = waiter->private_data;
-	if (events & POLLHUP) {
-		if (client->open)
-			client->ops->close(client);
-		close(client->ctrl_fd);
-		del_waiter(client->ctrl_fd);
-		list_del(&client->list);
-		free(client);
+	if (events & EPOLLHUP) {
+		client_release(client);
 		return 0;
 	}
 	if (client->open)
-		return client->ops->cmd(client);
+		return client_cmd(client);
 	else
 		return snd_client_open(client);
 }
 
-static int inet_pending_handler(waiter_t *waiter, unsigned short events)
+static int inet_pending_handler(waiter_t *waiter, unsigned int events)
 {
 	inet_pending_t *pending = waiter->private_data;
 	inet_pending_t *pdata;
@@ -831,7 +1010,7 @@ static int inet_pending_handler(waiter_t *waiter, unsigned short events)
 	uint32_t cookie;
 	struct list_head *item;
 	int remove = 0;
-	if (events & POLLHUP)
+	if (events & EPOLLHUP)
 		remove = 1;
 	else {
 		int err = read(waiter->fd, &cookie, sizeof(cookie));
@@ -843,9 +1022,9 @@ static int inet_pending_handler(waiter_t *waiter, unsigned short events)
 				remove = 1;
 		}
 	}
-	del_waiter(waiter->fd);
+	del_waiter(waiter);
 	if (remove) {
-		close(waiter->fd);
+		close(pending->fd);
 		list_del(&pending->list);
 		free(pending);
 		return 0;
@@ -863,11 +1042,16 @@ static int inet_pending_handler(waiter_t *waiter, unsigned short events)
 	client = calloc(1, sizeof(*client));
 	client->local = 0;
 	client->poll_fd = pdata->fd;
-	client->ctrl_fd = waiter->fd;
-	add_waiter(client->ctrl_fd, POLLIN | POLLHUP, client_ctrl_handler, client);
-	add_waiter(client->poll_fd, POLLHUP, client_poll_handler, client);
+	client->ctrl_fd = pending->fd;
+	client->worker = &listener;
+	add_waiter(&listener, &client->ctrl_waiter, client->ctrl_fd,
+		   EPOLLIN | EPOLLHUP, client_ctrl_handler, client);
+	add_waiter(&listener, &client->poll_waiter, client->poll_fd,
+		   EPOLLHUP, client_poll_handler, client);
 	client->open = 0;
+	pthread_mutex_lock(&clients_mutex);
 	list_add_tail(&client->list, &clients);
+	pthread_mutex_unlock(&clients_mutex);
 	list_del(&pending->list);
 	list_del(&pdata->list);
 	free(pending);
@@ -875,7 +1059,7 @@ static int inet_pending_handler(waiter_t *waiter, unsigned short events)
 	return 0;
 }
 
-static int local_handler(waiter_t *waiter, unsigned short events ATTRIBUTE_UNUSED)
+static int local_handler(waiter_t *waiter, unsigned int events ATTRIBUTE_UNUSED)
 {
 	int sock;
 	sock = accept(waiter->fd, 0, 0);
@@ -888,13 +1072,17 @@ static int local_handler(waiter_t *waiter, unsigned short events ATTRIBUTE_UNUSE
 		client->ctrl_fd = sock;
 		client->local = 1;
 		client->open = 0;
-		add_waiter(sock, POLLIN | POLLHUP, client_ctrl_handler, client);
+		client->worker = &listener;
+		add_waiter(&listener, &client->ctrl_waiter, sock,
+			   EPOLLIN | EPOLLHUP, client_ctrl_handler, client);
+		pthread_mutex_lock(&clients_mutex);
 		list_add_tail(&client->list, &clients);
+		pthread_mutex_unlock(&clients_mutex);
 	}
 	return 0;
 }
 
-static int inet_handler(waiter_t *waiter, unsigned short events ATTRIBUTE_UNUSED)
+static int inet_handler(waiter_t *waiter, unsigned int events ATTRIBUTE_UNUSED)
 {
 	int sock;
 	sock = accept(waiter->fd, 0, 0);
@@ -906,29 +1094,134 @@ static int inet_handler(waiter_t *waiter, unsigned short events ATTRIBUTE_UNUSED
 		inet_pending_t *pending = calloc(1, sizeof(*pending));
 		pending->fd = sock;
 		pending->cookie = 0;
-		add_waiter(sock, POLLIN, inet_pending_handler, pending);
+		add_waiter(&listener, &pending->waiter, sock, EPOLLIN,
+			   inet_pending_handler, pending);
 		list_add_tail(&pending->list, &inet_pendings);
 	}
 	return 0;
 }
 
+/* Queue the clients opened in this batch to their workers */
+static void listener_handoff(void)
+{
+	uint64_t one = 1;
+	while (!list_empty(&listener.outgoing)) {
+		client_t *client = list_entry(listener.outgoing.next, client_t, handoff);
+		worker_t *worker = client->worker;
+		list_del(&client->handoff);
+		pthread_mutex_lock(&worker->lock);
+		list_add_tail(&client->handoff, &worker->incoming);
+		pthread_mutex_unlock(&worker->lock);
+		if (write(worker->wakefd, &one, sizeof(one)) != sizeof(one))
+			SYSERROR("write failed");
+	}
+}
+
+static int worker_wake_handler(waiter_t *waiter, unsigned int events ATTRIBUTE_UNUSED)
+{
+	worker_t *worker = waiter->private_data;
+	uint64_t count;
+	if (read(worker->wakefd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+		SYSERROR("read failed");
+	while (1) {
+		client_t *client = NULL;
+		pthread_mutex_lock(&worker->lock);
+		if (!list_empty(&worker->incoming)) {
+			client = list_entry(worker->incoming.next, client_t, handoff);
+			list_del(&client->handoff);
+		}
+		pthread_mutex_unlock(&worker->lock);
+		if (!client)
+			break;
+		if (client_register(client) < 0) {
+			ERROR("cannot attach client %s", client->name);
+			client_release(client);
+		}
+	}
+	return 0;
+}
+
+static void worker_loop(worker_t *worker)
+{
+	struct epoll_event events[64];
+	int k, n;
+	while (1) {
+		n = epoll_wait(worker->epfd, events, 64, -1);
+		if (n < 0) {
+			if (errno != EINTR)
+				SYSERROR("epoll_wait failed");
+			continue;
+		}
+		for (k = 0; k < n; k++) {
+			waiter_t *w = events[k].data.ptr;
+			int err;
+			/* removed or detached in this batch */
+			if (!w->handler)
+				continue;
+			err = w->handler(w, events[k].events);
+			if (err < 0)
+				ERROR("waiter handler failed");
+		}
+		if (worker == &listener)
+			listener_handoff();
+		while (!list_empty(&worker->dead)) {
+			client_t *client = list_entry(worker->dead.next, client_t, list);
+			list_del(&client->list);
+			free(client);
+		}
+	}
+}
+
+static void *worker_thread(void *data)
+{
+	worker_loop(data);
+	return NULL;
+}
+
+static int worker_init(worker_t *worker)
+{
+	worker->epfd = epoll_create(64);
+	if (worker->epfd < 0) {
+		int result = -errno;
+		SYSERROR("epoll_create failed");
+		return result;
+	}
+	fcntl(worker->epfd, F_SETFD, FD_CLOEXEC);
+	INIT_LIST_HEAD(&worker->dead);
+	INIT_LIST_HEAD(&worker->outgoing);
+	INIT_LIST_HEAD(&worker->incoming);
+	pthread_mutex_init(&worker->lock, NULL);
+	if (worker == &listener)
+		return 0;
+	worker->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (worker->wakefd < 0) {
+		int result = -errno;
+		SYSERROR("eventfd failed");
+		return result;
+	}
+	return add_waiter(worker, &worker->wake_waiter, worker->wakefd, EPOLLIN,
+			  worker_wake_handler, worker);
+}
+
 static int server(const char *sockname, int port)
 {
-	int err;
+	static waiter_t local_waiter, inet_waiter;
 	unsigned int k;
-	long open_max;
 	int result;
 
 	if (!sockname && port < 0)
 		return -EINVAL;
-	open_max = sysconf(_SC_OPEN_MAX);
-	if (open_max < 0) {
-		result = -errno;
-		SYSERROR("sysconf failed");
+	result = worker_init(&listener);
+	if (result < 0)
 		return result;
+	workers = calloc(workers_count, sizeof(*workers));
+	if (!workers)
+		return -ENOMEM;
+	for (k = 0; k < workers_count; ++k) {
+		result = worker_init(&workers[k]);
+		if (result < 0)
+			goto _end;
 	}
-	pollfds = calloc((size_t) open_max, sizeof(*pollfds));
-	waiters = calloc((size_t) open_max, sizeof(*waiters));
 
 	if (sockname) {
 		int sock = make_local_socket(sockname);
@@ -944,7 +1237,10 @@ static int server(const char *sockname, int port)
 			SYSERROR("listen failed");
 			goto _end;
 		}
-		add_waiter(sock, POLLIN, local_handler, NULL);
+		result = add_waiter(&listener, &local_waiter, sock, EPOLLIN,
+				    local_handler, NULL);
+		if (result < 0)
+			goto _end;
 	}
 	if (port >= 0) {
 		int sock = make_inet_socket(port);
@@ -960,37 +1256,22 @@ static int server(const char *sockname, int port)
 			SYSERROR("listen failed");
 			goto _end;
 		}
-		add_waiter(sock, POLLIN, inet_handler, NULL);
+		result = add_waiter(&listener, &inet_waiter, sock, EPOLLIN,
+				    inet_handler, NULL);
+		if (result < 0)
+			goto _end;
 	}
 
-	while (1) {
-		struct pollfd pfds[open_max];
-		size_t pfds_count;
-		do {
-			err = poll(pollfds, pollfds_count, -1);
-		} while (err == 0);
-		if (err < 0) {
-			SYSERROR("poll failed");
-			continue;
-		}
-
-		pfds_count = pollfds_count;
-		memcpy(pfds, pollfds, sizeof(*pfds) * pfds_count);
-		for (k = 0; k < pfds_count; k++) {
-			struct pollfd *pfd = &pfds[k];
-			if (pfd->revents) {
-				waiter_t *w = &waiters[pfd->fd];
-				if (!w->handler)
-					continue;
-				err = w->handler(w, pfd->revents);
-				if (err < 0)
-					ERROR("waiter handler failed");
-			}
+	for (k = 0; k < workers_count; ++k) {
+		if (pthread_create(&workers[k].thread, NULL, worker_thread, &workers[k])) {
+			result = -EAGAIN;
+			ERROR("pthread_create failed");
+			goto _end;
 		}
 	}
+	worker_loop(&listener);
  _end:
-	free(pollfds);
-	free(waiters);
+	free(workers);
 	return result;
 }
 					
@@ -999,7 +1280,9 @@ static void usage(void)
 {
 	fprintf(stderr,
 		"Usage: %s [OPTIONS] server\n"
-		"--help			help\n",
+		"--help			help\n"
+		"--workers=#		threads serving the clients (default 1)\n"
+		"--verbose		print client statistics on disconnect\n",
 		command);
 }
 
@@ -1007,6 +1290,8 @@ int main(int argc, char **argv)
 {
 	static const struct option long_options[] = {
 		{"help", 0, 0, 'h'},
+		{"workers", 1, 0, 'w'},
+		{"verbose", 0, 0, 'v'},
 		{ 0 , 0 , 0, 0 }
 	};
 	int c;
@@ -1018,11 +1303,21 @@ int main(int argc, char **argv)
 	char *srvname;
 
 	command = argv[0];
-	while ((c = getopt_long(argc, argv, "h", long_options, 0)) != -1) {
+	while ((c = getopt_long(argc, argv, "hw:v", long_options, 0)) != -1) {
 		switch (c) {
 		case 'h':
 			usage();
 			return 0;
+		case 'w':
+			workers_count = atoi(optarg);
+			if (workers_count < 1) {
+				ERROR("invalid count of workers");
+				return 1;
+			}
+			break;
+		case 'v':
+			verbose = 1;
+			break;
 		default:
 			fprintf(stderr, "Try `%s --help' for more information\n", command);
 			return 1;
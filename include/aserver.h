@@ -111,6 +111,8 @@ typedef struct {
 #define SND_CTL_IOCTL_CLOSE		_IO ('U', 0xf2)
 #define SND_CTL_IOCTL_POLL_DESCRIPTOR	_IO ('U', 0xf3)
 #define SND_CTL_IOCTL_ASYNC		_IO ('U', 0xf4)
+#define SND_CTL_IOCTL_ELEMS_READ	_IO ('U', 0xf5)
+#define SND_CTL_IOCTL_ELEMS_WRITE	_IO ('U', 0xf6)
 
 typedef struct {
 	int result;
@@ -136,6 +138,10 @@ typedef struct {
 		int rawmidi_prefer_subdevice;
 		unsigned int power_state;
 		snd_ctl_event_t read;
+		struct {
+			unsigned int count;	/* values in data */
+			unsigned int done;
+		} elems;
 	} u;
 	char data[0];
 } snd_ctl_shm_ctrl_t;
@@ -68,6 +68,9 @@ typedef struct _snd_ctl_elem_value snd_ctl_elem_value_t;
 /** CTL event container */
 typedef struct _snd_ctl_event snd_ctl_event_t;
 
+/** Compiled dB mapping of a TLV */
+typedef struct _snd_tlv_dB_map snd_tlv_dB_map_t;
+
 /** CTL element type */
 typedef enum _snd_ctl_elem_type {
 	/** Invalid type */
@@ -210,6 +213,9 @@ typedef enum _snd_ctl_type {
 /** Read only (flag for open mode) \hideinitializer */
 #define SND_CTL_READONLY		0x0004
 
+/** Restore the old values when a batched write fails (flag for #snd_ctl_elems_write) \hideinitializer */
+#define SND_CTL_ELEMS_ATOMIC		0x0001
+
 /** CTL handle */
 typedef struct _snd_ctl snd_ctl_t;
 
@@ -219,11 +225,19 @@ typedef struct _snd_ctl snd_ctl_t;
 /** SCTL type */
 typedef struct _snd_sctl snd_sctl_t;
 
+/** Card hotplug callback, present is nonzero when the card has appeared */
+typedef void (*snd_card_registry_callback_t)(int card, int present,
+					     void *private_data);
+
 int snd_card_load(int card);
 int snd_card_next(int *card);
 int snd_card_get_index(const char *name);
 int snd_card_get_name(int card, char **name);
 int snd_card_get_longname(int card, char **name);
+int snd_card_registry_set_callback(snd_card_registry_callback_t callback,
+				   void *private_data);
+int snd_card_registry_poll_descriptor(void);
+int snd_card_registry_handle_events(void);
 
 int snd_device_name_hint(int card, const char *iface, void ***hints);
 int snd_device_name_free_hint(void **hints);
@@ -247,6 +261,10 @@ int snd_ctl_elem_list(snd_ctl_t *ctl, snd_ctl_elem_list_t *list);
 int snd_ctl_elem_info(snd_ctl_t *ctl, snd_ctl_elem_info_t *info);
 int snd_ctl_elem_read(snd_ctl_t *ctl, snd_ctl_elem_value_t *value);
 int snd_ctl_elem_write(snd_ctl_t *ctl, snd_ctl_elem_value_t *value);
+int snd_ctl_elems_read(snd_ctl_t *ctl, snd_ctl_elem_value_t **values,
+		       unsigned int count);
+int snd_ctl_elems_write(snd_ctl_t *ctl, snd_ctl_elem_value_t **values,
+			unsigned int count, unsigned int flags);
 int snd_ctl_elem_lock(snd_ctl_t *ctl, snd_ctl_elem_id_t *id);
 int snd_ctl_elem_unlock(snd_ctl_t *ctl, snd_ctl_elem_id_t *id);
 int snd_ctl_elem_tlv_read(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id,
@@ -273,6 +291,8 @@ int snd_ctl_set_power_state(snd_ctl_t *ctl, unsigned int state);
 int snd_ctl_get_power_state(snd_ctl_t *ctl, unsigned int *state);
 
 int snd_ctl_read(snd_ctl_t *ctl, snd_ctl_event_t *event);
+int snd_ctl_read_events(snd_ctl_t *ctl, snd_ctl_event_t **events,
+			unsigned int count);
 int snd_ctl_wait(snd_ctl_t *ctl, int timeout);
 const char *snd_ctl_name(snd_ctl_t *ctl);
 snd_ctl_type_t snd_ctl_type(snd_ctl_t *ctl);
@@ -485,6 +505,16 @@ int snd_ctl_convert_to_dB(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id,
 int snd_ctl_convert_from_dB(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id,
 			    long db_gain, long *value, int xdir);
 
+int snd_tlv_dB_map_new(snd_tlv_dB_map_t **map, unsigned int *tlv,
+		       long rangemin, long rangemax);
+void snd_tlv_dB_map_free(snd_tlv_dB_map_t *map);
+int snd_tlv_dB_map_get_range(snd_tlv_dB_map_t *map, long *min, long *max);
+int snd_tlv_dB_map_to_dB(snd_tlv_dB_map_t *map, long volume, long *db_gain);
+int snd_tlv_dB_map_from_dB(snd_tlv_dB_map_t *map, long db_gain, long *value,
+			   int xdir);
+int snd_ctl_get_dB_map(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id,
+		       snd_tlv_dB_map_t **map);
+
 /**
  *  \defgroup HControl High level Control Interface
  *  \ingroup Control
@@ -547,9 +577,13 @@ void *snd_hctl_get_callback_private(snd_hctl_t *hctl);
 int snd_hctl_load(snd_hctl_t *hctl);
 int snd_hctl_free(snd_hctl_t *hctl);
 int snd_hctl_handle_events(snd_hctl_t *hctl);
+int snd_hctl_handle_events_coalesce(snd_hctl_t *hctl);
 const char *snd_hctl_name(snd_hctl_t *hctl);
 int snd_hctl_wait(snd_hctl_t *hctl, int timeout);
 snd_ctl_t *snd_hctl_ctl(snd_hctl_t *hctl);
+int snd_hctl_set_cache(snd_hctl_t *hctl, int enable);
+void snd_hctl_get_cache_stats(snd_hctl_t *hctl, unsigned long *hits,
+			      unsigned long *misses);
 
 snd_hctl_elem_t *snd_hctl_elem_next(snd_hctl_elem_t *elem);
 snd_hctl_elem_t *snd_hctl_elem_prev(snd_hctl_elem_t *elem);
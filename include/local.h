@@ -333,12 +333,22 @@ static inline int snd_open_device(const char *filename, int fmode)
 	snd1_config_check_hop
 #define snd_config_search_alias_hooks \
 	snd1_config_search_alias_hooks
+#define snd_device_name_hint_cache_cleanup \
+	snd1_device_name_hint_cache_cleanup
+#define snd_card_registry_cleanup \
+	snd1_card_registry_cleanup
 
 /* dlobj cache */
 void *snd_dlobj_cache_get(const char *lib, const char *name, const char *version, int verbose);
 int snd_dlobj_cache_put(void *open_func);
 void snd_dlobj_cache_cleanup(void);
 
+/* device name hint cache */
+void snd_device_name_hint_cache_cleanup(void);
+
+/* card registry */
+void snd_card_registry_cleanup(void);
+
 /* for recursive checks */
 void snd_config_set_hop(snd_config_t *conf, int hop);
 int snd_config_check_hop(snd_config_t *conf);
@@ -98,6 +98,7 @@ int snd_mixer_close(snd_mixer_t *mixer);
 snd_mixer_elem_t *snd_mixer_first_elem(snd_mixer_t *mixer);
 snd_mixer_elem_t *snd_mixer_last_elem(snd_mixer_t *mixer);
 int snd_mixer_handle_events(snd_mixer_t *mixer);
+int snd_mixer_handle_events_coalesce(snd_mixer_t *mixer);
 int snd_mixer_attach(snd_mixer_t *mixer, const char *name);
 int snd_mixer_attach_hctl(snd_mixer_t *mixer, snd_hctl_t *hctl);
 int snd_mixer_detach(snd_mixer_t *mixer, const char *name);
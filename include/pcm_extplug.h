@@ -55,12 +55,22 @@ typedef snd_pcm_extplug snd_pcm_extplug_t;
 typedef snd_pcm_extplug_callback snd_pcm_extplug_callback_t;
 #endif
 
+/*
+ * bit flags for additional conditions; since v1.0.3
+ */
+#define SND_PCM_EXTPLUG_FLAG_INPLACE	(1<<0)	/**< transfer may get the same src and dst areas */
+#define SND_PCM_EXTPLUG_FLAG_ALIGNED	(1<<1)	/**< channel areas start at #SND_PCM_EXTPLUG_ALIGN bytes */
+#define SND_PCM_EXTPLUG_FLAG_PLANAR	(1<<2)	/**< non-interleaved buffers on the client side */
+
+/** alignment of the buffers given by #SND_PCM_EXTPLUG_FLAG_ALIGNED */
+#define SND_PCM_EXTPLUG_ALIGN		64
+
 /*
  * Protocol version
  */
 #define SND_PCM_EXTPLUG_VERSION_MAJOR	1	/**< Protocol major version */
 #define SND_PCM_EXTPLUG_VERSION_MINOR	0	/**< Protocol minor version */
-#define SND_PCM_EXTPLUG_VERSION_TINY	2	/**< Protocol tiny version */
+#define SND_PCM_EXTPLUG_VERSION_TINY	3	/**< Protocol tiny version */
 /**
  * Filter-plugin protocol version
  */
@@ -123,6 +133,11 @@ struct snd_pcm_extplug {
 	 * slave_channels hw parameter; filled after hw_params is caled
 	 */
 	unsigned int slave_channels;
+	/**
+	 * bit flags (SND_PCM_EXTPLUG_FLAG_XXX); must be filled before calling
+	 * #snd_pcm_extplug_create(); since v1.0.3
+	 */
+	unsigned int flags;
 };
 
 /** Callback table of extplug */
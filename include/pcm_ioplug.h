@@ -54,10 +54,13 @@ enum {
 typedef struct snd_pcm_ioplug snd_pcm_ioplug_t;
 /** Callback table of ioplug */
 typedef struct snd_pcm_ioplug_callback snd_pcm_ioplug_callback_t;
+/** Chunk of a vectored transfer */
+typedef struct snd_pcm_ioplug_chunk snd_pcm_ioplug_chunk_t;
 #ifdef DOC_HIDDEN
 /* redefine typedefs for stupid doxygen */
 typedef snd_pcm_ioplug snd_pcm_ioplug_t;
 typedef snd_pcm_ioplug_callback snd_pcm_ioplug_callback_t;
+typedef snd_pcm_ioplug_chunk snd_pcm_ioplug_chunk_t;
 #endif
 
 /*
@@ -65,13 +68,14 @@ typedef snd_pcm_ioplug_callback snd_pcm_ioplug_callback_t;
  */
 #define SND_PCM_IOPLUG_FLAG_LISTED	(1<<0)		/**< list up this PCM */
 #define SND_PCM_IOPLUG_FLAG_MONOTONIC	(1<<1)		/**< monotonic timestamps */
+#define SND_PCM_IOPLUG_FLAG_CACHED_PTR	(1<<2)		/**< pointer is cached until invalidated; since v1.0.3 */
 
 /*
  * Protocol version
  */
 #define SND_PCM_IOPLUG_VERSION_MAJOR	1	/**< Protocol major version */
 #define SND_PCM_IOPLUG_VERSION_MINOR	0	/**< Protocol minor version */
-#define SND_PCM_IOPLUG_VERSION_TINY	2	/**< Protocol tiny version */
+#define SND_PCM_IOPLUG_VERSION_TINY	3	/**< Protocol tiny version */
 /**
  * IO-plugin protocol version
  */
@@ -121,6 +125,13 @@ struct snd_pcm_ioplug {
 	snd_pcm_uframes_t buffer_size;	/**< buffer size; filled after hw_params is called */
 };
 
+/** Chunk of a vectored transfer */
+struct snd_pcm_ioplug_chunk {
+	const snd_pcm_channel_area_t *areas;	/**< channel areas */
+	snd_pcm_uframes_t offset;		/**< offset in frames within areas */
+	snd_pcm_uframes_t size;			/**< frames to transfer */
+};
+
 /** Callback table of ioplug */
 struct snd_pcm_ioplug_callback {
 	/**
@@ -206,6 +217,16 @@ struct snd_pcm_ioplug_callback {
 	 * set the channel map; optional; since v1.0.2
 	 */
 	int (*set_chmap)(snd_pcm_ioplug_t *io, const snd_pcm_chmap_t *map);
+	/**
+	 * transfer several chunks in one call; optional; since v1.0.3
+	 */
+	snd_pcm_sframes_t (*transferv)(snd_pcm_ioplug_t *io,
+				       const snd_pcm_ioplug_chunk_t *chunks,
+				       unsigned int nchunks);
+	/**
+	 * fill the areas of the plugin's own buffer used as mmap area; optional; since v1.0.3
+	 */
+	int (*buffer_areas)(snd_pcm_ioplug_t *io, snd_pcm_channel_area_t *areas);
 };
 
 
@@ -229,6 +250,9 @@ int snd_pcm_ioplug_set_param_list(snd_pcm_ioplug_t *io, int type, unsigned int n
 /* change PCM status */
 int snd_pcm_ioplug_set_state(snd_pcm_ioplug_t *ioplug, snd_pcm_state_t state);
 
+/* drop the cached pointer (SND_PCM_IOPLUG_FLAG_CACHED_PTR only) */
+void snd_pcm_ioplug_invalidate_ptr(snd_pcm_ioplug_t *ioplug);
+
 /** \} */
 
 #endif /* __ALSA_PCM_IOPLUG_H */
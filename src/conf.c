@@ -3858,6 +3858,8 @@ int snd_config_update_free_global(void)
 	snd_config_unlock();
 	/* FIXME: better to place this in another place... */
 	snd_dlobj_cache_cleanup();
+	snd_device_name_hint_cache_cleanup();
+	snd_card_registry_cleanup();
 
 	return 0;
 }
@@ -30,51 +30,298 @@
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include "control_local.h"
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef DOC_HIDDEN
-#define SND_FILE_CONTROL	ALSA_DEVICE_DIRECTORY "controlC%i"
+#define SND_FILE_CONTROL	"%scontrolC%i"
 #define SND_FILE_LOAD		ALOAD_DEVICE_DIRECTORY "aloadC%i"
 #endif
 
-static int snd_card_load2(const char *control)
+static int snd_card_load2(const char *control, snd_ctl_card_info_t *info)
 {
 	int open_dev;
-	snd_ctl_card_info_t info;
 
 	open_dev = snd_open_device(control, O_RDONLY);
 	if (open_dev >= 0) {
-		if (ioctl(open_dev, SNDRV_CTL_IOCTL_CARD_INFO, &info) < 0) {
+		if (ioctl(open_dev, SNDRV_CTL_IOCTL_CARD_INFO, info) < 0) {
 			int err = -errno;
 			close(open_dev);
 			return err;
 		}
 		close(open_dev);
-		return info.card;
+		return info->card;
 	} else {
 		return -errno;
 	}
 }
 
-static int snd_card_load1(int card)
+static int snd_card_load1(const char *dir, int card, snd_ctl_card_info_t *info)
 {
 	int res;
-	char control[sizeof(SND_FILE_CONTROL) + 10];
+	char control[PATH_MAX];
 
-	sprintf(control, SND_FILE_CONTROL, card);
-	res = snd_card_load2(control);
+	snprintf(control, sizeof(control), SND_FILE_CONTROL, dir, card);
+	res = snd_card_load2(control, info);
 #ifdef SUPPORT_ALOAD
 	if (res < 0) {
 		char aload[sizeof(SND_FILE_LOAD) + 10];
 		sprintf(aload, SND_FILE_LOAD, card);
-		res = snd_card_load2(aload);
+		res = snd_card_load2(aload, info);
 	}
 #endif
 	return res;
 }
 
+/*
+ * Card registry
+ *
+ * Once the application uses the registry functions, the card
+ * information is read once and kept until the control device node of
+ * the card is created, removed or changed in the device directory,
+ * which is watched with inotify.  Without inotify, or before the
+ * registry is used, every call probes the device as before.  A card id
+ * changed through sysfs does not touch the node, so the old id is kept
+ * until the next node change.
+ */
+#ifndef DOC_HIDDEN
+struct snd_card_entry {
+	int valid;			/* probed after the last node change */
+	int err;			/* probe result, 0 if present */
+	int present;			/* last reported to the callback */
+	snd_ctl_card_info_t info;
+};
+
+static struct {
+	int enabled;			/* used by the application */
+	int primed;			/* present flags initialized */
+	int state;			/* 0 = not yet, 1 = watching, <0 error */
+	int fd;
+	pid_t pid;			/* process owning fd */
+	const char *dir;
+	struct snd_card_entry cards[SND_MAX_CARDS];
+	snd_card_registry_callback_t callback;
+	void *callback_private;
+} card_registry = { .fd = -1 };
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t card_registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define card_registry_lock()	pthread_mutex_lock(&card_registry_mutex)
+#define card_registry_unlock()	pthread_mutex_unlock(&card_registry_mutex)
+#else
+#define card_registry_lock()	do {} while (0)
+#define card_registry_unlock()	do {} while (0)
+#endif
+#endif /* DOC_HIDDEN */
+
+static void snd_card_registry_invalidate(void)
+{
+	int card;
+
+	for (card = 0; card < SND_MAX_CARDS; card++)
+		card_registry.cards[card].valid = 0;
+}
+
+static void snd_card_registry_unwatch(void)
+{
+	if (card_registry.fd >= 0)
+		close(card_registry.fd);
+	card_registry.fd = -1;
+	card_registry.state = 0;
+}
+
+/* the tests point the registry to a directory of their own */
+static const char *snd_card_registry_dir(void)
+{
+	static char dir[PATH_MAX];
+	const char *env = getenv("LIBASOUND_CARD_REGISTRY_DIR");
+
+	if (!env || !*env)
+		return ALSA_DEVICE_DIRECTORY;
+	snprintf(dir, sizeof(dir), "%s/", env);
+	return dir;
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+static int snd_card_registry_watch(void)
+{
+	int fd;
+
+	if (card_registry.state > 0)
+		return 0;
+	fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0)
+		return card_registry.state = -errno;
+	/* the directory itself is missing until the first card appears */
+	if (inotify_add_watch(fd, card_registry.dir,
+			      IN_CREATE | IN_DELETE | IN_ATTRIB |
+			      IN_MOVED_FROM | IN_MOVED_TO |
+			      IN_DELETE_SELF | IN_MOVE_SELF) < 0) {
+		int err = -errno;
+		close(fd);
+		return card_registry.state = err;
+	}
+	card_registry.fd = fd;
+	card_registry.pid = getpid();
+	card_registry.state = 1;
+	snd_card_registry_invalidate();
+	return 0;
+}
+
+/* apply the pending directory changes */
+static void snd_card_registry_read(void)
+{
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	ssize_t len;
+	char *ptr;
+	int card, n;
+
+	while ((len = read(card_registry.fd, buf, sizeof(buf))) > 0) {
+		for (ptr = buf; ptr < buf + len;
+		     ptr += sizeof(*ev) + ev->len) {
+			ev = (const struct inotify_event *)ptr;
+			if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF |
+					IN_IGNORED)) {
+				/* the directory is gone, watch it again */
+				snd_card_registry_invalidate();
+				snd_card_registry_unwatch();
+				return;
+			}
+			if (ev->mask & IN_Q_OVERFLOW) {
+				snd_card_registry_invalidate();
+				continue;
+			}
+			if (ev->len == 0 ||
+			    sscanf(ev->name, "controlC%i%n", &card, &n) != 1 ||
+			    ev->name[n] != '\0' ||
+			    card < 0 || card >= SND_MAX_CARDS)
+				continue;
+			card_registry.cards[card].valid = 0;
+		}
+	}
+}
+#else
+static int snd_card_registry_watch(void)
+{
+	return card_registry.state = -ENOSYS;
+}
+
+static void snd_card_registry_read(void)
+{
+}
+#endif
+
+/* bring the registry up to date, called with the registry locked */
+static int snd_card_registry_sync(void)
+{
+	int err;
+
+	if (card_registry.state > 0 && card_registry.pid != getpid()) {
+		/* forked, the inotify queue is shared with the parent */
+		snd_card_registry_unwatch();
+		snd_card_registry_invalidate();
+	}
+	if (card_registry.state <= 0) {
+		err = snd_card_registry_watch();
+		if (err < 0)
+			return err;
+	}
+	snd_card_registry_read();
+	/* the directory was removed or replaced */
+	if (card_registry.state <= 0)
+		return snd_card_registry_watch();
+	return 0;
+}
+
+static void snd_card_registry_probe(int card)
+{
+	struct snd_card_entry *e = &card_registry.cards[card];
+	int res;
+
+	if (e->valid)
+		return;
+	res = snd_card_load1(card_registry.dir, card, &e->info);
+	e->err = res < 0 ? res : 0;
+	/* without the watch, nothing tells when to probe again */
+	if (card_registry.state <= 0)
+		return;
+	/* a card with changed node during the probe is probed again */
+	e->valid = 1;
+	snd_card_registry_read();
+}
+
+/*
+ * Start the registry on the first use of the registry functions,
+ * called with the registry locked.  The cards present at that time
+ * are not reported as changes.
+ */
+static int snd_card_registry_enable(void)
+{
+	int card, err;
+
+	if (!card_registry.enabled) {
+		card_registry.dir = snd_card_registry_dir();
+		card_registry.enabled = 1;
+	}
+	err = snd_card_registry_sync();
+	if (!card_registry.primed) {
+		for (card = 0; card < SND_MAX_CARDS; card++) {
+			snd_card_registry_probe(card);
+			card_registry.cards[card].present =
+				!card_registry.cards[card].err;
+		}
+		card_registry.primed = 1;
+	}
+	return err;
+}
+
+/*
+ * Get the card information, from the registry when it is used.
+ * Returns zero if the card is present, otherwise a negative error code.
+ */
+static int snd_card_info_get(int card, snd_ctl_card_info_t *info)
+{
+	int err;
+
+	card_registry_lock();
+	if (!card_registry.enabled) {
+		card_registry_unlock();
+		err = snd_card_load1(ALSA_DEVICE_DIRECTORY, card, info);
+		return err < 0 ? err : 0;
+	}
+	/* on error, the card is probed without caching */
+	snd_card_registry_sync();
+	snd_card_registry_probe(card);
+	err = card_registry.cards[card].err;
+	if (!err)
+		*info = card_registry.cards[card].info;
+	card_registry_unlock();
+	return err;
+}
+
+/*
+ * Release the inotify instance, the registry is set up again on the
+ * next use of the registry functions.  Called from
+ * snd_config_update_free_global().
+ */
+void snd_card_registry_cleanup(void)
+{
+	card_registry_lock();
+	card_registry.enabled = 0;
+	snd_card_registry_unwatch();
+	snd_card_registry_invalidate();
+	card_registry_unlock();
+}
+
 /**
  * \brief Try to load the driver for a card.
  * \param card Card number.
@@ -82,7 +329,11 @@ static int snd_card_load1(int card)
  */
 int snd_card_load(int card)
 {
-	return !!(snd_card_load1(card) >= 0);
+	snd_ctl_card_info_t info;
+
+	if (card < 0 || card >= SND_MAX_CARDS)
+		return 0;
+	return !snd_card_info_get(card, &info);
 }
 
 /**
@@ -113,6 +364,99 @@ int snd_card_next(int *rcard)
 	return 0;
 }
 
+/**
+ * \brief Set the card hotplug callback
+ * \param callback Function called for each card which appeared or
+ *        disappeared, NULL to remove the callback
+ * \param private_data Passed to the callback
+ * \result zero if success, otherwise a negative error code
+ *
+ * The callback is invoked from #snd_card_registry_handle_events(),
+ * which should be called when the descriptor returned by
+ * #snd_card_registry_poll_descriptor() becomes readable.  The cards
+ * present when the registry functions are first used are not reported.
+ *
+ * The card functions keep the card information in the registry from
+ * the first call of the registry functions until
+ * #snd_config_update_free_global().  A card id changed through sysfs
+ * is seen only after the next change of the card's control node.
+ */
+int snd_card_registry_set_callback(snd_card_registry_callback_t callback,
+				   void *private_data)
+{
+	int err;
+
+	card_registry_lock();
+	err = snd_card_registry_enable();
+	if (err >= 0) {
+		card_registry.callback = callback;
+		card_registry.callback_private = private_data;
+	}
+	card_registry_unlock();
+	return err;
+}
+
+/**
+ * \brief Get the file descriptor signalling card changes
+ * \result a file descriptor to poll for POLLIN, otherwise a negative
+ *         error code (-ENOSYS when inotify is not supported, -ENOENT
+ *         when the device directory does not exist yet)
+ *
+ * The descriptor is owned by the library.  It changes when the device
+ * directory is removed and created again, so get it again after each
+ * call of #snd_card_registry_handle_events() and after fork().  It is
+ * closed by #snd_config_update_free_global().
+ */
+int snd_card_registry_poll_descriptor(void)
+{
+	int err;
+
+	card_registry_lock();
+	err = snd_card_registry_enable();
+	if (err >= 0)
+		err = card_registry.fd;
+	card_registry_unlock();
+	return err;
+}
+
+/**
+ * \brief Process the pending card changes
+ * \result the number of cards which appeared or disappeared, otherwise
+ *         a negative error code
+ *
+ * Invokes the callback set with #snd_card_registry_set_callback() for
+ * each changed card.  The callback may call the card functions.
+ */
+int snd_card_registry_handle_events(void)
+{
+	unsigned char changed[SND_MAX_CARDS];
+	snd_card_registry_callback_t callback;
+	void *private_data;
+	int card, count = 0, err;
+
+	card_registry_lock();
+	err = snd_card_registry_enable();
+	if (err < 0) {
+		card_registry_unlock();
+		return err;
+	}
+	for (card = 0; card < SND_MAX_CARDS; card++) {
+		struct snd_card_entry *e = &card_registry.cards[card];
+		snd_card_registry_probe(card);
+		/* 0 = unchanged, 1 = disappeared, 2 = appeared */
+		changed[card] = e->present == !e->err ? 0 : 1 + !e->err;
+		e->present = !e->err;
+		count += !!changed[card];
+	}
+	callback = card_registry.callback;
+	private_data = card_registry.callback_private;
+	card_registry_unlock();
+	for (card = 0; callback && card < SND_MAX_CARDS; card++)
+		if (changed[card])
+			callback(card, changed[card] == 2, private_data);
+	return count;
+}
+
 /**
  * \brief Convert card string to an integer value.
  * \param string String containing card identifier
@@ -125,7 +469,6 @@ int snd_card_next(int *rcard)
 int snd_card_get_index(const char *string)
 {
 	int card, err;
-	snd_ctl_t *handle;
 	snd_ctl_card_info_t info;
 
 	if (!string || *string == '\0')
@@ -136,25 +479,16 @@ int snd_card_get_index(const char *string)
 			return -EINVAL;
 		if (card < 0 || card >= SND_MAX_CARDS)
 			return -EINVAL;
-		err = snd_card_load1(card);
+		err = snd_card_info_get(card, &info);
 		if (err >= 0)
 			return card;
 		return err;
 	}
 	if (string[0] == '/')	/* device name */
-		return snd_card_load2(string);
+		return snd_card_load2(string, &info);
 	for (card = 0; card < SND_MAX_CARDS; card++) {
-#ifdef SUPPORT_ALOAD
-		if (! snd_card_load(card))
-			continue;
-#endif
-		if (snd_ctl_hw_open(&handle, NULL, card, 0) < 0)
-			continue;
-		if (snd_ctl_card_info(handle, &info) < 0) {
-			snd_ctl_close(handle);
+		if (snd_card_info_get(card, &info) < 0)
 			continue;
-		}
-		snd_ctl_close(handle);
 		if (!strcmp((const char *)info.id, string))
 			return card;
 	}
@@ -172,19 +506,15 @@ int snd_card_get_index(const char *string)
  */
 int snd_card_get_name(int card, char **name)
 {
-	snd_ctl_t *handle;
 	snd_ctl_card_info_t info;
 	int err;
 	
 	if (name == NULL)
 		return -EINVAL;
-	if ((err = snd_ctl_hw_open(&handle, NULL, card, 0)) < 0)
-		return err;
-	if ((err = snd_ctl_card_info(handle, &info)) < 0) {
-		snd_ctl_close(handle);
+	if (card < 0 || card >= SND_MAX_CARDS)
+		return -EINVAL;
+	if ((err = snd_card_info_get(card, &info)) < 0)
 		return err;
-	}
-	snd_ctl_close(handle);
 	*name = strdup((const char *)info.name);
 	if (*name == NULL)
 		return -ENOMEM;
@@ -202,19 +532,15 @@ int snd_card_get_name(int card, char **name)
  */
 int snd_card_get_longname(int card, char **name)
 {
-	snd_ctl_t *handle;
 	snd_ctl_card_info_t info;
 	int err;
 	
 	if (name == NULL)
 		return -EINVAL;
-	if ((err = snd_ctl_hw_open(&handle, NULL, card, 0)) < 0)
-		return err;
-	if ((err = snd_ctl_card_info(handle, &info)) < 0) {
-		snd_ctl_close(handle);
+	if (card < 0 || card >= SND_MAX_CARDS)
+		return -EINVAL;
+	if ((err = snd_card_info_get(card, &info)) < 0)
 		return err;
-	}
-	snd_ctl_close(handle);
 	*name = strdup((const char *)info.longname);
 	if (*name == NULL)
 		return -ENOMEM;
@@ -485,6 +485,122 @@ int snd_ctl_elem_write(snd_ctl_t *ctl, snd_ctl_elem_value_t *control)
 	return ctl->ops->element_write(ctl, control);
 }
 
+/* use the batch op of the backend, or fall back to one call per element */
+static int snd_ctl_elems_do(snd_ctl_t *ctl, int write,
+			    snd_ctl_elem_value_t **values, unsigned int count,
+			    unsigned int *done)
+{
+	int (*multi)(snd_ctl_t *, snd_ctl_elem_value_t **, unsigned int,
+		     unsigned int *);
+	int (*single)(snd_ctl_t *, snd_ctl_elem_value_t *);
+	unsigned int i;
+	int err = 0;
+
+	multi = write ? ctl->ops->element_write_multi :
+			ctl->ops->element_read_multi;
+	if (multi)
+		return multi(ctl, values, count, done);
+	single = write ? ctl->ops->element_write : ctl->ops->element_read;
+	for (i = 0; i < count; i++) {
+		err = single(ctl, values[i]);
+		if (err < 0)
+			break;
+	}
+	*done = i;
+	return err < 0 ? err : 0;
+}
+
+/**
+ * \brief Get the values of several CTL elements
+ * \param ctl CTL handle
+ * \param values array of CTL element id/value pointers
+ * \param count number of elements in values
+ * \return the number of read values, or a negative error code
+ *
+ * The values are read in the array order, in as few backend round
+ * trips as possible.  When an element fails after others have been
+ * read, the count of the read values is returned.  Call again from
+ * that position to get the error code.
+ */
+int snd_ctl_elems_read(snd_ctl_t *ctl, snd_ctl_elem_value_t **values,
+		       unsigned int count)
+{
+	unsigned int done = 0;
+	int err;
+
+	assert(ctl && (values || !count));
+	err = snd_ctl_elems_do(ctl, 0, values, count, &done);
+	return done > 0 ? (int)done : err;
+}
+
+/**
+ * \brief Set the values of several CTL elements
+ * \param ctl CTL handle
+ * \param values array of CTL element id/value pointers
+ * \param count number of elements in values
+ * \param flags 0 or #SND_CTL_ELEMS_ATOMIC
+ * \return the number of written values, or a negative error code
+ *
+ * Without flags, this works like #snd_ctl_elems_read().  With
+ * #SND_CTL_ELEMS_ATOMIC, the current values are saved first.  If any
+ * element fails, the elements already written get their old values
+ * back, and the error code is returned.  Other clients may still see
+ * the intermediate state.
+ *
+ * Write-only elements cannot be saved and volatile ones may have
+ * changed on their own meanwhile, so neither is restored on failure.
+ */
+int snd_ctl_elems_write(snd_ctl_t *ctl, snd_ctl_elem_value_t **values,
+			unsigned int count, unsigned int flags)
+{
+	snd_ctl_elem_value_t *old = NULL, **oldp = NULL;
+	snd_ctl_elem_info_t info;
+	unsigned int i, saved = 0, done = 0, undone = 0;
+	int err;
+
+	assert(ctl && (values || !count));
+	if (!(flags & SND_CTL_ELEMS_ATOMIC) || !count) {
+		err = snd_ctl_elems_do(ctl, 1, values, count, &done);
+		return done > 0 ? (int)done : err;
+	}
+	old = calloc(count, sizeof(*old));
+	oldp = malloc(count * sizeof(*oldp));
+	if (!old || !oldp) {
+		err = -ENOMEM;
+		goto _end;
+	}
+	for (i = 0; i < count; i++) {
+		memset(&info, 0, sizeof(info));
+		info.id = values[i]->id;
+		err = snd_ctl_elem_info(ctl, &info);
+		if (err < 0)
+			goto _end;
+		if (!snd_ctl_elem_info_is_readable(&info) ||
+		    snd_ctl_elem_info_is_volatile(&info))
+			continue;
+		old[i].id = values[i]->id;
+		oldp[saved++] = &old[i];
+	}
+	err = snd_ctl_elems_do(ctl, 0, oldp, saved, &done);
+	if (err < 0)
+		goto _end;
+	err = snd_ctl_elems_do(ctl, 1, values, count, &done);
+	if (err < 0) {
+		/* the saved values of the elements written so far */
+		for (i = 0; i < saved && oldp[i] < old + done; i++)
+			;
+		if (i > 0 && snd_ctl_elems_do(ctl, 1, oldp, i, &undone) < 0)
+			SNDERR("cannot restore %u of %u elements",
+			       i - undone, i);
+		goto _end;
+	}
+	err = count;
+ _end:
+	free(oldp);
+	free(old);
+	return err;
+}
+
 static int snd_ctl_tlv_do(snd_ctl_t *ctl, int op_flag,
 			  const snd_ctl_elem_id_t *id,
 		          unsigned int *tlv, unsigned int tlv_size)
@@ -735,6 +851,61 @@ int snd_ctl_read(snd_ctl_t *ctl, snd_ctl_event_t *event)
 	return (ctl->ops->read)(ctl, event);
 }
 
+/* read up to count events into a plain array, used also by hcontrol */
+int snd_ctl_read_multi(snd_ctl_t *ctl, snd_ctl_event_t *events,
+		       unsigned int count)
+{
+	unsigned int i;
+	int res;
+
+	if (ctl->ops->read_multi)
+		return ctl->ops->read_multi(ctl, events, count);
+	for (i = 0; i < count; i++) {
+		res = ctl->ops->read(ctl, &events[i]);
+		if (res <= 0)
+			return i > 0 ? (int)i : res;
+		/* a further read could block */
+		if (!ctl->nonblock)
+			return 1;
+	}
+	return i;
+}
+
+/**
+ * \brief Read several events at once
+ * \param ctl CTL handle
+ * \param events Array of event pointers to fill
+ * \param count Number of event pointers in the array
+ * \return number of events read otherwise a negative error code on failure
+ *
+ * Drains up to \p count pending events, in as few backend calls as
+ * possible (a single read() per 16 events for the hw backend).  In
+ * blocking mode, this waits only when no event is pending and may
+ * return less events than are pending.
+ */
+int snd_ctl_read_events(snd_ctl_t *ctl, snd_ctl_event_t **events,
+			unsigned int count)
+{
+	snd_ctl_event_t buf[16];
+	unsigned int i, n, done = 0;
+	int res;
+
+	assert(ctl && (events || !count));
+	while (done < count) {
+		n = count - done;
+		if (n > sizeof(buf) / sizeof(buf[0]))
+			n = sizeof(buf) / sizeof(buf[0]);
+		res = snd_ctl_read_multi(ctl, buf, n);
+		if (res <= 0)
+			return done > 0 ? (int)done : res;
+		for (i = 0; i < (unsigned int)res; i++)
+			*events[done++] = buf[i];
+		if ((unsigned int)res < n || !ctl->nonblock)
+			break;
+	}
+	return done;
+}
+
 /**
  * \brief Wait for a CTL to become ready (i.e. at least one event pending)
  * \param ctl CTL handle
@@ -721,8 +721,10 @@ int snd_ctl_ext_create(snd_ctl_ext_t *ext, const char *name, int mode)
 	ctl->ops = &snd_ctl_ext_ops;
 	ctl->private_data = ext;
 	ctl->poll_fd = ext->poll_fd;
-	if (mode & SND_CTL_NONBLOCK)
+	if (mode & SND_CTL_NONBLOCK) {
 		ext->nonblock = 1;
+		ctl->nonblock = 1;
+	}
 
 	return 0;
 }
@@ -195,6 +195,40 @@ static int snd_ctl_hw_elem_write(snd_ctl_t *handle, snd_ctl_elem_value_t *contro
 	return 0;
 }
 
+static int snd_ctl_hw_elem_read_multi(snd_ctl_t *handle,
+				      snd_ctl_elem_value_t **controls,
+				      unsigned int count, unsigned int *done)
+{
+	snd_ctl_hw_t *hw = handle->private_data;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		if (ioctl(hw->fd, SNDRV_CTL_IOCTL_ELEM_READ, controls[i]) < 0) {
+			*done = i;
+			return -errno;
+		}
+	}
+	*done = count;
+	return 0;
+}
+
+static int snd_ctl_hw_elem_write_multi(snd_ctl_t *handle,
+				       snd_ctl_elem_value_t **controls,
+				       unsigned int count, unsigned int *done)
+{
+	snd_ctl_hw_t *hw = handle->private_data;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		if (ioctl(hw->fd, SNDRV_CTL_IOCTL_ELEM_WRITE, controls[i]) < 0) {
+			*done = i;
+			return -errno;
+		}
+	}
+	*done = count;
+	return 0;
+}
+
 static int snd_ctl_hw_elem_lock(snd_ctl_t *handle, snd_ctl_elem_id_t *id)
 {
 	snd_ctl_hw_t *hw = handle->private_data;
@@ -344,6 +378,21 @@ static int snd_ctl_hw_read(snd_ctl_t *handle, snd_ctl_event_t *event)
 	return 1;
 }
 
+static int snd_ctl_hw_read_multi(snd_ctl_t *handle, snd_ctl_event_t *events,
+				 unsigned int count)
+{
+	snd_ctl_hw_t *hw = handle->private_data;
+	ssize_t res = read(hw->fd, events, count * sizeof(*events));
+	if (res <= 0)
+		return -errno;
+	if (CHECK_SANITY(res % sizeof(*events))) {
+		SNDMSG("snd_ctl_hw_read_multi: read size error (req:%d, got:%d)\n",
+		       count * sizeof(*events), res);
+		return -EINVAL;
+	}
+	return res / sizeof(*events);
+}
+
 static const snd_ctl_ops_t snd_ctl_hw_ops = {
 	.close = snd_ctl_hw_close,
 	.nonblock = snd_ctl_hw_nonblock,
@@ -357,6 +406,8 @@ static const snd_ctl_ops_t snd_ctl_hw_ops = {
 	.element_remove = snd_ctl_hw_elem_remove,
 	.element_read = snd_ctl_hw_elem_read,
 	.element_write = snd_ctl_hw_elem_write,
+	.element_read_multi = snd_ctl_hw_elem_read_multi,
+	.element_write_multi = snd_ctl_hw_elem_write_multi,
 	.element_lock = snd_ctl_hw_elem_lock,
 	.element_unlock = snd_ctl_hw_elem_unlock,
 	.element_tlv = snd_ctl_hw_elem_tlv,
@@ -371,6 +422,7 @@ static const snd_ctl_ops_t snd_ctl_hw_ops = {
 	.set_power_state = snd_ctl_hw_set_power_state,
 	.get_power_state = snd_ctl_hw_get_power_state,
 	.read = snd_ctl_hw_read,
+	.read_multi = snd_ctl_hw_read_multi,
 };
 
 int snd_ctl_hw_open(snd_ctl_t **handle, const char *name, int card, int mode)
@@ -431,6 +483,7 @@ int snd_ctl_hw_open(snd_ctl_t **handle, const char *name, int card, int mode)
 	ctl->ops = &snd_ctl_hw_ops;
 	ctl->private_data = hw;
 	ctl->poll_fd = fd;
+	ctl->nonblock = !!(mode & SND_CTL_NONBLOCK);
 	*handle = ctl;
 	return 0;
 }
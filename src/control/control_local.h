@@ -34,6 +34,11 @@ typedef struct _snd_ctl_ops {
 	int (*element_remove)(snd_ctl_t *handle, snd_ctl_elem_id_t *id);
 	int (*element_read)(snd_ctl_t *handle, snd_ctl_elem_value_t *control);
 	int (*element_write)(snd_ctl_t *handle, snd_ctl_elem_value_t *control);
+	/* optional; process count values, store the number done */
+	int (*element_read_multi)(snd_ctl_t *handle, snd_ctl_elem_value_t **controls,
+				  unsigned int count, unsigned int *done);
+	int (*element_write_multi)(snd_ctl_t *handle, snd_ctl_elem_value_t **controls,
+				   unsigned int count, unsigned int *done);
 	int (*element_lock)(snd_ctl_t *handle, snd_ctl_elem_id_t *lock);
 	int (*element_unlock)(snd_ctl_t *handle, snd_ctl_elem_id_t *unlock);
 	int (*element_tlv)(snd_ctl_t *handle, int op_flag, unsigned int numid,
@@ -49,6 +54,9 @@ typedef struct _snd_ctl_ops {
 	int (*set_power_state)(snd_ctl_t *handle, unsigned int state);
 	int (*get_power_state)(snd_ctl_t *handle, unsigned int *state);
 	int (*read)(snd_ctl_t *handle, snd_ctl_event_t *event);
+	/* optional; read up to count pending events at once */
+	int (*read_multi)(snd_ctl_t *handle, snd_ctl_event_t *events,
+			  unsigned int count);
 	int (*poll_descriptors_count)(snd_ctl_t *handle);
 	int (*poll_descriptors)(snd_ctl_t *handle, struct pollfd *pfds, unsigned int space);
 	int (*poll_revents)(snd_ctl_t *handle, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
@@ -66,6 +74,15 @@ struct _snd_ctl {
 	struct list_head async_handlers;
 };
 
+/* element state kept by snd_hctl_set_cache() */
+struct snd_hctl_elem_cache {
+	unsigned int valid;		/* SNDRV_CTL_EVENT_MASK_* of valid parts */
+	snd_ctl_elem_info_t info;
+	snd_ctl_elem_value_t value;
+	unsigned int *tlv;
+	unsigned int tlv_size;		/* in bytes */
+};
+
 struct _snd_hctl_elem {
 	snd_ctl_elem_id_t id; 		/* must be always on top */
 	struct list_head list;		/* links for list of all helems */
@@ -75,6 +92,8 @@ struct _snd_hctl_elem {
 	void *callback_private;
 	/* links */
 	snd_hctl_t *hctl;		/* associated handle */
+	struct snd_hctl_elem_cache *cache;
+	int removed;			/* waits for compaction of pelems */
 };
 
 struct _snd_hctl {
@@ -82,17 +101,24 @@ struct _snd_hctl {
 	struct list_head elems;		/* list of all controls */
 	unsigned int alloc;	
 	unsigned int count;
+	unsigned int removed;		/* removed elements still in pelems */
 	snd_hctl_elem_t **pelems;
 	snd_hctl_compare_t compare;
 	snd_hctl_callback_t callback;
 	void *callback_private;
+	int cache;			/* value/TLV cache enabled */
+	unsigned long cache_hits;
+	unsigned long cache_misses;
 };
 
 
 /* make local functions really local */
 #define snd_ctl_new	snd1_ctl_new
+#define snd_ctl_read_multi	snd1_ctl_read_multi
 
 int snd_ctl_new(snd_ctl_t **ctlp, snd_ctl_type_t type, const char *name);
+int snd_ctl_read_multi(snd_ctl_t *ctl, snd_ctl_event_t *events,
+		       unsigned int count);
 int _snd_ctl_poll_descriptor(snd_ctl_t *ctl);
 #define _snd_ctl_async_descriptor _snd_ctl_poll_descriptor
 int snd_ctl_hw_open(snd_ctl_t **handle, const char *name, int card, int mode);
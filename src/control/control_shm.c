@@ -214,6 +214,69 @@ static int snd_ctl_shm_elem_write(snd_ctl_t *ctl, snd_ctl_elem_value_t *control)
 	return err;
 }
 
+/* pass as many values per request as fit into the data area */
+static int snd_ctl_shm_elems_do(snd_ctl_t *ctl, int cmd,
+				snd_ctl_elem_value_t **controls,
+				unsigned int count, unsigned int *done)
+{
+	snd_ctl_shm_t *shm = ctl->private_data;
+	volatile snd_ctl_shm_ctrl_t *ctrl = shm->ctrl;
+	snd_ctl_elem_value_t *buf = (snd_ctl_elem_value_t *)ctrl->data;
+	unsigned int i, n, max = CTL_SHM_DATA_MAXLEN / sizeof(*buf);
+	int err;
+
+	*done = 0;
+	while (*done < count) {
+		n = count - *done;
+		if (n > max)
+			n = max;
+		for (i = 0; i < n; i++)
+			buf[i] = *controls[*done + i];
+		ctrl->u.elems.count = n;
+		ctrl->u.elems.done = 0;
+		ctrl->cmd = cmd;
+		err = snd_ctl_shm_action(ctl);
+		if (err == -ENOSYS && *done == 0)
+			goto _single;	/* older server */
+		if (ctrl->u.elems.done < n)
+			n = ctrl->u.elems.done;
+		for (i = 0; i < n; i++)
+			*controls[*done + i] = buf[i];
+		*done += n;
+		if (err < 0)
+			return err;
+	}
+	return 0;
+
+ _single:
+	for (i = 0; i < count; i++) {
+		if (cmd == SND_CTL_IOCTL_ELEMS_READ)
+			err = snd_ctl_shm_elem_read(ctl, controls[i]);
+		else
+			err = snd_ctl_shm_elem_write(ctl, controls[i]);
+		if (err < 0)
+			break;
+	}
+	*done = i;
+	return err < 0 ? err : 0;
+}
+
+static int snd_ctl_shm_elem_read_multi(snd_ctl_t *ctl,
+				       snd_ctl_elem_value_t **controls,
+				       unsigned int count, unsigned int *done)
+{
+	return snd_ctl_shm_elems_do(ctl, SND_CTL_IOCTL_ELEMS_READ,
+				    controls, count, done);
+}
+
+static int snd_ctl_shm_elem_write_multi(snd_ctl_t *ctl,
+					snd_ctl_elem_value_t **controls,
+					unsigned int count, unsigned int *done)
+{
+	return snd_ctl_shm_elems_do(ctl, SND_CTL_IOCTL_ELEMS_WRITE,
+				    controls, count, done);
+}
+
 static int snd_ctl_shm_elem_lock(snd_ctl_t *ctl, snd_ctl_elem_id_t *id)
 {
 	snd_ctl_shm_t *shm = ctl->private_data;
@@ -407,6 +470,8 @@ static const snd_ctl_ops_t snd_ctl_shm_ops = {
 	.element_info = snd_ctl_shm_elem_info,
 	.element_read = snd_ctl_shm_elem_read,
 	.element_write = snd_ctl_shm_elem_write,
+	.element_read_multi = snd_ctl_shm_elem_read_multi,
+	.element_write_multi = snd_ctl_shm_elem_write_multi,
 	.element_lock = snd_ctl_shm_elem_lock,
 	.element_unlock = snd_ctl_shm_elem_unlock,
 	.hwdep_next_device = snd_ctl_shm_hwdep_next_device,
@@ -519,6 +584,7 @@ int snd_ctl_shm_open(snd_ctl_t **handlep, const char *name, const char *sockname
 	}
 	ctl->ops = &snd_ctl_shm_ops;
 	ctl->private_data = shm;
+	ctl->nonblock = !!(mode & SND_CTL_NONBLOCK);
 	err = snd_ctl_shm_poll_descriptor(ctl);
 	if (err < 0) {
 		snd_ctl_close(ctl);
@@ -40,6 +40,19 @@
 <P> High level control interface caches the accesses to primitive controls
 to reduce overhead accessing the real controls in kernel drivers.
 
+\section hcontrol_cache Element cache
+
+<P> When enabled with #snd_hctl_set_cache(), the element value and TLV
+data are kept after the first read.  Later calls of #snd_hctl_elem_read()
+and #snd_hctl_elem_tlv_read() return the stored copy without an ioctl.
+The copy is dropped when #snd_hctl_handle_events() receives the matching
+change event or when the element is written through the HCTL handle.
+The cached data is thus as recent as the last processed event.  Values
+of volatile elements are never cached.  #snd_hctl_elem_info() always
+asks the driver, because the lock owner reported in the info changes
+without an event.  #snd_hctl_get_cache_stats() reports the hit and miss
+counts.
+
 */
 
 #include <stdio.h>
@@ -343,40 +356,34 @@ static int _snd_hctl_find_elem(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id, in
 	return idx;
 }
 
-static int snd_hctl_elem_add(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
+static void snd_hctl_elem_cache_free(snd_hctl_elem_t *elem)
 {
-	int dir;
-	int idx; 
-	elem->compare_weight = get_compare_weight(&elem->id);
-	if (hctl->count == hctl->alloc) {
-		snd_hctl_elem_t **h;
-		hctl->alloc += 32;
-		h = realloc(hctl->pelems, sizeof(*h) * hctl->alloc);
-		if (!h) {
-			hctl->alloc -= 32;
-			return -ENOMEM;
-		}
-		hctl->pelems = h;
+	if (elem->cache) {
+		free(elem->cache->tlv);
+		free(elem->cache);
+		elem->cache = NULL;
 	}
-	if (hctl->count == 0) {
-		list_add_tail(&elem->list, &hctl->elems);
-		hctl->pelems[0] = elem;
-	} else {
-		idx = _snd_hctl_find_elem(hctl, &elem->id, &dir);
-		assert(dir != 0);
-		if (dir > 0) {
-			list_add(&elem->list, &hctl->pelems[idx]->list);
-			idx++;
-		} else {
-			list_add_tail(&elem->list, &hctl->pelems[idx]->list);
-		}
-		memmove(hctl->pelems + idx + 1,
-			hctl->pelems + idx,
-			(hctl->count - idx) * sizeof(snd_hctl_elem_t *));
-		hctl->pelems[idx] = elem;
-	}
-	hctl->count++;
-	return snd_hctl_throw_event(hctl, SNDRV_CTL_EVENT_MASK_ADD, elem);
+}
+
+/* mask is a set of SNDRV_CTL_EVENT_MASK_* bits */
+static void snd_hctl_elem_cache_invalidate(snd_hctl_elem_t *elem,
+					   unsigned int mask)
+{
+	if (!elem->cache)
+		return;
+	/* info changes may change the value layout, too */
+	if (mask & SNDRV_CTL_EVENT_MASK_INFO)
+		mask |= SNDRV_CTL_EVENT_MASK_VALUE;
+	elem->cache->valid &= ~mask;
+}
+
+static struct snd_hctl_elem_cache *snd_hctl_elem_cache(snd_hctl_elem_t *elem)
+{
+	if (!elem->hctl->cache)
+		return NULL;
+	if (!elem->cache)
+		elem->cache = calloc(1, sizeof(*elem->cache));
+	return elem->cache;
 }
 
 static void snd_hctl_elem_remove(snd_hctl_t *hctl, unsigned int idx)
@@ -385,6 +392,7 @@ static void snd_hctl_elem_remove(snd_hctl_t *hctl, unsigned int idx)
 	unsigned int m;
 	snd_hctl_elem_throw_event(elem, SNDRV_CTL_EVENT_MASK_REMOVE);
 	list_del(&elem->list);
+	snd_hctl_elem_cache_free(elem);
 	free(elem);
 	hctl->count--;
 	m = hctl->count - idx;
@@ -435,8 +443,10 @@ static void snd_hctl_sort(snd_hctl_t *hctl)
 #ifdef HAVE_LIBPTHREAD
 	pthread_mutex_unlock(&sync_lock);
 #endif
-	for (k = 0; k < hctl->count; k++)
-		list_add_tail(&hctl->pelems[k]->list, &hctl->elems);
+	for (k = 0; k < hctl->count; k++) {
+		if (!hctl->pelems[k]->removed)
+			list_add_tail(&hctl->pelems[k]->list, &hctl->elems);
+	}
 }
 
 /**
@@ -552,7 +562,7 @@ snd_hctl_elem_t *snd_hctl_find_elem(snd_hctl_t *hctl, const snd_ctl_elem_id_t *i
 {
 	int dir;
 	int res = _snd_hctl_find_elem(hctl, id, &dir);
-	if (res < 0 || dir != 0)
+	if (res < 0 || dir != 0 || hctl->pelems[res]->removed)
 		return NULL;
 	return hctl->pelems[res];
 }
@@ -661,7 +671,7 @@ void *snd_hctl_get_callback_private(snd_hctl_t *hctl)
  */
 unsigned int snd_hctl_get_count(snd_hctl_t *hctl)
 {
-	return hctl->count;
+	return hctl->count - hctl->removed;
 }
 
 /**
@@ -726,7 +736,170 @@ snd_ctl_t *snd_hctl_ctl(snd_hctl_t *hctl)
 	return hctl->ctl;
 }
 
-static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
+/**
+ * \brief Enable or disable the element cache of an HCTL handle
+ * \param hctl HCTL handle
+ * \param enable 0 = disable and drop all cached data, 1 = enable
+ * \return 0 on success otherwise a negative error code
+ *
+ * The cache relies on change events, so the handle is subscribed to
+ * them when enabling.  The application must call
+ * #snd_hctl_handle_events() to let the cache notice the changes.
+ */
+int snd_hctl_set_cache(snd_hctl_t *hctl, int enable)
+{
+	struct list_head *pos;
+	int err;
+
+	assert(hctl);
+	if (enable) {
+		err = snd_ctl_subscribe_events(hctl->ctl, 1);
+		if (err < 0)
+			return err;
+		hctl->cache = 1;
+		return 0;
+	}
+	hctl->cache = 0;
+	list_for_each(pos, &hctl->elems)
+		snd_hctl_elem_cache_free(list_entry(pos, snd_hctl_elem_t, list));
+	return 0;
+}
+
+/**
+ * \brief Get the element cache statistics of an HCTL handle
+ * \param hctl HCTL handle
+ * \param hits Returned count of requests served from the cache, or NULL
+ * \param misses Returned count of cacheable requests which needed an ioctl, or NULL
+ */
+void snd_hctl_get_cache_stats(snd_hctl_t *hctl, unsigned long *hits,
+			      unsigned long *misses)
+{
+	assert(hctl);
+	if (hits)
+		*hits = hctl->cache_hits;
+	if (misses)
+		*misses = hctl->cache_misses;
+}
+
+/*
+ * Elements added or removed by a burst of events are not inserted into
+ * or deleted from pelems one by one.  New elements are collected and
+ * merged with a single sort, removed ones are only unlinked and counted
+ * in hctl->removed until they are dropped in one pass.
+ */
+struct snd_hctl_batch {
+	snd_hctl_elem_t **add;		/* in event order */
+	unsigned int add_count;
+	unsigned int add_alloc;
+};
+
+static void snd_hctl_batch_compact(snd_hctl_t *hctl)
+{
+	unsigned int i, count = 0;
+
+	if (!hctl->removed)
+		return;
+	for (i = 0; i < hctl->count; i++) {
+		snd_hctl_elem_t *elem = hctl->pelems[i];
+		if (elem->removed) {
+			snd_hctl_elem_cache_free(elem);
+			free(elem);
+			continue;
+		}
+		hctl->pelems[count++] = elem;
+	}
+	hctl->count = count;
+	hctl->removed = 0;
+}
+
+static int snd_hctl_batch_merge(snd_hctl_t *hctl,
+				struct snd_hctl_batch *batch)
+{
+	unsigned int n = batch->add_count, i, j, k;
+	snd_hctl_elem_t **sorted;
+	int res, err = 0;
+
+	if (!n)
+		return 0;
+	batch->add_count = 0;
+	/* the new elements are linked next to their neighbours in pelems */
+	snd_hctl_batch_compact(hctl);
+	if (hctl->count + n > hctl->alloc) {
+		unsigned int alloc = hctl->alloc ? hctl->alloc : 32;
+		snd_hctl_elem_t **h;
+		while (alloc < hctl->count + n)
+			alloc *= 2;
+		h = realloc(hctl->pelems, sizeof(*h) * alloc);
+		if (!h) {
+			err = -ENOMEM;
+			goto _free;
+		}
+		hctl->pelems = h;
+		hctl->alloc = alloc;
+	}
+	sorted = malloc(n * sizeof(*sorted));
+	if (!sorted) {
+		err = -ENOMEM;
+		goto _free;
+	}
+	memcpy(sorted, batch->add, n * sizeof(*sorted));
+	if (!hctl->compare)
+		hctl->compare = snd_hctl_compare_default;
+	compare_hctl = hctl;
+	qsort(sorted, n, sizeof(*sorted), hctl_compare);
+	/*
+	 * merge from the end so that pelems needs no temporary copy; the
+	 * successor of a new element is already in place, so it is linked
+	 * in front of it and the rest of the list is left alone
+	 */
+	i = hctl->count;
+	j = n;
+	k = i + j;
+	while (j > 0) {
+		if (i > 0 && hctl->compare(hctl->pelems[i - 1], sorted[j - 1]) > 0) {
+			hctl->pelems[--k] = hctl->pelems[--i];
+			continue;
+		}
+		hctl->pelems[--k] = sorted[--j];
+		if (k + 1 < hctl->count + n)
+			list_add_tail(&hctl->pelems[k]->list,
+				      &hctl->pelems[k + 1]->list);
+		else
+			list_add_tail(&hctl->pelems[k]->list, &hctl->elems);
+	}
+	hctl->count += n;
+	free(sorted);
+	for (i = 0; i < n; i++) {
+		res = snd_hctl_throw_event(hctl, SNDRV_CTL_EVENT_MASK_ADD,
+					   batch->add[i]);
+		if (res < 0 && !err)
+			err = res;
+	}
+	return err;
+
+ _free:
+	for (i = 0; i < n; i++)
+		free(batch->add[i]);
+	return err;
+}
+
+static int snd_hctl_batch_add(struct snd_hctl_batch *batch,
+			      snd_hctl_elem_t *elem)
+{
+	if (batch->add_count == batch->add_alloc) {
+		unsigned int alloc = batch->add_alloc ? batch->add_alloc * 2 : 32;
+		snd_hctl_elem_t **h = realloc(batch->add, sizeof(*h) * alloc);
+		if (!h)
+			return -ENOMEM;
+		batch->add = h;
+		batch->add_alloc = alloc;
+	}
+	batch->add[batch->add_count++] = elem;
+	return 0;
+}
+
+static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event,
+				 struct snd_hctl_batch *batch)
 {
 	snd_hctl_elem_t *elem;
 	int res;
@@ -741,28 +914,54 @@ static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 	}
 	if (event->data.elem.mask == SNDRV_CTL_EVENT_MASK_REMOVE) {
 		int dir;
+		res = snd_hctl_batch_merge(hctl, batch);
+		if (res < 0)
+			return res;
 		res = _snd_hctl_find_elem(hctl, &event->data.elem.id, &dir);
 		assert(res >= 0 && dir == 0);
-		if (res < 0 || dir != 0)
+		if (res < 0 || dir != 0 || hctl->pelems[res]->removed)
 			return -ENOENT;
-		snd_hctl_elem_remove(hctl, (unsigned int) res);
+		elem = hctl->pelems[res];
+		snd_hctl_elem_throw_event(elem, SNDRV_CTL_EVENT_MASK_REMOVE);
+		list_del(&elem->list);
+		elem->removed = 1;
+		hctl->removed++;
 		return 0;
 	}
+	snd_hctl_batch_compact(hctl);
 	if (event->data.elem.mask & SNDRV_CTL_EVENT_MASK_ADD) {
 		elem = calloc(1, sizeof(snd_hctl_elem_t));
 		if (elem == NULL)
 			return -ENOMEM;
 		elem->id = event->data.elem.id;
 		elem->hctl = hctl;
-		res = snd_hctl_elem_add(hctl, elem);
-		if (res < 0)
+		elem->compare_weight = get_compare_weight(&elem->id);
+		res = snd_hctl_batch_add(batch, elem);
+		if (res < 0) {
+			free(elem);
 			return res;
+		}
+		if (!(event->data.elem.mask & (SNDRV_CTL_EVENT_MASK_VALUE |
+					       SNDRV_CTL_EVENT_MASK_INFO |
+					       SNDRV_CTL_EVENT_MASK_TLV)))
+			return 0;
+	}
+	/* other changes need the elements in place */
+	res = snd_hctl_batch_merge(hctl, batch);
+	if (res < 0)
+		return res;
+	if (hctl->cache &&
+	    (event->data.elem.mask & SNDRV_CTL_EVENT_MASK_TLV)) {
+		elem = snd_hctl_find_elem(hctl, &event->data.elem.id);
+		if (elem)
+			snd_hctl_elem_cache_invalidate(elem, SNDRV_CTL_EVENT_MASK_TLV);
 	}
 	if (event->data.elem.mask & (SNDRV_CTL_EVENT_MASK_VALUE |
 				     SNDRV_CTL_EVENT_MASK_INFO)) {
 		elem = snd_hctl_find_elem(hctl, &event->data.elem.id);
 		if (!elem)
 			return -ENOENT;
+		snd_hctl_elem_cache_invalidate(elem, event->data.elem.mask);
 		res = snd_hctl_elem_throw_event(elem, event->data.elem.mask &
 						(SNDRV_CTL_EVENT_MASK_VALUE |
 						 SNDRV_CTL_EVENT_MASK_INFO));
@@ -772,31 +971,124 @@ static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 	return 0;
 }
 
-/**
- * \brief Handle pending HCTL events invoking callbacks
- * \param hctl HCTL handle
- * \return 0 otherwise a negative error code on failure
+/* events fetched per read */
+#define HCTL_EVENTS_BATCH	32
+
+static int snd_hctl_event_same_elem(const snd_ctl_event_t *e1,
+				    const snd_ctl_event_t *e2)
+{
+	const snd_ctl_elem_id_t *id1 = &e1->data.elem.id;
+	const snd_ctl_elem_id_t *id2 = &e2->data.elem.id;
+
+	if (id1->numid && id2->numid)
+		return id1->numid == id2->numid;
+	return id1->iface == id2->iface &&
+	       id1->device == id2->device &&
+	       id1->subdevice == id2->subdevice &&
+	       id1->index == id2->index &&
+	       !strcmp((const char *)id1->name, (const char *)id2->name);
+}
+
+/*
+ * Drop the value-only events which are followed by another value change
+ * of the same element; the callback is invoked once, at the position of
+ * the last change.  Returns the new number of events.
  */
-int snd_hctl_handle_events(snd_hctl_t *hctl)
+static unsigned int snd_hctl_coalesce_events(snd_ctl_event_t *events,
+					     unsigned int count)
 {
-	snd_ctl_event_t event;
-	int res;
-	unsigned int count = 0;
+	unsigned int i, j, n = 0;
+
+	for (i = 0; i < count; i++) {
+		snd_ctl_event_t *ev = &events[i];
+		int drop = 0;
+		if (ev->type == SND_CTL_EVENT_ELEM &&
+		    ev->data.elem.mask == SNDRV_CTL_EVENT_MASK_VALUE) {
+			for (j = i + 1; j < count; j++) {
+				unsigned int mask = events[j].data.elem.mask;
+				if (events[j].type != SND_CTL_EVENT_ELEM ||
+				    !snd_hctl_event_same_elem(ev, &events[j]))
+					continue;
+				/* a new element with the same id, keep */
+				if (mask == SNDRV_CTL_EVENT_MASK_REMOVE ||
+				    (mask & SNDRV_CTL_EVENT_MASK_ADD))
+					break;
+				if (mask & SNDRV_CTL_EVENT_MASK_VALUE) {
+					drop = 1;
+					break;
+				}
+			}
+		}
+		if (drop)
+			continue;
+		if (n != i)
+			events[n] = *ev;
+		n++;
+	}
+	return n;
+}
+
+static int snd_hctl_handle_events1(snd_hctl_t *hctl, int coalesce)
+{
+	snd_ctl_event_t events[HCTL_EVENTS_BATCH];
+	struct snd_hctl_batch batch;
+	int res, err;
+	unsigned int i, n, count = 0;
 	
 	assert(hctl);
 	assert(hctl->ctl);
-	while ((res = snd_ctl_read(hctl->ctl, &event)) != 0 &&
-	       res != -EAGAIN) {
-		if (res < 0)
-			return res;
-		res = snd_hctl_handle_event(hctl, &event);
-		if (res < 0)
-			return res;
-		count++;
+	memset(&batch, 0, sizeof(batch));
+	while ((res = snd_ctl_read_multi(hctl->ctl, events,
+					 HCTL_EVENTS_BATCH)) > 0) {
+		count += res;
+		n = res;
+		if (coalesce)
+			n = snd_hctl_coalesce_events(events, n);
+		for (i = 0; i < n; i++) {
+			err = snd_hctl_handle_event(hctl, &events[i], &batch);
+			if (err < 0) {
+				res = err;
+				goto _flush;
+			}
+		}
 	}
+ _flush:
+	snd_hctl_batch_compact(hctl);
+	err = snd_hctl_batch_merge(hctl, &batch);
+	free(batch.add);
+	if (res < 0 && res != -EAGAIN)
+		return res;
+	if (err < 0)
+		return err;
 	return count;
 }
 
+/**
+ * \brief Handle pending HCTL events invoking callbacks
+ * \param hctl HCTL handle
+ * \return 0 otherwise a negative error code on failure
+ */
+int snd_hctl_handle_events(snd_hctl_t *hctl)
+{
+	return snd_hctl_handle_events1(hctl, 0);
+}
+
+/**
+ * \brief Handle pending HCTL events, merging repeated value changes
+ * \param hctl HCTL handle
+ * \return number of events read otherwise a negative error code on failure
+ *
+ * Works like #snd_hctl_handle_events(), but when the same element
+ * reports several value changes among the pending events, its callback
+ * is invoked only once, for the last of them.  Useful when the
+ * application only cares about the final state, e.g. while a volume
+ * knob is turned.
+ */
+int snd_hctl_handle_events_coalesce(snd_hctl_t *hctl)
+{
+	return snd_hctl_handle_events1(hctl, 1);
+}
+
 /**
  * \brief Get information for an HCTL element
  * \param elem HCTL element
@@ -805,11 +1097,37 @@ int snd_hctl_handle_events(snd_hctl_t *hctl)
  */
 int snd_hctl_elem_info(snd_hctl_elem_t *elem, snd_ctl_elem_info_t *info)
 {
+	struct snd_hctl_elem_cache *cache;
+	int err;
+
 	assert(elem);
 	assert(elem->hctl);
 	assert(info);
 	info->id = elem->id;
-	return snd_ctl_elem_info(elem->hctl->ctl, info);
+	/*
+	 * the lock owner changes without an event, so the info is always
+	 * read; the cached copy only decides whether the value is cached
+	 */
+	err = snd_ctl_elem_info(elem->hctl->ctl, info);
+	cache = snd_hctl_elem_cache(elem);
+	if (cache && err >= 0) {
+		cache->info = *info;
+		cache->valid |= SNDRV_CTL_EVENT_MASK_INFO;
+	}
+	return err;
+}
+
+/* volatile values may change without an event */
+static int snd_hctl_elem_value_cacheable(snd_hctl_elem_t *elem,
+					 struct snd_hctl_elem_cache *cache)
+{
+	if (!(cache->valid & SNDRV_CTL_EVENT_MASK_INFO)) {
+		cache->info.id = elem->id;
+		if (snd_ctl_elem_info(elem->hctl->ctl, &cache->info) < 0)
+			return 0;
+		cache->valid |= SNDRV_CTL_EVENT_MASK_INFO;
+	}
+	return !snd_ctl_elem_info_is_volatile(&cache->info);
 }
 
 /**
@@ -820,11 +1138,28 @@ int snd_hctl_elem_info(snd_hctl_elem_t *elem, snd_ctl_elem_info_t *info)
  */
 int snd_hctl_elem_read(snd_hctl_elem_t *elem, snd_ctl_elem_value_t * value)
 {
+	struct snd_hctl_elem_cache *cache;
+	int err;
+
 	assert(elem);
 	assert(elem->hctl);
 	assert(value);
 	value->id = elem->id;
-	return snd_ctl_elem_read(elem->hctl->ctl, value);
+	cache = snd_hctl_elem_cache(elem);
+	if (cache && (cache->valid & SNDRV_CTL_EVENT_MASK_VALUE)) {
+		*value = cache->value;
+		elem->hctl->cache_hits++;
+		return 0;
+	}
+	err = snd_ctl_elem_read(elem->hctl->ctl, value);
+	if (cache) {
+		elem->hctl->cache_misses++;
+		if (err >= 0 && snd_hctl_elem_value_cacheable(elem, cache)) {
+			cache->value = *value;
+			cache->valid |= SNDRV_CTL_EVENT_MASK_VALUE;
+		}
+	}
+	return err;
 }
 
 /**
@@ -841,6 +1176,7 @@ int snd_hctl_elem_write(snd_hctl_elem_t *elem, snd_ctl_elem_value_t * value)
 	assert(elem->hctl);
 	assert(value);
 	value->id = elem->id;
+	snd_hctl_elem_cache_invalidate(elem, SNDRV_CTL_EVENT_MASK_VALUE);
 	return snd_ctl_elem_write(elem->hctl->ctl, value);
 }
 
@@ -853,10 +1189,36 @@ int snd_hctl_elem_write(snd_hctl_elem_t *elem, snd_ctl_elem_value_t * value)
  */
 int snd_hctl_elem_tlv_read(snd_hctl_elem_t *elem, unsigned int *tlv, unsigned int tlv_size)
 {
+	struct snd_hctl_elem_cache *cache;
+	unsigned int size;
+	int err;
+
 	assert(elem);
 	assert(tlv);
 	assert(tlv_size >= 12);
-	return snd_ctl_elem_tlv_read(elem->hctl->ctl, &elem->id, tlv, tlv_size);
+	cache = snd_hctl_elem_cache(elem);
+	if (cache && (cache->valid & SNDRV_CTL_EVENT_MASK_TLV) &&
+	    cache->tlv_size <= tlv_size) {
+		memcpy(tlv, cache->tlv, cache->tlv_size);
+		elem->hctl->cache_hits++;
+		return 0;
+	}
+	err = snd_ctl_elem_tlv_read(elem->hctl->ctl, &elem->id, tlv, tlv_size);
+	if (cache) {
+		elem->hctl->cache_misses++;
+		if (err >= 0 && tlv[1] <= tlv_size - 2 * sizeof(unsigned int)) {
+			unsigned int *p;
+			size = tlv[1] + 2 * sizeof(unsigned int);
+			p = realloc(cache->tlv, size);
+			if (p) {
+				memcpy(p, tlv, size);
+				cache->tlv = p;
+				cache->tlv_size = size;
+				cache->valid |= SNDRV_CTL_EVENT_MASK_TLV;
+			}
+		}
+	}
+	return err;
 }
 
 /**
@@ -872,6 +1234,7 @@ int snd_hctl_elem_tlv_write(snd_hctl_elem_t *elem, const unsigned int *tlv)
 	assert(elem);
 	assert(tlv);
 	assert(tlv[1] >= 4);
+	snd_hctl_elem_cache_invalidate(elem, SNDRV_CTL_EVENT_MASK_TLV);
 	return snd_ctl_elem_tlv_write(elem->hctl->ctl, &elem->id, tlv);
 }
 
@@ -888,6 +1251,7 @@ int snd_hctl_elem_tlv_command(snd_hctl_elem_t *elem, const unsigned int *tlv)
 	assert(elem);
 	assert(tlv);
 	assert(tlv[1] >= 4);
+	snd_hctl_elem_cache_invalidate(elem, SNDRV_CTL_EVENT_MASK_TLV);
 	return snd_ctl_elem_tlv_command(elem->hctl->ctl, &elem->id, tlv);
 }
 
@@ -26,6 +26,10 @@
  */
 
 #include "local.h"
+#include <sys/stat.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef DOC_HIDDEN
 struct hint_list {
@@ -493,6 +497,120 @@ static int get_card_name(struct hint_list *list, int card)
 	return 0;
 }
 
+#ifndef DOC_HIDDEN
+/* per card probing, run in parallel when there are several cards */
+struct hint_card {
+	struct hint_list list;
+	snd_config_t *config;
+	snd_config_t *rw_config;
+	int card;
+	int err;
+	int probed;
+#ifdef HAVE_LIBPTHREAD
+	pthread_t thread;
+	int started;
+#endif
+};
+#endif
+
+static void *hint_card_probe(void *arg)
+{
+	struct hint_card *hc = arg;
+
+	hc->probed = 1;
+	hc->err = get_card_name(&hc->list, hc->card);
+	if (hc->err >= 0)
+		hc->err = add_card(hc->config, hc->rw_config, &hc->list,
+				   hc->card);
+	return NULL;
+}
+
+/* move the hints of a card to the main list */
+static int hint_list_move(struct hint_list *list, struct hint_list *from)
+{
+	unsigned int i;
+
+	for (i = 0; i < from->count; i++) {
+		if (list->count + 1 >= list->allocated) {
+			unsigned int alloc = list->allocated + from->count + 10;
+			char **n = realloc(list->list, alloc * sizeof(char *));
+			if (n == NULL)
+				return -ENOMEM;
+			memset(n + list->allocated, 0,
+			       (alloc - list->allocated) * sizeof(*n));
+			list->allocated = alloc;
+			list->list = n;
+		}
+		list->list[list->count++] = from->list[i];
+		from->list[i] = NULL;
+	}
+	return 0;
+}
+
+static int add_cards(snd_config_t *config, snd_config_t *rw_config,
+		     struct hint_list *list)
+{
+	struct hint_card *hc = NULL, *n;
+	unsigned int i, count = 0;
+	int card = -1, err;
+
+	while ((err = snd_card_next(&card)) >= 0 && card >= 0) {
+		n = realloc(hc, (count + 1) * sizeof(*hc));
+		if (n == NULL) {
+			err = -ENOMEM;
+			break;
+		}
+		hc = n;
+		memset(&hc[count], 0, sizeof(*hc));
+		hc[count].list.siface = list->siface;
+		hc[count].list.iface = list->iface;
+		hc[count].list.show_all = list->show_all;
+		hc[count].config = config;
+		hc[count].rw_config = rw_config;
+		hc[count].card = card;
+		count++;
+	}
+	if (err < 0)
+		goto __free;
+#ifdef HAVE_LIBPTHREAD
+	/* the expansion modifies the config, each probe needs a copy */
+	for (i = 0; count > 1 && i < count; i++) {
+		if (snd_config_copy(&hc[i].rw_config, config) < 0) {
+			hc[i].rw_config = rw_config;
+			continue;
+		}
+		if (pthread_create(&hc[i].thread, NULL, hint_card_probe,
+				   &hc[i]) == 0)
+			hc[i].started = 1;
+	}
+	for (i = 0; i < count; i++) {
+		if (hc[i].started)
+			pthread_join(hc[i].thread, NULL);
+	}
+#endif
+	for (i = 0; i < count; i++) {
+		if (!hc[i].probed)
+			hint_card_probe(&hc[i]);
+		/* the first failing card in order wins, as done sequentially */
+		if (err >= 0 && hc[i].err < 0)
+			err = hc[i].err;
+		if (err >= 0)
+			err = hint_list_move(list, &hc[i].list);
+	}
+      __free:
+	for (i = 0; i < count; i++) {
+		unsigned int j;
+		for (j = 0; j < hc[i].list.count; j++)
+			free(hc[i].list.list[j]);
+		free(hc[i].list.list);
+		free(hc[i].list.cardname);
+		if (hc[i].rw_config != rw_config)
+			snd_config_delete(hc[i].rw_config);
+	}
+	free(hc);
+	return err;
+}
+
 static int add_software_devices(snd_config_t *config, snd_config_t *rw_config,
 				struct hint_list *list)
 {
@@ -517,47 +635,150 @@ static int add_software_devices(snd_config_t *config, snd_config_t *rw_config,
 	return 0;
 }
 
-/**
- * \brief Get a set of device name hints
- * \param card Card number or -1 (means all cards)
- * \param iface Interface identification (like "pcm", "rawmidi", "timer", "seq")
- * \param hints Result - array of device name hints
- * \result zero if success, otherwise a negative error code
- *
- * hints will receive a NULL-terminated array of device name hints,
- * which can be passed to #snd_device_name_get_hint to extract usable
- * values. When no longer needed, hints should be passed to
- * #snd_device_name_free_hint to release resources.
- *
- * User-defined hints are gathered from namehint.IFACE tree like:
- *
- * <code>
- * namehint.pcm {<br>
- *   myfile "file:FILE=/tmp/soundwave.raw|Save sound output to /tmp/soundwave.raw"<br>
- *   myplug "plug:front:Do all conversions for front speakers"<br>
- * }
- * </code>
- *
- * Note: The device description is separated with '|' char.
- *
- * Special variables: defaults.namehint.showall specifies if all device
- * definitions are accepted (boolean type).
+#ifndef DOC_HIDDEN
+/*
+ * Results are cached per interface and card, together with the parsed
+ * configuration.  The cache is dropped when a card control device node
+ * appears, disappears or is recreated (hotplug), and the entries when
+ * the configuration files change.
  */
-int snd_device_name_hint(int card, const char *iface, void ***hints)
+struct hint_cache_entry {
+	struct hint_cache_entry *next;
+	char *iface;
+	int card;
+	char **hints;			/* NULL terminated */
+};
+
+static struct {
+	snd_config_t *config;
+	snd_config_update_t *update;
+	unsigned long long cards;	/* signature of the card devices */
+	struct hint_cache_entry *entries;
+} hint_cache;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t hint_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define hint_cache_lock()	pthread_mutex_lock(&hint_cache_mutex)
+#define hint_cache_unlock()	pthread_mutex_unlock(&hint_cache_mutex)
+#else
+#define hint_cache_lock()	do {} while (0)
+#define hint_cache_unlock()	do {} while (0)
+#endif
+
+#endif
+
+static unsigned long long hint_cards_signature(void)
+{
+	unsigned long long sig = 14695981039346656037ULL;	/* FNV-1a */
+	char path[sizeof(ALSA_DEVICE_DIRECTORY) + 16];
+	unsigned long long v[4];
+	unsigned int i;
+	struct stat st;
+	int card;
+
+	for (card = 0; card < SND_MAX_CARDS; card++) {
+		sprintf(path, ALSA_DEVICE_DIRECTORY "controlC%i", card);
+		if (stat(path, &st) < 0)
+			continue;
+		v[0] = card;
+		v[1] = st.st_ino;
+		v[2] = st.st_rdev;
+		v[3] = st.st_ctime;
+		for (i = 0; i < sizeof(v); i++)
+			sig = (sig ^ ((unsigned char *)v)[i]) * 1099511628211ULL;
+	}
+	return sig;
+}
+
+static void hint_cache_flush(int config)
+{
+	struct hint_cache_entry *e;
+
+	while ((e = hint_cache.entries) != NULL) {
+		hint_cache.entries = e->next;
+		snd_device_name_free_hint((void **)e->hints);
+		free(e->iface);
+		free(e);
+	}
+	if (!config)
+		return;
+	if (hint_cache.config)
+		snd_config_delete(hint_cache.config);
+	hint_cache.config = NULL;
+	if (hint_cache.update)
+		snd_config_update_free(hint_cache.update);
+	hint_cache.update = NULL;
+}
+
+static char **hint_copy(char **hints)
+{
+	unsigned int i, count = 0;
+	char **res;
+
+	while (hints[count])
+		count++;
+	res = calloc(count + 1, sizeof(char *));
+	if (res == NULL)
+		return NULL;
+	for (i = 0; i < count; i++) {
+		res[i] = strdup(hints[i]);
+		if (res[i] == NULL) {
+			snd_device_name_free_hint((void **)res);
+			return NULL;
+		}
+	}
+	return res;
+}
+
+static struct hint_cache_entry *hint_cache_find(const char *iface, int card)
+{
+	struct hint_cache_entry *e;
+
+	for (e = hint_cache.entries; e; e = e->next)
+		if (e->card == card && strcmp(e->iface, iface) == 0)
+			return e;
+	return NULL;
+}
+
+static void hint_cache_add(const char *iface, int card, char **hints)
+{
+	struct hint_cache_entry *e;
+
+	e = calloc(1, sizeof(*e));
+	if (e == NULL)
+		return;
+	e->iface = strdup(iface);
+	e->hints = hint_copy(hints);
+	if (e->iface == NULL || e->hints == NULL) {
+		free(e->iface);
+		snd_device_name_free_hint((void **)e->hints);
+		free(e);
+		return;
+	}
+	e->card = card;
+	e->next = hint_cache.entries;
+	hint_cache.entries = e;
+}
+
+/* free the cache, called from snd_config_update_free_global() */
+void snd_device_name_hint_cache_cleanup(void)
+{
+	hint_cache_lock();
+	hint_cache_flush(1);
+	hint_cache.cards = 0;
+	hint_cache_unlock();
+}
+
+static int device_name_hint(snd_config_t *local_config, int card,
+			    const char *iface, void ***hints)
 {
 	struct hint_list list;
 	char ehints[24];
 	const char *str;
-	snd_config_t *conf, *local_config = NULL, *local_config_rw = NULL;
-	snd_config_update_t *local_config_update = NULL;
+	snd_config_t *conf, *local_config_rw = NULL;
 	snd_config_iterator_t i, next;
 	int err;
 
-	if (hints == NULL)
-		return -EINVAL;
-	err = snd_config_update_r(&local_config, &local_config_update, NULL);
-	if (err < 0)
-		return err;
 	err = snd_config_copy(&local_config_rw, local_config);
 	list.list = NULL;
 	list.count = list.allocated = 0;
@@ -591,20 +812,9 @@ int snd_device_name_hint(int card, const char *iface, void ***hints)
 			err = add_card(local_config, local_config_rw, &list, card);
 	} else {
 		add_software_devices(local_config, local_config_rw, &list);
-		err = snd_card_next(&card);
+		err = add_cards(local_config, local_config_rw, &list);
 		if (err < 0)
 			goto __error;
-		while (card >= 0) {
-			err = get_card_name(&list, card);
-			if (err < 0)
-				goto __error;
-			err = add_card(local_config, local_config_rw, &list, card);
-			if (err < 0)
-				goto __error;
-			err = snd_card_next(&card);
-			if (err < 0)
-				goto __error;
-		}
 	}
 	sprintf(ehints, "namehint.%s", list.siface);
 	err = snd_config_search(local_config, ehints, &conf);
@@ -632,10 +842,69 @@ int snd_device_name_hint(int card, const char *iface, void ***hints)
 	free(list.cardname);
 	if (local_config_rw)
 		snd_config_delete(local_config_rw);
-	if (local_config)
-		snd_config_delete(local_config);
-	if (local_config_update)
-		snd_config_update_free(local_config_update);
+	return err;
+}
+
+/**
+ * \brief Get a set of device name hints
+ * \param card Card number or -1 (means all cards)
+ * \param iface Interface identification (like "pcm", "rawmidi", "timer", "seq")
+ * \param hints Result - array of device name hints
+ * \result zero if success, otherwise a negative error code
+ *
+ * hints will receive a NULL-terminated array of device name hints,
+ * which can be passed to #snd_device_name_get_hint to extract usable
+ * values. When no longer needed, hints should be passed to
+ * #snd_device_name_free_hint to release resources.
+ *
+ * User-defined hints are gathered from namehint.IFACE tree like:
+ *
+ * <code>
+ * namehint.pcm {<br>
+ *   myfile "file:FILE=/tmp/soundwave.raw|Save sound output to /tmp/soundwave.raw"<br>
+ *   myplug "plug:front:Do all conversions for front speakers"<br>
+ * }
+ * </code>
+ *
+ * Note: The device description is separated with '|' char.
+ *
+ * Special variables: defaults.namehint.showall specifies if all device
+ * definitions are accepted (boolean type).
+ *
+ * The result is cached until a configuration file changes or a card
+ * is added or removed; the cards are probed in parallel otherwise.
+ */
+int snd_device_name_hint(int card, const char *iface, void ***hints)
+{
+	struct hint_cache_entry *e;
+	unsigned long long cards;
+	int err;
+
+	if (hints == NULL)
+		return -EINVAL;
+	hint_cache_lock();
+	cards = hint_cards_signature();
+	if (cards != hint_cache.cards) {
+		/* the card specific configuration is loaded at parse time */
+		hint_cache_flush(1);
+		hint_cache.cards = cards;
+	}
+	err = snd_config_update_r(&hint_cache.config, &hint_cache.update, NULL);
+	if (err < 0)
+		goto __unlock;
+	if (err > 0)
+		hint_cache_flush(0);
+	e = hint_cache_find(iface, card);
+	if (e != NULL) {
+		*hints = (void **)hint_copy(e->hints);
+		err = *hints ? 0 : -ENOMEM;
+		goto __unlock;
+	}
+	err = device_name_hint(hint_cache.config, card, iface, hints);
+	if (err >= 0)
+		hint_cache_add(iface, card, (char **)*hints);
+      __unlock:
+	hint_cache_unlock();
 	return err;
 }
 
@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <limits.h>
 #ifndef HAVE_SOFT_FLOAT
 #include <math.h>
 #endif
@@ -291,7 +292,7 @@ int snd_tlv_convert_from_dB(unsigned int *tlv, long rangemin, long rangemax,
 {
 	switch (tlv[0]) {
 	case SND_CTL_TLVT_DB_RANGE: {
-		long dbmin, dbmax, prev_submax;
+		long dbmin = 0, dbmax = 0, prev_submax;
 		unsigned int pos, len;
 		len = int_index(tlv[1]);
 		if (len < 6 || len > MAX_TLV_RANGE_SIZE)
@@ -397,6 +398,333 @@ int snd_tlv_convert_from_dB(unsigned int *tlv, long rangemin, long rangemax,
 	return -EINVAL;
 }
 
+#ifndef DOC_HIDDEN
+/* raw ranges up to this size get a value -> dB table */
+#define DB_MAP_TABLE_MAX	4096
+/* table entry of a raw value without dB mapping */
+#define DB_MAP_INVALID		INT_MIN
+
+struct dB_map_seg {
+	long submin, submax;		/* raw range of the item */
+	unsigned int *tlv;		/* dB TLV of the item */
+	int range_err;
+	long dbmin, dbmax;		/* dB range, clipped to rangemax */
+#ifndef HAVE_SOFT_FLOAT
+	double lmin, lmax;		/* DB_LINEAR bounds, to dB */
+	double vmin, vmax;		/* DB_LINEAR bounds, from dB */
+#endif
+};
+
+struct _snd_tlv_dB_map {
+	unsigned int *tlv;		/* private copy of the dB TLV */
+	long rangemin, rangemax;
+	int range_err;
+	long dbmin, dbmax;
+	unsigned int nsegs;
+	struct dB_map_seg *segs;
+	int *table;			/* dB of each raw value or NULL */
+};
+#endif
+
+static int dB_map_seg_to_dB(const struct dB_map_seg *seg,
+			    long rangemin, long rangemax,
+			    long volume, long *db_gain)
+{
+#ifndef HAVE_SOFT_FLOAT
+	if (seg->tlv[0] == SND_CTL_TLVT_DB_LINEAR) {
+		int mindb = seg->tlv[2];
+		int maxdb = seg->tlv[3];
+		if (volume <= rangemin || rangemax <= rangemin)
+			*db_gain = mindb;
+		else if (volume >= rangemax)
+			*db_gain = maxdb;
+		else {
+			double val = (double)(volume - rangemin) /
+				(double)(rangemax - rangemin);
+			if (mindb <= SND_CTL_TLV_DB_GAIN_MUTE)
+				*db_gain = (long)(100.0 * 20.0 * log10(val)) +
+					maxdb;
+			else {
+				val = (seg->lmax - seg->lmin) * val + seg->lmin;
+				*db_gain = (long)(100.0 * 20.0 * log10(val));
+			}
+		}
+		return 0;
+	}
+#endif
+	return snd_tlv_convert_to_dB(seg->tlv, rangemin, rangemax,
+				     volume, db_gain);
+}
+
+static int dB_map_seg_from_dB(const struct dB_map_seg *seg,
+			      long rangemin, long rangemax,
+			      long db_gain, long *value, int xdir)
+{
+#ifndef HAVE_SOFT_FLOAT
+	if (seg->tlv[0] == SND_CTL_TLVT_DB_LINEAR) {
+		int min = seg->tlv[2];
+		int max = seg->tlv[3];
+		if (db_gain <= min)
+			*value = rangemin;
+		else if (db_gain >= max)
+			*value = rangemax;
+		else {
+			double v = pow(10.0, (double)db_gain / 2000.0);
+			v = (v - seg->vmin) * (rangemax - rangemin) /
+				(seg->vmax - seg->vmin);
+			if (xdir > 0)
+				v = ceil(v);
+			*value = (long)v + rangemin;
+		}
+		return 0;
+	}
+#endif
+	return snd_tlv_convert_from_dB(seg->tlv, rangemin, rangemax,
+				       db_gain, value, xdir);
+}
+
+/* same as snd_tlv_convert_to_dB() on the compiled segments */
+static int dB_map_convert_to_dB(snd_tlv_dB_map_t *map, long volume,
+				long *db_gain)
+{
+	unsigned int i;
+
+	if (map->tlv[0] != SND_CTL_TLVT_DB_RANGE)
+		return dB_map_seg_to_dB(&map->segs[0], map->rangemin,
+					map->rangemax, volume, db_gain);
+	for (i = 0; i < map->nsegs; i++) {
+		const struct dB_map_seg *seg = &map->segs[i];
+		if (volume >= seg->submin && volume <= seg->submax)
+			return dB_map_seg_to_dB(seg, seg->submin, seg->submax,
+						volume, db_gain);
+	}
+	return -EINVAL;
+}
+
+static void dB_map_add_seg(snd_tlv_dB_map_t *map, unsigned int *tlv,
+			   long submin, long submax)
+{
+	struct dB_map_seg *seg = &map->segs[map->nsegs++];
+	long clipped = submax;
+
+	seg->submin = submin;
+	seg->submax = submax;
+	seg->tlv = tlv;
+	if (map->tlv[0] == SND_CTL_TLVT_DB_RANGE && map->rangemax < clipped)
+		clipped = map->rangemax;
+	/*
+	 * like snd_tlv_convert_from_dB(), an item without a dB range keeps
+	 * the bounds of the previous one
+	 */
+	if (map->nsegs > 1) {
+		seg->dbmin = seg[-1].dbmin;
+		seg->dbmax = seg[-1].dbmax;
+	}
+	seg->range_err = snd_tlv_get_dB_range(tlv, submin, clipped,
+					      &seg->dbmin, &seg->dbmax);
+#ifndef HAVE_SOFT_FLOAT
+	if (tlv[0] == SND_CTL_TLVT_DB_LINEAR) {
+		int min = tlv[2];
+		int max = tlv[3];
+		if (min > SND_CTL_TLV_DB_GAIN_MUTE) {
+			seg->lmin = pow(10.0, min / 2000.0);
+			seg->lmax = pow(10.0, max / 2000.0);
+		}
+		seg->vmin = min <= SND_CTL_TLV_DB_GAIN_MUTE ? 0.0 :
+			pow(10.0, (double)min / 2000.0);
+		seg->vmax = !max ? 1.0 : pow(10.0, (double)max / 2000.0);
+	}
+#endif
+}
+
+static int dB_map_build_table(snd_tlv_dB_map_t *map)
+{
+	long v, db;
+	int *table;
+
+	if (map->rangemax < map->rangemin ||
+	    map->rangemax - map->rangemin >= DB_MAP_TABLE_MAX)
+		return 0;
+	table = malloc((map->rangemax - map->rangemin + 1) * sizeof(*table));
+	if (!table)
+		return -ENOMEM;
+	for (v = map->rangemin; v <= map->rangemax; v++) {
+		if (dB_map_convert_to_dB(map, v, &db) < 0)
+			db = DB_MAP_INVALID;
+		else if (db <= INT_MIN || db > INT_MAX) {
+			/* does not fit, stay with the segments */
+			free(table);
+			return 0;
+		}
+		table[v - map->rangemin] = db;
+	}
+	map->table = table;
+	return 0;
+}
+
+/**
+ * \brief Compile a dB TLV into a mapping object
+ * \param map the pointer to store the new mapping
+ * \param tlv the TLV source returned by #snd_tlv_parse_dB_info()
+ * \param rangemin the minimum value of the raw volume
+ * \param rangemax the maximum value of the raw volume
+ * \return 0 if successful, or a negative error code
+ *
+ * The TLV is parsed once; dB range items are flattened and the
+ * logarithmic scale bounds are precomputed.  For raw ranges of a
+ * moderate size, a table of the dB gain of every raw value is built.
+ * The results of the snd_tlv_dB_map_*() functions are the same as
+ * of the corresponding snd_tlv_*() functions with the same arguments.
+ * The mapping does not refer to \p tlv after this call.
+ */
+int snd_tlv_dB_map_new(snd_tlv_dB_map_t **map, unsigned int *tlv,
+		       long rangemin, long rangemax)
+{
+	snd_tlv_dB_map_t *m;
+	unsigned int len, pos, nsegs;
+	int err;
+
+	assert(map && tlv);
+	*map = NULL;
+	len = int_index(tlv[1]);
+	if (len > MAX_TLV_RANGE_SIZE)
+		return -EINVAL;
+	m = calloc(1, sizeof(*m));
+	if (!m)
+		return -ENOMEM;
+	m->rangemin = rangemin;
+	m->rangemax = rangemax;
+	m->tlv = malloc((len + 2) * sizeof(int));
+	if (!m->tlv) {
+		err = -ENOMEM;
+		goto _err;
+	}
+	memcpy(m->tlv, tlv, (len + 2) * sizeof(int));
+	nsegs = 1;
+	if (m->tlv[0] == SND_CTL_TLVT_DB_RANGE) {
+		nsegs = 0;
+		for (pos = 2; pos + 4 <= len;
+		     pos += int_index(m->tlv[pos + 3]) + 4)
+			nsegs++;
+	}
+	m->segs = calloc(nsegs ? nsegs : 1, sizeof(*m->segs));
+	if (!m->segs) {
+		err = -ENOMEM;
+		goto _err;
+	}
+	if (m->tlv[0] == SND_CTL_TLVT_DB_RANGE) {
+		for (pos = 2; pos + 4 <= len;
+		     pos += int_index(m->tlv[pos + 3]) + 4)
+			dB_map_add_seg(m, m->tlv + pos + 2,
+				       (int)m->tlv[pos], (int)m->tlv[pos + 1]);
+	} else
+		dB_map_add_seg(m, m->tlv, rangemin, rangemax);
+	m->range_err = snd_tlv_get_dB_range(m->tlv, rangemin, rangemax,
+					    &m->dbmin, &m->dbmax);
+	err = dB_map_build_table(m);
+	if (err < 0)
+		goto _err;
+	*map = m;
+	return 0;
+
+ _err:
+	snd_tlv_dB_map_free(m);
+	return err;
+}
+
+/**
+ * \brief Free a dB mapping object
+ * \param map the mapping returned by #snd_tlv_dB_map_new()
+ */
+void snd_tlv_dB_map_free(snd_tlv_dB_map_t *map)
+{
+	if (!map)
+		return;
+	free(map->table);
+	free(map->segs);
+	free(map->tlv);
+	free(map);
+}
+
+/**
+ * \brief Get the dB min/max values of a dB mapping
+ * \param map the mapping returned by #snd_tlv_dB_map_new()
+ * \param min the pointer to store the minimum dB value (in 0.01dB unit)
+ * \param max the pointer to store the maximum dB value (in 0.01dB unit)
+ * \return 0 if successful, or a negative error code
+ */
+int snd_tlv_dB_map_get_range(snd_tlv_dB_map_t *map, long *min, long *max)
+{
+	assert(map);
+	if (map->range_err < 0)
+		return map->range_err;
+	*min = map->dbmin;
+	*max = map->dbmax;
+	return 0;
+}
+
+/**
+ * \brief Convert a raw volume value to a dB gain using a dB mapping
+ * \param map the mapping returned by #snd_tlv_dB_map_new()
+ * \param volume the raw volume value to convert
+ * \param db_gain the dB gain (in 0.01dB unit)
+ * \return 0 if successful, or a negative error code
+ */
+int snd_tlv_dB_map_to_dB(snd_tlv_dB_map_t *map, long volume, long *db_gain)
+{
+	assert(map);
+	if (map->table && volume >= map->rangemin && volume <= map->rangemax) {
+		int db = map->table[volume - map->rangemin];
+		if (db == DB_MAP_INVALID)
+			return -EINVAL;
+		*db_gain = db;
+		return 0;
+	}
+	return dB_map_convert_to_dB(map, volume, db_gain);
+}
+
+/**
+ * \brief Convert from dB gain to the raw volume value using a dB mapping
+ * \param map the mapping returned by #snd_tlv_dB_map_new()
+ * \param db_gain the dB gain to convert (in 0.01dB unit)
+ * \param value the pointer to store the converted raw volume value
+ * \param xdir the direction for round-up. The value is round up
+ *        when this is positive.
+ * \return 0 if successful, or a negative error code
+ */
+int snd_tlv_dB_map_from_dB(snd_tlv_dB_map_t *map, long db_gain, long *value,
+			   int xdir)
+{
+	long submax, prev_submax = 0;
+	unsigned int i;
+
+	assert(map);
+	if (map->tlv[0] != SND_CTL_TLVT_DB_RANGE)
+		return dB_map_seg_from_dB(&map->segs[0], map->rangemin,
+					  map->rangemax, db_gain, value, xdir);
+	if (int_index(map->tlv[1]) < 6)
+		return -EINVAL;
+	for (i = 0; i < map->nsegs; i++) {
+		const struct dB_map_seg *seg = &map->segs[i];
+		submax = seg->submax;
+		if (map->rangemax < submax)
+			submax = map->rangemax;
+		if (!seg->range_err &&
+		    db_gain >= seg->dbmin && db_gain <= seg->dbmax)
+			return dB_map_seg_from_dB(seg, seg->submin, submax,
+						  db_gain, value, xdir);
+		else if (db_gain < seg->dbmin) {
+			*value = xdir > 0 || i == 0 ? seg->submin : prev_submax;
+			return 0;
+		}
+		prev_submax = submax;
+		if (map->rangemax == submax)
+			break;
+	}
+	*value = prev_submax;
+	return 0;
+}
+
 #ifndef DOC_HIDDEN
 #define TEMP_TLV_SIZE		4096
 struct tlv_info {
@@ -496,3 +824,27 @@ int snd_ctl_convert_from_dB(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id,
 	return snd_tlv_convert_from_dB(info.tlv, info.minval, info.maxval,
 				       db_gain, value, xdir);
 }
+
+/**
+ * \brief Compile the dB information of the given control element
+ * \param ctl the control handler
+ * \param id the element id
+ * \param map the pointer to store the new dB mapping
+ * \return 0 if successful, or a negative error code
+ *
+ * Use this instead of #snd_ctl_convert_to_dB() and friends when many
+ * values of the same element are converted; each of those reads the
+ * element information and TLV again.  Free the mapping with
+ * #snd_tlv_dB_map_free().
+ */
+int snd_ctl_get_dB_map(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id,
+		       snd_tlv_dB_map_t **map)
+{
+	struct tlv_info info;
+	int err;
+
+	err = get_tlv_info(ctl, id, &info);
+	if (err < 0)
+		return err;
+	return snd_tlv_dB_map_new(map, info.tlv, info.minval, info.maxval);
+}
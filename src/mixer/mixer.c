@@ -46,6 +46,7 @@ This is an abstraction layer over the hcontrol layer.
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include "mixer_local.h"
+#include "mixer_simple.h"
 
 #ifndef DOC_HIDDEN
 typedef struct _snd_mixer_slave {
@@ -75,6 +76,7 @@ int snd_mixer_open(snd_mixer_t **mixerp, int mode ATTRIBUTE_UNUSED)
 	INIT_LIST_HEAD(&mixer->slaves);
 	INIT_LIST_HEAD(&mixer->classes);
 	INIT_LIST_HEAD(&mixer->elems);
+	INIT_LIST_HEAD(&mixer->dirty);
 	mixer->compare = snd_mixer_compare_default;
 	*mixerp = mixer;
 	return 0;
@@ -116,6 +118,9 @@ int snd_mixer_elem_detach(snd_mixer_elem_t *melem,
 	assert(err >= 0);
 	err = bag_del(&melem->helems, helem);
 	assert(err >= 0);
+	if (bag_del(&melem->dirty_helems, helem) == 0 &&
+	    bag_empty(&melem->dirty_helems))
+		list_del(&melem->dirty);
 	return 0;
 }
 
@@ -131,10 +136,74 @@ int snd_mixer_elem_empty(snd_mixer_elem_t *melem)
 	return bag_empty(&melem->helems);
 }
 
+/*
+ * dispatch the deferred value events, once per changed HCTL element of
+ * each mixer element; the class may remove the mixer element meanwhile
+ */
+static int snd_mixer_dirty_flush(snd_mixer_t *mixer)
+{
+	int res = 0;
+
+	while (!list_empty(&mixer->dirty)) {
+		snd_mixer_elem_t *melem;
+		snd_hctl_elem_t *helem;
+		int err;
+
+		melem = list_entry(mixer->dirty.next, snd_mixer_elem_t, dirty);
+		helem = bag_iterator_entry(melem->dirty_helems.next);
+		bag_del(&melem->dirty_helems, helem);
+		if (bag_empty(&melem->dirty_helems))
+			list_del(&melem->dirty);
+		err = melem->class->event(melem->class, SND_CTL_EVENT_MASK_VALUE,
+					  helem, melem);
+		if (err < 0)
+			res = err;
+	}
+	return res;
+}
+
+/* queue a value event of the HCTL element, each element only once */
+static int snd_mixer_dirty_add(snd_mixer_t *mixer, snd_mixer_elem_t *melem,
+			       snd_hctl_elem_t *helem)
+{
+	int queued = !bag_empty(&melem->dirty_helems);
+	bag_iterator_t i;
+	int err;
+
+	bag_for_each(i, &melem->dirty_helems) {
+		if (bag_iterator_entry(i) == helem)
+			return 0;
+	}
+	err = bag_add(&melem->dirty_helems, helem);
+	if (err < 0)
+		return err;
+	if (!queued)
+		list_add_tail(&melem->dirty, &mixer->dirty);
+	return 0;
+}
+
 static int hctl_elem_event_handler(snd_hctl_elem_t *helem,
 				   unsigned int mask)
 {
 	bag_t *bag = snd_hctl_elem_get_callback_private(helem);
+	snd_mixer_t *mixer = snd_hctl_get_callback_private(snd_hctl_elem_get_hctl(helem));
+	if (mixer->defer) {
+		if (mask == SND_CTL_EVENT_MASK_VALUE) {
+			bag_iterator_t i;
+			int err = 0;
+			bag_for_each(i, bag) {
+				snd_mixer_elem_t *melem = bag_iterator_entry(i);
+				err = snd_mixer_dirty_add(mixer, melem, helem);
+				if (err < 0)
+					break;
+			}
+			if (err >= 0)
+				return 0;
+			/* out of memory, deliver it right now */
+		}
+		/* keep the order against structural changes */
+		snd_mixer_dirty_flush(mixer);
+	}
 	if (mask == SND_CTL_EVENT_MASK_REMOVE) {
 		int res = 0;
 		int err;
@@ -169,6 +238,8 @@ static int hctl_event_handler(snd_hctl_t *hctl, unsigned int mask,
 {
 	snd_mixer_t *mixer = snd_hctl_get_callback_private(hctl);
 	int res = 0;
+	if (mixer->defer)
+		snd_mixer_dirty_flush(mixer);
 	if (mask & SND_CTL_EVENT_MASK_ADD) {
 		struct list_head *pos;
 		bag_t *bag;
@@ -347,6 +418,123 @@ static int _snd_mixer_find_elem(snd_mixer_t *mixer, snd_mixer_elem_t *elem, int
 	return idx;
 }
 
+#define MIXER_HASH_MIN	64
+
+static unsigned int snd_mixer_hash_key(const char *name, unsigned int index)
+{
+	unsigned int key = 2166136261U;		/* FNV-1a */
+
+	while (*name)
+		key = (key ^ (unsigned char)*name++) * 16777619U;
+	return (key ^ index) * 16777619U;
+}
+
+static snd_mixer_selem_id_t *snd_mixer_hash_id(snd_mixer_elem_t *elem)
+{
+	if (elem->type != SND_MIXER_ELEM_SIMPLE || !elem->private_data)
+		return NULL;
+	return sm_selem(elem)->id;
+}
+
+static int snd_mixer_hash_resize(snd_mixer_t *mixer, unsigned int size)
+{
+	snd_mixer_elem_t **hash, *e, *next;
+	unsigned int k;
+
+	hash = calloc(size, sizeof(*hash));
+	if (!hash)
+		return -ENOMEM;
+	for (k = 0; k < mixer->hash_size; k++) {
+		for (e = mixer->hash[k]; e; e = next) {
+			next = e->hash_next;
+			e->hash_next = hash[e->hash_key & (size - 1)];
+			hash[e->hash_key & (size - 1)] = e;
+		}
+	}
+	free(mixer->hash);
+	mixer->hash = hash;
+	mixer->hash_size = size;
+	return 0;
+}
+
+static int snd_mixer_hash_add(snd_mixer_t *mixer, snd_mixer_elem_t *elem)
+{
+	snd_mixer_selem_id_t *id = snd_mixer_hash_id(elem);
+	unsigned int b;
+	int err;
+
+	if (!id)
+		return 0;
+	if (mixer->hash_count >= mixer->hash_size) {
+		err = snd_mixer_hash_resize(mixer, mixer->hash_size ?
+					    mixer->hash_size * 2 :
+					    MIXER_HASH_MIN);
+		if (err < 0)
+			return err;
+	}
+	elem->hash_key = snd_mixer_hash_key(id->name, id->index);
+	b = elem->hash_key & (mixer->hash_size - 1);
+	elem->hash_next = mixer->hash[b];
+	mixer->hash[b] = elem;
+	mixer->hash_count++;
+	return 0;
+}
+
+static void snd_mixer_hash_del(snd_mixer_t *mixer, snd_mixer_elem_t *elem)
+{
+	snd_mixer_elem_t **p;
+
+	if (!mixer->hash || !snd_mixer_hash_id(elem))
+		return;
+	p = &mixer->hash[elem->hash_key & (mixer->hash_size - 1)];
+	for (; *p; p = &(*p)->hash_next) {
+		if (*p == elem) {
+			*p = elem->hash_next;
+			elem->hash_next = NULL;
+			mixer->hash_count--;
+			return;
+		}
+	}
+}
+
+/*
+ * Find a simple element by name and index.  When several elements
+ * share the id, the first one in the mixer element order is returned.
+ */
+snd_mixer_elem_t *_snd_mixer_find_selem(snd_mixer_t *mixer, const char *name,
+					unsigned int index)
+{
+	snd_mixer_elem_t *e, *found = NULL;
+	snd_mixer_selem_id_t *id;
+	struct list_head *pos;
+	unsigned int key;
+
+	if (!mixer->hash)
+		return NULL;
+	key = snd_mixer_hash_key(name, index);
+	for (e = mixer->hash[key & (mixer->hash_size - 1)]; e; e = e->hash_next) {
+		if (e->hash_key != key)
+			continue;
+		id = sm_selem(e)->id;
+		if (id->index != index || strcmp(id->name, name))
+			continue;
+		if (found)
+			goto _dup;
+		found = e;
+	}
+	return found;
+
+ _dup:
+	/* rare (several simple classes), keep the list order */
+	list_for_each(pos, &mixer->elems) {
+		e = list_entry(pos, snd_mixer_elem_t, list);
+		id = snd_mixer_hash_id(e);
+		if (id && id->index == index && !strcmp(id->name, name))
+			return e;
+	}
+	return found;
+}
+
 /**
  * \brief Get private data associated to give mixer element
  * \param elem Mixer element
@@ -384,6 +572,7 @@ int snd_mixer_elem_new(snd_mixer_elem_t **elem,
 	melem->private_data = private_data;
 	melem->private_free = private_free;
 	INIT_LIST_HEAD(&melem->helems);
+	INIT_LIST_HEAD(&melem->dirty_helems);
 	*elem = melem;
 	return 0;
 }
@@ -412,6 +601,8 @@ int snd_mixer_elem_add(snd_mixer_elem_t *elem, snd_mixer_class_t *class)
 		}
 		mixer->pelems = m;
 	}
+	if (snd_mixer_hash_add(mixer, elem) < 0)
+		return -ENOMEM;
 	if (mixer->count == 0) {
 		list_add_tail(&elem->list, &mixer->elems);
 		mixer->pelems[0] = elem;
@@ -456,6 +647,7 @@ int snd_mixer_elem_remove(snd_mixer_elem_t *elem)
 		snd_mixer_elem_detach(elem, helem);
 	}
 	err = snd_mixer_elem_throw_event(elem, SND_CTL_EVENT_MASK_REMOVE);
+	snd_mixer_hash_del(mixer, elem);
 	list_del(&elem->list);
 	snd_mixer_elem_free(elem);
 	mixer->count--;
@@ -611,6 +803,8 @@ int snd_mixer_close(snd_mixer_t *mixer)
 	assert(mixer->count == 0);
 	free(mixer->pelems);
 	mixer->pelems = NULL;
+	free(mixer->hash);
+	mixer->hash = NULL;
 	while (!list_empty(&mixer->slaves)) {
 		int err;
 		snd_mixer_slave_t *s;
@@ -853,6 +1047,41 @@ int snd_mixer_handle_events(snd_mixer_t *mixer)
 	return mixer->events;
 }
 
+/**
+ * \brief Handle pending mixer events, updating each element once
+ * \param mixer Mixer handle
+ * \return Number of events that occured on success, otherwise a negative error code on failure
+ *
+ * Works like #snd_mixer_handle_events(), but the value changes of the
+ * HCTL elements are collected first and delivered after all pending
+ * events were read: the class of each mixer element gets one value
+ * event per changed HCTL element, however many changes the element
+ * reported.  A simple element re-reads its state then and invokes its
+ * callback once if it changed.  Element additions and removals are
+ * still handled in order.
+ */
+int snd_mixer_handle_events_coalesce(snd_mixer_t *mixer)
+{
+	struct list_head *pos;
+	int err = 0;
+	assert(mixer);
+	mixer->events = 0;
+	mixer->defer = 1;
+	list_for_each(pos, &mixer->slaves) {
+		snd_mixer_slave_t *s;
+		s = list_entry(pos, snd_mixer_slave_t, list);
+		err = snd_hctl_handle_events_coalesce(s->hctl);
+		if (err < 0)
+			break;
+	}
+	mixer->defer = 0;
+	if (err >= 0)
+		err = snd_mixer_dirty_flush(mixer);
+	else
+		snd_mixer_dirty_flush(mixer);
+	return err < 0 ? err : (int)mixer->events;
+}
+
 /**
  * \brief Set callback function for a mixer
  * \param obj mixer handle
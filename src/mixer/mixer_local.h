@@ -61,6 +61,10 @@ struct _snd_mixer_elem {
 	void *callback_private;
 	bag_t helems;
 	int compare_weight;		/* compare weight (reversed) */
+	snd_mixer_elem_t *hash_next;	/* simple elem (name, index) chain */
+	unsigned int hash_key;
+	struct list_head dirty;		/* link for list of deferred elems */
+	bag_t dirty_helems;		/* changed HCTL elems, queued if not empty */
 };
 
 struct _snd_mixer {
@@ -70,6 +74,11 @@ struct _snd_mixer {
 	snd_mixer_elem_t **pelems;	/* array of all elems */
 	unsigned int count;
 	unsigned int alloc;
+	snd_mixer_elem_t **hash;	/* simple elems by (name, index) */
+	unsigned int hash_size;		/* power of two */
+	unsigned int hash_count;
+	struct list_head dirty;		/* elems with deferred value events */
+	int defer;			/* defer value events to the list */
 	unsigned int events;
 	snd_mixer_callback_t callback;
 	void *callback_private;
@@ -80,3 +89,6 @@ struct _snd_mixer_selem_id {
 	char name[60];
 	unsigned int index;
 };
+
+snd_mixer_elem_t *_snd_mixer_find_selem(snd_mixer_t *mixer, const char *name,
+					unsigned int index);
@@ -87,6 +87,8 @@ typedef struct _selem_none {
 		long vol[32];
 		unsigned int sw;
 		unsigned int *db_info;
+		snd_tlv_dB_map_t *db_map;	/* compiled for min, max below */
+		long db_map_min, db_map_max;
 	} str[2];
 } selem_none_t;
 
@@ -663,6 +665,8 @@ static void selem_free(snd_mixer_elem_t *elem)
 	/* free db range information */
 	free(simple->str[0].db_info);
 	free(simple->str[1].db_info);
+	snd_tlv_dB_map_free(simple->str[0].db_map);
+	snd_tlv_dB_map_free(simple->str[1].db_map);
 	free(simple);
 }
 
@@ -1082,13 +1086,35 @@ static int get_volume_ops(snd_mixer_elem_t *elem, int dir,
 
 static int init_db_range(snd_hctl_elem_t *ctl, struct selem_str *rec);
 
+/* get the dB map for the current volume range, (re)compiling the TLV */
+static snd_tlv_dB_map_t *get_db_map(snd_hctl_elem_t *ctl,
+				    struct selem_str *rec)
+{
+	if (init_db_range(ctl, rec) < 0)
+		return NULL;
+	if (rec->db_map &&
+	    (rec->db_map_min != rec->min || rec->db_map_max != rec->max)) {
+		snd_tlv_dB_map_free(rec->db_map);
+		rec->db_map = NULL;
+	}
+	if (!rec->db_map) {
+		if (snd_tlv_dB_map_new(&rec->db_map, rec->db_info,
+				       rec->min, rec->max) < 0)
+			return NULL;
+		rec->db_map_min = rec->min;
+		rec->db_map_max = rec->max;
+	}
+	return rec->db_map;
+}
+
 static int convert_to_dB(snd_hctl_elem_t *ctl, struct selem_str *rec,
 			 long volume, long *db_gain)
 {
-	if (init_db_range(ctl, rec) < 0)
+	snd_tlv_dB_map_t *map = get_db_map(ctl, rec);
+
+	if (!map)
 		return -EINVAL;
-	return snd_tlv_convert_to_dB(rec->db_info, rec->min, rec->max,
-				     volume, db_gain);
+	return snd_tlv_dB_map_to_dB(map, volume, db_gain);
 }
 
 /* initialize dB range information, reading TLV via hcontrol
@@ -1156,10 +1182,11 @@ static selem_ctl_t *get_selem_ctl(selem_none_t *s, int dir)
 static int get_dB_range(snd_hctl_elem_t *ctl, struct selem_str *rec,
 			long *min, long *max)
 {
-	if (init_db_range(ctl, rec) < 0)
-		return -EINVAL;
+	snd_tlv_dB_map_t *map = get_db_map(ctl, rec);
 
-	return snd_tlv_get_dB_range(rec->db_info, rec->min, rec->max, min, max);
+	if (!map)
+		return -EINVAL;
+	return snd_tlv_dB_map_get_range(map, min, max);
 }
 	
 static int get_dB_range_ops(snd_mixer_elem_t *elem, int dir,
@@ -1179,11 +1206,11 @@ static int get_dB_range_ops(snd_mixer_elem_t *elem, int dir,
 static int convert_from_dB(snd_hctl_elem_t *ctl, struct selem_str *rec,
 			   long db_gain, long *value, int xdir)
 {
-	if (init_db_range(ctl, rec) < 0)
-		return -EINVAL;
+	snd_tlv_dB_map_t *map = get_db_map(ctl, rec);
 
-	return snd_tlv_convert_from_dB(rec->db_info, rec->min, rec->max,
-				       db_gain, value, xdir);
+	if (!map)
+		return -EINVAL;
+	return snd_tlv_dB_map_from_dB(map, db_gain, value, xdir);
 }
 
 static int ask_vol_dB_ops(snd_mixer_elem_t *elem,
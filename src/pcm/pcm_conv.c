@@ -0,0 +1,615 @@
+/**
+ * \file pcm/pcm_conv.c
+ * \ingroup PCM_Plugins
+ * \brief PCM Sample Format Conversion Functions
+ * \author Abramo Bagnara <abramo@alsa-project.org>
+ * \author Jaroslav Kysela <perex@perex.cz>
+ * \date 2000-2001
+ */
+/*
+ *  PCM - Sample format conversion functions of the linear, lfloat
+ *        and route plugins
+ *  Copyright (c) 2000 by Abramo Bagnara <abramo@alsa-project.org>
+ *                        Jaroslav Kysela <perex@perex.cz>
+ *
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * The functions use only the public format helpers, so test/pcm_convert
+ * links this file on its own to compare the kernels with the generic
+ * conversion.
+ */
+
+#include <byteswap.h>
+#include "pcm_local.h"
+#include "pcm_plugin.h"
+
+#include "plugin_ops.h"
+
+#ifndef DOC_HIDDEN
+
+typedef float float_t;
+typedef double double_t;
+
+#if __GNUC__ < 2 || (__GNUC__ == 2 && __GNUC_MINOR__ <= 91)
+#define BUGGY_GCC
+#endif
+
+
+int snd_pcm_linear_convert_index(snd_pcm_format_t src_format,
+				 snd_pcm_format_t dst_format)
+{
+	int src_endian, dst_endian, sign, src_width, dst_width;
+
+	sign = (snd_pcm_format_signed(src_format) !=
+		snd_pcm_format_signed(dst_format));
+#ifdef SND_LITTLE_ENDIAN
+	src_endian = snd_pcm_format_big_endian(src_format);
+	dst_endian = snd_pcm_format_big_endian(dst_format);
+#else
+	src_endian = snd_pcm_format_little_endian(src_format);
+	dst_endian = snd_pcm_format_little_endian(dst_format);
+#endif
+
+	if (src_endian < 0)
+		src_endian = 0;
+	if (dst_endian < 0)
+		dst_endian = 0;
+
+	src_width = snd_pcm_format_width(src_format) / 8 - 1;
+	dst_width = snd_pcm_format_width(dst_format) / 8 - 1;
+
+	return src_width * 32 + src_endian * 16 + sign * 8 + dst_width * 2 + dst_endian;
+}
+
+int snd_pcm_linear_get_index(snd_pcm_format_t src_format, snd_pcm_format_t dst_format)
+{
+	int sign, width, pwidth, endian;
+	sign = (snd_pcm_format_signed(src_format) != 
+		snd_pcm_format_signed(dst_format));
+#ifdef SND_LITTLE_ENDIAN
+	endian = snd_pcm_format_big_endian(src_format);
+#else
+	endian = snd_pcm_format_little_endian(src_format);
+#endif
+	if (endian < 0)
+		endian = 0;
+	pwidth = snd_pcm_format_physical_width(src_format);
+	width = snd_pcm_format_width(src_format);
+	if (pwidth == 24) {
+		switch (width) {
+		case 24:
+			width = 0; break;
+		case 20:
+			width = 1; break;
+		case 18:
+		default:
+			width = 2; break;
+		}
+		return width * 4 + endian * 2 + sign + 16;
+	} else {
+		width = width / 8 - 1;
+		return width * 4 + endian * 2 + sign;
+	}
+}
+
+int snd_pcm_linear_put_index(snd_pcm_format_t src_format, snd_pcm_format_t dst_format)
+{
+	int sign, width, pwidth, endian;
+	sign = (snd_pcm_format_signed(src_format) != 
+		snd_pcm_format_signed(dst_format));
+#ifdef SND_LITTLE_ENDIAN
+	endian = snd_pcm_format_big_endian(dst_format);
+#else
+	endian = snd_pcm_format_little_endian(dst_format);
+#endif
+	if (endian < 0)
+		endian = 0;
+	pwidth = snd_pcm_format_physical_width(dst_format);
+	width = snd_pcm_format_width(dst_format);
+	if (pwidth == 24) {
+		switch (width) {
+		case 24:
+			width = 0; break;
+		case 20:
+			width = 1; break;
+		case 18:
+		default:
+			width = 2; break;
+		}
+		return width * 4 + endian * 2 + sign + 16;
+	} else {
+		width = width / 8 - 1;
+		return width * 4 + endian * 2 + sign;
+	}
+}
+
+void snd_pcm_linear_convert(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+			    const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+			    unsigned int channels, snd_pcm_uframes_t frames,
+			    unsigned int convidx)
+{
+#define CONV_LABELS
+#include "plugin_ops.h"
+#undef CONV_LABELS
+	void *conv = conv_labels[convidx];
+	unsigned int channel;
+	for (channel = 0; channel < channels; ++channel) {
+		const char *src;
+		char *dst;
+		int src_step, dst_step;
+		snd_pcm_uframes_t frames1;
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		src = snd_pcm_channel_area_addr(src_area, src_offset);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		src_step = snd_pcm_channel_area_step(src_area);
+		dst_step = snd_pcm_channel_area_step(dst_area);
+		frames1 = frames;
+		while (frames1-- > 0) {
+			goto *conv;
+#define CONV_END after
+#include "plugin_ops.h"
+#undef CONV_END
+		after:
+			src += src_step;
+			dst += dst_step;
+		}
+	}
+}
+
+void snd_pcm_linear_getput(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+			   const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+			   unsigned int channels, snd_pcm_uframes_t frames,
+			   unsigned int get_idx, unsigned int put_idx)
+{
+#define CONV24_LABELS
+#include "plugin_ops.h"
+#undef CONV24_LABELS
+	void *get = get32_labels[get_idx];
+	void *put = put32_labels[put_idx];
+	unsigned int channel;
+	u_int32_t sample = 0;
+	for (channel = 0; channel < channels; ++channel) {
+		const char *src;
+		char *dst;
+		int src_step, dst_step;
+		snd_pcm_uframes_t frames1;
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		src = snd_pcm_channel_area_addr(src_area, src_offset);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		src_step = snd_pcm_channel_area_step(src_area);
+		dst_step = snd_pcm_channel_area_step(dst_area);
+		frames1 = frames;
+		while (frames1-- > 0) {
+			goto *get;
+#define CONV24_END after
+#include "plugin_ops.h"
+#undef CONV24_END
+		after:
+			src += src_step;
+			dst += dst_step;
+		}
+	}
+}
+
+/*
+ * Specialized conversion kernels
+ *
+ * Every kernel converts one stream of samples between two fixed formats,
+ * the samples are passed through a MSB aligned 32-bit integer like in the
+ * get32/put32 operators, so the results are identical with the generic
+ * code. The loops have no indirect jumps and use plain indexing for
+ * packed samples, so the compiler can unroll and vectorize them.
+ */
+
+#ifdef SND_LITTLE_ENDIAN
+#define CONV_LE16(x)	(x)
+#define CONV_BE16(x)	bswap_16(x)
+#define CONV_LE32(x)	(x)
+#define CONV_BE32(x)	bswap_32(x)
+#else
+#define CONV_LE16(x)	bswap_16(x)
+#define CONV_BE16(x)	(x)
+#define CONV_LE32(x)	bswap_32(x)
+#define CONV_BE32(x)	(x)
+#endif
+
+#define CONV_SIZE_s16_le	2
+#define CONV_SIZE_s16_be	2
+#define CONV_SIZE_s24_3le	3
+#define CONV_SIZE_s24_3be	3
+#define CONV_SIZE_s24_le	4
+#define CONV_SIZE_s24_be	4
+#define CONV_SIZE_s32_le	4
+#define CONV_SIZE_s32_be	4
+#define CONV_SIZE_float_le	4
+#define CONV_SIZE_float_be	4
+
+static inline int32_t conv_load_s16_le(const char *p)
+{
+	return (int32_t)((u_int32_t)CONV_LE16(*(const u_int16_t *)(p)) << 16);
+}
+
+static inline int32_t conv_load_s16_be(const char *p)
+{
+	return (int32_t)((u_int32_t)CONV_BE16(*(const u_int16_t *)(p)) << 16);
+}
+
+static inline int32_t conv_load_s24_3le(const char *p)
+{
+	return (int32_t)(((u_int32_t)(u_int8_t)p[0] | (u_int32_t)(u_int8_t)p[1] << 8 | (u_int32_t)(u_int8_t)p[2] << 16) << 8);
+}
+
+static inline int32_t conv_load_s24_3be(const char *p)
+{
+	return (int32_t)(((u_int32_t)(u_int8_t)p[0] << 16 | (u_int32_t)(u_int8_t)p[1] << 8 | (u_int32_t)(u_int8_t)p[2]) << 8);
+}
+
+static inline int32_t conv_load_s24_le(const char *p)
+{
+	return (int32_t)(CONV_LE32(*(const u_int32_t *)(p)) << 8);
+}
+
+static inline int32_t conv_load_s24_be(const char *p)
+{
+	return (int32_t)(CONV_BE32(*(const u_int32_t *)(p)) << 8);
+}
+
+static inline int32_t conv_load_s32_le(const char *p)
+{
+	return (int32_t)CONV_LE32(*(const u_int32_t *)(p));
+}
+
+static inline int32_t conv_load_s32_be(const char *p)
+{
+	return (int32_t)CONV_BE32(*(const u_int32_t *)(p));
+}
+
+static inline int32_t conv_float_to_s32(float f)
+{
+	if (f >= 1.0)
+		return 0x7fffffff;
+	if (f <= -1.0)
+		return (int32_t)0x80000000;
+	return (int32_t)(f * (float)0x80000000UL);
+}
+
+static inline int32_t conv_load_float_le(const char *p)
+{
+	snd_tmp_float_t tmp;
+	tmp.i = CONV_LE32(*(const u_int32_t *)(p));
+	return conv_float_to_s32(tmp.f);
+}
+
+static inline int32_t conv_load_float_be(const char *p)
+{
+	snd_tmp_float_t tmp;
+	tmp.i = CONV_BE32(*(const u_int32_t *)(p));
+	return conv_float_to_s32(tmp.f);
+}
+
+static inline void conv_store_s16_le(char *p, int32_t s)
+{
+	*(u_int16_t *)(p) = CONV_LE16((u_int16_t)((u_int32_t)s >> 16));
+}
+
+static inline void conv_store_s16_be(char *p, int32_t s)
+{
+	*(u_int16_t *)(p) = CONV_BE16((u_int16_t)((u_int32_t)s >> 16));
+}
+
+static inline void conv_store_s24_3le(char *p, int32_t s)
+{
+	p[0] = (u_int32_t)s >> 8;
+	p[1] = (u_int32_t)s >> 16;
+	p[2] = (u_int32_t)s >> 24;
+}
+
+static inline void conv_store_s24_3be(char *p, int32_t s)
+{
+	p[0] = (u_int32_t)s >> 24;
+	p[1] = (u_int32_t)s >> 16;
+	p[2] = (u_int32_t)s >> 8;
+}
+
+static inline void conv_store_s24_le(char *p, int32_t s)
+{
+	*(u_int32_t *)(p) = CONV_LE32((u_int32_t)(s >> 8));
+}
+
+static inline void conv_store_s24_be(char *p, int32_t s)
+{
+	*(u_int32_t *)(p) = CONV_BE32((u_int32_t)(s >> 8));
+}
+
+static inline void conv_store_s32_le(char *p, int32_t s)
+{
+	*(u_int32_t *)(p) = CONV_LE32((u_int32_t)s);
+}
+
+static inline void conv_store_s32_be(char *p, int32_t s)
+{
+	*(u_int32_t *)(p) = CONV_BE32((u_int32_t)s);
+}
+
+static inline void conv_store_float_le(char *p, int32_t s)
+{
+	snd_tmp_float_t tmp;
+	tmp.f = (float)s / (float)0x80000000UL;
+	*(u_int32_t *)(p) = CONV_LE32(tmp.i);
+}
+
+static inline void conv_store_float_be(char *p, int32_t s)
+{
+	snd_tmp_float_t tmp;
+	tmp.f = (float)s / (float)0x80000000UL;
+	*(u_int32_t *)(p) = CONV_BE32(tmp.i);
+}
+
+#define CONV_SRC_FORMATS(X) \
+	X(s16_le) X(s16_be) X(s24_3le) X(s24_3be) X(s24_le) X(s24_be) \
+	X(s32_le) X(s32_be) X(float_le) X(float_be)
+
+#define CONV_DST_FORMATS(X, src) \
+	X(src, s16_le) X(src, s16_be) X(src, s24_3le) X(src, s24_3be) \
+	X(src, s24_le) X(src, s24_be) X(src, s32_le) X(src, s32_be) \
+	X(src, float_le) X(src, float_be)
+
+#define CONV_BLOCK	16
+
+#define CONV_KERNEL(src, dst) \
+static void conv_##src##_##dst(char *__restrict d, int dst_step, \
+			       const char *__restrict s, int src_step, \
+			       snd_pcm_uframes_t frames) \
+{ \
+	snd_pcm_uframes_t i, j; \
+	if (src_step == CONV_SIZE_##src && dst_step == CONV_SIZE_##dst) { \
+		/* fixed size blocks are vectorized even at -O2 */ \
+		for (i = 0; i + CONV_BLOCK <= frames; i += CONV_BLOCK) \
+			for (j = i; j < i + CONV_BLOCK; j++) \
+				conv_store_##dst(d + j * CONV_SIZE_##dst, \
+						 conv_load_##src(s + j * CONV_SIZE_##src)); \
+		for (; i < frames; i++) \
+			conv_store_##dst(d + i * CONV_SIZE_##dst, \
+					 conv_load_##src(s + i * CONV_SIZE_##src)); \
+		return; \
+	} \
+	for (i = 0; i < frames; i++) { \
+		conv_store_##dst(d, conv_load_##src(s)); \
+		s += src_step; \
+		d += dst_step; \
+	} \
+}
+
+#define CONV_KERNEL_ROW(src) CONV_DST_FORMATS(CONV_KERNEL, src)
+CONV_SRC_FORMATS(CONV_KERNEL_ROW)
+
+#define CONV_TABLE_ENTRY(src, dst) conv_##src##_##dst,
+#define CONV_TABLE_ROW(src) { CONV_DST_FORMATS(CONV_TABLE_ENTRY, src) },
+static const snd_pcm_linear_kernel_func_t conv_kernels[10][10] = {
+	CONV_SRC_FORMATS(CONV_TABLE_ROW)
+};
+
+static int conv_kernel_index(snd_pcm_format_t format)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16_LE: return 0;
+	case SND_PCM_FORMAT_S16_BE: return 1;
+	case SND_PCM_FORMAT_S24_3LE: return 2;
+	case SND_PCM_FORMAT_S24_3BE: return 3;
+	case SND_PCM_FORMAT_S24_LE: return 4;
+	case SND_PCM_FORMAT_S24_BE: return 5;
+	case SND_PCM_FORMAT_S32_LE: return 6;
+	case SND_PCM_FORMAT_S32_BE: return 7;
+	case SND_PCM_FORMAT_FLOAT_LE: return 8;
+	case SND_PCM_FORMAT_FLOAT_BE: return 9;
+	default: return -1;
+	}
+}
+
+int snd_pcm_linear_kernel(snd_pcm_linear_kernel_t *kernel,
+			  snd_pcm_format_t src_format,
+			  snd_pcm_format_t dst_format)
+{
+	int src = conv_kernel_index(src_format);
+	int dst = conv_kernel_index(dst_format);
+
+	kernel->func = NULL;
+	/* float to float would lose precision through the integer sample */
+	if (src < 0 || dst < 0 ||
+	    (snd_pcm_format_float(src_format) == 1 &&
+	     snd_pcm_format_float(dst_format) == 1))
+		return -EINVAL;
+	kernel->func = conv_kernels[src][dst];
+	kernel->src_width = snd_pcm_format_physical_width(src_format);
+	kernel->dst_width = snd_pcm_format_physical_width(dst_format);
+	return 0;
+}
+
+/* all channels are interleaved in one buffer */
+static int conv_areas_interleaved(const snd_pcm_channel_area_t *areas,
+				  unsigned int channels, unsigned int width)
+{
+	unsigned int channel;
+
+	if (areas[0].first % 8 || areas[0].step != channels * width)
+		return 0;
+	for (channel = 1; channel < channels; channel++) {
+		if (areas[channel].addr != areas[0].addr ||
+		    areas[channel].first != areas[0].first + channel * width ||
+		    areas[channel].step != areas[0].step)
+			return 0;
+	}
+	return 1;
+}
+
+void snd_pcm_linear_kernel_areas(const snd_pcm_linear_kernel_t *kernel,
+				 const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+				 const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+				 unsigned int channels, snd_pcm_uframes_t frames)
+{
+	unsigned int channel;
+
+	if (channels > 1 &&
+	    conv_areas_interleaved(src_areas, channels, kernel->src_width) &&
+	    conv_areas_interleaved(dst_areas, channels, kernel->dst_width)) {
+		kernel->func(snd_pcm_channel_area_addr(dst_areas, dst_offset),
+			     kernel->dst_width / 8,
+			     snd_pcm_channel_area_addr(src_areas, src_offset),
+			     kernel->src_width / 8,
+			     frames * channels);
+		return;
+	}
+	for (channel = 0; channel < channels; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		kernel->func(snd_pcm_channel_area_addr(dst_area, dst_offset),
+			     snd_pcm_channel_area_step(dst_area),
+			     snd_pcm_channel_area_addr(src_area, src_offset),
+			     snd_pcm_channel_area_step(src_area),
+			     frames);
+	}
+}
+
+
+int snd_pcm_lfloat_get_s32_index(snd_pcm_format_t format)
+{
+	int width, endian;
+
+	switch (format) {
+	case SND_PCM_FORMAT_FLOAT_LE:
+	case SND_PCM_FORMAT_FLOAT_BE:
+		width = 32;
+		break;
+	case SND_PCM_FORMAT_FLOAT64_LE:
+	case SND_PCM_FORMAT_FLOAT64_BE:
+		width = 64;
+		break;
+	default:
+		return -EINVAL;
+	}
+#ifdef SND_LITTLE_ENDIAN
+	endian = snd_pcm_format_big_endian(format);
+#else
+	endian = snd_pcm_format_little_endian(format);
+#endif
+	return ((width / 32)-1) * 2 + endian;
+}
+
+int snd_pcm_lfloat_put_s32_index(snd_pcm_format_t format)
+{
+	return snd_pcm_lfloat_get_s32_index(format);
+}
+
+#ifndef BUGGY_GCC
+
+void snd_pcm_lfloat_convert_integer_float(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+					  const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+					  unsigned int channels, snd_pcm_uframes_t frames,
+					  unsigned int get32idx, unsigned int put32floatidx)
+{
+#define GET32_LABELS
+#define PUT32F_LABELS
+#include "plugin_ops.h"
+#undef PUT32F_LABELS
+#undef GET32_LABELS
+	void *get32 = get32_labels[get32idx];
+	void *put32float = put32float_labels[put32floatidx];
+	unsigned int channel;
+	for (channel = 0; channel < channels; ++channel) {
+		const char *src;
+		char *dst;
+		int src_step, dst_step;
+		snd_pcm_uframes_t frames1;
+		int32_t sample = 0;
+		snd_tmp_float_t tmp_float;
+		snd_tmp_double_t tmp_double;
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		src = snd_pcm_channel_area_addr(src_area, src_offset);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		src_step = snd_pcm_channel_area_step(src_area);
+		dst_step = snd_pcm_channel_area_step(dst_area);
+		frames1 = frames;
+		while (frames1-- > 0) {
+			goto *get32;
+#define GET32_END sample_loaded
+#include "plugin_ops.h"
+#undef GET32_END
+		sample_loaded:
+			goto *put32float;
+#define PUT32F_END sample_put
+#include "plugin_ops.h"
+#undef PUT32F_END
+		sample_put:
+			src += src_step;
+			dst += dst_step;
+		}
+	}
+}
+
+void snd_pcm_lfloat_convert_float_integer(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+					  const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+					  unsigned int channels, snd_pcm_uframes_t frames,
+					  unsigned int put32idx, unsigned int get32floatidx)
+{
+#define PUT32_LABELS
+#define GET32F_LABELS
+#include "plugin_ops.h"
+#undef GET32F_LABELS
+#undef PUT32_LABELS
+	void *put32 = put32_labels[put32idx];
+	void *get32float = get32float_labels[get32floatidx];
+	unsigned int channel;
+	for (channel = 0; channel < channels; ++channel) {
+		const char *src;
+		char *dst;
+		int src_step, dst_step;
+		snd_pcm_uframes_t frames1;
+		int32_t sample = 0;
+		snd_tmp_float_t tmp_float;
+		snd_tmp_double_t tmp_double;
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		src = snd_pcm_channel_area_addr(src_area, src_offset);
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		src_step = snd_pcm_channel_area_step(src_area);
+		dst_step = snd_pcm_channel_area_step(dst_area);
+		frames1 = frames;
+		while (frames1-- > 0) {
+			goto *get32float;
+#define GET32F_END sample_loaded
+#include "plugin_ops.h"
+#undef GET32F_END
+		sample_loaded:
+			goto *put32;
+#define PUT32_END sample_put
+#include "plugin_ops.h"
+#undef PUT32_END
+		sample_put:
+			src += src_step;
+			dst += dst_step;
+		}
+	}
+}
+
+#endif /* BUGGY_GCC */
+
+#endif /* DOC_HIDDEN */
@@ -39,6 +39,14 @@
 #include <sys/un.h>
 #include <sys/mman.h>
 #include "pcm_direct.h"
+#ifdef HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#endif
+
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#define DIRECT_SHM_LOCK
+#endif
 
 /*
  *
@@ -51,11 +59,6 @@ union semun {
 	struct seminfo  *__buf;  /* Buffer for IPC_INFO (Linux specific) */
 };
  
-/*
- * FIXME:
- *  add possibility to use futexes here
- */
-
 int snd_pcm_direct_semaphore_create_or_connect(snd_pcm_direct_t *dmix)
 {
 	union semun s;
@@ -82,6 +85,86 @@ int snd_pcm_direct_semaphore_create_or_connect(snd_pcm_direct_t *dmix)
 	return 0;
 }
 
+/*
+ * Lock for the frequent operations (ring buffer mixing) living in the
+ * shared memory segment: a process shared robust mutex, so taking an
+ * uncontended lock costs no syscall.  When the owner dies while holding
+ * the lock, the kernel marks it and the next locker takes it over.
+ * The SysV semaphore is still used to serialize open and close, since
+ * it protects the shared memory segment itself, and it replaces this
+ * lock when pthreads are not available.
+ */
+#ifdef DIRECT_SHM_LOCK
+/* the mutex layout differs between the ABIs */
+#define DIRECT_LOCK_ABI	((unsigned int)(sizeof(pthread_mutex_t) | \
+					(sizeof(long) << 8)))
+
+int snd_pcm_direct_shm_lock_init(snd_pcm_direct_t *dmix, int first_instance)
+{
+	pthread_mutex_t *mutex = (pthread_mutex_t *)dmix->shmptr->lock;
+	pthread_mutexattr_t attr;
+	int err;
+
+	if (sizeof(pthread_mutex_t) > sizeof(dmix->shmptr->lock))
+		return -ENOSYS;
+	if (!first_instance) {
+		if (dmix->shmptr->lock_abi != DIRECT_LOCK_ABI) {
+			SNDERR("the shared lock was created by a client with a different ABI");
+			return -EINVAL;
+		}
+		return 0;
+	}
+	err = pthread_mutexattr_init(&attr);
+	if (err)
+		return -err;
+	err = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	if (!err)
+		err = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	if (!err)
+		err = pthread_mutex_init(mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+	if (err)
+		return -err;
+	dmix->shmptr->lock_abi = DIRECT_LOCK_ABI;
+	return 0;
+}
+
+int snd_pcm_direct_shm_lock(snd_pcm_direct_t *dmix)
+{
+	pthread_mutex_t *mutex = (pthread_mutex_t *)dmix->shmptr->lock;
+	int err;
+
+	err = pthread_mutex_lock(mutex);
+	if (err == EOWNERDEAD) {
+		/* the owner died in the critical section; the sum buffer
+		 * may keep a partial update, but it stays usable */
+		err = pthread_mutex_consistent(mutex);
+	}
+	return -err;
+}
+
+int snd_pcm_direct_shm_unlock(snd_pcm_direct_t *dmix)
+{
+	return -pthread_mutex_unlock((pthread_mutex_t *)dmix->shmptr->lock);
+}
+#else /* !DIRECT_SHM_LOCK */
+int snd_pcm_direct_shm_lock_init(snd_pcm_direct_t *dmix ATTRIBUTE_UNUSED,
+				 int first_instance ATTRIBUTE_UNUSED)
+{
+	return 0;
+}
+
+int snd_pcm_direct_shm_lock(snd_pcm_direct_t *dmix)
+{
+	return snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT);
+}
+
+int snd_pcm_direct_shm_unlock(snd_pcm_direct_t *dmix)
+{
+	return snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
+}
+#endif /* DIRECT_SHM_LOCK */
+
 #define SND_PCM_DIRECT_MAGIC	(0xa15ad300 + sizeof(snd_pcm_direct_share_t))
 
 /*
@@ -255,6 +338,8 @@ static void server_cleanup(snd_pcm_direct_t *dmix)
 	close(dmix->hw_fd);
 	if (dmix->server_free)
 		dmix->server_free(dmix);
+	if (dmix->shmptr->use_memfd && dmix->ipc_fd >= 0)
+		close(dmix->ipc_fd);
 	unlink(dmix->shmptr->socket_name);
 	_snd_pcm_direct_shm_discard(dmix);
 	snd_pcm_direct_semaphore_discard(dmix);
@@ -280,7 +365,7 @@ static int _snd_send_fd(int sock, void *data, size_t len, int fd)
 	struct msghdr msghdr;
 	struct iovec vec;
 
-	vec.iov_base = (void *)&data;
+	vec.iov_base = data;
 	vec.iov_len = len;
 
 	cmsg->cmsg_len = cmsg_len;
@@ -321,7 +406,8 @@ static void server_job(snd_pcm_direct_t *dmix)
 #else
 	while (--i >= 0) {
 #endif
-		if (i != dmix->server_fd && i != dmix->hw_fd)
+		if (i != dmix->server_fd && i != dmix->hw_fd &&
+		    (!dmix->shmptr->use_memfd || i != dmix->ipc_fd))
 			close(i);
 	}
 	
@@ -367,6 +453,10 @@ static void server_job(snd_pcm_direct_t *dmix)
 					pfds[current+1].fd = sck;
 					pfds[current+1].events = POLLIN | POLLERR | POLLHUP;
 					_snd_send_fd(sck, &buf, 1, dmix->hw_fd);
+					if (dmix->shmptr->use_memfd) {
+						buf = 'M';
+						_snd_send_fd(sck, &buf, 1, dmix->ipc_fd);
+					}
 					server_printf("DIRECT SERVER: fd sent ok\n");
 					current++;
 				}
@@ -477,6 +567,16 @@ int snd_pcm_direct_client_connect(snd_pcm_direct_t *dmix)
 		dmix->comm_fd = -1;
 		return ret;
 	}
+	if (dmix->shmptr->use_memfd) {
+		/* the shared buffer follows the hw fd */
+		ret = snd_receive_fd(dmix->comm_fd, &buf, 1, &dmix->ipc_fd);
+		if (ret < 1 || dmix->ipc_fd < 0) {
+			close(dmix->hw_fd);
+			close(dmix->comm_fd);
+			dmix->comm_fd = -1;
+			return ret < 0 ? ret : -EIO;
+		}
+	}
 
 	dmix->client = 1;
 	return 0;
@@ -510,6 +610,13 @@ int snd_pcm_direct_async(snd_pcm_t *pcm, int sig, pid_t pid)
 /* empty the timer read queue */
 void snd_pcm_direct_clear_timer_queue(snd_pcm_direct_t *dmix)
 {
+	if (dmix->safety_margin) {
+		unsigned long long expirations;
+		/* poll_fd is the timerfd in the low latency mode */
+		while (read(dmix->hrtimer_fd, &expirations, sizeof(expirations)) > 0)
+			;
+		return;
+	}
 	if (dmix->timer_need_poll) {
 		while (poll(&dmix->timer_fd, 1, 0) > 0) {
 			/* we don't need the value */
@@ -540,6 +647,13 @@ void snd_pcm_direct_clear_timer_queue(snd_pcm_direct_t *dmix)
 int snd_pcm_direct_timer_stop(snd_pcm_direct_t *dmix)
 {
 	snd_timer_stop(dmix->timer);
+#ifdef HAVE_SYS_TIMERFD_H
+	if (dmix->safety_margin) {
+		struct itimerspec its;
+		memset(&its, 0, sizeof(its));
+		timerfd_settime(dmix->hrtimer_fd, 0, &its, NULL);
+	}
+#endif
 	return 0;
 }
 
@@ -768,9 +882,41 @@ int snd_pcm_direct_hw_free(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
 	return 0;
 }
 
-int snd_pcm_direct_sw_params(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_sw_params_t * params ATTRIBUTE_UNUSED)
+/*
+ * The slave timer fires once per slave period for every client. A client
+ * which asks for a larger avail_min does not need all these wakeups, so
+ * let its own timer instance skip the ticks it would only sleep through.
+ * The wakeup may come up to one timer interval after avail_min is
+ * reached, thus keep avail_min plus that interval within the buffer.
+ */
+static unsigned int direct_timer_ticks(snd_pcm_direct_t *dmix,
+				       snd_pcm_uframes_t buffer_size,
+				       snd_pcm_uframes_t avail_min)
+{
+	snd_pcm_uframes_t period = dmix->slave_period_size;
+	snd_pcm_uframes_t ticks;
+
+	if (!period || avail_min >= buffer_size)
+		return 1;
+	ticks = avail_min / period;
+	if (ticks > (buffer_size - avail_min) / period)
+		ticks = (buffer_size - avail_min) / period;
+	return ticks > 1 ? ticks : 1;
+}
+
+int snd_pcm_direct_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t * params)
 {
+	snd_pcm_direct_t *dmix = pcm->private_data;
+	unsigned int ticks;
+
 	/* values are cached in the pcm structure */
+	ticks = direct_timer_ticks(dmix, pcm->buffer_size, params->avail_min);
+	if (ticks == dmix->timer_ticks)
+		return 0;
+	dmix->timer_ticks = ticks;
+	/* changing the timer parameters stops a running timer */
+	if (dmix->state == SND_PCM_STATE_PREPARED)
+		return snd_pcm_direct_set_timer_params(dmix);
 	return 0;
 }
 
@@ -1181,6 +1327,46 @@ int snd_pcm_direct_initialize_poll_fd(snd_pcm_direct_t *dmix)
 	return 0;
 }
 
+/*
+ * Low latency mode: the slave period only limits how often the slave
+ * timer fires, so the clients are woken by a timerfd instead, twice
+ * per safety margin.  The slave timer stays running and still reports
+ * the stop and suspend events through the slave state.
+ */
+int snd_pcm_direct_hrtimer_open(snd_pcm_direct_t *dmix)
+{
+#ifdef HAVE_SYS_TIMERFD_H
+	dmix->hrtimer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (dmix->hrtimer_fd < 0)
+		return -errno;
+	dmix->poll_fd = dmix->hrtimer_fd;
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
+int snd_pcm_direct_hrtimer_start(snd_pcm_direct_t *dmix)
+{
+#ifdef HAVE_SYS_TIMERFD_H
+	struct itimerspec its;
+	unsigned long long nsec;
+
+	nsec = (unsigned long long)dmix->safety_margin * 1000000000ULL /
+	       dmix->shmptr->s.rate / 2;
+	if (nsec < 100000)
+		nsec = 100000;
+	its.it_interval.tv_sec = nsec / 1000000000ULL;
+	its.it_interval.tv_nsec = nsec % 1000000000ULL;
+	its.it_value = its.it_interval;
+	if (timerfd_settime(dmix->hrtimer_fd, 0, &its, NULL) < 0)
+		return -errno;
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
 static snd_pcm_uframes_t recalc_boundary_size(unsigned long long bsize, snd_pcm_uframes_t buffer_size)
 {
 	if (bsize > LONG_MAX) {
@@ -1301,7 +1487,7 @@ int snd_pcm_direct_set_timer_params(snd_pcm_direct_t *dmix)
 	snd_timer_params_set_auto_start(params, 1);
 	if (dmix->type != SND_PCM_TYPE_DSNOOP)
 		snd_timer_params_set_early_event(params, 1);
-	snd_timer_params_set_ticks(params, 1);
+	snd_timer_params_set_ticks(params, dmix->timer_ticks ? dmix->timer_ticks : 1);
 	if (dmix->tread) {
 		filter = (1<<SND_TIMER_EVENT_TICK) |
 			 dmix->timer_events;
@@ -1591,6 +1777,9 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 	rec->ipc_gid = -1;
 	rec->slowptr = 1;
 	rec->max_periods = 0;
+	rec->zerocopy = 0;
+	rec->ipc_memfd = 0;
+	rec->safety_margin = 0;
 
 	/* read defaults */
 	if (snd_config_search(root, "defaults.pcm.dmix_max_periods", &n) >= 0) {
@@ -1697,6 +1886,32 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 			rec->max_periods = val;
 			continue;
 		}
+		if (strcmp(id, "safety_margin") == 0) {
+			long val;
+			err = snd_config_get_integer(n, &val);
+			if (err < 0)
+				return err;
+			if (val < 0 || val > INT_MAX) {
+				SNDERR("The field safety_margin is out of range");
+				return -EINVAL;
+			}
+			rec->safety_margin = val;
+			continue;
+		}
+		if (strcmp(id, "ipc_memfd") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->ipc_memfd = err;
+			continue;
+		}
+		if (strcmp(id, "zerocopy") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->zerocopy = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -66,6 +66,7 @@ typedef struct {
 	char socket_name[256];			/* name of communication socket */
 	snd_pcm_type_t type;			/* PCM type (currently only hw) */
 	int use_server;
+	int use_memfd;				/* buffers are memfds passed by the server */
 	struct {
 		unsigned int format;
 		snd_interval_t rate;
@@ -112,8 +113,17 @@ typedef struct {
 			unsigned long long chn_mask;
 		} dshare;
 	} u;
+	unsigned int lock_abi;			/* mutex size and word size */
+	unsigned long long lock[8];		/* pthread_mutex_t, robust */
 } snd_pcm_direct_share_t;
 
+/* run of consecutive client channels bound to consecutive slave channels */
+typedef struct {
+	unsigned int src;		/* first client channel */
+	unsigned int dst;		/* first slave channel */
+	unsigned int count;		/* channels in the run */
+} snd_pcm_direct_run_t;
+
 typedef struct snd_pcm_direct snd_pcm_direct_t;
 
 struct snd_pcm_direct {
@@ -147,18 +157,26 @@ struct snd_pcm_direct {
 	int tread: 1;
 	int timer_need_poll: 1;
 	unsigned int timer_events;
+	unsigned int timer_ticks;	/* slave periods per timer wakeup */
+	snd_pcm_uframes_t safety_margin; /* low latency: frames kept ahead of hw (dmix) */
+	snd_pcm_uframes_t margin_appl_ptr; /* last_appl_ptr at the last margin jump */
+	int hrtimer_fd;			/* timerfd used as poll_fd in low latency mode */
 	int server_fd;
 	pid_t server_pid;
 	snd_timer_t *timer; 		/* timer used as poll_fd */
 	int interleaved;	 	/* we have interleaved buffer */
 	int slowptr;			/* use slow but more precise ptr updates */
 	int max_periods;		/* max periods (-1 = fixed periods, 0 = max buffer size) */
+	int zerocopy;			/* share the slave ring instead of copying (dsnoop) */
+	int ipc_memfd;			/* use memfd instead of SysV shm for buffers */
+	int ipc_fd;			/* memfd passed to the clients with hw_fd */
 	unsigned int channels;		/* client's channels */
 	unsigned int *bindings;
 	union {
 		struct {
 			int shmid_sum;			/* IPC global sum ring buffer memory identification */
 			signed int *sum_buffer;		/* shared sum buffer */
+			size_t sum_size;		/* mapped size of the memfd sum buffer */
 			mix_areas_16_t *mix_areas_16;
 			mix_areas_32_t *mix_areas_32;
 			mix_areas_24_t *mix_areas_24;
@@ -172,6 +190,8 @@ struct snd_pcm_direct {
 		} dsnoop;
 		struct {
 			unsigned long long chn_mask;
+			snd_pcm_direct_run_t *runs;	/* binding runs for the scatter path */
+			unsigned int nruns;		/* 0 = scatter path not usable */
 		} dshare;
 	} u;
 	void (*server_free)(snd_pcm_direct_t *direct);
@@ -180,6 +200,12 @@ struct snd_pcm_direct {
 /* make local functions really local */
 #define snd_pcm_direct_semaphore_create_or_connect \
 	snd1_pcm_direct_semaphore_create_or_connect
+#define snd_pcm_direct_shm_lock_init \
+	snd1_pcm_direct_shm_lock_init
+#define snd_pcm_direct_shm_lock \
+	snd1_pcm_direct_shm_lock
+#define snd_pcm_direct_shm_unlock \
+	snd1_pcm_direct_shm_unlock
 #define snd_pcm_direct_shm_create_or_connect \
 	snd1_pcm_direct_shm_create_or_connect
 #define snd_pcm_direct_shm_discard \
@@ -198,6 +224,10 @@ struct snd_pcm_direct {
 	snd1_pcm_direct_initialize_secondary_slave
 #define snd_pcm_direct_initialize_poll_fd \
 	snd1_pcm_direct_initialize_poll_fd
+#define snd_pcm_direct_hrtimer_open \
+	snd1_pcm_direct_hrtimer_open
+#define snd_pcm_direct_hrtimer_start \
+	snd1_pcm_direct_hrtimer_start
 #define snd_pcm_direct_check_interleave \
 	snd1_pcm_direct_check_interleave
 #define snd_pcm_direct_parse_bindings \
@@ -280,6 +310,53 @@ static inline int snd_pcm_direct_semaphore_final(snd_pcm_direct_t *dmix, int sem
 	return snd_pcm_direct_semaphore_up(dmix, sem_num);
 }
 
+/*
+ * low latency mode (dmix): data which would land closer than the safety
+ * margin to the estimated hardware pointer hw_ptr (or behind it) is moved
+ * ahead by the margin; the gap plays as silence instead of a partially
+ * played mix.  The jump never leaves the writable part of the slave
+ * buffer, which ends one period before the last known hardware pointer
+ * wraps around, even if the estimate is ahead of that pointer.
+ */
+static inline void snd_pcm_direct_margin_check(snd_pcm_direct_t *dmix,
+					       snd_pcm_uframes_t hw_ptr)
+{
+	snd_pcm_uframes_t queued, ahead, margin, limit;
+
+	if (dmix->slave_appl_ptr >= hw_ptr)
+		queued = dmix->slave_appl_ptr - hw_ptr;
+	else
+		queued = dmix->slave_appl_ptr + (dmix->slave_boundary - hw_ptr);
+	if (queued >= dmix->safety_margin && queued <= dmix->slave_buffer_size)
+		return;
+	if (hw_ptr >= dmix->slave_hw_ptr)
+		ahead = hw_ptr - dmix->slave_hw_ptr;
+	else
+		ahead = hw_ptr + (dmix->slave_boundary - dmix->slave_hw_ptr);
+	limit = dmix->slave_buffer_size - dmix->slave_period_size;
+	margin = dmix->safety_margin;
+	if (ahead + margin > limit)
+		margin = limit > ahead ? limit - ahead : 0;
+	/* already as far ahead as allowed */
+	if (queued <= dmix->slave_buffer_size && queued >= margin)
+		return;
+	dmix->slave_appl_ptr = (hw_ptr + margin) % dmix->slave_boundary;
+	/* data mixed before this point cannot be rewound */
+	dmix->margin_appl_ptr = dmix->last_appl_ptr;
+}
+
+/* low latency mode (dmix): frames mixed since the last margin jump */
+static inline snd_pcm_uframes_t
+snd_pcm_direct_margin_mixed(snd_pcm_direct_t *dmix, snd_pcm_uframes_t boundary)
+{
+	if (dmix->last_appl_ptr >= dmix->margin_appl_ptr)
+		return dmix->last_appl_ptr - dmix->margin_appl_ptr;
+	return dmix->last_appl_ptr + (boundary - dmix->margin_appl_ptr);
+}
+
+int snd_pcm_direct_shm_lock_init(snd_pcm_direct_t *dmix, int first_instance);
+int snd_pcm_direct_shm_lock(snd_pcm_direct_t *dmix);
+int snd_pcm_direct_shm_unlock(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_shm_create_or_connect(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_shm_discard(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_server_create(snd_pcm_direct_t *dmix);
@@ -289,6 +366,8 @@ int snd_pcm_direct_client_discard(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_initialize_slave(snd_pcm_direct_t *dmix, snd_pcm_t *spcm, struct slave_params *params);
 int snd_pcm_direct_initialize_secondary_slave(snd_pcm_direct_t *dmix, snd_pcm_t *spcm, struct slave_params *params);
 int snd_pcm_direct_initialize_poll_fd(snd_pcm_direct_t *dmix);
+int snd_pcm_direct_hrtimer_open(snd_pcm_direct_t *dmix);
+int snd_pcm_direct_hrtimer_start(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_check_interleave(snd_pcm_direct_t *dmix, snd_pcm_t *pcm);
 int snd_pcm_direct_parse_bindings(snd_pcm_direct_t *dmix,
 				  struct slave_params *params,
@@ -323,6 +402,9 @@ struct snd_pcm_direct_open_conf {
 	int ipc_gid;
 	int slowptr;
 	int max_periods;
+	int zerocopy;
+	int ipc_memfd;
+	int safety_margin;
 	snd_config_t *slave;
 	snd_config_t *bindings;
 };
@@ -39,6 +39,7 @@
 #include <sys/mman.h>
 #include <sys/shm.h>
 #include <sys/sem.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -61,6 +62,84 @@ const char *_snd_module_pcm_dmix = "";
 
 static int shm_sum_discard(snd_pcm_direct_t *dmix);
 
+/*
+ *  sum ring buffer in a memfd segment
+ *
+ *  The first client creates the segment, the server keeps it open and
+ *  passes it to the other clients with the hw fd.  The memory goes away
+ *  with the last user, there is no key and no SysV limit involved.
+ */
+#ifdef HAVE_MEMFD_CREATE
+#define DMIX_HUGE_PAGE_SIZE	(2 * 1024 * 1024)
+
+static int memfd_sum_map(snd_pcm_direct_t *dmix, int fd, size_t size)
+{
+	void *ptr;
+
+	ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ptr == MAP_FAILED)
+		return -errno;
+	mlock(ptr, size);
+	dmix->u.dmix.sum_buffer = ptr;
+	dmix->u.dmix.sum_size = size;
+	return 0;
+}
+
+static int memfd_sum_create(snd_pcm_direct_t *dmix, size_t size, unsigned int flags)
+{
+	int fd, err;
+
+	fd = memfd_create("alsa-dmix-sum", MFD_CLOEXEC | flags);
+	if (fd < 0)
+		return -errno;
+	if (ftruncate(fd, size) < 0) {
+		err = -errno;
+		close(fd);
+		return err;
+	}
+#ifdef F_ADD_SEALS
+	/* hugetlbfs supports seals since Linux 4.16, fail for a fallback */
+	if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+		err = -errno;
+		close(fd);
+		return err;
+	}
+#endif
+	/* the pages are touched (mlock) by the creator first */
+	err = memfd_sum_map(dmix, fd, size);
+	if (err < 0) {
+		close(fd);
+		return err;
+	}
+	dmix->ipc_fd = fd;
+	return 0;
+}
+
+static int memfd_sum_create_or_connect(snd_pcm_direct_t *dmix, size_t size)
+{
+	struct stat st;
+	int err = -ENOMEM;
+
+	if (dmix->ipc_fd >= 0) {
+		/* received from the server */
+		if (fstat(dmix->ipc_fd, &st) < 0)
+			return -errno;
+		if ((size_t)st.st_size < size)
+			return -EINVAL;
+		return memfd_sum_map(dmix, dmix->ipc_fd, st.st_size);
+	}
+#ifdef MFD_HUGETLB
+	if (size >= DMIX_HUGE_PAGE_SIZE)
+		err = memfd_sum_create(dmix, (size + DMIX_HUGE_PAGE_SIZE - 1) &
+					     ~(size_t)(DMIX_HUGE_PAGE_SIZE - 1),
+				       MFD_HUGETLB | MFD_ALLOW_SEALING);
+#endif
+	if (err < 0)
+		err = memfd_sum_create(dmix, size, MFD_ALLOW_SEALING);
+	return err;
+}
+#endif /* HAVE_MEMFD_CREATE */
+
 /*
  *  sum ring buffer shared memory area 
  */
@@ -73,6 +152,10 @@ static int shm_sum_create_or_connect(snd_pcm_direct_t *dmix)
 	size = dmix->shmptr->s.channels *
 	       dmix->shmptr->s.buffer_size *
 	       sizeof(signed int);	
+#ifdef HAVE_MEMFD_CREATE
+	if (dmix->shmptr->use_memfd)
+		return memfd_sum_create_or_connect(dmix, size);
+#endif
 retryshm:
 	dmix->u.dmix.shmid_sum = shmget(dmix->ipc_key + 1, size,
 					IPC_CREAT | dmix->ipc_perm);
@@ -111,6 +194,16 @@ static int shm_sum_discard(snd_pcm_direct_t *dmix)
 	struct shmid_ds buf;
 	int ret = 0;
 
+	if (dmix->shmptr->use_memfd) {
+		if (dmix->ipc_fd < 0)
+			return -EINVAL;
+		if (dmix->u.dmix.sum_buffer != (void *) -1)
+			munmap(dmix->u.dmix.sum_buffer, dmix->u.dmix.sum_size);
+		dmix->u.dmix.sum_buffer = (void *) -1;
+		close(dmix->ipc_fd);
+		dmix->ipc_fd = -1;
+		return 0;
+	}
 	if (dmix->u.dmix.shmid_sum < 0)
 		return -EINVAL;
 	if (dmix->u.dmix.sum_buffer != (void *) -1 && shmdt(dmix->u.dmix.sum_buffer) < 0)
@@ -130,7 +223,8 @@ static int shm_sum_discard(snd_pcm_direct_t *dmix)
 static void dmix_server_free(snd_pcm_direct_t *dmix)
 {
 	/* remove the memory region */
-	shm_sum_create_or_connect(dmix);
+	if (!dmix->shmptr->use_memfd)
+		shm_sum_create_or_connect(dmix);
 	shm_sum_discard(dmix);
 }
 
@@ -289,18 +383,45 @@ static void remix_areas(snd_pcm_direct_t *dmix,
 
 /*
  * if no concurrent access is allowed in the mixing routines, we need to protect
- * the area via semaphore
+ * the area via the shared memory lock
  */
 #ifndef DOC_HIDDEN
 #ifdef NO_CONCURRENT_ACCESS
-#define dmix_down_sem(dmix) snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT)
-#define dmix_up_sem(dmix) snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT)
+#define dmix_down_sem(dmix) snd_pcm_direct_shm_lock(dmix)
+#define dmix_up_sem(dmix) snd_pcm_direct_shm_unlock(dmix)
 #else
 #define dmix_down_sem(dmix)
 #define dmix_up_sem(dmix)
 #endif
 #endif
 
+/*
+ * low latency mode: the driver updates the slave hw_ptr at its own pace,
+ * extrapolate the current position from the timestamp of the last update
+ */
+static snd_pcm_uframes_t dmix_hw_estimate(snd_pcm_t *pcm, snd_pcm_direct_t *dmix)
+{
+	snd_htimestamp_t tstamp, now;
+	long long nsec;
+	snd_pcm_uframes_t frames;
+
+	tstamp = snd_pcm_hw_fast_tstamp(dmix->spcm);
+	if (!tstamp.tv_sec && !tstamp.tv_nsec)
+		return dmix->slave_hw_ptr;
+	gettimestamp(&now, pcm->tstamp_type);
+	nsec = (now.tv_sec - tstamp.tv_sec) * 1000000000LL +
+	       (now.tv_nsec - tstamp.tv_nsec);
+	if (nsec <= 0)
+		return dmix->slave_hw_ptr;
+	if (nsec > 1000000000LL)
+		nsec = 1000000000LL;
+	frames = nsec * dmix->shmptr->s.rate / 1000000000LL;
+	/* the pointer is updated at least once per period */
+	if (frames > dmix->slave_period_size)
+		frames = dmix->slave_period_size;
+	return (dmix->slave_hw_ptr + frames) % dmix->slave_boundary;
+}
+
 /*
  *  synchronize shm ring buffer with hardware
  */
@@ -321,6 +442,9 @@ static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
 	if (size >= pcm->boundary / 2)
 		size = pcm->boundary - size;
 
+	if (dmix->safety_margin)
+		snd_pcm_direct_margin_check(dmix, dmix_hw_estimate(pcm, dmix));
+
 	/* the slave_app_ptr can be far behind the slave_hw_ptr */
 	/* reduce mixing and errors here - just skip not catched writes */
 	if (dmix->slave_hw_ptr <= dmix->slave_appl_ptr)
@@ -427,7 +551,7 @@ static int snd_pcm_dmix_sync_ptr(snd_pcm_t *pcm)
 	if (avail > dmix->avail_max)
 		dmix->avail_max = avail;
 	if (avail >= pcm->stop_threshold) {
-		snd_timer_stop(dmix->timer);
+		snd_pcm_direct_timer_stop(dmix);
 		gettimestamp(&dmix->trigger_tstamp, pcm->tstamp_type);
 		if (dmix->state == SND_PCM_STATE_RUNNING) {
 			dmix->state = SND_PCM_STATE_XRUN;
@@ -546,6 +670,10 @@ static int snd_pcm_dmix_prepare(snd_pcm_t *pcm)
 static void reset_slave_ptr(snd_pcm_t *pcm, snd_pcm_direct_t *dmix)
 {
 	dmix->slave_appl_ptr = dmix->slave_hw_ptr = *dmix->spcm->hw.ptr;
+	if (dmix->safety_margin) {
+		snd_pcm_direct_margin_check(dmix, dmix_hw_estimate(pcm, dmix));
+		return;
+	}
 	if (pcm->buffer_size > pcm->period_size * 2)
 		return;
 	/* If we have too litte periods, better to align the start position
@@ -574,6 +702,11 @@ static int snd_pcm_dmix_start_timer(snd_pcm_t *pcm, snd_pcm_direct_t *dmix)
 	err = snd_timer_start(dmix->timer);
 	if (err < 0)
 		return err;
+	if (dmix->safety_margin) {
+		err = snd_pcm_direct_hrtimer_start(dmix);
+		if (err < 0)
+			return err;
+	}
 	dmix->state = SND_PCM_STATE_RUNNING;
 	return 0;
 }
@@ -661,7 +794,19 @@ static int snd_pcm_dmix_pause(snd_pcm_t *pcm ATTRIBUTE_UNUSED, int enable ATTRIB
 
 static snd_pcm_sframes_t snd_pcm_dmix_rewindable(snd_pcm_t *pcm)
 {
-	return snd_pcm_mmap_playback_hw_rewindable(pcm);
+	snd_pcm_direct_t *dmix = pcm->private_data;
+	snd_pcm_sframes_t avail, limit;
+
+	avail = snd_pcm_mmap_playback_hw_rewindable(pcm);
+	if (!dmix->safety_margin || avail <= 0)
+		return avail;
+	/* not yet mixed frames plus the ones mixed since the last jump */
+	if (dmix->appl_ptr >= dmix->last_appl_ptr)
+		limit = dmix->appl_ptr - dmix->last_appl_ptr;
+	else
+		limit = dmix->appl_ptr + (pcm->boundary - dmix->last_appl_ptr);
+	limit += snd_pcm_direct_margin_mixed(dmix, pcm->boundary);
+	return avail < limit ? avail : limit;
 }
 
 static snd_pcm_sframes_t snd_pcm_dmix_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
@@ -691,6 +836,14 @@ static snd_pcm_sframes_t snd_pcm_dmix_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t f
 		return size;
 	result = size;
 
+	/* the slave position does not map to older data after a jump */
+	if (dmix->safety_margin &&
+	    frames > snd_pcm_direct_margin_mixed(dmix, pcm->boundary)) {
+		frames = snd_pcm_direct_margin_mixed(dmix, pcm->boundary);
+		if (!frames)
+			return result;
+	}
+
 	if (dmix->hw_ptr < dmix->appl_ptr)
 		size = dmix->appl_ptr - dmix->hw_ptr;
 	else
@@ -774,6 +927,8 @@ static int snd_pcm_dmix_close(snd_pcm_t *pcm)
 
 	if (dmix->timer)
 		snd_timer_close(dmix->timer);
+	if (dmix->hrtimer_fd >= 0)
+		close(dmix->hrtimer_fd);
 	snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT);
 	snd_pcm_close(dmix->spcm);
  	if (dmix->server)
@@ -979,6 +1134,11 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 	dmix->ipc_gid = opts->ipc_gid;
 	dmix->semid = -1;
 	dmix->shmid = -1;
+	dmix->ipc_fd = -1;
+	dmix->hrtimer_fd = -1;
+	dmix->ipc_memfd = opts->ipc_memfd;
+	dmix->safety_margin = opts->safety_margin;
+	dmix->u.dmix.shmid_sum = -1;
 
 	ret = snd_pcm_new(&pcm, dmix->type = SND_PCM_TYPE_DMIX, name, stream, mode);
 	if (ret < 0)
@@ -1006,6 +1166,13 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 		SNDERR("unable to create IPC shm instance");
 		goto _err;
 	}
+#ifdef NO_CONCURRENT_ACCESS
+	ret = snd_pcm_direct_shm_lock_init(dmix, first_instance);
+	if (ret < 0) {
+		SNDERR("unable to initialize the shared lock");
+		goto _err;
+	}
+#endif
 		
 	pcm->ops = &snd_pcm_dmix_ops;
 	pcm->fast_ops = &snd_pcm_dmix_fast_ops;
@@ -1039,6 +1206,19 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 
 		dmix->spcm = spcm;
 
+#ifdef HAVE_MEMFD_CREATE
+		if (dmix->ipc_memfd) {
+			/* the server hands the sum buffer to the other clients */
+			dmix->shmptr->use_memfd = 1;
+			dmix->shmptr->use_server = 1;
+			ret = shm_sum_create_or_connect(dmix);
+			if (ret < 0) {
+				SNDERR("unable to initialize sum ring buffer");
+				goto _err;
+			}
+		}
+#endif
+
 		if (dmix->shmptr->use_server) {
 			dmix->server_free = dmix_server_free;
 		
@@ -1090,10 +1270,12 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 		dmix->spcm = spcm;
 	}
 
-	ret = shm_sum_create_or_connect(dmix);
-	if (ret < 0) {
-		SNDERR("unable to initialize sum ring buffer");
-		goto _err;
+	if (!dmix->u.dmix.sum_buffer) {		/* not created above */
+		ret = shm_sum_create_or_connect(dmix);
+		if (ret < 0) {
+			SNDERR("unable to initialize sum ring buffer");
+			goto _err;
+		}
 	}
 
 	ret = snd_pcm_direct_initialize_poll_fd(dmix);
@@ -1102,6 +1284,19 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 		goto _err;
 	}
 
+	if (dmix->safety_margin) {
+		if (dmix->safety_margin >= dmix->slave_buffer_size) {
+			SNDERR("safety_margin must be smaller than the slave buffer");
+			ret = -EINVAL;
+			goto _err;
+		}
+		ret = snd_pcm_direct_hrtimer_open(dmix);
+		if (ret < 0) {
+			SNDERR("unable to create the low latency timer");
+			goto _err;
+		}
+	}
+
 	mix_select_callbacks(dmix);
 		
 	pcm->poll_fd = dmix->poll_fd;
@@ -1122,13 +1317,15 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
  _err:
 	if (dmix->timer)
 		snd_timer_close(dmix->timer);
+	if (dmix->hrtimer_fd >= 0)
+		close(dmix->hrtimer_fd);
 	if (dmix->server)
 		snd_pcm_direct_server_discard(dmix);
 	if (dmix->client)
 		snd_pcm_direct_client_discard(dmix);
 	if (spcm)
 		snd_pcm_close(spcm);
-	if (dmix->u.dmix.shmid_sum >= 0)
+	if (dmix->u.dmix.shmid_sum >= 0 || dmix->ipc_fd >= 0)
 		shm_sum_discard(dmix);
 	if (dmix->shmid >= 0)
 		snd_pcm_direct_shm_discard(dmix);
@@ -1158,6 +1355,8 @@ pcm.name {
 	ipc_key INT		# unique IPC key
 	ipc_key_add_uid BOOL	# add current uid to unique IPC key
 	ipc_perm INT		# IPC permissions (octal, default 0600)
+	ipc_memfd BOOL		# sum buffer in a memfd passed by the server
+	safety_margin INT	# low latency mode, frames ahead of the hw pointer
 	slave STR
 	# or
 	slave {			# Slave definition
@@ -1190,6 +1389,26 @@ added to the value set in <code>ipc_key</code>.  This will
 avoid the confliction of the same IPC key with different users
 concurrently.
 
+When <code>ipc_memfd</code> is set true (and the system supports
+memfd_create), the first client places the sum ring buffer into an
+anonymous memfd segment instead of a SysV shared memory segment and
+starts the helper server, which passes the segment to the other
+clients together with the hardware descriptor.  Large buffers use
+huge pages when they are available.  The segment is released with
+its last user, and only the small control area still counts against
+the SysV shared memory limits.  The setting of the first client
+applies to all the others.
+
+A non-zero <code>safety_margin</code> enables the low latency mode.
+The slave can then run with large periods while the client data is
+mixed only the given count of frames ahead of the hardware pointer,
+which is extrapolated from the timestamp of its last update.  The
+client is woken by a high resolution timer twice per margin instead
+of once per slave period.  Data which arrives too late is moved ahead
+by the margin instead of being mixed into the region being played.  The
+jump always leaves at least one slave period of the buffer free, so a
+margin near the slave buffer size is reduced.
+
 Note that the dmix plugin itself supports only a single configuration.
 That is, it supports only the fixed rate (default 48000), format
 (\c S16), channels (2), and period_time (125000).
@@ -1198,6 +1417,12 @@ in the slave PCM definition.  The rate, format and channels can be
 covered by an additional \ref pcm_plugins_dmix "plug plugin",
 but there is only one base configuration, anyway.
 
+Each client is woken up by its own instance of the slave PCM timer.
+When the client sets an \c avail_min larger than the slave period,
+its timer skips the periods it would only sleep through, as long as
+the remaining buffer space allows it.  The same applies to the dsnoop
+and dshare plugins.
+
 An example configuration for setting 44100 Hz, \c S32_LE format
 as the slave PCM of "hw:0" is like below:
 \code
@@ -1284,6 +1509,10 @@ int _snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 	err = snd_pcm_direct_parse_open_conf(root, conf, stream, &dopen);
 	if (err < 0)
 		return err;
+	if (dopen.zerocopy) {
+		SNDERR("zerocopy is supported only by dsnoop");
+		return -EINVAL;
+	}
 
 	/* the default settings, it might be invalid for some hardware */
 	params.format = SND_PCM_FORMAT_S16;
@@ -71,6 +71,49 @@ static void do_silence(snd_pcm_t *pcm)
 	}
 }
 
+#define SCATTER_FRAMES(bytes) \
+	for (; size > 0; size--, src += src_step, dst += dst_step) \
+		memcpy(dst, src, bytes)
+
+static void scatter_runs(snd_pcm_direct_t *dshare,
+			 const snd_pcm_channel_area_t *src_areas,
+			 const snd_pcm_channel_area_t *dst_areas,
+			 snd_pcm_uframes_t src_ofs,
+			 snd_pcm_uframes_t dst_ofs,
+			 snd_pcm_uframes_t frames)
+{
+	unsigned int fbytes, src_step, dst_step, i;
+
+	fbytes = snd_pcm_format_physical_width(dshare->shmptr->s.format) / 8;
+	src_step = dshare->channels * fbytes;
+	dst_step = dshare->shmptr->s.channels * fbytes;
+	for (i = 0; i < dshare->u.dshare.nruns; i++) {
+		const snd_pcm_direct_run_t *run = &dshare->u.dshare.runs[i];
+		const char *src = (const char *)src_areas[0].addr +
+				  src_ofs * src_step + run->src * fbytes;
+		char *dst = (char *)dst_areas[0].addr +
+			    dst_ofs * dst_step + run->dst * fbytes;
+		snd_pcm_uframes_t size = frames;
+		unsigned int bytes = run->count * fbytes;
+
+		/* constant sizes let the compiler use plain vector moves */
+		switch (bytes) {
+		case 2: SCATTER_FRAMES(2); break;
+		case 4: SCATTER_FRAMES(4); break;
+		case 6: SCATTER_FRAMES(6); break;
+		case 8: SCATTER_FRAMES(8); break;
+		case 12: SCATTER_FRAMES(12); break;
+		case 16: SCATTER_FRAMES(16); break;
+		case 24: SCATTER_FRAMES(24); break;
+		case 32: SCATTER_FRAMES(32); break;
+		case 64: SCATTER_FRAMES(64); break;
+		default: SCATTER_FRAMES(bytes); break;
+		}
+	}
+}
+
+#undef SCATTER_FRAMES
+
 static void share_areas(snd_pcm_direct_t *dshare,
 		      const snd_pcm_channel_area_t *src_areas,
 		      const snd_pcm_channel_area_t *dst_areas,
@@ -88,6 +131,8 @@ static void share_areas(snd_pcm_direct_t *dshare,
 		memcpy(((char *)dst_areas[0].addr) + (dst_ofs * channels * fbytes),
 		       ((char *)src_areas[0].addr) + (src_ofs * channels * fbytes),
 		       size * channels * fbytes);
+	} else if (dshare->u.dshare.nruns) {
+		scatter_runs(dshare, src_areas, dst_areas, src_ofs, dst_ofs, size);
 	} else {
 		for (chn = 0; chn < channels; chn++) {
 			dchn = dshare->bindings ? dshare->bindings[chn] : chn;
@@ -97,6 +142,59 @@ static void share_areas(snd_pcm_direct_t *dshare,
 	}
 }
 
+/*
+ * Group the bindings into runs of consecutive channels.  When both the
+ * client and the slave buffers are interleaved, each run is then copied
+ * with one fixed size move per frame instead of one strided sample copy
+ * per channel.
+ */
+static void snd_pcm_dshare_build_runs(snd_pcm_t *pcm)
+{
+	snd_pcm_direct_t *dshare = pcm->private_data;
+	const snd_pcm_channel_area_t *src_areas, *dst_areas;
+	snd_pcm_direct_run_t *run = NULL;
+	unsigned int chn, dchn, bits, schannels;
+
+	dshare->u.dshare.nruns = 0;
+	if (dshare->interleaved || !dshare->u.dshare.runs)
+		return;
+	bits = snd_pcm_format_physical_width(pcm->format);
+	if (bits % 8)
+		return;
+	schannels = dshare->shmptr->s.channels;
+	src_areas = snd_pcm_mmap_areas(pcm);
+	dst_areas = snd_pcm_mmap_areas(dshare->spcm);
+	for (chn = 0; chn < dshare->channels; chn++) {
+		if (src_areas[chn].addr != src_areas[0].addr ||
+		    src_areas[chn].first != chn * bits ||
+		    src_areas[chn].step != dshare->channels * bits)
+			return;
+	}
+	for (chn = 0; chn < schannels; chn++) {
+		if (dst_areas[chn].addr != dst_areas[0].addr ||
+		    dst_areas[chn].first != chn * bits ||
+		    dst_areas[chn].step != schannels * bits)
+			return;
+	}
+	for (chn = 0; chn < dshare->channels; chn++) {
+		dchn = dshare->bindings[chn];
+		if (dchn >= schannels) {
+			/* leave unbound channels to the generic copy */
+			dshare->u.dshare.nruns = 0;
+			return;
+		}
+		if (run && run->src + run->count == chn &&
+		    run->dst + run->count == dchn) {
+			run->count++;
+			continue;
+		}
+		run = &dshare->u.dshare.runs[dshare->u.dshare.nruns++];
+		run->src = chn;
+		run->dst = dchn;
+		run->count = 1;
+	}
+}
+
 /*
  *  synchronize shm ring buffer with hardware
  */
@@ -300,6 +398,7 @@ static int snd_pcm_dshare_prepare(snd_pcm_t *pcm)
 	snd_pcm_direct_t *dshare = pcm->private_data;
 
 	snd_pcm_direct_check_interleave(dshare, pcm);
+	snd_pcm_dshare_build_runs(pcm);
 	dshare->state = SND_PCM_STATE_PREPARED;
 	dshare->appl_ptr = dshare->last_appl_ptr = 0;
 	dshare->hw_ptr = 0;
@@ -471,6 +570,7 @@ static int snd_pcm_dshare_close(snd_pcm_t *pcm)
 			snd_pcm_direct_semaphore_final(dshare, DIRECT_IPC_SEM_CLIENT);
 	} else
 		snd_pcm_direct_semaphore_final(dshare, DIRECT_IPC_SEM_CLIENT);
+	free(dshare->u.dshare.runs);
 	free(dshare->bindings);
 	pcm->private_data = NULL;
 	free(dshare);
@@ -655,6 +755,9 @@ int snd_pcm_dshare_open(snd_pcm_t **pcmp, const char *name,
 		ret = -EINVAL;
 		goto _err_nosem;
 	}
+	/* a missing table only disables the scatter fast path */
+	dshare->u.dshare.runs = malloc(dshare->channels *
+				       sizeof(*dshare->u.dshare.runs));
 	
 	dshare->ipc_key = opts->ipc_key;
 	dshare->ipc_perm = opts->ipc_perm;
@@ -815,6 +918,7 @@ int snd_pcm_dshare_open(snd_pcm_t **pcmp, const char *name,
 		snd_pcm_direct_semaphore_up(dshare, DIRECT_IPC_SEM_CLIENT);
  _err_nosem:
 	if (dshare) {
+		free(dshare->u.dshare.runs);
 		free(dshare->bindings);
 		free(dshare);
 	}
@@ -898,6 +1002,18 @@ int _snd_pcm_dshare_open(snd_pcm_t **pcmp, const char *name,
 	err = snd_pcm_direct_parse_open_conf(root, conf, stream, &dopen);
 	if (err < 0)
 		return err;
+	if (dopen.safety_margin) {
+		SNDERR("safety_margin is supported only by dmix");
+		return -EINVAL;
+	}
+	if (dopen.ipc_memfd) {
+		SNDERR("ipc_memfd is supported only by dmix");
+		return -EINVAL;
+	}
+	if (dopen.zerocopy) {
+		SNDERR("zerocopy is supported only by dsnoop");
+		return -EINVAL;
+	}
 
 	/* the default settings, it might be invalid for some hardware */
 	params.format = SND_PCM_FORMAT_S16;
@@ -152,7 +152,8 @@ static int snd_pcm_dsnoop_sync_ptr(snd_pcm_t *pcm)
 		slave_hw_ptr += dsnoop->slave_boundary;
 		diff = slave_hw_ptr - old_slave_hw_ptr;
 	}
-	snd_pcm_dsnoop_sync_area(pcm, old_slave_hw_ptr, diff);
+	if (!pcm->mmap_shadow)
+		snd_pcm_dsnoop_sync_area(pcm, old_slave_hw_ptr, diff);
 	dsnoop->hw_ptr += diff;
 	dsnoop->hw_ptr %= pcm->boundary;
 	// printf("sync ptr diff = %li\n", diff);
@@ -271,7 +272,9 @@ static int snd_pcm_dsnoop_prepare(snd_pcm_t *pcm)
 static int snd_pcm_dsnoop_reset(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dsnoop = pcm->private_data;
-	dsnoop->hw_ptr %= pcm->period_size;
+	/* in zero-copy mode hw_ptr must stay congruent with the slave ring */
+	if (!pcm->mmap_shadow)
+		dsnoop->hw_ptr %= pcm->period_size;
 	dsnoop->appl_ptr = dsnoop->hw_ptr;
 	dsnoop->slave_appl_ptr = dsnoop->slave_hw_ptr;
 	return 0;
@@ -287,6 +290,10 @@ static int snd_pcm_dsnoop_start(snd_pcm_t *pcm)
 	snd_pcm_hwsync(dsnoop->spcm);
 	snoop_timestamp(pcm);
 	dsnoop->slave_appl_ptr = dsnoop->slave_hw_ptr;
+	if (pcm->mmap_shadow) {
+		dsnoop->hw_ptr = dsnoop->slave_hw_ptr % pcm->buffer_size;
+		dsnoop->appl_ptr = dsnoop->hw_ptr;
+	}
 	err = snd_timer_start(dsnoop->timer);
 	if (err < 0)
 		return err;
@@ -460,11 +467,100 @@ static int snd_pcm_dsnoop_htimestamp(snd_pcm_t *pcm,
 	return 0;
 }
 
+/*
+ * zero-copy mode: when the client geometry matches the slave ring,
+ * the client areas point directly to the slave buffer and only the
+ * pointers are tracked per client
+ */
+static int snd_pcm_dsnoop_can_share(snd_pcm_t *pcm)
+{
+	snd_pcm_direct_t *dsnoop = pcm->private_data;
+	snd_pcm_t *spcm = dsnoop->spcm;
+	const snd_pcm_channel_area_t *areas;
+	unsigned int chn, bits;
+
+	if (!dsnoop->zerocopy || !spcm->running_areas)
+		return 0;
+	if (pcm->buffer_size != dsnoop->slave_buffer_size ||
+	    pcm->channels != spcm->channels ||
+	    pcm->format != spcm->format)
+		return 0;
+	for (chn = 0; chn < pcm->channels; chn++) {
+		if (dsnoop->bindings && dsnoop->bindings[chn] != chn)
+			return 0;
+	}
+	areas = spcm->running_areas;
+	bits = pcm->sample_bits;
+	switch (pcm->access) {
+	case SND_PCM_ACCESS_MMAP_INTERLEAVED:
+		for (chn = 0; chn < pcm->channels; chn++) {
+			if (areas[chn].addr != areas[0].addr ||
+			    areas[chn].first != chn * bits ||
+			    areas[chn].step != pcm->frame_bits)
+				return 0;
+		}
+		break;
+	case SND_PCM_ACCESS_MMAP_NONINTERLEAVED:
+		for (chn = 0; chn < pcm->channels; chn++) {
+			if (areas[chn].first != 0 ||
+			    areas[chn].step != bits)
+				return 0;
+		}
+		break;
+	default:
+		break;
+	}
+	return 1;
+}
+
+static int snd_pcm_dsnoop_munmap(snd_pcm_t *pcm)
+{
+	if (pcm->mmap_shadow) {
+		free(pcm->mmap_channels);
+		free(pcm->running_areas);
+		pcm->mmap_channels = NULL;
+		pcm->running_areas = NULL;
+		pcm->mmap_shadow = 0;
+		pcm->mmap_readonly = 0;
+	}
+	return 0;
+}
+
+static int snd_pcm_dsnoop_mmap(snd_pcm_t *pcm)
+{
+	snd_pcm_direct_t *dsnoop = pcm->private_data;
+	snd_pcm_t *spcm = dsnoop->spcm;
+	unsigned int chn;
+
+	if (!snd_pcm_dsnoop_can_share(pcm))
+		return 0;
+	pcm->mmap_channels = calloc(pcm->channels,
+				    sizeof(pcm->mmap_channels[0]));
+	pcm->running_areas = calloc(pcm->channels,
+				    sizeof(pcm->running_areas[0]));
+	if (!pcm->mmap_channels || !pcm->running_areas) {
+		free(pcm->mmap_channels);
+		free(pcm->running_areas);
+		pcm->mmap_channels = NULL;
+		pcm->running_areas = NULL;
+		return -ENOMEM;
+	}
+	for (chn = 0; chn < pcm->channels; chn++) {
+		pcm->mmap_channels[chn] = spcm->mmap_channels[chn];
+		pcm->mmap_channels[chn].channel = chn;
+		pcm->running_areas[chn] = spcm->running_areas[chn];
+	}
+	pcm->mmap_shadow = 1;
+	pcm->mmap_readonly = 1;
+	return 0;
+}
+
 static void snd_pcm_dsnoop_dump(snd_pcm_t *pcm, snd_output_t *out)
 {
 	snd_pcm_direct_t *dsnoop = pcm->private_data;
 
-	snd_output_printf(out, "Direct Snoop PCM\n");
+	snd_output_printf(out, "Direct Snoop PCM%s\n",
+			  pcm->mmap_shadow ? " (zero-copy)" : "");
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -484,8 +580,8 @@ static const snd_pcm_ops_t snd_pcm_dsnoop_ops = {
 	.dump = snd_pcm_dsnoop_dump,
 	.nonblock = snd_pcm_direct_nonblock,
 	.async = snd_pcm_direct_async,
-	.mmap = snd_pcm_direct_mmap,
-	.munmap = snd_pcm_direct_munmap,
+	.mmap = snd_pcm_dsnoop_mmap,
+	.munmap = snd_pcm_dsnoop_munmap,
 	.query_chmaps = snd_pcm_direct_query_chmaps,
 	.get_chmap = snd_pcm_direct_get_chmap,
 	.set_chmap = snd_pcm_direct_set_chmap,
@@ -603,6 +699,7 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 	dsnoop->state = SND_PCM_STATE_OPEN;
 	dsnoop->slowptr = opts->slowptr;
 	dsnoop->max_periods = opts->max_periods;
+	dsnoop->zerocopy = opts->zerocopy;
 	dsnoop->sync_ptr = snd_pcm_dsnoop_sync_ptr;
 
 	if (first_instance) {
@@ -759,9 +856,24 @@ pcm.name {
 		N INT		# maps slave channel to client channel N
 	}
 	slowptr BOOL		# slow but more precise pointer updates
+	zerocopy BOOL		# share the slave ring buffer (default no)
 }
 \endcode
 
+When \c zerocopy is enabled and the client setup matches the slave
+(same buffer size, format and channels, identity bindings and a layout
+compatible with the requested access), the client mmap areas point
+directly to the slave ring buffer instead of a private copy, so several
+capture clients do not multiply the memory traffic.  The areas are shared
+by all clients and must be treated as read-only.  Otherwise the plugin
+falls back silently to copying.
+
+Plugins stacked on top which convert on the place (\ref pcm_plugins_softvol
+"softvol" in capture direction, external plugins asking for in-place
+transfers) see the shared areas flagged read-only and use a private
+buffer instead.  Applications writing to the mmap areas of a zero-copy
+handle corrupt the samples read by every other client.
+
 \subsection pcm_plugins_dsnoop_funcref Function reference
 
 <UL>
@@ -796,6 +908,14 @@ int _snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 	err = snd_pcm_direct_parse_open_conf(root, conf, stream, &dopen);
 	if (err < 0)
 		return err;
+	if (dopen.safety_margin) {
+		SNDERR("safety_margin is supported only by dmix");
+		return -EINVAL;
+	}
+	if (dopen.ipc_memfd) {
+		SNDERR("ipc_memfd is supported only by dmix");
+		return -EINVAL;
+	}
 
 	/* the default settings, it might be invalid for some hardware */
 	params.format = SND_PCM_FORMAT_S16;
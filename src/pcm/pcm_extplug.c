@@ -43,8 +43,15 @@ typedef struct snd_pcm_extplug_priv {
 	snd_pcm_extplug_t *data;
 	struct snd_ext_parm params[SND_PCM_EXTPLUG_HW_PARAMS];
 	struct snd_ext_parm sparams[SND_PCM_EXTPLUG_HW_PARAMS];
+	unsigned int inplace: 1;	/* transfer works on the slave buffer */
+	unsigned int own_buffer: 1;	/* aligned buffer allocated here */
+	void *buffer;
 } extplug_priv_t;
 
+/* flags are present since v1.0.3 */
+#define extplug_flags(ext) \
+	((ext)->data->version >= 0x010003 ? (ext)->data->flags : 0)
+
 static const int hw_params_type[SND_PCM_EXTPLUG_HW_PARAMS] = {
 	[SND_PCM_EXTPLUG_HW_FORMAT] = SND_PCM_HW_PARAM_FORMAT,
 	[SND_PCM_EXTPLUG_HW_CHANNELS] = SND_PCM_HW_PARAM_CHANNELS
@@ -207,8 +214,10 @@ static int snd_pcm_extplug_hw_refine_cprepare(snd_pcm_t *pcm,
 	extplug_priv_t *ext = pcm->private_data;
 	int err;
 	snd_pcm_access_mask_t access_mask = { SND_PCM_ACCBIT_SHM };
+	snd_pcm_access_mask_t planar_mask = { SND_PCM_ACCBIT_SHMN };
 	err = _snd_pcm_hw_param_set_mask(params, SND_PCM_HW_PARAM_ACCESS,
-					 &access_mask);
+					 (extplug_flags(ext) & SND_PCM_EXTPLUG_FLAG_PLANAR) ?
+					 &planar_mask : &access_mask);
 	if (err < 0)
 		return err;
 	err = extplug_hw_refine(params, ext->params);
@@ -284,6 +293,34 @@ static int snd_pcm_extplug_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params
 	return err;
 }
 
+/*
+ * check whether the slave buffer satisfies the plugin for in-place transfers
+ */
+static int extplug_inplace_ok(extplug_priv_t *ext)
+{
+	snd_pcm_t *slave = ext->plug.gen.slave;
+	unsigned int flags = extplug_flags(ext);
+	unsigned int c, width;
+
+	if (!(flags & SND_PCM_EXTPLUG_FLAG_INPLACE))
+		return 0;
+	if (ext->data->format != ext->data->slave_format ||
+	    ext->data->channels != ext->data->slave_channels ||
+	    !slave->running_areas || slave->mmap_readonly)
+		return 0;
+	width = snd_pcm_format_physical_width(slave->format);
+	for (c = 0; c < slave->channels; c++) {
+		const snd_pcm_channel_area_t *a = &slave->running_areas[c];
+		if ((flags & SND_PCM_EXTPLUG_FLAG_PLANAR) && a->step != width)
+			return 0;
+		if ((flags & SND_PCM_EXTPLUG_FLAG_ALIGNED) &&
+		    (((unsigned long)a->addr % SND_PCM_EXTPLUG_ALIGN) ||
+		     (a->first % (SND_PCM_EXTPLUG_ALIGN * 8))))
+			return 0;
+	}
+	return 1;
+}
+
 /*
  * hw_params callback
  */
@@ -306,6 +343,7 @@ static int snd_pcm_extplug_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params
 	INTERNAL(snd_pcm_hw_params_get_format)(params, &ext->data->format);
 	INTERNAL(snd_pcm_hw_params_get_subformat)(params, &ext->data->subformat);
 	INTERNAL(snd_pcm_hw_params_get_channels)(params, &ext->data->channels);
+	ext->inplace = extplug_inplace_ok(ext);
 
 	if (ext->data->callback->hw_params) {
 		err = ext->data->callback->hw_params(ext->data, params);
@@ -323,6 +361,7 @@ static int snd_pcm_extplug_hw_free(snd_pcm_t *pcm)
 	extplug_priv_t *ext = pcm->private_data;
 
 	snd_pcm_hw_free(ext->plug.gen.slave);
+	ext->inplace = 0;
 	if (ext->data->callback->hw_free)
 		return ext->data->callback->hw_free(ext->data);
 	return 0;
@@ -344,8 +383,19 @@ snd_pcm_extplug_write_areas(snd_pcm_t *pcm,
 
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	size = ext->data->callback->transfer(ext->data, slave_areas, slave_offset,
-					     areas, offset, size);
+	if (ext->inplace) {
+		if (areas != slave_areas || offset != slave_offset)
+			snd_pcm_areas_copy(slave_areas, slave_offset,
+					   areas, offset,
+					   pcm->channels, size, pcm->format);
+		size = ext->data->callback->transfer(ext->data,
+						     slave_areas, slave_offset,
+						     slave_areas, slave_offset,
+						     size);
+	} else
+		size = ext->data->callback->transfer(ext->data,
+						     slave_areas, slave_offset,
+						     areas, offset, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -366,12 +416,126 @@ snd_pcm_extplug_read_areas(snd_pcm_t *pcm,
 
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	size = ext->data->callback->transfer(ext->data, areas, offset,
-					     slave_areas, slave_offset, size);
+	if (ext->inplace) {
+		size = ext->data->callback->transfer(ext->data,
+						     slave_areas, slave_offset,
+						     slave_areas, slave_offset,
+						     size);
+		if (areas != slave_areas || offset != slave_offset)
+			snd_pcm_areas_copy(areas, offset,
+					   slave_areas, slave_offset,
+					   pcm->channels, size, pcm->format);
+	} else
+		size = ext->data->callback->transfer(ext->data, areas, offset,
+						     slave_areas, slave_offset, size);
 	*slave_sizep = size;
 	return size;
 }
 
+/*
+ * allocate the client buffer with each channel plane aligned
+ */
+static int extplug_alloc_buffer(snd_pcm_t *pcm)
+{
+	extplug_priv_t *ext = pcm->private_data;
+	int interleaved = (pcm->access == SND_PCM_ACCESS_MMAP_INTERLEAVED ||
+			   pcm->access == SND_PCM_ACCESS_RW_INTERLEAVED);
+	unsigned int c, planes = interleaved ? 1 : pcm->channels;
+	size_t plane;
+	int err;
+
+	if (interleaved)
+		plane = snd_pcm_frames_to_bytes(pcm, pcm->buffer_size);
+	else
+		plane = snd_pcm_samples_to_bytes(pcm, pcm->buffer_size);
+	plane = (plane + SND_PCM_EXTPLUG_ALIGN - 1) &
+		~(size_t)(SND_PCM_EXTPLUG_ALIGN - 1);
+	err = posix_memalign(&ext->buffer, SND_PCM_EXTPLUG_ALIGN, plane * planes);
+	if (err) {
+		ext->buffer = NULL;
+		return -err;
+	}
+	pcm->mmap_channels = calloc(pcm->channels, sizeof(pcm->mmap_channels[0]));
+	pcm->running_areas = calloc(pcm->channels, sizeof(pcm->running_areas[0]));
+	if (!pcm->mmap_channels || !pcm->running_areas) {
+		free(pcm->mmap_channels);
+		free(pcm->running_areas);
+		pcm->mmap_channels = NULL;
+		pcm->running_areas = NULL;
+		free(ext->buffer);
+		ext->buffer = NULL;
+		return -ENOMEM;
+	}
+	for (c = 0; c < pcm->channels; c++) {
+		snd_pcm_channel_info_t *i = &pcm->mmap_channels[c];
+		snd_pcm_channel_area_t *a = &pcm->running_areas[c];
+		i->channel = c;
+		i->type = SND_PCM_AREA_LOCAL;
+		if (interleaved) {
+			i->addr = ext->buffer;
+			i->first = c * pcm->sample_bits;
+			i->step = pcm->frame_bits;
+		} else {
+			i->addr = (char *)ext->buffer + c * plane;
+			i->first = 0;
+			i->step = pcm->sample_bits;
+		}
+		a->addr = i->addr;
+		a->first = i->first;
+		a->step = i->step;
+	}
+	ext->own_buffer = 1;
+	pcm->mmap_shadow = 1;
+	return 0;
+}
+
+/*
+ * mmap callback - share the slave buffer for in-place transfers,
+ * or provide an aligned buffer if the plugin asks for it
+ */
+static int snd_pcm_extplug_mmap(snd_pcm_t *pcm)
+{
+	extplug_priv_t *ext = pcm->private_data;
+
+	if (ext->inplace) {
+		pcm->mmap_shadow = 1;
+		return snd_pcm_generic_mmap(pcm);
+	}
+	if (extplug_flags(ext) & (SND_PCM_EXTPLUG_FLAG_ALIGNED |
+				  SND_PCM_EXTPLUG_FLAG_PLANAR))
+		return extplug_alloc_buffer(pcm);
+	return 0;
+}
+
+static int snd_pcm_extplug_munmap(snd_pcm_t *pcm)
+{
+	extplug_priv_t *ext = pcm->private_data;
+
+	if (ext->own_buffer) {
+		free(pcm->mmap_channels);
+		free(pcm->running_areas);
+		pcm->mmap_channels = NULL;
+		pcm->running_areas = NULL;
+		free(ext->buffer);
+		ext->buffer = NULL;
+		ext->own_buffer = 0;
+	} else
+		snd_pcm_generic_munmap(pcm);
+	pcm->mmap_shadow = 0;
+	return 0;
+}
+
+static int snd_pcm_extplug_channel_info(snd_pcm_t *pcm, snd_pcm_channel_info_t *info)
+{
+	extplug_priv_t *ext = pcm->private_data;
+
+	if (ext->own_buffer) {
+		*info = pcm->mmap_channels[info->channel];
+		return 0;
+	}
+	return snd_pcm_generic_channel_info(pcm, info);
+}
+
 /*
  * call init callback
  */
@@ -462,12 +626,12 @@ static const snd_pcm_ops_t snd_pcm_extplug_ops = {
 	.hw_params = snd_pcm_extplug_hw_params,
 	.hw_free = snd_pcm_extplug_hw_free,
 	.sw_params = snd_pcm_generic_sw_params,
-	.channel_info = snd_pcm_generic_channel_info,
+	.channel_info = snd_pcm_extplug_channel_info,
 	.dump = snd_pcm_extplug_dump,
 	.nonblock = snd_pcm_generic_nonblock,
 	.async = snd_pcm_generic_async,
-	.mmap = snd_pcm_generic_mmap,
-	.munmap = snd_pcm_generic_munmap,
+	.mmap = snd_pcm_extplug_mmap,
+	.munmap = snd_pcm_extplug_munmap,
 	.query_chmaps = snd_pcm_extplug_query_chmaps,
 	.get_chmap = snd_pcm_extplug_get_chmap,
 	.set_chmap = snd_pcm_extplug_set_chmap,
@@ -622,6 +786,20 @@ The init callback is called when the PCM is at prepare state or any
 initialization is issued.  Use this callback to reset the PCM instance
 to a sane initial state.
 
+Since version 1.0.3, the flags field can request a buffer layout
+suitable for vectorized processing.  With #SND_PCM_EXTPLUG_FLAG_INPLACE
+the plugin declares that transfer copes with identical source and
+destination areas.  When the format and channels of both sides match,
+the transfer callback then always works in place on the slave buffer,
+and mmap clients share that buffer without a copy.
+#SND_PCM_EXTPLUG_FLAG_PLANAR restricts the client side to the
+non-interleaved access types, and #SND_PCM_EXTPLUG_FLAG_ALIGNED makes
+each channel area start at a #SND_PCM_EXTPLUG_ALIGN byte boundary.
+Both apply to the buffers owned by the library.  In-place mode is used
+only if the slave buffer meets them, too.  Combined with a
+SND_PCM_FORMAT_FLOAT constraint, the plugin gets aligned planar float
+data.
+
 The hw_params constraints can be defined via either
 #snd_pcm_extplug_set_param_minmax() and #snd_pcm_extplug_set_param_list()
 functions after calling #snd_pcm_extplug_create().
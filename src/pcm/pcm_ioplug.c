@@ -45,17 +45,25 @@ typedef struct snd_pcm_ioplug_priv {
 	unsigned int last_hw;
 	snd_pcm_uframes_t avail_max;
 	snd_htimestamp_t trigger_tstamp;
+	int ptr_valid;		/* last pointer() result still current */
 } ioplug_priv_t;
 
+/* v1.0.3 callbacks */
+#define ioplug_has_transferv(io) \
+	((io)->data->version >= 0x010003 && (io)->data->callback->transferv)
+
 /* update the hw pointer */
 static void snd_pcm_ioplug_hw_ptr_update(snd_pcm_t *pcm)
 {
 	ioplug_priv_t *io = pcm->private_data;
 	snd_pcm_sframes_t hw;
 
+	if ((io->data->flags & SND_PCM_IOPLUG_FLAG_CACHED_PTR) && io->ptr_valid)
+		return;
 	hw = io->data->callback->pointer(io->data);
 	if (hw >= 0) {
 		unsigned int delta;
+		io->ptr_valid = 1;
 		if ((unsigned int)hw >= io->last_hw)
 			delta = hw - io->last_hw;
 		else
@@ -132,6 +140,7 @@ static int snd_pcm_ioplug_reset(snd_pcm_t *pcm)
 	io->data->hw_ptr = 0;
 	io->last_hw = 0;
 	io->avail_max = 0;
+	io->ptr_valid = 0;
 	return 0;
 }
 
@@ -450,6 +459,7 @@ static int snd_pcm_ioplug_start(snd_pcm_t *pcm)
 
 	gettimestamp(&io->trigger_tstamp, pcm->tstamp_type);
 	io->data->state = SND_PCM_STATE_RUNNING;
+	io->ptr_valid = 0;
 
 	return 0;
 }
@@ -465,6 +475,7 @@ static int snd_pcm_ioplug_drop(snd_pcm_t *pcm)
 
 	gettimestamp(&io->trigger_tstamp, pcm->tstamp_type);
 	io->data->state = SND_PCM_STATE_SETUP;
+	io->ptr_valid = 0;
 
 	return 0;
 }
@@ -498,6 +509,7 @@ static int snd_pcm_ioplug_pause(snd_pcm_t *pcm, int enable)
 			return err;
 	}
 	io->data->state = states[enable];
+	io->ptr_valid = 0;
 	return 0;
 }
 
@@ -529,23 +541,90 @@ static int snd_pcm_ioplug_resume(snd_pcm_t *pcm)
 
 	if (io->data->callback->resume)
 		io->data->callback->resume(io->data);
+	io->ptr_valid = 0;
 	return 0;
 }
 
+/* pass the chunks to the plugin, in a single call when transferv is given */
+static snd_pcm_sframes_t ioplug_transfer_chunks(ioplug_priv_t *io,
+						const snd_pcm_ioplug_chunk_t *chunks,
+						unsigned int nchunks)
+{
+	snd_pcm_sframes_t result, xfer = 0;
+	unsigned int i;
+
+	io->ptr_valid = 0;
+	if (ioplug_has_transferv(io))
+		return io->data->callback->transferv(io->data, chunks, nchunks);
+	for (i = 0; i < nchunks; i++) {
+		if (io->data->callback->transfer)
+			result = io->data->callback->transfer(io->data,
+							      chunks[i].areas,
+							      chunks[i].offset,
+							      chunks[i].size);
+		else
+			result = chunks[i].size;
+		if (result < 0)
+			return xfer > 0 ? xfer : result;
+		xfer += result;
+		if ((snd_pcm_uframes_t)result < chunks[i].size)
+			break;
+	}
+	return xfer;
+}
+
 static snd_pcm_sframes_t ioplug_priv_transfer_areas(snd_pcm_t *pcm,
 						       const snd_pcm_channel_area_t *areas,
 						       snd_pcm_uframes_t offset,
 						       snd_pcm_uframes_t size)
 {
 	ioplug_priv_t *io = pcm->private_data;
+	snd_pcm_ioplug_chunk_t chunk;
 	snd_pcm_sframes_t result;
 		
 	if (! size)
 		return 0;
-	if (io->data->callback->transfer)
-		result = io->data->callback->transfer(io->data, areas, offset, size);
-	else
-		result = size;
+	chunk.areas = areas;
+	chunk.offset = offset;
+	chunk.size = size;
+	result = ioplug_transfer_chunks(io, &chunk, 1);
+	if (result > 0)
+		snd_pcm_mmap_appl_forward(pcm, result);
+	return result;
+}
+
+/* copy into the ring buffer and hand both sides of a wrap to transferv at once */
+static snd_pcm_sframes_t ioplug_mmap_write_areas(snd_pcm_t *pcm,
+						 const snd_pcm_channel_area_t *areas,
+						 snd_pcm_uframes_t offset,
+						 snd_pcm_uframes_t size)
+{
+	ioplug_priv_t *io = pcm->private_data;
+	const snd_pcm_channel_area_t *ring = snd_pcm_mmap_areas(pcm);
+	snd_pcm_uframes_t ofs = snd_pcm_mmap_offset(pcm);
+	snd_pcm_uframes_t xfer = 0;
+	snd_pcm_ioplug_chunk_t chunks[2];
+	unsigned int nchunks = 0;
+	snd_pcm_sframes_t result;
+
+	while (xfer < size && nchunks < 2) {
+		snd_pcm_uframes_t frames = size - xfer;
+		snd_pcm_uframes_t cont = pcm->buffer_size - ofs;
+
+		if (frames > cont)
+			frames = cont;
+		snd_pcm_areas_copy(ring, ofs, areas, offset + xfer,
+				   pcm->channels, frames, pcm->format);
+		chunks[nchunks].areas = ring;
+		chunks[nchunks].offset = ofs;
+		chunks[nchunks].size = frames;
+		nchunks++;
+		xfer += frames;
+		ofs = 0;
+	}
+	if (! nchunks)
+		return 0;
+	result = ioplug_transfer_chunks(io, chunks, nchunks);
 	if (result > 0)
 		snd_pcm_mmap_appl_forward(pcm, result);
 	return result;
@@ -553,7 +632,14 @@ static snd_pcm_sframes_t ioplug_priv_transfer_areas(snd_pcm_t *pcm,
 
 static snd_pcm_sframes_t snd_pcm_ioplug_writei(snd_pcm_t *pcm, const void *buffer, snd_pcm_uframes_t size)
 {
-	if (pcm->mmap_rw)
+	ioplug_priv_t *io = pcm->private_data;
+
+	if (pcm->mmap_rw && ioplug_has_transferv(io)) {
+		snd_pcm_channel_area_t areas[pcm->channels];
+		snd_pcm_areas_from_buf(pcm, areas, (void*)buffer);
+		return snd_pcm_write_areas(pcm, areas, 0, size,
+					   ioplug_mmap_write_areas);
+	} else if (pcm->mmap_rw)
 		return snd_pcm_mmap_writei(pcm, buffer, size);
 	else {
 		snd_pcm_channel_area_t areas[pcm->channels];
@@ -565,7 +651,14 @@ static snd_pcm_sframes_t snd_pcm_ioplug_writei(snd_pcm_t *pcm, const void *buffe
 
 static snd_pcm_sframes_t snd_pcm_ioplug_writen(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t size)
 {
-	if (pcm->mmap_rw)
+	ioplug_priv_t *io = pcm->private_data;
+
+	if (pcm->mmap_rw && ioplug_has_transferv(io)) {
+		snd_pcm_channel_area_t areas[pcm->channels];
+		snd_pcm_areas_from_bufs(pcm, areas, bufs);
+		return snd_pcm_write_areas(pcm, areas, 0, size,
+					   ioplug_mmap_write_areas);
+	} else if (pcm->mmap_rw)
 		return snd_pcm_mmap_writen(pcm, bufs, size);
 	else {
 		snd_pcm_channel_area_t areas[pcm->channels];
@@ -630,7 +723,27 @@ static snd_pcm_sframes_t snd_pcm_ioplug_avail_update(snd_pcm_t *pcm)
 	if (pcm->stream == SND_PCM_STREAM_CAPTURE &&
 	    pcm->access != SND_PCM_ACCESS_RW_INTERLEAVED &&
 	    pcm->access != SND_PCM_ACCESS_RW_NONINTERLEAVED) {
-		if (io->data->callback->transfer) {
+		if (ioplug_has_transferv(io)) {
+			/* the whole avail, split at the buffer end */
+			snd_pcm_ioplug_chunk_t chunks[2];
+			unsigned int nchunks = 1;
+			snd_pcm_uframes_t size = UINT_MAX;
+			snd_pcm_sframes_t result;
+
+			snd_pcm_mmap_begin(pcm, &chunks[0].areas,
+					   &chunks[0].offset, &size);
+			chunks[0].size = size;
+			avail = snd_pcm_mmap_avail(pcm);
+			if (avail > size) {
+				chunks[1].areas = chunks[0].areas;
+				chunks[1].offset = 0;
+				chunks[1].size = avail - size;
+				nchunks++;
+			}
+			result = ioplug_transfer_chunks(io, chunks, nchunks);
+			if (result < 0)
+				return result;
+		} else if (io->data->callback->transfer) {
 			const snd_pcm_channel_area_t *areas;
 			snd_pcm_uframes_t offset, size = UINT_MAX;
 			snd_pcm_sframes_t result;
@@ -686,6 +799,7 @@ static int snd_pcm_ioplug_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsi
 {
 	ioplug_priv_t *io = pcm->private_data;
 
+	io->ptr_valid = 0;
 	if (io->data->callback->poll_revents)
 		return io->data->callback->poll_revents(io->data, pfds, nfds, revents);
 	else
@@ -693,9 +807,44 @@ static int snd_pcm_ioplug_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsi
 	return 0;
 }
 
-static int snd_pcm_ioplug_mmap(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+static int snd_pcm_ioplug_mmap(snd_pcm_t *pcm)
 {
+	ioplug_priv_t *io = pcm->private_data;
+	unsigned int c;
+	int err;
+
+	if (io->data->version < 0x010003 || !io->data->callback->buffer_areas)
+		return 0;
+
+	/* map the plugin's own buffer instead of allocating a copy */
+	pcm->mmap_channels = calloc(pcm->channels, sizeof(pcm->mmap_channels[0]));
+	if (!pcm->mmap_channels)
+		return -ENOMEM;
+	pcm->running_areas = calloc(pcm->channels, sizeof(pcm->running_areas[0]));
+	if (!pcm->running_areas) {
+		err = -ENOMEM;
+		goto _err;
+	}
+	err = io->data->callback->buffer_areas(io->data, pcm->running_areas);
+	if (err < 0)
+		goto _err;
+	for (c = 0; c < pcm->channels; c++) {
+		snd_pcm_channel_info_t *i = &pcm->mmap_channels[c];
+		i->channel = c;
+		i->type = SND_PCM_AREA_LOCAL;
+		i->addr = pcm->running_areas[c].addr;
+		i->first = pcm->running_areas[c].first;
+		i->step = pcm->running_areas[c].step;
+	}
+	pcm->mmap_shadow = 1;
 	return 0;
+
+ _err:
+	free(pcm->running_areas);
+	pcm->running_areas = NULL;
+	free(pcm->mmap_channels);
+	pcm->mmap_channels = NULL;
+	return err;
 }
 
 static int snd_pcm_ioplug_async(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
@@ -705,8 +854,15 @@ static int snd_pcm_ioplug_async(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
 	return -ENOSYS;
 }
 
-static int snd_pcm_ioplug_munmap(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+static int snd_pcm_ioplug_munmap(snd_pcm_t *pcm)
 {
+	if (pcm->mmap_shadow) {
+		free(pcm->mmap_channels);
+		free(pcm->running_areas);
+		pcm->mmap_channels = NULL;
+		pcm->running_areas = NULL;
+		pcm->mmap_shadow = 0;
+	}
 	return 0;
 }
 
@@ -891,6 +1047,21 @@ receives the area array, offset and the size to transfer.  The area
 array contains the array of snd_pcm_channel_area_t with the elements
 of number of channels.
 
+Since version 1.0.3, the transferv callback may be given instead.  It
+receives an array of #snd_pcm_ioplug_chunk_t, each holding the areas,
+offset and size of one contiguous range, and returns the total number of
+frames processed.  When the range to transfer wraps at the end of the
+ring buffer, both pieces are passed in a single call.  The buffer_areas
+callback lets the plugin expose its own buffer as the mmap areas of the
+PCM; it fills one snd_pcm_channel_area_t per channel.  The areas must
+stay valid until hw_free is called, and no intermediate copy is made
+then.
+
+If #SND_PCM_IOPLUG_FLAG_CACHED_PTR is set, the result of the pointer
+callback is reused until the next trigger, transfer or poll event.
+A plugin which learns about a position change by other means can call
+#snd_pcm_ioplug_invalidate_ptr() to force the next query.
+
 When the PCM is closed, close callback is called.  If the driver
 allocates any internal buffers, they should be released in this
 callback.  The hw_params and hw_free callbacks are called when
@@ -1107,3 +1278,17 @@ int snd_pcm_ioplug_set_state(snd_pcm_ioplug_t *ioplug, snd_pcm_state_t state)
 	ioplug->state = state;
 	return 0;
 }
+
+/**
+ * \brief Drop the cached hw pointer of ioplug
+ * \param ioplug the ioplug handle
+ *
+ * Forces the pointer callback to be called on the next position query.
+ * Only meaningful when #SND_PCM_IOPLUG_FLAG_CACHED_PTR is set.
+ */
+void snd_pcm_ioplug_invalidate_ptr(snd_pcm_ioplug_t *ioplug)
+{
+	ioplug_priv_t *io = ioplug->pcm->private_data;
+
+	io->ptr_valid = 0;
+}
@@ -35,6 +35,7 @@
 #include <dirent.h>
 #include <locale.h>
 #include <math.h>
+#include <pthread.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
 
@@ -54,7 +55,17 @@ typedef enum _snd_pcm_ladspa_policy {
 	SND_PCM_LADSPA_POLICY_DUPLICATE		/* duplicate bindings for all channels */
 } snd_pcm_ladspa_policy_t;
 
+struct snd_pcm_ladspa;
+struct snd_pcm_ladspa_instance;
+
 typedef struct {
+	struct snd_pcm_ladspa *ladspa;
+	unsigned int idx;
+	pthread_t thread;
+	unsigned int generation;
+} snd_pcm_ladspa_worker_t;
+
+typedef struct snd_pcm_ladspa {
 	/* This field need to be the first */
 	snd_pcm_plugin_t plug;
 	/* Plugin custom fields */
@@ -63,6 +74,30 @@ typedef struct {
 	unsigned int channels;			/* forced input channels, 0 = auto */
 	unsigned int allocated;			/* count of allocated samples */
 	LADSPA_Data *zero[2];			/* zero input or dummy output */
+	/* execution schedule: instances grouped by dependency level */
+	struct snd_pcm_ladspa_instance **sched;
+	unsigned int sched_count;
+	unsigned int *level_start;		/* levels + 1 entries */
+	unsigned int levels;
+	LADSPA_Data *arena;			/* intermediate buffers */
+	unsigned int arena_slots;
+	/* worker pool; the caller thread acts as executor #0 */
+	unsigned int threads;			/* requested worker threads */
+	unsigned int workers_count;
+	snd_pcm_ladspa_worker_t *workers;
+	pthread_mutex_t pool_mutex;
+	pthread_cond_t job_cond;
+	pthread_cond_t done_cond;
+	unsigned int job_generation;
+	unsigned int job_pending;
+	int pool_quit;
+	/* current job */
+	unsigned int job_level;
+	const snd_pcm_channel_area_t *job_in_areas;
+	snd_pcm_uframes_t job_in_offset;
+	const snd_pcm_channel_area_t *job_out_areas;
+	snd_pcm_uframes_t job_out_offset;
+	unsigned long job_size;
 } snd_pcm_ladspa_t;
  
 typedef struct {
@@ -82,6 +117,7 @@ typedef struct snd_pcm_ladspa_instance {
 	const LADSPA_Descriptor *desc;
 	LADSPA_Handle *handle;
 	unsigned int depth;
+	unsigned int level;			/* dependency level in the schedule */
 	snd_pcm_ladspa_eps_t input;
 	snd_pcm_ladspa_eps_t output;
 	struct snd_pcm_ladspa_instance *prev;
@@ -192,6 +228,8 @@ static void snd_pcm_ladspa_free_plugins(struct list_head *plugins)
 	}
 }
 
+static void snd_pcm_ladspa_stop_workers(snd_pcm_ladspa_t *ladspa);
+
 static void snd_pcm_ladspa_free(snd_pcm_ladspa_t *ladspa)
 {
         unsigned int idx;
@@ -209,6 +247,7 @@ static int snd_pcm_ladspa_close(snd_pcm_t *pcm)
 {
 	snd_pcm_ladspa_t *ladspa = pcm->private_data;
 
+	snd_pcm_ladspa_stop_workers(ladspa);
 	snd_pcm_ladspa_free(ladspa);
 	return snd_pcm_generic_close(pcm);
 }
@@ -356,6 +395,17 @@ static void snd_pcm_ladspa_free_instances(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
 			assert(list_empty(&plugin->instances));
 		}
 	}
+	if (cleanup) {
+		free(ladspa->sched);
+		ladspa->sched = NULL;
+		ladspa->sched_count = 0;
+		free(ladspa->level_start);
+		ladspa->level_start = NULL;
+		ladspa->levels = 0;
+		free(ladspa->arena);
+		ladspa->arena = NULL;
+		ladspa->arena_slots = 0;
+	}
 }
 
 static int snd_pcm_ladspa_add_to_carray(snd_pcm_ladspa_array_t *array,
@@ -820,6 +870,351 @@ static int snd_pcm_ladspa_allocate_memory(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
 	return 0;
 }
 
+/* key of the buffer connected to a port, NULL data means the ALSA areas */
+static unsigned long snd_pcm_ladspa_buffer_key(LADSPA_Data *data,
+					       int output, unsigned int chn)
+{
+	if (data)
+		return (unsigned long)data;
+	return ((unsigned long)chn << 2) | (output ? 3 : 1);
+}
+
+/* the dummy output buffer is written but never read, writers of it do
+ * not depend on each other
+ */
+static int snd_pcm_ladspa_eps_share(snd_pcm_ladspa_t *ladspa,
+				    snd_pcm_ladspa_eps_t *eps1, int output1,
+				    snd_pcm_ladspa_eps_t *eps2, int output2)
+{
+	unsigned int idx1, idx2;
+	unsigned long key;
+
+	for (idx1 = 0; idx1 < eps1->channels.size; idx1++) {
+		if (eps1->data[idx1] && eps1->data[idx1] == ladspa->zero[1])
+			continue;
+		key = snd_pcm_ladspa_buffer_key(eps1->data[idx1], output1,
+						eps1->channels.array[idx1]);
+		for (idx2 = 0; idx2 < eps2->channels.size; idx2++)
+			if (key == snd_pcm_ladspa_buffer_key(eps2->data[idx2], output2,
+							     eps2->channels.array[idx2]))
+				return 1;
+	}
+	return 0;
+}
+
+/* instance b must run after instance a (read after write, write after
+ * read or write after write on the same buffer)
+ */
+static int snd_pcm_ladspa_depends(snd_pcm_ladspa_t *ladspa,
+				  snd_pcm_ladspa_instance_t *a,
+				  snd_pcm_ladspa_instance_t *b)
+{
+	return snd_pcm_ladspa_eps_share(ladspa, &b->input, 0, &a->output, 1) ||
+	       snd_pcm_ladspa_eps_share(ladspa, &b->output, 1, &a->input, 0) ||
+	       snd_pcm_ladspa_eps_share(ladspa, &b->output, 1, &a->output, 1);
+}
+
+typedef struct {
+	LADSPA_Data *data;
+	unsigned int first;			/* producer level */
+	unsigned int last;			/* last consumer level */
+	unsigned int slot;
+} snd_pcm_ladspa_buffer_t;
+
+/* move the intermediate buffers to one arena, reusing the memory of
+ * buffers which are not referenced by the later levels
+ */
+static int snd_pcm_ladspa_allocate_arena(snd_pcm_ladspa_t *ladspa)
+{
+	snd_pcm_ladspa_buffer_t *bufs;
+	unsigned int *slot_last;
+	unsigned int count = 0, i, j, idx, stride;
+	void *arena;
+
+	for (i = 0; i < ladspa->sched_count; i++) {
+		snd_pcm_ladspa_instance_t *instance = ladspa->sched[i];
+		for (idx = 0; idx < instance->output.channels.size; idx++)
+			if (instance->output.m_data[idx])
+				count++;
+	}
+	if (count == 0)
+		return 0;
+	bufs = calloc(count, sizeof(*bufs));
+	slot_last = calloc(count, sizeof(*slot_last));
+	if (bufs == NULL || slot_last == NULL) {
+		free(bufs);
+		free(slot_last);
+		return -ENOMEM;
+	}
+	/* the schedule is sorted by level, so are the buffers */
+	for (i = j = 0; i < ladspa->sched_count; i++) {
+		snd_pcm_ladspa_instance_t *instance = ladspa->sched[i];
+		for (idx = 0; idx < instance->output.channels.size; idx++) {
+			if (instance->output.m_data[idx] == NULL)
+				continue;
+			bufs[j].data = instance->output.m_data[idx];
+			bufs[j].first = bufs[j].last = instance->level;
+			j++;
+		}
+	}
+	for (i = 0; i < ladspa->sched_count; i++) {
+		snd_pcm_ladspa_instance_t *instance = ladspa->sched[i];
+		for (idx = 0; idx < instance->input.channels.size; idx++)
+			for (j = 0; j < count; j++)
+				if (bufs[j].data == instance->input.data[idx] &&
+				    bufs[j].last < instance->level)
+					bufs[j].last = instance->level;
+	}
+	ladspa->arena_slots = 0;
+	for (j = 0; j < count; j++) {
+		for (i = 0; i < ladspa->arena_slots; i++)
+			if (slot_last[i] < bufs[j].first)
+				break;
+		if (i == ladspa->arena_slots)
+			ladspa->arena_slots++;
+		slot_last[i] = bufs[j].last;
+		bufs[j].slot = i;
+	}
+	free(slot_last);
+	/* keep every slot aligned to 64 bytes */
+	stride = (ladspa->allocated + 15) & ~15;
+	if (posix_memalign(&arena, 64, ladspa->arena_slots * stride * sizeof(LADSPA_Data))) {
+		free(bufs);
+		ladspa->arena_slots = 0;
+		return -ENOMEM;
+	}
+	ladspa->arena = arena;
+	for (i = 0; i < ladspa->sched_count; i++) {
+		snd_pcm_ladspa_instance_t *instance = ladspa->sched[i];
+		for (idx = 0; idx < instance->input.channels.size; idx++)
+			for (j = 0; j < count; j++)
+				if (bufs[j].data == instance->input.data[idx])
+					instance->input.data[idx] = ladspa->arena + bufs[j].slot * stride;
+		for (idx = 0; idx < instance->output.channels.size; idx++)
+			for (j = 0; j < count; j++)
+				if (bufs[j].data == instance->output.data[idx]) {
+					instance->output.data[idx] = ladspa->arena + bufs[j].slot * stride;
+					instance->output.m_data[idx] = NULL;
+				}
+	}
+	for (j = 0; j < count; j++)
+		free(bufs[j].data);
+	free(bufs);
+	return 0;
+}
+
+/* sort the instances to levels of mutually independent instances */
+static int snd_pcm_ladspa_build_schedule(snd_pcm_t *pcm, snd_pcm_ladspa_t *ladspa)
+{
+	struct list_head *list, *pos, *pos1;
+	snd_pcm_ladspa_instance_t **order;
+	unsigned int count = 0, i, j, level;
+
+	list = pcm->stream == SND_PCM_STREAM_PLAYBACK ? &ladspa->pplugins : &ladspa->cplugins;
+	list_for_each(pos, list) {
+		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
+		list_for_each(pos1, &plugin->instances)
+			count++;
+	}
+	order = calloc(count, sizeof(*order));
+	ladspa->sched = calloc(count, sizeof(*ladspa->sched));
+	if (order == NULL || ladspa->sched == NULL) {
+		free(order);
+		return -ENOMEM;
+	}
+	i = 0;
+	list_for_each(pos, list) {
+		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
+		list_for_each(pos1, &plugin->instances)
+			order[i++] = list_entry(pos1, snd_pcm_ladspa_instance_t, list);
+	}
+	ladspa->levels = 0;
+	for (i = 0; i < count; i++) {
+		level = 0;
+		for (j = 0; j < i; j++)
+			if (order[j]->level >= level &&
+			    snd_pcm_ladspa_depends(ladspa, order[j], order[i]))
+				level = order[j]->level + 1;
+		order[i]->level = level;
+		if (level >= ladspa->levels)
+			ladspa->levels = level + 1;
+	}
+	ladspa->level_start = calloc(ladspa->levels + 1, sizeof(*ladspa->level_start));
+	if (ladspa->level_start == NULL) {
+		free(order);
+		return -ENOMEM;
+	}
+	ladspa->sched_count = 0;
+	for (level = 0; level < ladspa->levels; level++) {
+		ladspa->level_start[level] = ladspa->sched_count;
+		for (i = 0; i < count; i++)
+			if (order[i]->level == level)
+				ladspa->sched[ladspa->sched_count++] = order[i];
+	}
+	ladspa->level_start[ladspa->levels] = ladspa->sched_count;
+	free(order);
+	return snd_pcm_ladspa_allocate_arena(ladspa);
+}
+
+static void snd_pcm_ladspa_run_instance(snd_pcm_ladspa_t *ladspa,
+					snd_pcm_ladspa_instance_t *instance)
+{
+	const snd_pcm_channel_area_t *area;
+	LADSPA_Data *data;
+	unsigned int idx;
+
+	for (idx = 0; idx < instance->input.channels.size; idx++) {
+		data = instance->input.data[idx];
+		if (data == NULL) {
+			area = &ladspa->job_in_areas[instance->input.channels.array[idx]];
+			data = (LADSPA_Data *)((char *)area->addr + (area->first / 8));
+			data += ladspa->job_in_offset;
+		}
+		instance->desc->connect_port(instance->handle, instance->input.ports.array[idx], data);
+	}
+	for (idx = 0; idx < instance->output.channels.size; idx++) {
+		data = instance->output.data[idx];
+		if (data == NULL) {
+			area = &ladspa->job_out_areas[instance->output.channels.array[idx]];
+			data = (LADSPA_Data *)((char *)area->addr + (area->first / 8));
+			data += ladspa->job_out_offset;
+		}
+		instance->desc->connect_port(instance->handle, instance->output.ports.array[idx], data);
+	}
+	instance->desc->run(instance->handle, ladspa->job_size);
+}
+
+/* run the instances of the current level assigned to the given executor */
+static void snd_pcm_ladspa_run_slice(snd_pcm_ladspa_t *ladspa,
+				     unsigned int first, unsigned int step)
+{
+	unsigned int i;
+
+	for (i = ladspa->level_start[ladspa->job_level] + first;
+	     i < ladspa->level_start[ladspa->job_level + 1]; i += step)
+		snd_pcm_ladspa_run_instance(ladspa, ladspa->sched[i]);
+}
+
+static void *snd_pcm_ladspa_worker_thread(void *data)
+{
+	snd_pcm_ladspa_worker_t *worker = data;
+	snd_pcm_ladspa_t *ladspa = worker->ladspa;
+
+	pthread_mutex_lock(&ladspa->pool_mutex);
+	for (;;) {
+		while (worker->generation == ladspa->job_generation &&
+		       !ladspa->pool_quit)
+			pthread_cond_wait(&ladspa->job_cond, &ladspa->pool_mutex);
+		if (ladspa->pool_quit)
+			break;
+		worker->generation = ladspa->job_generation;
+		pthread_mutex_unlock(&ladspa->pool_mutex);
+		snd_pcm_ladspa_run_slice(ladspa, worker->idx,
+					 ladspa->workers_count + 1);
+		pthread_mutex_lock(&ladspa->pool_mutex);
+		if (--ladspa->job_pending == 0)
+			pthread_cond_signal(&ladspa->done_cond);
+	}
+	pthread_mutex_unlock(&ladspa->pool_mutex);
+	return NULL;
+}
+
+static void snd_pcm_ladspa_stop_workers(snd_pcm_ladspa_t *ladspa)
+{
+	unsigned int i;
+
+	if (!ladspa->workers)
+		return;
+	pthread_mutex_lock(&ladspa->pool_mutex);
+	ladspa->pool_quit = 1;
+	pthread_cond_broadcast(&ladspa->job_cond);
+	pthread_mutex_unlock(&ladspa->pool_mutex);
+	for (i = 0; i < ladspa->workers_count; i++)
+		pthread_join(ladspa->workers[i].thread, NULL);
+	pthread_cond_destroy(&ladspa->done_cond);
+	pthread_cond_destroy(&ladspa->job_cond);
+	pthread_mutex_destroy(&ladspa->pool_mutex);
+	free(ladspa->workers);
+	ladspa->workers = NULL;
+	ladspa->workers_count = 0;
+}
+
+static int snd_pcm_ladspa_start_workers(snd_pcm_ladspa_t *ladspa)
+{
+	unsigned int i, width = 0, threads;
+	int err;
+
+	/* no more threads than the widest level can use */
+	for (i = 0; i < ladspa->levels; i++)
+		if (ladspa->level_start[i + 1] - ladspa->level_start[i] > width)
+			width = ladspa->level_start[i + 1] - ladspa->level_start[i];
+	threads = ladspa->threads;
+	if (threads >= width)
+		threads = width > 0 ? width - 1 : 0;
+	if (threads == ladspa->workers_count)
+		return 0;
+	snd_pcm_ladspa_stop_workers(ladspa);
+	if (threads == 0)
+		return 0;
+	ladspa->workers = calloc(threads, sizeof(*ladspa->workers));
+	if (!ladspa->workers)
+		return -ENOMEM;
+	pthread_mutex_init(&ladspa->pool_mutex, NULL);
+	pthread_cond_init(&ladspa->job_cond, NULL);
+	pthread_cond_init(&ladspa->done_cond, NULL);
+	ladspa->pool_quit = 0;
+	for (i = 0; i < threads; i++) {
+		snd_pcm_ladspa_worker_t *worker = &ladspa->workers[i];
+		worker->ladspa = ladspa;
+		worker->idx = i + 1;
+		worker->generation = ladspa->job_generation;
+		err = pthread_create(&worker->thread, NULL,
+				     snd_pcm_ladspa_worker_thread, worker);
+		if (err) {
+			SNDERR("cannot create the worker thread");
+			snd_pcm_ladspa_stop_workers(ladspa);
+			return -err;
+		}
+		ladspa->workers_count++;
+	}
+	return 0;
+}
+
+/* process one block through the whole plugin chain */
+static void snd_pcm_ladspa_run(snd_pcm_ladspa_t *ladspa,
+			       const snd_pcm_channel_area_t *in_areas,
+			       snd_pcm_uframes_t in_offset,
+			       const snd_pcm_channel_area_t *out_areas,
+			       snd_pcm_uframes_t out_offset,
+			       unsigned long size)
+{
+	unsigned int level;
+
+	ladspa->job_in_areas = in_areas;
+	ladspa->job_in_offset = in_offset;
+	ladspa->job_out_areas = out_areas;
+	ladspa->job_out_offset = out_offset;
+	ladspa->job_size = size;
+	for (level = 0; level < ladspa->levels; level++) {
+		ladspa->job_level = level;
+		if (!ladspa->workers_count ||
+		    ladspa->level_start[level + 1] - ladspa->level_start[level] < 2) {
+			snd_pcm_ladspa_run_slice(ladspa, 0, 1);
+			continue;
+		}
+		pthread_mutex_lock(&ladspa->pool_mutex);
+		ladspa->job_pending = ladspa->workers_count;
+		ladspa->job_generation++;
+		pthread_cond_broadcast(&ladspa->job_cond);
+		pthread_mutex_unlock(&ladspa->pool_mutex);
+		snd_pcm_ladspa_run_slice(ladspa, 0, ladspa->workers_count + 1);
+		pthread_mutex_lock(&ladspa->pool_mutex);
+		while (ladspa->job_pending)
+			pthread_cond_wait(&ladspa->done_cond, &ladspa->pool_mutex);
+		pthread_mutex_unlock(&ladspa->pool_mutex);
+	}
+}
+
 static int snd_pcm_ladspa_init(snd_pcm_t *pcm)
 {
 	snd_pcm_ladspa_t *ladspa = pcm->private_data;
@@ -836,7 +1231,12 @@ static int snd_pcm_ladspa_init(snd_pcm_t *pcm)
 		snd_pcm_ladspa_free_instances(pcm, ladspa, 1);
 		return err;
 	}
-	return 0;
+	err = snd_pcm_ladspa_build_schedule(pcm, ladspa);
+	if (err < 0) {
+		snd_pcm_ladspa_free_instances(pcm, ladspa, 1);
+		return err;
+	}
+	return snd_pcm_ladspa_start_workers(ladspa);
 }
 
 static int snd_pcm_ladspa_hw_free(snd_pcm_t *pcm)
@@ -857,10 +1257,7 @@ snd_pcm_ladspa_write_areas(snd_pcm_t *pcm,
 			   snd_pcm_uframes_t *slave_sizep)
 {
 	snd_pcm_ladspa_t *ladspa = pcm->private_data;
-	snd_pcm_ladspa_instance_t *instance;
-	struct list_head *pos, *pos1;
-	LADSPA_Data *data;
-	unsigned int idx, chn, size1, size2;
+	unsigned int size1, size2;
 	
 	if (size > *slave_sizep)
 		size = *slave_sizep;
@@ -874,31 +1271,8 @@ snd_pcm_ladspa_write_areas(snd_pcm_t *pcm,
                 size1 = size;
                 if (size1 > ladspa->allocated)
                         size1 = ladspa->allocated;
-        	list_for_each(pos, &ladspa->pplugins) {
-        		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
-        		list_for_each(pos1, &plugin->instances) {
-        			instance = list_entry(pos1, snd_pcm_ladspa_instance_t, list);
-        			for (idx = 0; idx < instance->input.channels.size; idx++) {
-                                        chn = instance->input.channels.array[idx];
-                                        data = instance->input.data[idx];
-                                        if (data == NULL) {
-                                		data = (LADSPA_Data *)((char *)areas[chn].addr + (areas[chn].first / 8));
-                                       		data += offset;
-                                        }
-                                        instance->desc->connect_port(instance->handle, instance->input.ports.array[idx], data);
-        			}
-        			for (idx = 0; idx < instance->output.channels.size; idx++) {
-                                        chn = instance->output.channels.array[idx];
-                                        data = instance->output.data[idx];
-                                        if (data == NULL) {
-                                		data = (LADSPA_Data *)((char *)slave_areas[chn].addr + (areas[chn].first / 8));
-                                		data += slave_offset;
-                                        }
-					instance->desc->connect_port(instance->handle, instance->output.ports.array[idx], data);
-        			}
-        			instance->desc->run(instance->handle, size1);
-        		}
-        	}
+		snd_pcm_ladspa_run(ladspa, areas, offset,
+				   slave_areas, slave_offset, size1);
         	offset += size1;
         	slave_offset += size1;
         	size -= size1;
@@ -918,10 +1292,7 @@ snd_pcm_ladspa_read_areas(snd_pcm_t *pcm,
 			  snd_pcm_uframes_t *slave_sizep)
 {
 	snd_pcm_ladspa_t *ladspa = pcm->private_data;
-	snd_pcm_ladspa_instance_t *instance;
-	struct list_head *pos, *pos1;
-	LADSPA_Data *data;
-	unsigned int idx, chn, size1, size2;;
+	unsigned int size1, size2;
 
 	if (size > *slave_sizep)
 		size = *slave_sizep;
@@ -935,31 +1306,8 @@ snd_pcm_ladspa_read_areas(snd_pcm_t *pcm,
                 size1 = size;
                 if (size1 > ladspa->allocated)
                         size1 = ladspa->allocated;
-        	list_for_each(pos, &ladspa->cplugins) {
-        		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
-        		list_for_each(pos1, &plugin->instances) {
-        			instance = list_entry(pos1, snd_pcm_ladspa_instance_t, list);
-        			for (idx = 0; idx < instance->input.channels.size; idx++) {
-                                        chn = instance->input.channels.array[idx];
-                                        data = instance->input.data[idx];
-                                        if (data == NULL) {
-                                		data = (LADSPA_Data *)((char *)slave_areas[chn].addr + (areas[chn].first / 8));
-                                		data += slave_offset;
-                                        }	
-                			instance->desc->connect_port(instance->handle, instance->input.ports.array[idx], data);
-        			}
-        			for (idx = 0; idx < instance->output.channels.size; idx++) {
-                                        chn = instance->output.channels.array[idx];
-                                        data = instance->output.data[idx];
-                                        if (data == NULL) {
-                                		data = (LADSPA_Data *)((char *)areas[chn].addr + (areas[chn].first / 8));
-                                       		data += offset;
-                                        }
-        		        	instance->desc->connect_port(instance->handle, instance->output.ports.array[idx], data);
-        			}
-        			instance->desc->run(instance->handle, size1);
-        		}
-        	}
+		snd_pcm_ladspa_run(ladspa, slave_areas, slave_offset,
+				   areas, offset, size1);
         	offset += size1;
         	slave_offset += size1;
         	size -= size1;
@@ -1057,6 +1405,10 @@ static void snd_pcm_ladspa_dump(snd_pcm_t *pcm, snd_output_t *out)
 	snd_pcm_ladspa_plugins_dump(&ladspa->pplugins, out);
 	snd_output_printf(out, "  Capture:\n");
 	snd_pcm_ladspa_plugins_dump(&ladspa->cplugins, out);
+	if (ladspa->sched)
+		snd_output_printf(out, "  Schedule: %u instances in %u levels, %u intermediate buffers, %u worker threads\n",
+				  ladspa->sched_count, ladspa->levels,
+				  ladspa->arena_slots, ladspa->workers_count);
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -1672,6 +2024,14 @@ connected to a dummy sample area.
 
 Instances of LADSPA plugins are created dynamically.
 
+The instances are sorted into levels by their data dependencies, so that
+the instances of one level do not share any buffer (for example the
+per-channel instances created by the duplicate policy).  The intermediate
+buffers live in one arena and are reused once the later levels do not
+refer to them anymore.  When \c threads is set, the instances of each
+level are distributed over a pool of worker threads plus the calling
+thread and the levels are joined one after another.
+
 \code
 pcm.name {
         type ladspa             # ALSA<->LADSPA PCM
@@ -1683,6 +2043,7 @@ pcm.name {
                 pcm { }         # Slave PCM definition
         }
         [channels INT]		# count input channels (input to LADSPA plugin chain)
+	[threads INT]		# Worker threads for independent instances (default 0)
 	[path STR]		# Path (directory) with LADSPA plugins
 	plugins |		# Definition for both directions
         playback_plugins |	# Definition for playback direction
@@ -1740,6 +2101,7 @@ int _snd_pcm_ladspa_open(snd_pcm_t **pcmp, const char *name,
 	snd_config_t *slave = NULL, *sconf;
 	const char *path = NULL;
 	long channels = 0;
+	long threads = 0;
 	snd_config_t *plugins = NULL, *pplugins = NULL, *cplugins = NULL;
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1764,6 +2126,14 @@ int _snd_pcm_ladspa_open(snd_pcm_t **pcmp, const char *name,
                                 channels = 0;
 			continue;
 		}
+		if (strcmp(id, "threads") == 0) {
+			if (snd_config_get_integer(n, &threads) < 0 ||
+			    threads < 0) {
+				SNDERR("Invalid value for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
 		if (strcmp(id, "plugins") == 0) {
 			plugins = n;
 			continue;
@@ -1799,9 +2169,12 @@ int _snd_pcm_ladspa_open(snd_pcm_t **pcmp, const char *name,
 	if (err < 0)
 		return err;
 	err = snd_pcm_ladspa_open(pcmp, name, path, channels, pplugins, cplugins, spcm, 1);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
-	return err;
+		return err;
+	}
+	((snd_pcm_ladspa_t *)(*pcmp)->private_data)->threads = threads;
+	return 0;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_ladspa_open, SND_PCM_DLSYM_VERSION);
@@ -52,139 +52,17 @@ typedef struct {
 	unsigned int int32_idx;
 	unsigned int float32_idx;
 	snd_pcm_format_t sformat;
+	snd_pcm_linear_kernel_t kernel;
 	void (*func)(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
 		     const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
 		     unsigned int channels, snd_pcm_uframes_t frames,
 		     unsigned int get32idx, unsigned int put32floatidx);
 } snd_pcm_lfloat_t;
 
-int snd_pcm_lfloat_get_s32_index(snd_pcm_format_t format)
-{
-	int width, endian;
-
-	switch (format) {
-	case SND_PCM_FORMAT_FLOAT_LE:
-	case SND_PCM_FORMAT_FLOAT_BE:
-		width = 32;
-		break;
-	case SND_PCM_FORMAT_FLOAT64_LE:
-	case SND_PCM_FORMAT_FLOAT64_BE:
-		width = 64;
-		break;
-	default:
-		return -EINVAL;
-	}
-#ifdef SND_LITTLE_ENDIAN
-	endian = snd_pcm_format_big_endian(format);
-#else
-	endian = snd_pcm_format_little_endian(format);
-#endif
-	return ((width / 32)-1) * 2 + endian;
-}
-
-int snd_pcm_lfloat_put_s32_index(snd_pcm_format_t format)
-{
-	return snd_pcm_lfloat_get_s32_index(format);
-}
-
 #endif /* DOC_HIDDEN */
 
 #ifndef BUGGY_GCC
 
-#ifndef DOC_HIDDEN
-
-void snd_pcm_lfloat_convert_integer_float(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
-					  const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
-					  unsigned int channels, snd_pcm_uframes_t frames,
-					  unsigned int get32idx, unsigned int put32floatidx)
-{
-#define GET32_LABELS
-#define PUT32F_LABELS
-#include "plugin_ops.h"
-#undef PUT32F_LABELS
-#undef GET32_LABELS
-	void *get32 = get32_labels[get32idx];
-	void *put32float = put32float_labels[put32floatidx];
-	unsigned int channel;
-	for (channel = 0; channel < channels; ++channel) {
-		const char *src;
-		char *dst;
-		int src_step, dst_step;
-		snd_pcm_uframes_t frames1;
-		int32_t sample = 0;
-		snd_tmp_float_t tmp_float;
-		snd_tmp_double_t tmp_double;
-		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
-		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
-		src = snd_pcm_channel_area_addr(src_area, src_offset);
-		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
-		src_step = snd_pcm_channel_area_step(src_area);
-		dst_step = snd_pcm_channel_area_step(dst_area);
-		frames1 = frames;
-		while (frames1-- > 0) {
-			goto *get32;
-#define GET32_END sample_loaded
-#include "plugin_ops.h"
-#undef GET32_END
-		sample_loaded:
-			goto *put32float;
-#define PUT32F_END sample_put
-#include "plugin_ops.h"
-#undef PUT32F_END
-		sample_put:
-			src += src_step;
-			dst += dst_step;
-		}
-	}
-}
-
-void snd_pcm_lfloat_convert_float_integer(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
-					  const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
-					  unsigned int channels, snd_pcm_uframes_t frames,
-					  unsigned int put32idx, unsigned int get32floatidx)
-{
-#define PUT32_LABELS
-#define GET32F_LABELS
-#include "plugin_ops.h"
-#undef GET32F_LABELS
-#undef PUT32_LABELS
-	void *put32 = put32_labels[put32idx];
-	void *get32float = get32float_labels[get32floatidx];
-	unsigned int channel;
-	for (channel = 0; channel < channels; ++channel) {
-		const char *src;
-		char *dst;
-		int src_step, dst_step;
-		snd_pcm_uframes_t frames1;
-		int32_t sample = 0;
-		snd_tmp_float_t tmp_float;
-		snd_tmp_double_t tmp_double;
-		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
-		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
-		src = snd_pcm_channel_area_addr(src_area, src_offset);
-		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
-		src_step = snd_pcm_channel_area_step(src_area);
-		dst_step = snd_pcm_channel_area_step(dst_area);
-		frames1 = frames;
-		while (frames1-- > 0) {
-			goto *get32float;
-#define GET32F_END sample_loaded
-#include "plugin_ops.h"
-#undef GET32F_END
-		sample_loaded:
-			goto *put32;
-#define PUT32_END sample_put
-#include "plugin_ops.h"
-#undef PUT32_END
-		sample_put:
-			src += src_step;
-			dst += dst_step;
-		}
-	}
-}
-
-#endif /* DOC_HIDDEN */
-
 static int snd_pcm_lfloat_hw_refine_cprepare(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
@@ -285,6 +163,7 @@ static int snd_pcm_lfloat_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		src_format = slave->format;
 		err = INTERNAL(snd_pcm_hw_params_get_format)(params, &dst_format);
 	}
+	snd_pcm_linear_kernel(&lfloat->kernel, src_format, dst_format);
 	if (snd_pcm_format_linear(src_format)) {
 		lfloat->int32_idx = snd_pcm_linear_get_index(src_format, SND_PCM_FORMAT_S32);
 		lfloat->float32_idx = snd_pcm_lfloat_put_s32_index(dst_format);
@@ -309,10 +188,16 @@ snd_pcm_lfloat_write_areas(snd_pcm_t *pcm,
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	lfloat->func(slave_areas, slave_offset,
-		     areas, offset, 
-		     pcm->channels, size,
-		     lfloat->int32_idx, lfloat->float32_idx);
+	if (lfloat->kernel.func)
+		snd_pcm_linear_kernel_areas(&lfloat->kernel,
+					    slave_areas, slave_offset,
+					    areas, offset,
+					    pcm->channels, size);
+	else
+		lfloat->func(slave_areas, slave_offset,
+			     areas, offset, 
+			     pcm->channels, size,
+			     lfloat->int32_idx, lfloat->float32_idx);
 	*slave_sizep = size;
 	return size;
 }
@@ -329,10 +214,16 @@ snd_pcm_lfloat_read_areas(snd_pcm_t *pcm,
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	lfloat->func(areas, offset, 
-		     slave_areas, slave_offset,
-		     pcm->channels, size,
-		     lfloat->int32_idx, lfloat->float32_idx);
+	if (lfloat->kernel.func)
+		snd_pcm_linear_kernel_areas(&lfloat->kernel,
+					    areas, offset,
+					    slave_areas, slave_offset,
+					    pcm->channels, size);
+	else
+		lfloat->func(areas, offset, 
+			     slave_areas, slave_offset,
+			     pcm->channels, size,
+			     lfloat->int32_idx, lfloat->float32_idx);
 	*slave_sizep = size;
 	return size;
 }
@@ -43,173 +43,12 @@ typedef struct {
 	snd_pcm_plugin_t plug;
 	unsigned int use_getput;
 	unsigned int conv_idx;
+	snd_pcm_linear_kernel_t kernel;
 	unsigned int get_idx, put_idx;
 	snd_pcm_format_t sformat;
 } snd_pcm_linear_t;
 #endif
 
-#ifndef DOC_HIDDEN
-
-int snd_pcm_linear_convert_index(snd_pcm_format_t src_format,
-				 snd_pcm_format_t dst_format)
-{
-	int src_endian, dst_endian, sign, src_width, dst_width;
-
-	sign = (snd_pcm_format_signed(src_format) !=
-		snd_pcm_format_signed(dst_format));
-#ifdef SND_LITTLE_ENDIAN
-	src_endian = snd_pcm_format_big_endian(src_format);
-	dst_endian = snd_pcm_format_big_endian(dst_format);
-#else
-	src_endian = snd_pcm_format_little_endian(src_format);
-	dst_endian = snd_pcm_format_little_endian(dst_format);
-#endif
-
-	if (src_endian < 0)
-		src_endian = 0;
-	if (dst_endian < 0)
-		dst_endian = 0;
-
-	src_width = snd_pcm_format_width(src_format) / 8 - 1;
-	dst_width = snd_pcm_format_width(dst_format) / 8 - 1;
-
-	return src_width * 32 + src_endian * 16 + sign * 8 + dst_width * 2 + dst_endian;
-}
-
-int snd_pcm_linear_get_index(snd_pcm_format_t src_format, snd_pcm_format_t dst_format)
-{
-	int sign, width, pwidth, endian;
-	sign = (snd_pcm_format_signed(src_format) != 
-		snd_pcm_format_signed(dst_format));
-#ifdef SND_LITTLE_ENDIAN
-	endian = snd_pcm_format_big_endian(src_format);
-#else
-	endian = snd_pcm_format_little_endian(src_format);
-#endif
-	if (endian < 0)
-		endian = 0;
-	pwidth = snd_pcm_format_physical_width(src_format);
-	width = snd_pcm_format_width(src_format);
-	if (pwidth == 24) {
-		switch (width) {
-		case 24:
-			width = 0; break;
-		case 20:
-			width = 1; break;
-		case 18:
-		default:
-			width = 2; break;
-		}
-		return width * 4 + endian * 2 + sign + 16;
-	} else {
-		width = width / 8 - 1;
-		return width * 4 + endian * 2 + sign;
-	}
-}
-
-int snd_pcm_linear_put_index(snd_pcm_format_t src_format, snd_pcm_format_t dst_format)
-{
-	int sign, width, pwidth, endian;
-	sign = (snd_pcm_format_signed(src_format) != 
-		snd_pcm_format_signed(dst_format));
-#ifdef SND_LITTLE_ENDIAN
-	endian = snd_pcm_format_big_endian(dst_format);
-#else
-	endian = snd_pcm_format_little_endian(dst_format);
-#endif
-	if (endian < 0)
-		endian = 0;
-	pwidth = snd_pcm_format_physical_width(dst_format);
-	width = snd_pcm_format_width(dst_format);
-	if (pwidth == 24) {
-		switch (width) {
-		case 24:
-			width = 0; break;
-		case 20:
-			width = 1; break;
-		case 18:
-		default:
-			width = 2; break;
-		}
-		return width * 4 + endian * 2 + sign + 16;
-	} else {
-		width = width / 8 - 1;
-		return width * 4 + endian * 2 + sign;
-	}
-}
-
-void snd_pcm_linear_convert(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
-			    const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
-			    unsigned int channels, snd_pcm_uframes_t frames,
-			    unsigned int convidx)
-{
-#define CONV_LABELS
-#include "plugin_ops.h"
-#undef CONV_LABELS
-	void *conv = conv_labels[convidx];
-	unsigned int channel;
-	for (channel = 0; channel < channels; ++channel) {
-		const char *src;
-		char *dst;
-		int src_step, dst_step;
-		snd_pcm_uframes_t frames1;
-		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
-		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
-		src = snd_pcm_channel_area_addr(src_area, src_offset);
-		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
-		src_step = snd_pcm_channel_area_step(src_area);
-		dst_step = snd_pcm_channel_area_step(dst_area);
-		frames1 = frames;
-		while (frames1-- > 0) {
-			goto *conv;
-#define CONV_END after
-#include "plugin_ops.h"
-#undef CONV_END
-		after:
-			src += src_step;
-			dst += dst_step;
-		}
-	}
-}
-
-void snd_pcm_linear_getput(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
-			   const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
-			   unsigned int channels, snd_pcm_uframes_t frames,
-			   unsigned int get_idx, unsigned int put_idx)
-{
-#define CONV24_LABELS
-#include "plugin_ops.h"
-#undef CONV24_LABELS
-	void *get = get32_labels[get_idx];
-	void *put = put32_labels[put_idx];
-	unsigned int channel;
-	u_int32_t sample = 0;
-	for (channel = 0; channel < channels; ++channel) {
-		const char *src;
-		char *dst;
-		int src_step, dst_step;
-		snd_pcm_uframes_t frames1;
-		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
-		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
-		src = snd_pcm_channel_area_addr(src_area, src_offset);
-		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
-		src_step = snd_pcm_channel_area_step(src_area);
-		dst_step = snd_pcm_channel_area_step(dst_area);
-		frames1 = frames;
-		while (frames1-- > 0) {
-			goto *get;
-#define CONV24_END after
-#include "plugin_ops.h"
-#undef CONV24_END
-		after:
-			src += src_step;
-			dst += dst_step;
-		}
-	}
-}
-
-#endif /* DOC_HIDDEN */
-
 static int snd_pcm_linear_hw_refine_cprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t *params)
 {
 	int err;
@@ -302,6 +141,10 @@ static int snd_pcm_linear_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	err = INTERNAL(snd_pcm_hw_params_get_format)(params, &format);
 	if (err < 0)
 		return err;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		snd_pcm_linear_kernel(&linear->kernel, format, linear->sformat);
+	else
+		snd_pcm_linear_kernel(&linear->kernel, linear->sformat, format);
 	linear->use_getput = (snd_pcm_format_physical_width(format) == 24 ||
 			      snd_pcm_format_physical_width(linear->sformat) == 24);
 	if (linear->use_getput) {
@@ -335,7 +178,12 @@ snd_pcm_linear_write_areas(snd_pcm_t *pcm,
 	snd_pcm_linear_t *linear = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	if (linear->use_getput)
+	if (linear->kernel.func)
+		snd_pcm_linear_kernel_areas(&linear->kernel,
+					    slave_areas, slave_offset,
+					    areas, offset,
+					    pcm->channels, size);
+	else if (linear->use_getput)
 		snd_pcm_linear_getput(slave_areas, slave_offset,
 				      areas, offset, 
 				      pcm->channels, size,
@@ -360,7 +208,12 @@ snd_pcm_linear_read_areas(snd_pcm_t *pcm,
 	snd_pcm_linear_t *linear = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	if (linear->use_getput)
+	if (linear->kernel.func)
+		snd_pcm_linear_kernel_areas(&linear->kernel,
+					    areas, offset,
+					    slave_areas, slave_offset,
+					    pcm->channels, size);
+	else if (linear->use_getput)
 		snd_pcm_linear_getput(areas, offset, 
 				      slave_areas, slave_offset,
 				      pcm->channels, size,
@@ -229,6 +229,9 @@ struct _snd_pcm {
 	unsigned int mmap_shadow: 1;	/* don't call actual mmap,
 					 * use the mmaped buffer of the slave
 					 */
+	unsigned int mmap_readonly: 1;	/* the mmaped buffer is shared with
+					 * other handles, don't convert on it
+					 */
 	unsigned int donot_close: 1;	/* don't close this PCM */
 	snd_pcm_channel_info_t *mmap_channels;
 	snd_pcm_channel_area_t *running_areas;
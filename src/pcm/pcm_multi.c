@@ -31,8 +31,15 @@
 #include <unistd.h>
 #include <string.h>
 #include <math.h>
+#include <byteswap.h>
 #include "pcm_local.h"
-#include "pcm_generic.h"
+#include "pcm_plugin.h"
+
+#include "plugin_ops.h"
+
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef PIC
 /* entry for static linking */
@@ -41,33 +48,641 @@ const char *_snd_module_pcm_multi = "";
 
 #ifndef DOC_HIDDEN
 
+typedef struct {
+	unsigned long long count;
+	unsigned long long total_ns;
+	unsigned long long max_ns;
+} snd_pcm_multi_timing_t;
+
+#define SND_PCM_MULTI_DRIFT_POINTS	64		/* sliding window size */
+#define SND_PCM_MULTI_DRIFT_INTERVAL	100000000LL	/* nsec between points */
+#define SND_PCM_MULTI_DRIFT_MAX_RATIO	0.01		/* sanity limit */
+#define SND_PCM_MULTI_DRIFT_MAX_ADJUST	0.001		/* fill level correction */
+#define SND_PCM_MULTI_DRIFT_SETTLE	2.0		/* correction time in sec */
+
+typedef struct {
+	snd_htimestamp_t tstamp;
+	snd_pcm_uframes_t pos;
+} snd_pcm_multi_drift_point_t;
+
+typedef struct {
+	/* rate measurement */
+	snd_pcm_multi_drift_point_t points[SND_PCM_MULTI_DRIFT_POINTS];
+	unsigned int head;
+	unsigned int count;
+	double rate;			/* measured frames per second */
+	double ratio;			/* measured rate against the master */
+	double applied;			/* ratio used by the resampler */
+	double min_ratio;
+	double max_ratio;
+	snd_pcm_sframes_t delay_error;
+	/* resampler (playback, non-master slaves only) */
+	int compensate;
+	double pos;			/* input position of the next output frame */
+	int32_t *last;			/* last input sample of each channel */
+	char *buffer;			/* shadow buffer exposed to the application */
+	snd_pcm_channel_area_t *areas;
+	unsigned int get_idx;
+	unsigned int put_idx;
+	unsigned long long frames_in;
+	unsigned long long frames_out;
+	unsigned long long frames_dropped;
+} snd_pcm_multi_drift_t;
+
 typedef struct {
 	snd_pcm_t *pcm;
 	unsigned int channels_count;
 	int close_slave;
 	snd_pcm_t *linked;
+	snd_pcm_multi_drift_t *drift;	/* NULL unless drift compensation is on */
+	/* per-slave job arguments and result (worker pool) */
+	snd_pcm_uframes_t job_frames;
+	snd_pcm_sframes_t job_result;
+	snd_pcm_multi_timing_t commit_timing;
+	snd_pcm_multi_timing_t avail_timing;
 } snd_pcm_multi_slave_t;
 
+typedef enum {
+	SND_PCM_MULTI_JOB_COMMIT,
+	SND_PCM_MULTI_JOB_AVAIL,
+	SND_PCM_MULTI_JOB_RESET,
+	SND_PCM_MULTI_JOB_REWIND,
+	SND_PCM_MULTI_JOB_FORWARD,
+} snd_pcm_multi_job_t;
+
+struct snd_pcm_multi;
+
+typedef struct {
+	struct snd_pcm_multi *multi;
+	unsigned int idx;
+	unsigned int generation;
+#ifdef HAVE_LIBPTHREAD
+	pthread_t thread;
+#endif
+} snd_pcm_multi_worker_t;
+
 typedef struct {
 	int slave_idx;
 	unsigned int slave_channel;
 } snd_pcm_multi_channel_t;
 
-typedef struct {
+typedef struct snd_pcm_multi {
 	unsigned int slaves_count;
 	unsigned int master_slave;
 	snd_pcm_multi_slave_t *slaves;
 	unsigned int channels_count;
 	snd_pcm_multi_channel_t *channels;
+	/* worker pool; the caller thread acts as executor #0 */
+	unsigned int workers_count;
+	snd_pcm_multi_worker_t *workers;
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t pool_mutex;
+	pthread_cond_t job_cond;
+	pthread_cond_t done_cond;
+#endif
+	unsigned int job_generation;
+	unsigned int job_pending;
+	snd_pcm_multi_job_t job;
+	snd_pcm_uframes_t job_offset;
+	int pool_quit;
+	int drift;
 } snd_pcm_multi_t;
 
 #endif
 
+static void snd_pcm_multi_timing_add(snd_pcm_multi_timing_t *timing,
+				     const snd_htimestamp_t *start)
+{
+	snd_htimestamp_t now;
+	long long ns;
+
+	gettimestamp(&now, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+	ns = (long long)(now.tv_sec - start->tv_sec) * 1000000000LL +
+		(now.tv_nsec - start->tv_nsec);
+	if (ns < 0)
+		ns = 0;
+	timing->count++;
+	timing->total_ns += ns;
+	if ((unsigned long long)ns > timing->max_ns)
+		timing->max_ns = ns;
+}
+
+static long long snd_pcm_multi_tstamp_diff(const snd_htimestamp_t *t1,
+					    const snd_htimestamp_t *t0)
+{
+	return (long long)(t1->tv_sec - t0->tv_sec) * 1000000000LL +
+		(t1->tv_nsec - t0->tv_nsec);
+}
+
+/* resample count frames from the shadow buffer at offset into the slave */
+static void snd_pcm_multi_drift_resample(snd_pcm_multi_slave_t *slave,
+					 snd_pcm_uframes_t offset,
+					 snd_pcm_uframes_t count,
+					 const snd_pcm_channel_area_t *dst_areas,
+					 snd_pcm_uframes_t dst_offset,
+					 snd_pcm_uframes_t out_idx,
+					 snd_pcm_uframes_t out_frames)
+{
+#define GET32_LABELS
+#define PUT32_LABELS
+#include "plugin_ops.h"
+#undef GET32_LABELS
+#undef PUT32_LABELS
+	snd_pcm_multi_drift_t *drift = slave->drift;
+	void *get = get32_labels[drift->get_idx];
+	void *put = put32_labels[drift->put_idx];
+	double step = 1.0 / drift->applied;
+	unsigned int channel;
+
+	for (channel = 0; channel < slave->channels_count; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &drift->areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const char *src0 = snd_pcm_channel_area_addr(src_area, offset);
+		int src_step = snd_pcm_channel_area_step(src_area);
+		char *dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		int dst_step = snd_pcm_channel_area_step(dst_area);
+		snd_pcm_uframes_t k;
+
+		for (k = out_idx; k < out_idx + out_frames; ++k) {
+			double p = drift->pos + k * step;
+			long idx = (long)floor(p);
+			double frac = p - idx;
+			int32_t s[2];
+			unsigned int n;
+			u_int32_t sample = 0;
+
+			for (n = 0; n < 2; ++n) {
+				const char *src;
+				if (idx + (long)n < 0) {
+					s[n] = drift->last[channel];
+					continue;
+				}
+				if ((snd_pcm_uframes_t)(idx + n) >= count) {
+					s[n] = s[0];
+					continue;
+				}
+				src = src0 + (idx + n) * src_step;
+				goto *get;
+#define GET32_END after_get
+#include "plugin_ops.h"
+#undef GET32_END
+			after_get:
+				s[n] = (int32_t)sample;
+			}
+			sample = (u_int32_t)(int32_t)(s[0] + (s[1] - (double)s[0]) * frac);
+			goto *put;
+#define PUT32_END after_put
+#include "plugin_ops.h"
+#undef PUT32_END
+		after_put:
+			dst += dst_step;
+		}
+	}
+}
+
+static void snd_pcm_multi_drift_save_last(snd_pcm_multi_slave_t *slave,
+					  snd_pcm_uframes_t offset)
+{
+#define GET32_LABELS
+#include "plugin_ops.h"
+#undef GET32_LABELS
+	snd_pcm_multi_drift_t *drift = slave->drift;
+	void *get = get32_labels[drift->get_idx];
+	unsigned int channel;
+
+	for (channel = 0; channel < slave->channels_count; ++channel) {
+		const char *src = snd_pcm_channel_area_addr(&drift->areas[channel],
+							    offset);
+		u_int32_t sample = 0;
+		goto *get;
+#define GET32_END after_get
+#include "plugin_ops.h"
+#undef GET32_END
+	after_get:
+		drift->last[channel] = (int32_t)sample;
+	}
+}
+
+/* commit from the shadow buffer to a slave running on its own clock */
+static snd_pcm_sframes_t snd_pcm_multi_drift_commit(snd_pcm_multi_slave_t *slave,
+						    snd_pcm_uframes_t offset,
+						    snd_pcm_uframes_t size)
+{
+	snd_pcm_multi_drift_t *drift = slave->drift;
+	double step = 1.0 / drift->applied;
+	snd_pcm_uframes_t out_frames, done = 0;
+
+	if (size == 0)
+		return 0;
+	if (drift->pos < size - 1)
+		out_frames = (snd_pcm_uframes_t)ceil((size - 1 - drift->pos) / step);
+	else
+		out_frames = 0;
+	while (done < out_frames) {
+		const snd_pcm_channel_area_t *areas;
+		snd_pcm_uframes_t soffset, frames = out_frames - done;
+		snd_pcm_sframes_t result;
+		int err;
+
+		err = snd_pcm_mmap_begin(slave->pcm, &areas, &soffset, &frames);
+		if (err < 0)
+			return err;
+		if (frames == 0) {
+			drift->frames_dropped += out_frames - done;
+			break;
+		}
+		snd_pcm_multi_drift_resample(slave, offset, size, areas, soffset,
+					     done, frames);
+		result = snd_pcm_mmap_commit(slave->pcm, soffset, frames);
+		if (result < 0)
+			return result;
+		done += frames;
+	}
+	drift->pos += out_frames * step - size;
+	snd_pcm_multi_drift_save_last(slave, offset + size - 1);
+	drift->frames_in += size;
+	drift->frames_out += done;
+	return size;
+}
+
+static snd_pcm_sframes_t snd_pcm_multi_drift_avail(snd_pcm_multi_slave_t *slave)
+{
+	snd_pcm_sframes_t avail = snd_pcm_avail_update(slave->pcm);
+
+	if (avail < 0)
+		return avail;
+	/* keep a couple of frames for the interpolation rounding */
+	avail = (snd_pcm_sframes_t)((avail - 2) / slave->drift->applied);
+	return avail < 0 ? 0 : avail;
+}
+
+static snd_pcm_sframes_t snd_pcm_multi_slave_commit(snd_pcm_multi_slave_t *slave,
+						    snd_pcm_uframes_t offset,
+						    snd_pcm_uframes_t size)
+{
+	snd_htimestamp_t start;
+	snd_pcm_sframes_t result;
+
+	gettimestamp(&start, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+	if (slave->drift && slave->drift->compensate)
+		result = snd_pcm_multi_drift_commit(slave, offset, size);
+	else
+		result = snd_pcm_mmap_commit(slave->pcm, offset, size);
+	snd_pcm_multi_timing_add(&slave->commit_timing, &start);
+	return result;
+}
+
+static snd_pcm_sframes_t snd_pcm_multi_slave_avail(snd_pcm_multi_slave_t *slave)
+{
+	snd_htimestamp_t start;
+	snd_pcm_sframes_t result;
+
+	gettimestamp(&start, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+	if (slave->drift && slave->drift->compensate)
+		result = snd_pcm_multi_drift_avail(slave);
+	else
+		result = snd_pcm_avail_update(slave->pcm);
+	snd_pcm_multi_timing_add(&slave->avail_timing, &start);
+	return result;
+}
+
+static void snd_pcm_multi_drift_reset(snd_pcm_multi_t *multi)
+{
+	unsigned int i;
+
+	for (i = 0; i < multi->slaves_count; ++i) {
+		snd_pcm_multi_drift_t *drift = multi->slaves[i].drift;
+		if (!drift)
+			continue;
+		drift->count = 0;
+		drift->head = 0;
+		drift->pos = 0;
+		if (drift->last)
+			memset(drift->last, 0, multi->slaves[i].channels_count *
+			       sizeof(*drift->last));
+	}
+}
+
+/* frames processed by the device at the time of the given avail */
+static snd_pcm_uframes_t snd_pcm_multi_drift_hw_pos(snd_pcm_t *slave,
+						    snd_pcm_uframes_t avail)
+{
+	snd_pcm_uframes_t pos = *slave->appl.ptr + avail;
+
+	if (slave->stream == SND_PCM_STREAM_PLAYBACK) {
+		if (pos < slave->buffer_size)
+			pos += slave->boundary;
+		pos -= slave->buffer_size;
+	}
+	if (pos >= slave->boundary)
+		pos -= slave->boundary;
+	return pos;
+}
+
+/* sample the slave positions and update the rate estimations */
+static void snd_pcm_multi_drift_update(snd_pcm_t *pcm)
+{
+	snd_pcm_multi_t *multi = pcm->private_data;
+	snd_pcm_multi_slave_t *master = &multi->slaves[multi->master_slave];
+	snd_pcm_uframes_t avails[multi->slaves_count];
+	int valid[multi->slaves_count];
+	unsigned int i;
+
+	if (snd_pcm_state(master->pcm) != SND_PCM_STATE_RUNNING) {
+		/* positions do not advance, restart the measurement */
+		for (i = 0; i < multi->slaves_count; ++i)
+			multi->slaves[i].drift->count = 0;
+		return;
+	}
+	for (i = 0; i < multi->slaves_count; ++i) {
+		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
+		snd_pcm_multi_drift_t *drift = slave->drift;
+		snd_pcm_multi_drift_point_t *newest, *oldest;
+		snd_htimestamp_t tstamp;
+		snd_pcm_uframes_t pos;
+		long long span;
+
+		valid[i] = 0;
+		if (snd_pcm_htimestamp(slave->pcm, &avails[i], &tstamp) < 0)
+			continue;
+		valid[i] = 1;
+		pos = snd_pcm_multi_drift_hw_pos(slave->pcm, avails[i]);
+		if (drift->count > 0) {
+			newest = &drift->points[(drift->head + SND_PCM_MULTI_DRIFT_POINTS - 1) %
+						SND_PCM_MULTI_DRIFT_POINTS];
+			if (snd_pcm_multi_tstamp_diff(&tstamp, &newest->tstamp) <
+			    SND_PCM_MULTI_DRIFT_INTERVAL)
+				continue;
+		}
+		drift->points[drift->head].tstamp = tstamp;
+		drift->points[drift->head].pos = pos;
+		drift->head = (drift->head + 1) % SND_PCM_MULTI_DRIFT_POINTS;
+		if (drift->count < SND_PCM_MULTI_DRIFT_POINTS)
+			drift->count++;
+		if (drift->count < 2)
+			continue;
+		oldest = &drift->points[(drift->head + SND_PCM_MULTI_DRIFT_POINTS -
+					 drift->count) % SND_PCM_MULTI_DRIFT_POINTS];
+		span = snd_pcm_multi_tstamp_diff(&tstamp, &oldest->tstamp);
+		if (span <= 0)
+			continue;
+		if (pos < oldest->pos)
+			pos += slave->pcm->boundary;
+		drift->rate = (double)(pos - oldest->pos) * 1000000000.0 / span;
+	}
+
+	if (!valid[multi->master_slave] || master->drift->rate <= 0)
+		return;
+	for (i = 0; i < multi->slaves_count; ++i) {
+		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
+		snd_pcm_multi_drift_t *drift = slave->drift;
+		snd_pcm_sframes_t mqueued, squeued;
+		double ratio, adjust;
+
+		if (i == multi->master_slave || !valid[i] || drift->rate <= 0)
+			continue;
+		ratio = drift->rate / master->drift->rate;
+		if (fabs(ratio - 1.0) > SND_PCM_MULTI_DRIFT_MAX_RATIO)
+			continue;
+		drift->ratio = ratio;
+		if (drift->min_ratio == 0 || ratio < drift->min_ratio)
+			drift->min_ratio = ratio;
+		if (ratio > drift->max_ratio)
+			drift->max_ratio = ratio;
+		if (!drift->compensate)
+			continue;
+		/* steer the fill level of the slave back to the master's one */
+		mqueued = master->pcm->buffer_size - avails[multi->master_slave];
+		squeued = slave->pcm->buffer_size - avails[i];
+		drift->delay_error = squeued - (snd_pcm_sframes_t)(mqueued * ratio);
+		adjust = -drift->delay_error /
+			(master->drift->rate * SND_PCM_MULTI_DRIFT_SETTLE);
+		if (adjust > SND_PCM_MULTI_DRIFT_MAX_ADJUST)
+			adjust = SND_PCM_MULTI_DRIFT_MAX_ADJUST;
+		else if (adjust < -SND_PCM_MULTI_DRIFT_MAX_ADJUST)
+			adjust = -SND_PCM_MULTI_DRIFT_MAX_ADJUST;
+		drift->applied = ratio + adjust;
+	}
+}
+
+static void snd_pcm_multi_drift_free(snd_pcm_multi_t *multi)
+{
+	unsigned int i;
+
+	for (i = 0; i < multi->slaves_count; ++i) {
+		snd_pcm_multi_drift_t *drift = multi->slaves[i].drift;
+		if (!drift)
+			continue;
+		free(drift->last);
+		free(drift->areas);
+		free(drift->buffer);
+		free(drift);
+		multi->slaves[i].drift = NULL;
+	}
+}
+
+static int snd_pcm_multi_drift_init(snd_pcm_t *pcm, snd_pcm_multi_t *multi)
+{
+	unsigned int i;
+
+	for (i = 0; i < multi->slaves_count; ++i) {
+		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
+		snd_pcm_multi_drift_t *drift = calloc(1, sizeof(*drift));
+		if (!drift) {
+			snd_pcm_multi_drift_free(multi);
+			return -ENOMEM;
+		}
+		drift->ratio = 1.0;
+		drift->applied = 1.0;
+		drift->compensate = (i != multi->master_slave &&
+				     pcm->stream == SND_PCM_STREAM_PLAYBACK);
+		if (drift->compensate) {
+			drift->last = calloc(slave->channels_count,
+					     sizeof(*drift->last));
+			drift->areas = calloc(slave->channels_count,
+					      sizeof(*drift->areas));
+			if (!drift->last || !drift->areas) {
+				free(drift->last);
+				free(drift->areas);
+				free(drift);
+				snd_pcm_multi_drift_free(multi);
+				return -ENOMEM;
+			}
+		}
+		slave->drift = drift;
+	}
+	multi->drift = 1;
+	return 0;
+}
+
+/* run the current job on the slaves assigned to the given executor */
+static void snd_pcm_multi_run_slice(snd_pcm_multi_t *multi, unsigned int idx)
+{
+	unsigned int i;
+
+	for (i = idx; i < multi->slaves_count; i += multi->workers_count + 1) {
+		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
+		switch (multi->job) {
+		case SND_PCM_MULTI_JOB_COMMIT:
+			slave->job_result = snd_pcm_multi_slave_commit(slave,
+							multi->job_offset,
+							slave->job_frames);
+			break;
+		case SND_PCM_MULTI_JOB_AVAIL:
+			slave->job_result = snd_pcm_multi_slave_avail(slave);
+			break;
+		case SND_PCM_MULTI_JOB_RESET:
+			slave->job_result = snd_pcm_reset(slave->pcm);
+			break;
+		case SND_PCM_MULTI_JOB_REWIND:
+			if (slave->job_frames)
+				slave->job_result = snd_pcm_rewind(slave->pcm,
+							slave->job_frames);
+			else
+				slave->job_result = 0;
+			break;
+		case SND_PCM_MULTI_JOB_FORWARD:
+			if (slave->job_frames)
+				slave->job_result = INTERNAL(snd_pcm_forward)(slave->pcm,
+							slave->job_frames);
+			else
+				slave->job_result = 0;
+			break;
+		}
+	}
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void *snd_pcm_multi_worker_thread(void *data)
+{
+	snd_pcm_multi_worker_t *worker = data;
+	snd_pcm_multi_t *multi = worker->multi;
+
+	pthread_mutex_lock(&multi->pool_mutex);
+	for (;;) {
+		while (worker->generation == multi->job_generation &&
+		       !multi->pool_quit)
+			pthread_cond_wait(&multi->job_cond, &multi->pool_mutex);
+		if (multi->pool_quit)
+			break;
+		worker->generation = multi->job_generation;
+		pthread_mutex_unlock(&multi->pool_mutex);
+		snd_pcm_multi_run_slice(multi, worker->idx);
+		pthread_mutex_lock(&multi->pool_mutex);
+		if (--multi->job_pending == 0)
+			pthread_cond_signal(&multi->done_cond);
+	}
+	pthread_mutex_unlock(&multi->pool_mutex);
+	return NULL;
+}
+
+/* dispatch the job to all executors and wait until every slave is done */
+static void snd_pcm_multi_run_job(snd_pcm_multi_t *multi,
+				  snd_pcm_multi_job_t job,
+				  snd_pcm_uframes_t offset)
+{
+	multi->job = job;
+	multi->job_offset = offset;
+	if (!multi->workers_count) {
+		snd_pcm_multi_run_slice(multi, 0);
+		return;
+	}
+	pthread_mutex_lock(&multi->pool_mutex);
+	multi->job_pending = multi->workers_count;
+	multi->job_generation++;
+	pthread_cond_broadcast(&multi->job_cond);
+	pthread_mutex_unlock(&multi->pool_mutex);
+	snd_pcm_multi_run_slice(multi, 0);
+	pthread_mutex_lock(&multi->pool_mutex);
+	while (multi->job_pending)
+		pthread_cond_wait(&multi->done_cond, &multi->pool_mutex);
+	pthread_mutex_unlock(&multi->pool_mutex);
+}
+
+static void snd_pcm_multi_stop_workers(snd_pcm_multi_t *multi)
+{
+	unsigned int i;
+
+	if (!multi->workers)
+		return;
+	pthread_mutex_lock(&multi->pool_mutex);
+	multi->pool_quit = 1;
+	pthread_cond_broadcast(&multi->job_cond);
+	pthread_mutex_unlock(&multi->pool_mutex);
+	for (i = 0; i < multi->workers_count; ++i)
+		pthread_join(multi->workers[i].thread, NULL);
+	pthread_cond_destroy(&multi->done_cond);
+	pthread_cond_destroy(&multi->job_cond);
+	pthread_mutex_destroy(&multi->pool_mutex);
+	free(multi->workers);
+	multi->workers = NULL;
+	multi->workers_count = 0;
+}
+
+static int snd_pcm_multi_start_workers(snd_pcm_multi_t *multi,
+				       unsigned int threads)
+{
+	unsigned int i;
+	int err;
+
+	/* the caller thread always takes a share of the slaves */
+	if (threads >= multi->slaves_count)
+		threads = multi->slaves_count - 1;
+	if (threads == 0)
+		return 0;
+	multi->workers = calloc(threads, sizeof(*multi->workers));
+	if (!multi->workers)
+		return -ENOMEM;
+	pthread_mutex_init(&multi->pool_mutex, NULL);
+	pthread_cond_init(&multi->job_cond, NULL);
+	pthread_cond_init(&multi->done_cond, NULL);
+	multi->pool_quit = 0;
+	multi->workers_count = 0;
+	for (i = 0; i < threads; ++i) {
+		snd_pcm_multi_worker_t *worker = &multi->workers[i];
+		worker->multi = multi;
+		worker->idx = i + 1;
+		worker->generation = multi->job_generation;
+		err = pthread_create(&worker->thread, NULL,
+				     snd_pcm_multi_worker_thread, worker);
+		if (err) {
+			SNDERR("cannot create the worker thread");
+			snd_pcm_multi_stop_workers(multi);
+			return -err;
+		}
+		multi->workers_count++;
+	}
+	return 0;
+}
+#else /* HAVE_LIBPTHREAD */
+static void snd_pcm_multi_run_job(snd_pcm_multi_t *multi,
+				  snd_pcm_multi_job_t job,
+				  snd_pcm_uframes_t offset)
+{
+	multi->job = job;
+	multi->job_offset = offset;
+	snd_pcm_multi_run_slice(multi, 0);
+}
+
+static void snd_pcm_multi_stop_workers(snd_pcm_multi_t *multi ATTRIBUTE_UNUSED)
+{
+}
+
+static int snd_pcm_multi_start_workers(snd_pcm_multi_t *multi ATTRIBUTE_UNUSED,
+				       unsigned int threads ATTRIBUTE_UNUSED)
+{
+	SNDERR("threads are not supported, the slaves are served serially");
+	return 0;
+}
+#endif /* HAVE_LIBPTHREAD */
+
 static int snd_pcm_multi_close(snd_pcm_t *pcm)
 {
 	snd_pcm_multi_t *multi = pcm->private_data;
 	unsigned int i;
 	int ret = 0;
+	snd_pcm_multi_stop_workers(multi);
+	snd_pcm_multi_drift_free(multi);
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
 		if (slave->close_slave) {
@@ -157,6 +772,14 @@ static int snd_pcm_multi_hw_refine_cprepare(snd_pcm_t *pcm, snd_pcm_hw_params_t
 				    multi->channels_count, 0);
 	if (err < 0)
 		return err;
+	if (multi->drift) {
+		/* the drift resampler handles only linear formats */
+		snd_pcm_format_mask_t format_mask = { SND_PCM_FMTBIT_LINEAR };
+		err = _snd_pcm_hw_param_set_mask(params, SND_PCM_HW_PARAM_FORMAT,
+						 &format_mask);
+		if (err < 0)
+			return err;
+	}
 	params->info = ~0U;
 	return 0;
 }
@@ -378,9 +1001,13 @@ static int snd_pcm_multi_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t *params)
 	snd_pcm_multi_t *multi = pcm->private_data;
 	unsigned int i;
 	int err;
+	snd_pcm_sw_params_t sparams = *params;
+	/* the drift estimation needs the slave timestamps */
+	if (multi->drift)
+		sparams.tstamp_mode = SND_PCM_TSTAMP_ENABLE;
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_t *slave = multi->slaves[i].pcm;
-		err = snd_pcm_sw_params(slave, params);
+		err = snd_pcm_sw_params(slave, &sparams);
 		if (err < 0)
 			return err;
 	}
@@ -420,9 +1047,22 @@ static snd_pcm_sframes_t snd_pcm_multi_avail_update(snd_pcm_t *pcm)
 	snd_pcm_multi_t *multi = pcm->private_data;
 	snd_pcm_sframes_t ret = LONG_MAX;
 	unsigned int i;
+	if (multi->drift)
+		snd_pcm_multi_drift_update(pcm);
+	if (multi->workers_count) {
+		snd_pcm_multi_run_job(multi, SND_PCM_MULTI_JOB_AVAIL, 0);
+		for (i = 0; i < multi->slaves_count; ++i) {
+			snd_pcm_sframes_t avail = multi->slaves[i].job_result;
+			if (avail < 0)
+				return avail;
+			if (ret > avail)
+				ret = avail;
+		}
+		return ret;
+	}
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_sframes_t avail;
-		avail = snd_pcm_avail_update(multi->slaves[i].pcm);
+		avail = snd_pcm_multi_slave_avail(&multi->slaves[i]);
 		if (avail < 0)
 			return avail;
 		if (ret > avail)
@@ -444,6 +1084,8 @@ static int snd_pcm_multi_prepare(snd_pcm_t *pcm)
 	snd_pcm_multi_t *multi = pcm->private_data;
 	int result = 0, err;
 	unsigned int i;
+	if (multi->drift)
+		snd_pcm_multi_drift_reset(multi);
 	for (i = 0; i < multi->slaves_count; ++i) {
 		/* We call prepare to each slave even if it's linked.
 		 * This is to make sure to sync non-mmaped control/status.
@@ -460,6 +1102,17 @@ static int snd_pcm_multi_reset(snd_pcm_t *pcm)
 	snd_pcm_multi_t *multi = pcm->private_data;
 	int result = 0, err;
 	unsigned int i;
+	if (multi->drift)
+		snd_pcm_multi_drift_reset(multi);
+	if (multi->workers_count) {
+		snd_pcm_multi_run_job(multi, SND_PCM_MULTI_JOB_RESET, 0);
+		for (i = 0; i < multi->slaves_count; ++i) {
+			err = multi->slaves[i].job_result;
+			if (err < 0)
+				result = err;
+		}
+		return result;
+	}
 	for (i = 0; i < multi->slaves_count; ++i) {
 		/* Reset each slave, as well as in prepare */
 		err = snd_pcm_reset(multi->slaves[i].pcm);
@@ -561,6 +1214,10 @@ static snd_pcm_sframes_t snd_pcm_multi_rewindable(snd_pcm_t *pcm)
 	unsigned int i;
 	snd_pcm_sframes_t frames = LONG_MAX;
 
+	/* resampled data cannot be moved back and forth */
+	if (multi->drift && pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		return 0;
+
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_sframes_t f = snd_pcm_rewindable(multi->slaves[i].pcm);
 		if (f <= 0)
@@ -579,6 +1236,10 @@ static snd_pcm_sframes_t snd_pcm_multi_forwardable(snd_pcm_t *pcm)
 	unsigned int i;
 	snd_pcm_sframes_t frames = LONG_MAX;
 
+	/* resampled data cannot be moved back and forth */
+	if (multi->drift && pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		return 0;
+
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_sframes_t f = snd_pcm_forwardable(multi->slaves[i].pcm);
 		if (f <= 0)
@@ -591,11 +1252,49 @@ static snd_pcm_sframes_t snd_pcm_multi_forwardable(snd_pcm_t *pcm)
 
 }
 
+/* move all slaves in parallel, then realign them to the smallest move */
+static snd_pcm_sframes_t snd_pcm_multi_move_parallel(snd_pcm_multi_t *multi,
+						     snd_pcm_uframes_t frames,
+						     snd_pcm_multi_job_t job,
+						     snd_pcm_multi_job_t back_job)
+{
+	unsigned int i;
+
+	for (i = 0; i < multi->slaves_count; ++i)
+		multi->slaves[i].job_frames = frames;
+	snd_pcm_multi_run_job(multi, job, 0);
+	for (i = 0; i < multi->slaves_count; ++i) {
+		snd_pcm_sframes_t f = multi->slaves[i].job_result;
+		if (f < 0)
+			return f;
+		if ((snd_pcm_uframes_t)f < frames)
+			frames = f;
+	}
+	/* Realign the pointers */
+	for (i = 0; i < multi->slaves_count; ++i)
+		multi->slaves[i].job_frames = multi->slaves[i].job_result - frames;
+	snd_pcm_multi_run_job(multi, back_job, 0);
+	for (i = 0; i < multi->slaves_count; ++i) {
+		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
+		if (slave->job_result < 0)
+			return slave->job_result;
+		if ((snd_pcm_uframes_t)slave->job_result != slave->job_frames)
+			return -EIO;
+	}
+	return frames;
+}
+
 static snd_pcm_sframes_t snd_pcm_multi_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
 {
 	snd_pcm_multi_t *multi = pcm->private_data;
 	unsigned int i;
 	snd_pcm_uframes_t pos[multi->slaves_count];
+	if (multi->drift && pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		return 0;
+	if (multi->workers_count)
+		return snd_pcm_multi_move_parallel(multi, frames,
+						   SND_PCM_MULTI_JOB_REWIND,
+						   SND_PCM_MULTI_JOB_FORWARD);
 	memset(pos, 0, sizeof(pos));
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_t *slave_i = multi->slaves[i].pcm;
@@ -626,6 +1325,12 @@ static snd_pcm_sframes_t snd_pcm_multi_forward(snd_pcm_t *pcm, snd_pcm_uframes_t
 	snd_pcm_multi_t *multi = pcm->private_data;
 	unsigned int i;
 	snd_pcm_uframes_t pos[multi->slaves_count];
+	if (multi->drift && pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		return 0;
+	if (multi->workers_count)
+		return snd_pcm_multi_move_parallel(multi, frames,
+						   SND_PCM_MULTI_JOB_FORWARD,
+						   SND_PCM_MULTI_JOB_REWIND);
 	memset(pos, 0, sizeof(pos));
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_t *slave_i = multi->slaves[i].pcm;
@@ -719,13 +1424,25 @@ static snd_pcm_sframes_t snd_pcm_multi_mmap_commit(snd_pcm_t *pcm,
 						   snd_pcm_uframes_t size)
 {
 	snd_pcm_multi_t *multi = pcm->private_data;
-	snd_pcm_t *slave;
 	unsigned int i;
 	snd_pcm_sframes_t result;
 
+	if (multi->workers_count) {
+		for (i = 0; i < multi->slaves_count; ++i)
+			multi->slaves[i].job_frames = size;
+		snd_pcm_multi_run_job(multi, SND_PCM_MULTI_JOB_COMMIT, offset);
+		for (i = 0; i < multi->slaves_count; ++i) {
+			result = multi->slaves[i].job_result;
+			if (result < 0)
+				return result;
+			if ((snd_pcm_uframes_t)result != size)
+				return -EIO;
+		}
+		return size;
+	}
 	for (i = 0; i < multi->slaves_count; ++i) {
-		slave = multi->slaves[i].pcm;
-		result = snd_pcm_mmap_commit(slave, offset, size);
+		result = snd_pcm_multi_slave_commit(&multi->slaves[i],
+						    offset, size);
 		if (result < 0)
 			return result;
 		if ((snd_pcm_uframes_t)result != size)
@@ -736,6 +1453,16 @@ static snd_pcm_sframes_t snd_pcm_multi_mmap_commit(snd_pcm_t *pcm,
 
 static int snd_pcm_multi_munmap(snd_pcm_t *pcm)
 {
+	snd_pcm_multi_t *multi = pcm->private_data;
+	unsigned int i;
+
+	for (i = 0; i < multi->slaves_count; ++i) {
+		snd_pcm_multi_drift_t *drift = multi->slaves[i].drift;
+		if (drift) {
+			free(drift->buffer);
+			drift->buffer = NULL;
+		}
+	}
 	free(pcm->mmap_channels);
 	free(pcm->running_areas);
 	pcm->mmap_channels = NULL;
@@ -743,10 +1470,40 @@ static int snd_pcm_multi_munmap(snd_pcm_t *pcm)
 	return 0;
 }
 
+/* allocate the application side buffers of the drift compensated slaves */
+static int snd_pcm_multi_drift_mmap(snd_pcm_t *pcm)
+{
+	snd_pcm_multi_t *multi = pcm->private_data;
+	unsigned int width = snd_pcm_format_physical_width(pcm->format);
+	unsigned int i, c;
+
+	for (i = 0; i < multi->slaves_count; ++i) {
+		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
+		snd_pcm_multi_drift_t *drift = slave->drift;
+		if (!drift || !drift->compensate)
+			continue;
+		drift->buffer = calloc(pcm->buffer_size,
+				       slave->channels_count * width / 8);
+		if (!drift->buffer)
+			return -ENOMEM;
+		for (c = 0; c < slave->channels_count; ++c) {
+			drift->areas[c].addr = drift->buffer;
+			drift->areas[c].first = c * width;
+			drift->areas[c].step = slave->channels_count * width;
+		}
+		drift->get_idx = snd_pcm_linear_get_index(pcm->format,
+							  SND_PCM_FORMAT_S32);
+		drift->put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S32,
+							  pcm->format);
+	}
+	return 0;
+}
+
 static int snd_pcm_multi_mmap(snd_pcm_t *pcm)
 {
 	snd_pcm_multi_t *multi = pcm->private_data;
 	unsigned int c;
+	int err;
 
 	pcm->mmap_channels = calloc(pcm->channels,
 				    sizeof(pcm->mmap_channels[0]));
@@ -756,15 +1513,34 @@ static int snd_pcm_multi_mmap(snd_pcm_t *pcm)
 		snd_pcm_multi_munmap(pcm);
 		return -ENOMEM;
 	}
+	if (multi->drift) {
+		err = snd_pcm_multi_drift_mmap(pcm);
+		if (err < 0) {
+			snd_pcm_multi_munmap(pcm);
+			return err;
+		}
+	}
 
 	/* Copy the slave mmapped buffer data */
 	for (c = 0; c < pcm->channels; c++) {
 		snd_pcm_multi_channel_t *chan = &multi->channels[c];
+		snd_pcm_multi_drift_t *drift;
 		snd_pcm_t *slave;
 		if (chan->slave_idx < 0) {
 			snd_pcm_multi_munmap(pcm);
 			return -ENXIO;
 		}
+		drift = multi->slaves[chan->slave_idx].drift;
+		if (drift && drift->compensate) {
+			snd_pcm_channel_info_t *info = &pcm->mmap_channels[c];
+			info->channel = c;
+			info->type = SND_PCM_AREA_LOCAL;
+			info->first = drift->areas[chan->slave_channel].first;
+			info->step = drift->areas[chan->slave_channel].step;
+			info->addr = drift->buffer;
+			pcm->running_areas[c] = drift->areas[chan->slave_channel];
+			continue;
+		}
 		slave = multi->slaves[chan->slave_idx].pcm;
 		pcm->mmap_channels[c] =
 			slave->mmap_channels[chan->slave_channel];
@@ -929,6 +1705,44 @@ static void snd_pcm_multi_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
+	if (multi->workers_count)
+		snd_output_printf(out, "  Worker threads: %u\n",
+				  multi->workers_count);
+	snd_output_printf(out, "  Slave timing (calls / avg usec / max usec):\n");
+	for (k = 0; k < multi->slaves_count; ++k) {
+		snd_pcm_multi_slave_t *slave = &multi->slaves[k];
+		snd_pcm_multi_timing_t *c = &slave->commit_timing;
+		snd_pcm_multi_timing_t *a = &slave->avail_timing;
+		snd_output_printf(out, "    %d: commit %llu / %llu / %llu, avail %llu / %llu / %llu\n",
+				  k,
+				  c->count, c->count ? c->total_ns / c->count / 1000 : 0,
+				  c->max_ns / 1000,
+				  a->count, a->count ? a->total_ns / a->count / 1000 : 0,
+				  a->max_ns / 1000);
+	}
+	if (multi->drift) {
+		snd_output_printf(out, "  Slave drift against the master (ppm):\n");
+		for (k = 0; k < multi->slaves_count; ++k) {
+			snd_pcm_multi_drift_t *drift = multi->slaves[k].drift;
+			if (k == multi->master_slave) {
+				snd_output_printf(out, "    %d: master, %.1f Hz\n",
+						  k, drift->rate);
+				continue;
+			}
+			snd_output_printf(out, "    %d: measured %+.1f (min %+.1f, max %+.1f)",
+					  k, (drift->ratio - 1.0) * 1e6,
+					  drift->min_ratio ? (drift->min_ratio - 1.0) * 1e6 : 0,
+					  drift->max_ratio ? (drift->max_ratio - 1.0) * 1e6 : 0);
+			if (drift->compensate)
+				snd_output_printf(out, ", applied %+.1f, delay error %ld, frames in %llu out %llu dropped %llu",
+						  (drift->applied - 1.0) * 1e6,
+						  (long)drift->delay_error,
+						  drift->frames_in,
+						  drift->frames_out,
+						  drift->frames_dropped);
+			snd_output_printf(out, "\n");
+		}
+	}
 	for (k = 0; k < multi->slaves_count; ++k) {
 		snd_output_printf(out, "Slave #%d: ", k);
 		snd_pcm_dump(multi->slaves[k].pcm, out);
@@ -1110,9 +1924,34 @@ pcm.name {
 		}
 	}
 	[master INT]		# Define the master slave
+	[threads INT]		# Worker threads for the slave commit,
+				# avail, reset and rewind paths (default 0)
+	[drift BOOL]		# Compensate the clock drift of the slaves
 }
 \endcode
 
+With \c threads set, the slaves are distributed over a pool of worker
+threads plus the calling thread, so that mmap_commit, avail_update,
+reset, rewind and forward are issued to all slaves concurrently and
+joined before returning.  This helps when many independent slave devices
+(e.g. several USB interfaces) are aggregated and one slow slave would
+otherwise delay all the others.  The value is limited to the number of
+slaves minus one.  The time spent in each slave's commit and avail_update
+calls is shown in the snd_pcm_dump() output.  Without thread support in
+the library the option is ignored.
+
+Normally all slaves are expected to share the same clock.  With \c drift
+enabled, the rate of each slave is measured from its timestamps against
+the master slave over a sliding window of several seconds.  For playback,
+the non-master slaves are then fed through a linear interpolating
+resampler that follows the measured ratio and steers the slave fill level
+back to the master one, so that independent devices without a common
+word clock do not drift apart and xrun.  The channels of these slaves are
+double buffered, the stream cannot be rewound or forwarded and only
+linear formats are accepted.  For capture, the drift is measured only.
+The measured and applied corrections are shown in the snd_pcm_dump()
+output.
+
 For example, to bind two PCM streams with two-channel stereo (hw:0,0 and
 hw:0,1) as one 4-channel stereo PCM stream, define like this:
 \code
@@ -1189,6 +2028,8 @@ int _snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 	unsigned int *channels_schannel = NULL;
 	unsigned int slaves_count = 0;
 	long master_slave = 0;
+	long threads = 0;
+	int drift = 0;
 	unsigned int channels_count = 0;
 	snd_config_for_each(i, inext, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1220,6 +2061,21 @@ int _snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 			}
 			continue;
 		}
+		if (strcmp(id, "drift") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			drift = err;
+			continue;
+		}
+		if (strcmp(id, "threads") == 0) {
+			if (snd_config_get_integer(n, &threads) < 0 ||
+			    threads < 0) {
+				SNDERR("Invalid value for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1369,6 +2225,21 @@ int _snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 				 channels_count,
 				 channels_sidx, channels_schannel,
 				 1);
+	if (err >= 0 && drift) {
+		err = snd_pcm_multi_drift_init(*pcmp, (*pcmp)->private_data);
+		if (err < 0) {
+			snd_pcm_close(*pcmp);
+			goto _free_conf;
+		}
+	}
+	if (err >= 0 && threads > 0) {
+		snd_pcm_multi_t *multi = (*pcmp)->private_data;
+		err = snd_pcm_multi_start_workers(multi, threads);
+		if (err < 0) {
+			snd_pcm_close(*pcmp);
+			goto _free_conf;
+		}
+	}
 _free:
 	if (err < 0) {
 		for (idx = 0; idx < slaves_count; ++idx) {
@@ -1376,6 +2247,7 @@ _free:
 				snd_pcm_close(slaves_pcm[idx]);
 		}
 	}
+_free_conf:
 	if (slaves_conf) {
 		for (idx = 0; idx < slaves_count; ++idx) {
 			if (slaves_conf[idx])
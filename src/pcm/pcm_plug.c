@@ -44,6 +44,37 @@ enum snd_pcm_plug_route_policy {
 	PLUG_ROUTE_POLICY_DUP,
 };
 
+typedef struct {
+	snd_pcm_access_t access;
+	snd_pcm_format_t format;
+	unsigned int channels;
+	unsigned int rate;
+} snd_pcm_plug_params_t;
+
+enum snd_pcm_plug_step_type {
+	PLUG_STEP_FORMAT,
+	PLUG_STEP_ROUTE,
+	PLUG_STEP_RATE,
+};
+
+/* one conversion pass, params are the client side of the pass */
+typedef struct {
+	enum snd_pcm_plug_step_type type;
+	snd_pcm_plug_params_t params;
+} snd_pcm_plug_step_t;
+
+#define PLUG_PLAN_MAX_STEPS	5
+
+/* conversion passes ordered from the slave to the client */
+typedef struct {
+	snd_pcm_plug_params_t slave;
+	unsigned int steps;
+	snd_pcm_plug_step_t step[PLUG_PLAN_MAX_STEPS];
+	unsigned long long cost;	/* touched bits per second, weighted */
+	unsigned int bits;		/* narrowest sample resolution on the way */
+	unsigned int candidates;
+} snd_pcm_plug_plan_t;
+
 typedef struct {
 	snd_pcm_generic_t gen;
 	snd_pcm_t *req_slave;
@@ -55,6 +86,7 @@ typedef struct {
 	snd_pcm_route_ttable_entry_t *ttable;
 	int ttable_ok;
 	unsigned int tt_ssize, tt_cused, tt_sused;
+	snd_pcm_plug_plan_t plan;
 } snd_pcm_plug_t;
 
 #endif
@@ -341,17 +373,9 @@ static void snd_pcm_plug_clear(snd_pcm_t *pcm)
 		pcm->fast_ops = slave->fast_ops;
 		pcm->fast_op_arg = slave->fast_op_arg;
 	}
+	plug->plan.steps = 0;
 }
 
-#ifndef DOC_HIDDEN
-typedef struct {
-	snd_pcm_access_t access;
-	snd_pcm_format_t format;
-	unsigned int channels;
-	unsigned int rate;
-} snd_pcm_plug_params_t;
-#endif
-
 #ifdef BUILD_PCM_PLUGIN_RATE
 static int snd_pcm_plug_change_rate(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_plug_params_t *clt, snd_pcm_plug_params_t *slv)
 {
@@ -620,51 +644,239 @@ static int snd_pcm_plug_change_mmap(snd_pcm_t *pcm, snd_pcm_t **new,
 }
 #endif
 
-static int snd_pcm_plug_insert_plugins(snd_pcm_t *pcm,
-				       snd_pcm_plug_params_t *client,
-				       snd_pcm_plug_params_t *slave)
+/* effective sample resolution of a format */
+static unsigned int snd_pcm_plug_format_bits(snd_pcm_format_t format)
 {
-	snd_pcm_plug_t *plug = pcm->private_data;
-	static int (*const funcs[])(snd_pcm_t *_pcm, snd_pcm_t **new, snd_pcm_plug_params_t *s, snd_pcm_plug_params_t *d) = {
-#ifdef BUILD_PCM_PLUGIN_MMAP_EMUL
-		snd_pcm_plug_change_mmap,
+	if (snd_pcm_format_linear(format) == 1)
+		return snd_pcm_format_width(format);
+	if (snd_pcm_format_float(format) == 1)
+		return snd_pcm_format_width(format) == 64 ? 32 : 24;
+	/* companded formats expand to 16 bits */
+	return 16;
+}
+
+static void snd_pcm_plug_plan_add(snd_pcm_plug_plan_t *plan,
+				  enum snd_pcm_plug_step_type type,
+				  snd_pcm_plug_params_t *cur,
+				  const snd_pcm_plug_params_t *params)
+{
+	/* weight of one touched bit for the pass type */
+	static const unsigned int weight[] = {
+		[PLUG_STEP_FORMAT] = 1,
+		[PLUG_STEP_ROUTE] = 2,
+		[PLUG_STEP_RATE] = 4,
+	};
+	unsigned long long in, out;
+	unsigned int bits;
+
+	assert(plan->steps < PLUG_PLAN_MAX_STEPS);
+	plan->step[plan->steps].type = type;
+	plan->step[plan->steps].params = *params;
+	plan->steps++;
+	in = (unsigned long long)cur->channels * cur->rate *
+		snd_pcm_format_physical_width(cur->format);
+	out = (unsigned long long)params->channels * params->rate *
+		snd_pcm_format_physical_width(params->format);
+	plan->cost += (in + out) * weight[type];
+	bits = snd_pcm_plug_format_bits(params->format);
+	if (bits < plan->bits)
+		plan->bits = bits;
+	*cur = *params;
+}
+
+/*
+ * Build the conversion passes for the given placement of the route pass
+ * (below or above the rate pass) and the linear work format used between
+ * the passes. Linear format changes are done by the route and rate passes
+ * themselves, a separate format pass is used only for the float and
+ * non-linear formats.
+ */
+static int snd_pcm_plug_plan_build(snd_pcm_plug_t *plug,
+				   snd_pcm_plug_plan_t *plan,
+				   const snd_pcm_plug_params_t *client,
+				   const snd_pcm_plug_params_t *slave,
+				   int route_low, snd_pcm_format_t wfmt)
+{
+	snd_pcm_plug_params_t cur = *slave, next;
+	int need_rate = client->rate != slave->rate;
+	int need_route = client->channels != slave->channels || plug->ttable;
+	int clt_linear = snd_pcm_format_linear(client->format) == 1;
+	int slv_linear = snd_pcm_format_linear(slave->format) == 1;
+	int pass, last;
+
+	plan->slave = *slave;
+	plan->steps = 0;
+	plan->cost = 0;
+	plan->bits = snd_pcm_plug_format_bits(slave->format);
+	cur.access = client->access;
+#ifndef BUILD_PCM_PLUGIN_RATE
+	if (need_rate)
+		return -EINVAL;
 #endif
-		snd_pcm_plug_change_format,
+#ifndef BUILD_PCM_PLUGIN_ROUTE
+	if (need_route)
+		return -EINVAL;
+#endif
+	if (!need_rate && !need_route) {
+		if (client->format == slave->format)
+			return 0;
+		if (!clt_linear && !slv_linear) {
+			next = cur;
+			next.format = wfmt;
+			snd_pcm_plug_plan_add(plan, PLUG_STEP_FORMAT, &cur, &next);
+		}
+		snd_pcm_plug_plan_add(plan, PLUG_STEP_FORMAT, &cur, client);
+		return 0;
+	}
+	if (!slv_linear) {
+		next = cur;
+		next.format = wfmt;
+		snd_pcm_plug_plan_add(plan, PLUG_STEP_FORMAT, &cur, &next);
+	}
+	for (pass = 0; pass < 2; pass++) {
+		int route = (pass == 0) == !!route_low;
+		if (route ? !need_route : !need_rate)
+			continue;
+		last = route ? (route_low || !need_rate) : (!route_low || !need_route);
+		next = cur;
+		next.format = last && clt_linear ? client->format : wfmt;
+		if (route)
+			next.channels = client->channels;
+		else
+			next.rate = client->rate;
+		snd_pcm_plug_plan_add(plan, route ? PLUG_STEP_ROUTE : PLUG_STEP_RATE,
+				      &cur, &next);
+	}
+	if (!clt_linear)
+		snd_pcm_plug_plan_add(plan, PLUG_STEP_FORMAT, &cur, client);
+	return 0;
+}
+
+/* prefer lossless plans, then the cheaper ones, then the more precise ones */
+static int snd_pcm_plug_plan_better(const snd_pcm_plug_plan_t *a,
+				    const snd_pcm_plug_plan_t *b,
+				    unsigned int ref_bits)
+{
+	if ((a->bits >= ref_bits) != (b->bits >= ref_bits))
+		return a->bits >= ref_bits;
+	if (a->cost != b->cost)
+		return a->cost < b->cost;
+	return a->bits > b->bits;
+}
+
+static int snd_pcm_plug_plan(snd_pcm_plug_t *plug,
+			     const snd_pcm_plug_params_t *client,
+			     const snd_pcm_plug_params_t *slave)
+{
+	snd_pcm_format_t wfmts[4];
+	snd_pcm_plug_plan_t plan;
+	unsigned int i, nwfmts = 0, ref_bits, candidates = 0;
+	int route_low, found = 0, err;
+
+	wfmts[nwfmts++] = SND_PCM_FORMAT_S16;
+	wfmts[nwfmts++] = SND_PCM_FORMAT_S32;
+	if (snd_pcm_format_linear(client->format) == 1 &&
+	    client->format != SND_PCM_FORMAT_S16 &&
+	    client->format != SND_PCM_FORMAT_S32)
+		wfmts[nwfmts++] = client->format;
+	if (snd_pcm_format_linear(slave->format) == 1 &&
+	    slave->format != SND_PCM_FORMAT_S16 &&
+	    slave->format != SND_PCM_FORMAT_S32 &&
+	    slave->format != client->format)
+		wfmts[nwfmts++] = slave->format;
+	ref_bits = snd_pcm_plug_format_bits(client->format);
+	if (snd_pcm_plug_format_bits(slave->format) < ref_bits)
+		ref_bits = snd_pcm_plug_format_bits(slave->format);
+	for (route_low = 0; route_low < 2; route_low++) {
+		/* the placement of the route pass matters only with a rate pass */
+		if (route_low && (client->rate == slave->rate ||
+				  (client->channels == slave->channels &&
+				   !plug->ttable)))
+			break;
+		for (i = 0; i < nwfmts; i++) {
+			err = snd_pcm_plug_plan_build(plug, &plan, client, slave,
+						      route_low, wfmts[i]);
+			if (err < 0)
+				return err;
+			candidates++;
+			if (!found ||
+			    snd_pcm_plug_plan_better(&plan, &plug->plan, ref_bits)) {
+				plug->plan = plan;
+				found = 1;
+			}
+		}
+	}
+	plug->plan.candidates = candidates;
+	return 0;
+}
+
+static int snd_pcm_plug_insert_step(snd_pcm_t *pcm, snd_pcm_t **new,
+				    snd_pcm_plug_step_t *step,
+				    snd_pcm_plug_params_t *slv)
+{
+	switch (step->type) {
+	case PLUG_STEP_FORMAT:
+		return snd_pcm_plug_change_format(pcm, new, &step->params, slv);
 #ifdef BUILD_PCM_PLUGIN_ROUTE
-		snd_pcm_plug_change_channels,
+	case PLUG_STEP_ROUTE:
+		return snd_pcm_plug_change_channels(pcm, new, &step->params, slv);
 #endif
 #ifdef BUILD_PCM_PLUGIN_RATE
-		snd_pcm_plug_change_rate,
+	case PLUG_STEP_RATE:
+		return snd_pcm_plug_change_rate(pcm, new, &step->params, slv);
 #endif
-#ifdef BUILD_PCM_PLUGIN_ROUTE
-		snd_pcm_plug_change_channels,
-#endif
-		snd_pcm_plug_change_format,
-		snd_pcm_plug_change_access
-	};
+	default:
+		return -EINVAL;
+	}
+}
+
+static int snd_pcm_plug_insert_plugins(snd_pcm_t *pcm,
+				       snd_pcm_plug_params_t *client,
+				       snd_pcm_plug_params_t *slave)
+{
+	snd_pcm_plug_t *plug = pcm->private_data;
 	snd_pcm_plug_params_t p = *slave;
-	unsigned int k = 0;
+	snd_pcm_t *new;
+	unsigned int k;
+	int err;
+
 	plug->ttable_ok = 0;
-	while (client->format != p.format ||
-	       client->channels != p.channels ||
-	       client->rate != p.rate ||
-	       client->access != p.access ||
-	       (plug->ttable && !plug->ttable_ok)) {
-		snd_pcm_t *new;
-		int err;
-		if (k >= sizeof(funcs)/sizeof(*funcs))
-			return -EINVAL;
-		err = funcs[k](pcm, &new, client, &p);
-		if (err < 0) {
-			snd_pcm_plug_clear(pcm);
-			return err;
-		}
-		if (err) {
-			plug->gen.slave = new;
-		}
-		k++;
+	err = snd_pcm_plug_plan(plug, client, slave);
+	if (err < 0)
+		return err;
+#ifdef BUILD_PCM_PLUGIN_MMAP_EMUL
+	err = snd_pcm_plug_change_mmap(pcm, &new, client, &p);
+	if (err < 0)
+		goto _err;
+	if (err)
+		plug->gen.slave = new;
+#endif
+	for (k = 0; k < plug->plan.steps; k++) {
+		err = snd_pcm_plug_insert_step(pcm, &new, &plug->plan.step[k], &p);
+		if (err == 0)
+			err = -EINVAL;
+		if (err < 0)
+			goto _err;
+		plug->gen.slave = new;
+	}
+	if (client->format != p.format ||
+	    client->channels != p.channels ||
+	    client->rate != p.rate ||
+	    (plug->ttable && !plug->ttable_ok)) {
+		err = -EINVAL;
+		goto _err;
+	}
+	if (client->access != p.access) {
+		err = snd_pcm_plug_change_access(pcm, &new, client, &p);
+		if (err < 0)
+			goto _err;
+		plug->gen.slave = new;
 	}
 	return 0;
+
+ _err:
+	snd_pcm_plug_clear(pcm);
+	return err;
 }
 
 static int snd_pcm_plug_hw_refine_cprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t *params)
@@ -1051,8 +1263,28 @@ static int snd_pcm_plug_hw_free(snd_pcm_t *pcm)
 static void snd_pcm_plug_dump(snd_pcm_t *pcm, snd_output_t *out)
 {
 	snd_pcm_plug_t *plug = pcm->private_data;
+	unsigned int k;
+
 	snd_output_printf(out, "Plug PCM: ");
 	snd_pcm_dump(plug->gen.slave, out);
+	if (!plug->plan.steps)
+		return;
+	snd_output_printf(out, "Plug plan: %u passes, cost %llu, %u bits (best of %u candidates)\n",
+			  plug->plan.steps, plug->plan.cost, plug->plan.bits,
+			  plug->plan.candidates);
+	for (k = plug->plan.steps; k-- > 0; ) {
+		static const char *const names[] = {
+			[PLUG_STEP_FORMAT] = "format",
+			[PLUG_STEP_ROUTE] = "route",
+			[PLUG_STEP_RATE] = "rate",
+		};
+		const snd_pcm_plug_params_t *c = &plug->plan.step[k].params;
+		const snd_pcm_plug_params_t *s = k > 0 ? &plug->plan.step[k - 1].params : &plug->plan.slave;
+		snd_output_printf(out, "  %-6s %s %uch %uHz -> %s %uch %uHz\n",
+				  names[plug->plan.step[k].type],
+				  snd_pcm_format_name(c->format), c->channels, c->rate,
+				  snd_pcm_format_name(s->format), s->channels, s->rate);
+	}
 }
 
 static const snd_pcm_ops_t snd_pcm_plug_ops = {
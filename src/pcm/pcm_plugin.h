@@ -89,6 +89,8 @@ snd_pcm_sframes_t snd_pcm_plugin_undo_write_generic
 #define snd_pcm_linear_convert_index	snd1_pcm_linear_convert_index
 #define snd_pcm_linear_convert	snd1_pcm_linear_convert
 #define snd_pcm_linear_getput	snd1_pcm_linear_getput
+#define snd_pcm_linear_kernel	snd1_pcm_linear_kernel
+#define snd_pcm_linear_kernel_areas	snd1_pcm_linear_kernel_areas
 #define snd_pcm_alaw_decode	snd1_pcm_alaw_decode
 #define snd_pcm_alaw_encode	snd1_pcm_alaw_encode
 #define snd_pcm_mulaw_decode	snd1_pcm_mulaw_decode
@@ -108,6 +110,31 @@ void snd_pcm_linear_getput(const snd_pcm_channel_area_t *dst_areas, snd_pcm_ufra
 			   const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
 			   unsigned int channels, snd_pcm_uframes_t frames,
 			   unsigned int get_idx, unsigned int put_idx);
+
+typedef void (*snd_pcm_linear_kernel_func_t)(char *dst, int dst_step,
+					     const char *src, int src_step,
+					     snd_pcm_uframes_t frames);
+typedef struct {
+	snd_pcm_linear_kernel_func_t func;	/* NULL when not available */
+	unsigned int src_width, dst_width;	/* physical widths in bits */
+} snd_pcm_linear_kernel_t;
+
+int snd_pcm_linear_kernel(snd_pcm_linear_kernel_t *kernel,
+			  snd_pcm_format_t src_format, snd_pcm_format_t dst_format);
+void snd_pcm_linear_kernel_areas(const snd_pcm_linear_kernel_t *kernel,
+				 const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+				 const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+				 unsigned int channels, snd_pcm_uframes_t frames);
+int snd_pcm_lfloat_get_s32_index(snd_pcm_format_t format);
+int snd_pcm_lfloat_put_s32_index(snd_pcm_format_t format);
+void snd_pcm_lfloat_convert_integer_float(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+					  const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+					  unsigned int channels, snd_pcm_uframes_t frames,
+					  unsigned int get32idx, unsigned int put32floatidx);
+void snd_pcm_lfloat_convert_float_integer(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+					  const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+					  unsigned int channels, snd_pcm_uframes_t frames,
+					  unsigned int put32idx, unsigned int get32floatidx);
 void snd_pcm_alaw_decode(const snd_pcm_channel_area_t *dst_areas,
 			 snd_pcm_uframes_t dst_offset,
 			 const snd_pcm_channel_area_t *src_areas,
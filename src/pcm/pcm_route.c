@@ -64,6 +64,7 @@ typedef struct {
 	unsigned int get_idx;
 	unsigned int put_idx;
 	unsigned int conv_idx;
+	snd_pcm_linear_kernel_t kernel;
 	int use_getput;
 	unsigned int src_size;
 	snd_pcm_format_t dst_sfmt;
@@ -288,7 +289,12 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 					    frames, ttable, params);
 		return;
 	} else if (nsrcs == 1 && src_tt[0].as_int == SND_PCM_PLUGIN_ROUTE_RESOLUTION) {
-		if (params->use_getput)
+		if (params->kernel.func)
+			snd_pcm_linear_kernel_areas(&params->kernel,
+						    dst_area, dst_offset,
+						    &src_areas[src_tt[0].channel],
+						    src_offset, 1, frames);
+		else if (params->use_getput)
 			snd_pcm_route_convert1_one_getput(dst_area, dst_offset,
 							  src_areas, src_offset,
 							  src_channels,
@@ -572,6 +578,7 @@ static int snd_pcm_route_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	route->params.get_idx = snd_pcm_linear_get_index(src_format, SND_PCM_FORMAT_S32);
 	route->params.put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S32, dst_format);
 	route->params.conv_idx = snd_pcm_linear_convert_index(src_format, dst_format);
+	snd_pcm_linear_kernel(&route->params.kernel, src_format, dst_format);
 	route->params.src_size = snd_pcm_format_width(src_format) / 8;
 	route->params.dst_sfmt = dst_format;
 #if SND_PCM_PLUGIN_ROUTE_FLOAT
@@ -31,6 +31,7 @@
 #include <limits.h>
 #include <unistd.h>
 #include <string.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <math.h>
 #include <sys/socket.h>
@@ -38,6 +39,9 @@
 #include <sys/shm.h>
 #include <pthread.h>
 #include "pcm_local.h"
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
 
 #ifndef PIC
 /* entry for static linking */
@@ -89,8 +93,13 @@ typedef struct {
 	snd_pcm_uframes_t silence_frames;
 	snd_pcm_sw_params_t sw_params;
 	snd_pcm_uframes_t hw_ptr;
+	struct snd_pcm_share **heap[2];	/* clients by position, [0] min, [1] max */
+	unsigned int heap_count[2];
+	unsigned int heap_alloc;
+	int order_valid;
 	int poll[2];
 	int polling;
+	int wakeup;
 	pthread_t thread;
 	pthread_mutex_t mutex;
 #ifdef MUTEX_DEBUG
@@ -99,7 +108,7 @@ typedef struct {
 	pthread_cond_t poll_cond;
 } snd_pcm_share_slave_t;
 
-typedef struct {
+typedef struct snd_pcm_share {
 	struct list_head list;
 	snd_pcm_t *pcm;
 	snd_pcm_share_slave_t *slave;
@@ -110,6 +119,7 @@ typedef struct {
 	snd_pcm_state_t state;
 	snd_pcm_uframes_t hw_ptr;
 	snd_pcm_uframes_t appl_ptr;
+	int heap_pos[2];		/* index in the slave heaps or -1 */
 	int ready;
 	int client_socket;
 	int slave_socket;
@@ -133,42 +143,202 @@ static snd_pcm_uframes_t snd_pcm_share_slave_avail(snd_pcm_share_slave_t *slave)
 	return avail;
 }
 
+/* Frames the client is ahead of the slave appl_ptr */
+static snd_pcm_sframes_t snd_pcm_share_client_frames(snd_pcm_share_slave_t *slave,
+						     snd_pcm_share_t *share)
+{
+	snd_pcm_t *spcm = slave->pcm;
+	snd_pcm_sframes_t frames = share->appl_ptr - *spcm->appl.ptr;
+	if (frames > (snd_pcm_sframes_t)(spcm->boundary / 2))
+		frames -= spcm->boundary;
+	else if (frames < -(snd_pcm_sframes_t)(spcm->boundary / 2))
+		frames += spcm->boundary;
+	return frames;
+}
+
 /* Warning: take the mutex before to call this */
-/* Return number of frames to mmap_commit the slave */
-static snd_pcm_uframes_t _snd_pcm_share_slave_forward(snd_pcm_share_slave_t *slave)
+/* Forget the cached client ordering after a state or pointer change */
+static inline void _snd_pcm_share_invalidate(snd_pcm_share_slave_t *slave)
+{
+	slave->order_valid = 0;
+}
+
+/* Client a is ahead of client b in the heap h (0 = min, 1 = max) */
+static int snd_pcm_share_heap_before(snd_pcm_share_slave_t *slave, int h,
+				     snd_pcm_share_t *a, snd_pcm_share_t *b)
+{
+	snd_pcm_sframes_t diff = snd_pcm_share_client_frames(slave, a) -
+				 snd_pcm_share_client_frames(slave, b);
+	return h ? diff > 0 : diff < 0;
+}
+
+static void snd_pcm_share_heap_set(snd_pcm_share_slave_t *slave, int h,
+				   unsigned int pos, snd_pcm_share_t *share)
+{
+	slave->heap[h][pos] = share;
+	share->heap_pos[h] = pos;
+}
+
+static void snd_pcm_share_heap_up(snd_pcm_share_slave_t *slave, int h,
+				  unsigned int pos)
+{
+	snd_pcm_share_t *share = slave->heap[h][pos];
+	while (pos > 0) {
+		unsigned int parent = (pos - 1) / 2;
+		if (!snd_pcm_share_heap_before(slave, h, share, slave->heap[h][parent]))
+			break;
+		snd_pcm_share_heap_set(slave, h, pos, slave->heap[h][parent]);
+		pos = parent;
+	}
+	snd_pcm_share_heap_set(slave, h, pos, share);
+}
+
+static void snd_pcm_share_heap_down(snd_pcm_share_slave_t *slave, int h,
+				    unsigned int pos)
+{
+	snd_pcm_share_t *share = slave->heap[h][pos];
+	unsigned int count = slave->heap_count[h];
+	for (;;) {
+		unsigned int child = pos * 2 + 1;
+		if (child >= count)
+			break;
+		if (child + 1 < count &&
+		    snd_pcm_share_heap_before(slave, h, slave->heap[h][child + 1],
+					      slave->heap[h][child]))
+			child++;
+		if (!snd_pcm_share_heap_before(slave, h, slave->heap[h][child], share))
+			break;
+		snd_pcm_share_heap_set(slave, h, pos, slave->heap[h][child]);
+		pos = child;
+	}
+	snd_pcm_share_heap_set(slave, h, pos, share);
+}
+
+/* Warning: take the mutex before to call this */
+/* Rebuild the client heaps: running clients by position in the min heap,
+   running and draining playback clients in the max heap */
+static void _snd_pcm_share_order(snd_pcm_share_slave_t *slave)
 {
 	struct list_head *i;
-	snd_pcm_uframes_t buffer_size;
-	snd_pcm_sframes_t frames, safety_frames;
-	snd_pcm_sframes_t min_frames, max_frames;
-	snd_pcm_uframes_t avail, slave_avail;
-	snd_pcm_uframes_t slave_hw_avail;
-	slave_avail = snd_pcm_share_slave_avail(slave);
-	buffer_size = slave->pcm->buffer_size;
-	min_frames = slave_avail;
-	max_frames = 0;
+	unsigned int count = 0, pos;
+	int h;
+
+	list_for_each(i, &slave->clients)
+		count++;
+	if (count > slave->heap_alloc) {
+		for (h = 0; h < 2; h++) {
+			snd_pcm_share_t **heap = realloc(slave->heap[h],
+							 count * sizeof(*heap));
+			if (!heap) {
+				/* forward falls back to a walk of all clients */
+				slave->heap_count[0] = slave->heap_count[1] = 0;
+				return;
+			}
+			slave->heap[h] = heap;
+		}
+		slave->heap_alloc = count;
+	}
+	slave->heap_count[0] = slave->heap_count[1] = 0;
 	list_for_each(i, &slave->clients) {
 		snd_pcm_share_t *share = list_entry(i, snd_pcm_share_t, list);
-		snd_pcm_t *pcm = share->pcm;
+		share->heap_pos[0] = share->heap_pos[1] = -1;
 		switch (share->state) {
 		case SND_PCM_STATE_RUNNING:
+			snd_pcm_share_heap_set(slave, 0, slave->heap_count[0]++, share);
 			break;
 		case SND_PCM_STATE_DRAINING:
-			if (pcm->stream != SND_PCM_STREAM_PLAYBACK)
+			if (share->pcm->stream != SND_PCM_STREAM_PLAYBACK)
 				continue;
 			break;
 		default:
 			continue;
 		}
-		avail = snd_pcm_mmap_avail(pcm);
-		frames = slave_avail - avail;
-		if (frames > max_frames)
+		snd_pcm_share_heap_set(slave, 1, slave->heap_count[1]++, share);
+	}
+	for (h = 0; h < 2; h++)
+		for (pos = slave->heap_count[h] / 2; pos-- > 0; )
+			snd_pcm_share_heap_down(slave, h, pos);
+	slave->order_valid = 1;
+}
+
+/* Warning: take the mutex before to call this */
+/* Find the running client furthest behind and the client furthest ahead
+   by walking all clients, used when the heaps cannot be allocated */
+static void _snd_pcm_share_scan(snd_pcm_share_slave_t *slave,
+				snd_pcm_share_t **min_share,
+				snd_pcm_share_t **max_share)
+{
+	struct list_head *i;
+	snd_pcm_sframes_t frames, min_frames = 0, max_frames = 0;
+	*min_share = NULL;
+	*max_share = NULL;
+	list_for_each(i, &slave->clients) {
+		snd_pcm_share_t *share = list_entry(i, snd_pcm_share_t, list);
+		switch (share->state) {
+		case SND_PCM_STATE_RUNNING:
+			break;
+		case SND_PCM_STATE_DRAINING:
+			if (share->pcm->stream != SND_PCM_STREAM_PLAYBACK)
+				continue;
+			break;
+		default:
+			continue;
+		}
+		frames = snd_pcm_share_client_frames(slave, share);
+		if (!*max_share || frames > max_frames) {
+			*max_share = share;
 			max_frames = frames;
+		}
 		if (share->state != SND_PCM_STATE_RUNNING)
 			continue;
+		if (!*min_share || frames < min_frames) {
+			*min_share = share;
+			min_frames = frames;
+		}
+	}
+}
+
+/* Warning: take the mutex before to call this */
+/* Return number of frames to mmap_commit the slave */
+/* Only the committing client moved forward, so it is just sifted in
+   both heaps: O(log n) per commit. */
+static snd_pcm_uframes_t _snd_pcm_share_slave_forward(snd_pcm_share_slave_t *slave,
+						      snd_pcm_share_t *share)
+{
+	snd_pcm_uframes_t buffer_size;
+	snd_pcm_sframes_t frames, safety_frames;
+	snd_pcm_sframes_t min_frames, max_frames;
+	snd_pcm_uframes_t slave_avail;
+	snd_pcm_uframes_t slave_hw_avail;
+	snd_pcm_share_t *min_share, *max_share;
+	slave_avail = snd_pcm_share_slave_avail(slave);
+	buffer_size = slave->pcm->buffer_size;
+	if (!slave->order_valid) {
+		_snd_pcm_share_order(slave);
+	} else {
+		if (share->heap_pos[0] >= 0)
+			snd_pcm_share_heap_down(slave, 0, share->heap_pos[0]);
+		if (share->heap_pos[1] >= 0)
+			snd_pcm_share_heap_up(slave, 1, share->heap_pos[1]);
+	}
+	if (slave->order_valid) {
+		min_share = slave->heap_count[0] ? slave->heap[0][0] : NULL;
+		max_share = slave->heap_count[1] ? slave->heap[1][0] : NULL;
+	} else {
+		_snd_pcm_share_scan(slave, &min_share, &max_share);
+	}
+	min_frames = slave_avail;
+	max_frames = 0;
+	if (min_share) {
+		frames = snd_pcm_share_client_frames(slave, min_share);
 		if (frames < min_frames)
 			min_frames = frames;
 	}
+	if (max_share) {
+		frames = snd_pcm_share_client_frames(slave, max_share);
+		if (frames > max_frames)
+			max_frames = frames;
+	}
 	if (max_frames == 0)
 		return 0;
 	frames = min_frames;
@@ -351,6 +521,45 @@ static snd_pcm_uframes_t _snd_pcm_share_slave_missing(snd_pcm_share_slave_t *sla
 	return missing;
 }
 
+static int snd_pcm_share_wakeup_open(snd_pcm_share_slave_t *slave)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+	int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd >= 0) {
+		slave->poll[0] = slave->poll[1] = fd;
+		return 0;
+	}
+#endif
+	if (pipe(slave->poll) < 0) {
+		SYSERR("can't create a pipe");
+		return -errno;
+	}
+	fcntl(slave->poll[0], F_SETFL, O_NONBLOCK);
+	fcntl(slave->poll[1], F_SETFL, O_NONBLOCK);
+	return 0;
+}
+
+static void snd_pcm_share_wakeup_close(snd_pcm_share_slave_t *slave)
+{
+	if (slave->poll[1] != slave->poll[0])
+		close(slave->poll[1]);
+	close(slave->poll[0]);
+}
+
+/* Warning: take the mutex before to call this */
+/* Kick the polling thread, at most once per thread cycle */
+static void _snd_pcm_share_wakeup(snd_pcm_share_slave_t *slave)
+{
+	uint64_t val = 1;
+	if (slave->wakeup)
+		return;
+	slave->wakeup = 1;
+	if (slave->poll[1] == slave->poll[0])
+		write(slave->poll[1], &val, sizeof(val));
+	else
+		write(slave->poll[1], &val, 1);
+}
+
 static void *snd_pcm_share_thread(void *data)
 {
 	snd_pcm_share_slave_t *slave = data;
@@ -366,12 +575,6 @@ static void *snd_pcm_share_thread(void *data)
 		return NULL;
 	}
 	Pthread_mutex_lock(&slave->mutex);
-	err = pipe(slave->poll);
-	if (err < 0) {
-		SYSERR("can't create a pipe");
-		Pthread_mutex_unlock(&slave->mutex);
-		return NULL;
-	}
 	while (slave->open_count > 0) {
 		snd_pcm_uframes_t missing;
 		// printf("begin min_missing\n");
@@ -405,8 +608,9 @@ static void *snd_pcm_share_thread(void *data)
 			err = poll(pfd, 2, -1);
 			Pthread_mutex_lock(&slave->mutex);
 			if (pfd[0].revents & POLLIN) {
-				char buf[1];
-				read(pfd[0].fd, buf, 1);
+				uint64_t val;
+				read(pfd[0].fd, &val, sizeof(val));
+				slave->wakeup = 0;
 			}
 		} else {
 			slave->polling = 0;
@@ -444,15 +648,9 @@ static void _snd_pcm_share_update(snd_pcm_t *pcm)
 			avail_min += spcm->buffer_size;
 		if (avail_min < 0)
 			avail_min += spcm->boundary;
-		if ((snd_pcm_uframes_t)avail_min < spcm->avail_min) {
-			int err;
-			snd_pcm_sw_params_set_avail_min(spcm, &slave->sw_params, avail_min);
-			err = snd_pcm_sw_params(spcm, &slave->sw_params);
-			if (err < 0) {
-				SYSERR("snd_pcm_sw_params error");
-				return;
-			}
-		}
+		/* the thread reprograms the slave avail_min itself */
+		if ((snd_pcm_uframes_t)avail_min < spcm->avail_min)
+			_snd_pcm_share_wakeup(slave);
 	}
 }
 
@@ -837,7 +1035,7 @@ static snd_pcm_sframes_t _snd_pcm_share_mmap_commit(snd_pcm_t *pcm,
 	}
 	snd_pcm_mmap_appl_forward(pcm, size);
 	if (share->state == SND_PCM_STATE_RUNNING) {
-		frames = _snd_pcm_share_slave_forward(slave);
+		frames = _snd_pcm_share_slave_forward(slave, share);
 		if (frames > 0) {
 			snd_pcm_sframes_t err;
 			err = snd_pcm_mmap_commit(spcm, snd_pcm_mmap_offset(spcm), frames);
@@ -896,6 +1094,7 @@ static int snd_pcm_share_prepare(snd_pcm_t *pcm)
 	share->hw_ptr = 0;
 	share->appl_ptr = 0;
 	share->state = SND_PCM_STATE_PREPARED;
+	_snd_pcm_share_invalidate(slave);
  _end:
 	Pthread_mutex_unlock(&slave->mutex);
 	return err;
@@ -911,6 +1110,7 @@ static int snd_pcm_share_reset(snd_pcm_t *pcm)
 	snd_pcm_areas_silence(pcm->running_areas, 0, pcm->channels, pcm->buffer_size, pcm->format);
 	share->hw_ptr = *slave->pcm->hw.ptr;
 	share->appl_ptr = share->hw_ptr;
+	_snd_pcm_share_invalidate(slave);
 	Pthread_mutex_unlock(&slave->mutex);
 	return err;
 }
@@ -974,6 +1174,7 @@ static int snd_pcm_share_start(snd_pcm_t *pcm)
 			goto _end;
 	}
 	slave->running_count++;
+	_snd_pcm_share_invalidate(slave);
 	_snd_pcm_share_update(pcm);
 	gettimestamp(&share->trigger_tstamp, pcm->tstamp_type);
  _end:
@@ -1036,6 +1237,7 @@ static snd_pcm_sframes_t _snd_pcm_share_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t
 		frames = ret;
 	}
 	snd_pcm_mmap_appl_backward(pcm, frames);
+	_snd_pcm_share_invalidate(slave);
 	_snd_pcm_share_update(pcm);
 	return n;
 }
@@ -1093,6 +1295,7 @@ static snd_pcm_sframes_t _snd_pcm_share_forward(snd_pcm_t *pcm, snd_pcm_uframes_
 		frames = ret;
 	}
 	snd_pcm_mmap_appl_forward(pcm, frames);
+	_snd_pcm_share_invalidate(slave);
 	_snd_pcm_share_update(pcm);
 	return n;
 }
@@ -1149,6 +1352,7 @@ static void _snd_pcm_share_stop(snd_pcm_t *pcm, snd_pcm_state_t state)
 	share->state = state;
 	slave->prepared_count--;
 	slave->running_count--;
+	_snd_pcm_share_invalidate(slave);
 	if (slave->running_count == 0) {
 		int err = snd_pcm_drop(slave->pcm);
 		assert(err >= 0);
@@ -1181,6 +1385,7 @@ static int snd_pcm_share_drain(snd_pcm_t *pcm)
 		case SND_PCM_STATE_DRAINING:
 		case SND_PCM_STATE_RUNNING:
 			share->state = SND_PCM_STATE_DRAINING;
+			_snd_pcm_share_invalidate(slave);
 			_snd_pcm_share_update(pcm);
 			Pthread_mutex_unlock(&slave->mutex);
 			if (!(pcm->mode & SND_PCM_NONBLOCK))
@@ -1265,13 +1470,17 @@ static int snd_pcm_share_close(snd_pcm_t *pcm)
 		err = pthread_join(slave->thread, 0);
 		assert(err == 0);
 		err = snd_pcm_close(slave->pcm);
+		snd_pcm_share_wakeup_close(slave);
 		pthread_mutex_destroy(&slave->mutex);
 		pthread_cond_destroy(&slave->poll_cond);
 		list_del(&slave->list);
+		free(slave->heap[0]);
+		free(slave->heap[1]);
 		free(slave);
 		list_del(&share->list);
 	} else {
 		list_del(&share->list);
+		_snd_pcm_share_invalidate(slave);
 		Pthread_mutex_unlock(&slave->mutex);
 	}
 	Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
@@ -1492,6 +1701,18 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 		slave->rate = srate;
 		slave->period_time = speriod_time;
 		slave->buffer_time = sbuffer_time;
+		err = snd_pcm_share_wakeup_open(slave);
+		if (err < 0) {
+			Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
+			snd_pcm_close(spcm);
+			free(slave);
+			close(sd[0]);
+			close(sd[1]);
+			snd_pcm_free(pcm);
+			free(share->slave_channels);
+			free(share);
+			return err;
+		}
 		pthread_mutex_init(&slave->mutex, NULL);
 		pthread_cond_init(&slave->poll_cond, NULL);
 		list_add_tail(&slave->list, &snd_pcm_share_slaves);
@@ -54,7 +54,13 @@ const char *_snd_module_pcm_shm = "";
 typedef struct {
 	int socket;
 	volatile snd_pcm_shm_ctrl_t *ctrl;
+	/* device pages shared with the server, NULL/0 when not mapped */
+	volatile struct snd_pcm_mmap_status *mmap_status;
+	int mmap_control;
 } snd_pcm_shm_t;
+
+/* pointers live in the device pages, so the fast path needs no server */
+#define SHM_FAST(shm) ((shm)->mmap_status && (shm)->mmap_control)
 #endif
 
 static long snd_pcm_shm_action_fd0(snd_pcm_t *pcm, int *fd)
@@ -81,10 +87,13 @@ static int snd_pcm_shm_new_rbptr(snd_pcm_t *pcm, snd_pcm_shm_t *shm,
 				 snd_pcm_rbptr_t *rbptr, volatile snd_pcm_shm_rbptr_t *shm_rbptr)
 {
 	if (!shm_rbptr->use_mmap) {
-		if (&pcm->hw == rbptr)
+		if (&pcm->hw == rbptr) {
+			shm->mmap_status = NULL;
 			snd_pcm_set_hw_ptr(pcm, &shm_rbptr->ptr, -1, 0);
-		else
+		} else {
+			shm->mmap_control = 0;
 			snd_pcm_set_appl_ptr(pcm, &shm_rbptr->ptr, -1, 0);
+		}
 	} else {
 		void *ptr;
 		size_t mmap_size, mmap_offset, offset;
@@ -101,10 +110,17 @@ static int snd_pcm_shm_new_rbptr(snd_pcm_t *pcm, snd_pcm_shm_t *shm,
 			SYSERR("shm rbptr mmap failed");
 			return -errno;
 		}
-		if (&pcm->hw == rbptr)
+		if (&pcm->hw == rbptr) {
+			if (shm_rbptr->offset == SNDRV_PCM_MMAP_OFFSET_STATUS +
+			    offsetof(struct snd_pcm_mmap_status, hw_ptr))
+				shm->mmap_status = ptr;
+			else
+				shm->mmap_status = NULL;
 			snd_pcm_set_hw_ptr(pcm, (snd_pcm_uframes_t *)((char *)ptr + offset), fd, shm_rbptr->offset);
-		else
+		} else {
+			shm->mmap_control = shm_rbptr->offset == SNDRV_PCM_MMAP_OFFSET_CONTROL;
 			snd_pcm_set_appl_ptr(pcm, (snd_pcm_uframes_t *)((char *)ptr + offset), fd, shm_rbptr->offset);
+		}
 	}
 	return 0;
 }
@@ -404,6 +420,8 @@ static snd_pcm_state_t snd_pcm_shm_state(snd_pcm_t *pcm)
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	if (SHM_FAST(shm))
+		return (snd_pcm_state_t) shm->mmap_status->state;
 	ctrl->cmd = SND_PCM_IOCTL_STATE;
 	return snd_pcm_shm_action(pcm);
 }
@@ -434,6 +452,20 @@ static snd_pcm_sframes_t snd_pcm_shm_avail_update(snd_pcm_t *pcm)
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
 	int err;
+	if (SHM_FAST(shm)) {
+		snd_pcm_uframes_t avail = snd_pcm_mmap_avail(pcm);
+		switch (shm->mmap_status->state) {
+		case SNDRV_PCM_STATE_RUNNING:
+			/* let the server report the xrun */
+			if (avail >= pcm->stop_threshold)
+				break;
+			/* Fall through */
+		case SNDRV_PCM_STATE_PREPARED:
+			return avail;
+		default:
+			break;
+		}
+	}
 	ctrl->cmd = SND_PCM_IOCTL_AVAIL_UPDATE;
 	err = snd_pcm_shm_action(pcm);
 	if (err < 0)
@@ -550,6 +582,16 @@ static snd_pcm_sframes_t snd_pcm_shm_mmap_commit(snd_pcm_t *pcm,
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	if (SHM_FAST(shm)) {
+		switch (shm->mmap_status->state) {
+		case SNDRV_PCM_STATE_RUNNING:
+		case SNDRV_PCM_STATE_PREPARED:
+			snd_pcm_mmap_appl_forward(pcm, size);
+			return size;
+		default:
+			break;
+		}
+	}
 	ctrl->cmd = SND_PCM_IOCTL_MMAP_COMMIT;
 	ctrl->u.mmap_commit.offset = offset;
 	ctrl->u.mmap_commit.frames = size;
@@ -778,6 +820,10 @@ This plugin communicates with aserver via shared memory. It is a raw
 communication without any conversions, but it can be expected worse
 performance.
 
+When the server PCM is a plain hw device with mmapped status and control
+pages, the client maps the same pages and handles the state, avail_update
+and mmap_commit calls locally without a round-trip to the server.
+
 \code
 pcm.name {
         type shm                # Shared memory PCM
@@ -805,6 +805,29 @@ static int softvol_load_control(snd_pcm_t *pcm, snd_pcm_softvol_t *svol,
 	return 0;
 }
 
+/*
+ * the conversion is done on the place, which is not allowed on a buffer
+ * shared with other handles (zero-copy dsnoop), use an own buffer then
+ */
+static int snd_pcm_softvol_mmap(snd_pcm_t *pcm)
+{
+	snd_pcm_softvol_t *svol = pcm->private_data;
+
+	if (svol->plug.gen.slave->mmap_readonly) {
+		pcm->mmap_shadow = 0;
+		return 0;
+	}
+	return snd_pcm_generic_mmap(pcm);
+}
+
+static int snd_pcm_softvol_munmap(snd_pcm_t *pcm)
+{
+	int err = snd_pcm_generic_munmap(pcm);
+
+	pcm->mmap_shadow = 1;
+	return err;
+}
+
 static const snd_pcm_ops_t snd_pcm_softvol_ops = {
 	.close = snd_pcm_softvol_close,
 	.info = snd_pcm_generic_info,
@@ -816,8 +839,8 @@ static const snd_pcm_ops_t snd_pcm_softvol_ops = {
 	.dump = snd_pcm_softvol_dump,
 	.nonblock = snd_pcm_generic_nonblock,
 	.async = snd_pcm_generic_async,
-	.mmap = snd_pcm_generic_mmap,
-	.munmap = snd_pcm_generic_munmap,
+	.mmap = snd_pcm_softvol_mmap,
+	.munmap = snd_pcm_softvol_munmap,
 	.query_chmaps = snd_pcm_generic_query_chmaps,
 	.get_chmap = snd_pcm_generic_get_chmap,
 	.set_chmap = snd_pcm_generic_set_chmap,
@@ -900,7 +923,7 @@ int snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	/*
 	 * Since the softvol converts on the place, and the format/channels
 	 * must be identical between source and destination, we don't need
-	 * an extra buffer.
+	 * an extra buffer unless the slave buffer is read-only.
 	 */
 	pcm->mmap_shadow = 1;
 	pcm->tstamp_type = slave->tstamp_type;
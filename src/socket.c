@@ -49,7 +49,7 @@ int snd_send_fd(int sock, void *data, size_t len, int fd)
 	struct msghdr msghdr;
 	struct iovec vec;
 
-	vec.iov_base = (void *)&data;
+	vec.iov_base = data;
 	vec.iov_len = len;
 
 	cmsg->cmsg_len = cmsg_len;
@@ -82,7 +82,7 @@ int snd_receive_fd(int sock, void *data, size_t len, int *fd)
 	struct msghdr msghdr;
 	struct iovec vec;
 
-	vec.iov_base = (void *)&data;
+	vec.iov_base = data;
 	vec.iov_len = len;
 
 	cmsg->cmsg_len = cmsg_len;
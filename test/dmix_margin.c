@@ -0,0 +1,145 @@
+/*
+ *  dmix low latency mode test
+ *
+ *  Checks the pointer arithmetic of the safety margin: the jump ahead of
+ *  the estimated hardware pointer, its limit within the slave buffer and
+ *  the amount of mixed data which can be rewound after a jump.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/sem.h>
+/* the helpers are inline in the dmix header */
+#include "../src/pcm/pcm_direct.h"
+
+#define BUFFER		1024
+#define PERIOD		256
+#define SLAVE_BOUNDARY	(BUFFER * 16)
+#define BOUNDARY	(BUFFER * 64)
+
+static int failed;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", \
+			__FILE__, __LINE__, #cond); \
+		failed = 1; \
+	} \
+} while (0)
+
+static void setup(snd_pcm_direct_t *dmix, snd_pcm_uframes_t margin)
+{
+	memset(dmix, 0, sizeof(*dmix));
+	dmix->slave_buffer_size = BUFFER;
+	dmix->slave_period_size = PERIOD;
+	dmix->slave_boundary = SLAVE_BOUNDARY;
+	dmix->safety_margin = margin;
+}
+
+/* what sync_area does with the pointers */
+static void mix(snd_pcm_direct_t *dmix, snd_pcm_uframes_t frames)
+{
+	dmix->last_appl_ptr = (dmix->last_appl_ptr + frames) % BOUNDARY;
+	dmix->slave_appl_ptr = (dmix->slave_appl_ptr + frames) % SLAVE_BOUNDARY;
+}
+
+/* what rewind does with the pointers, returns the frames rewound */
+static snd_pcm_uframes_t rewind_mixed(snd_pcm_direct_t *dmix,
+				      snd_pcm_uframes_t frames)
+{
+	snd_pcm_uframes_t mixed = snd_pcm_direct_margin_mixed(dmix, BOUNDARY);
+
+	if (frames > mixed)
+		frames = mixed;
+	dmix->last_appl_ptr = (dmix->last_appl_ptr + BOUNDARY - frames) % BOUNDARY;
+	dmix->slave_appl_ptr = (dmix->slave_appl_ptr + SLAVE_BOUNDARY - frames) %
+			       SLAVE_BOUNDARY;
+	return frames;
+}
+
+static void test_jump_and_rewind(void)
+{
+	snd_pcm_direct_t dmix;
+
+	setup(&dmix, 128);
+	snd_pcm_direct_margin_check(&dmix, 0);
+	CHECK(dmix.slave_appl_ptr == 128);
+	mix(&dmix, 200);
+	CHECK(snd_pcm_direct_margin_mixed(&dmix, BOUNDARY) == 200);
+
+	/* enough queued, nothing moves */
+	dmix.slave_hw_ptr = 256;
+	snd_pcm_direct_margin_check(&dmix, 200);
+	CHECK(dmix.slave_appl_ptr == 328);
+
+	/* too close to the hardware, jump */
+	snd_pcm_direct_margin_check(&dmix, 300);
+	CHECK(dmix.slave_appl_ptr == 428);
+	CHECK(snd_pcm_direct_margin_mixed(&dmix, BOUNDARY) == 0);
+	mix(&dmix, 50);
+
+	/* only the data mixed after the jump is rewound */
+	CHECK(rewind_mixed(&dmix, 100) == 50);
+	CHECK(dmix.slave_appl_ptr == 428 && dmix.last_appl_ptr == 200);
+	CHECK(rewind_mixed(&dmix, 100) == 0);
+	/* the rewound position is exactly at the margin, no new jump */
+	snd_pcm_direct_margin_check(&dmix, 300);
+	CHECK(dmix.slave_appl_ptr == 428);
+	mix(&dmix, 20);
+	CHECK(snd_pcm_direct_margin_mixed(&dmix, BOUNDARY) == 20);
+
+	/* behind the hardware pointer, jump */
+	dmix.slave_hw_ptr = 768;
+	snd_pcm_direct_margin_check(&dmix, 800);
+	CHECK(dmix.slave_appl_ptr == 928);
+	CHECK(snd_pcm_direct_margin_mixed(&dmix, BOUNDARY) == 0);
+}
+
+static void test_cap(void)
+{
+	snd_pcm_direct_t dmix;
+
+	/* the estimate is a period ahead, the margin would overrun */
+	setup(&dmix, 900);
+	dmix.slave_hw_ptr = 256;
+	dmix.slave_appl_ptr = 256;
+	snd_pcm_direct_margin_check(&dmix, 512);
+	CHECK(dmix.slave_appl_ptr == 256 + BUFFER - PERIOD);
+
+	/* already at the limit, the rewindable data is kept */
+	mix(&dmix, 10);
+	dmix.slave_appl_ptr = 256 + BUFFER - PERIOD;
+	snd_pcm_direct_margin_check(&dmix, 512);
+	CHECK(dmix.slave_appl_ptr == 256 + BUFFER - PERIOD);
+	CHECK(snd_pcm_direct_margin_mixed(&dmix, BOUNDARY) == 10);
+
+	/* across the boundary */
+	setup(&dmix, 900);
+	dmix.slave_hw_ptr = SLAVE_BOUNDARY - 100;
+	dmix.slave_appl_ptr = SLAVE_BOUNDARY - 100;
+	snd_pcm_direct_margin_check(&dmix, SLAVE_BOUNDARY - 50);
+	CHECK(dmix.slave_appl_ptr == BUFFER - PERIOD - 100);
+}
+
+int main(void)
+{
+	test_jump_and_rewind();
+	test_cap();
+	return failed;
+}
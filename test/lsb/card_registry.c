@@ -0,0 +1,288 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include "test.h"
+
+/*
+ * The registry watches and probes this directory instead of /dev/snd.
+ * Its control nodes are regular files holding the card id, the card
+ * info ioctl on them is answered below instead of by a driver.
+ */
+static char dir[] = "/tmp/alsa-card-registry-XXXXXX";
+static int probes;
+
+static int fake_card_info(int fd, int card, void *arg)
+{
+	char id[16];
+	ssize_t len;
+
+	len = pread(fd, id, sizeof(id) - 1, 0);
+	if (len < 0)
+		return -1;
+	id[len] = '\0';
+	memset(arg, 0, snd_ctl_card_info_sizeof());
+	/* struct snd_ctl_card_info starts with card, a pad and id[16] */
+	*(int *)arg = card;
+	strcpy((char *)arg + 2 * sizeof(int), id);
+	probes++;
+	return 0;
+}
+
+int ioctl(int fd, unsigned long request, ...)
+{
+	char link[32], path[256];
+	va_list ap;
+	void *arg;
+	ssize_t len;
+	int card;
+
+	va_start(ap, request);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+	if (request == _IOC(_IOC_READ, 'U', 0x01, snd_ctl_card_info_sizeof())) {
+		sprintf(link, "/proc/self/fd/%d", fd);
+		len = readlink(link, path, sizeof(path) - 1);
+		if (len > 0) {
+			path[len] = '\0';
+			if (!strncmp(path, dir, strlen(dir)) &&
+			    sscanf(path + strlen(dir), "/controlC%i", &card) == 1)
+				return fake_card_info(fd, card, arg);
+		}
+	}
+	return syscall(SYS_ioctl, fd, request, arg);
+}
+
+static void create_card(int card, const char *id)
+{
+	char path[sizeof(dir) + 32];
+	int fd;
+
+	sprintf(path, "%s/controlC%i", dir, card);
+	fd = open(path, O_WRONLY | O_CREAT, 0644);
+	TEST_CHECK(fd >= 0);
+	if (fd < 0)
+		return;
+	TEST_CHECK(write(fd, id, strlen(id)) == (ssize_t)strlen(id));
+	close(fd);
+}
+
+static void create_file(const char *name)
+{
+	char path[sizeof(dir) + 32];
+	int fd;
+
+	sprintf(path, "%s/%s", dir, name);
+	fd = open(path, O_WRONLY | O_CREAT, 0644);
+	TEST_CHECK(fd >= 0);
+	if (fd >= 0)
+		close(fd);
+}
+
+static void remove_file(const char *name)
+{
+	char path[sizeof(dir) + 32];
+
+	sprintf(path, "%s/%s", dir, name);
+	TEST_CHECK(unlink(path) == 0);
+}
+
+static void remove_card(int card)
+{
+	char name[32];
+
+	sprintf(name, "controlC%i", card);
+	remove_file(name);
+}
+
+static int readable(int fd)
+{
+	struct pollfd pfd;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+static int count_fds(void)
+{
+	DIR *d = opendir("/proc/self/fd");
+	int count = 0;
+
+	if (!d)
+		return -1;
+	while (readdir(d))
+		count++;
+	closedir(d);
+	return count;
+}
+
+static int changes, changed_card, changed_present;
+
+static void card_changed(int card, int present, void *private_data)
+{
+	TEST_CHECK(private_data == dir);
+	changes++;
+	changed_card = card;
+	changed_present = present;
+}
+
+/* the card functions alone do not set up the registry */
+static void test_opt_in(void)
+{
+	int fds, card = -1;
+
+	fds = count_fds();
+	ALSA_CHECK(snd_card_next(&card));
+	TEST_CHECK(count_fds() == fds);
+}
+
+/* the cards present when the registry is first used are not reported */
+static void test_initial_cards(void)
+{
+	TEST_CHECK(snd_card_registry_handle_events() == 0);
+	TEST_CHECK(snd_card_get_index("Zero") == 0);
+}
+
+static void test_events(void)
+{
+	int fd, n;
+
+	ALSA_CHECK(snd_card_registry_set_callback(card_changed, dir));
+	fd = ALSA_CHECK(snd_card_registry_poll_descriptor());
+	if (fd < 0)
+		return;
+	TEST_CHECK(!readable(fd));
+
+	create_card(3, "Three");
+	TEST_CHECK(readable(fd));
+	changes = 0;
+	TEST_CHECK(snd_card_registry_handle_events() == 1);
+	TEST_CHECK(changes == 1 && changed_card == 3 && changed_present);
+	TEST_CHECK(!readable(fd));
+
+	/* served from the registry */
+	n = probes;
+	TEST_CHECK(snd_card_get_index("Three") == 3);
+	TEST_CHECK(snd_card_get_index("3") == 3);
+	TEST_CHECK(probes == n);
+
+	/* other nodes do not invalidate the cards */
+	create_file("pcmC3D0p");
+	TEST_CHECK(readable(fd));
+	changes = 0;
+	TEST_CHECK(snd_card_registry_handle_events() == 0);
+	TEST_CHECK(changes == 0);
+	TEST_CHECK(probes == n);
+	remove_file("pcmC3D0p");
+
+	remove_card(3);
+	changes = 0;
+	TEST_CHECK(snd_card_registry_handle_events() == 1);
+	TEST_CHECK(changes == 1 && changed_card == 3 && !changed_present);
+	TEST_CHECK(snd_card_get_index("3") == -ENOENT);
+}
+
+/* the child watches on its own and does not steal the parent's events */
+static void test_fork(void)
+{
+	pid_t pid;
+	int status;
+
+	pid = fork();
+	TEST_CHECK(pid >= 0);
+	if (pid < 0)
+		return;
+	if (pid == 0) {
+		create_card(4, "Four");
+		_exit(snd_card_registry_handle_events() == 1 &&
+		      snd_card_get_index("Four") == 4 ? 0 : 1);
+	}
+	TEST_CHECK(waitpid(pid, &status, 0) == pid);
+	TEST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	changes = 0;
+	TEST_CHECK(snd_card_registry_handle_events() == 1);
+	TEST_CHECK(changes == 1 && changed_card == 4 && changed_present);
+	remove_card(4);
+	TEST_CHECK(snd_card_registry_handle_events() == 1);
+}
+
+static void test_directory_removal(void)
+{
+	int fd;
+
+	remove_card(0);
+	TEST_CHECK(rmdir(dir) == 0);
+	TEST_CHECK(snd_card_registry_handle_events() == -ENOENT);
+	TEST_CHECK(snd_card_registry_poll_descriptor() == -ENOENT);
+
+	TEST_CHECK(mkdir(dir, 0755) == 0);
+	create_card(1, "One");
+	fd = ALSA_CHECK(snd_card_registry_poll_descriptor());
+	if (fd < 0)
+		return;
+	/* card 0 is gone and card 1 appeared meanwhile */
+	changes = 0;
+	TEST_CHECK(snd_card_registry_handle_events() == 2);
+	TEST_CHECK(changes == 2);
+	TEST_CHECK(snd_card_get_index("One") == 1);
+}
+
+static void test_cleanup(void)
+{
+	int fd;
+
+	fd = ALSA_CHECK(snd_card_registry_poll_descriptor());
+	if (fd < 0)
+		return;
+	ALSA_CHECK(snd_config_update_free_global());
+	/* the inotify instance is released */
+	TEST_CHECK(fcntl(fd, F_GETFD) < 0 && errno == EBADF);
+	fd = ALSA_CHECK(snd_card_registry_poll_descriptor());
+	if (fd < 0)
+		return;
+	remove_card(1);
+	TEST_CHECK(readable(fd));
+	changes = 0;
+	TEST_CHECK(snd_card_registry_handle_events() == 1);
+	TEST_CHECK(changes == 1 && changed_card == 1 && !changed_present);
+	ALSA_CHECK(snd_config_update_free_global());
+}
+
+int main(void)
+{
+	int err;
+
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	setenv("LIBASOUND_CARD_REGISTRY_DIR", dir, 1);
+
+	test_opt_in();
+
+	create_card(0, "Zero");
+	err = snd_card_registry_poll_descriptor();
+	if (err == -ENOSYS) {
+		/* no inotify, skip */
+		remove_card(0);
+		rmdir(dir);
+		return 77;
+	}
+	test_initial_cards();
+	test_events();
+	test_fork();
+	test_directory_removal();
+	test_cleanup();
+
+	rmdir(dir);
+	return TEST_EXIT_CODE();
+}
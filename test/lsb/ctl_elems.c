@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "fake_ctl.h"
+
+static struct fake_ctl fc;
+static snd_ctl_t *ctl;
+
+static snd_ctl_elem_value_t *new_value(struct fake_elem *e, long value)
+{
+	snd_ctl_elem_value_t *v;
+	unsigned int i;
+
+	if (snd_ctl_elem_value_malloc(&v) < 0)
+		exit(1);
+	snd_ctl_elem_value_set_interface(v, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_value_set_name(v, e->name);
+	for (i = 0; i < e->count; i++)
+		snd_ctl_elem_value_set_integer(v, i, value);
+	return v;
+}
+
+static void free_values(snd_ctl_elem_value_t **v, unsigned int count)
+{
+	while (count--)
+		snd_ctl_elem_value_free(v[count]);
+}
+
+static void test_read(void)
+{
+	struct fake_elem *a, *b, *c;
+	snd_ctl_elem_value_t *v[3];
+
+	a = fake_ctl_add(&fc, "Read A", SND_CTL_ELEM_TYPE_INTEGER, 2, 0, 100);
+	b = fake_ctl_add(&fc, "Read B", SND_CTL_ELEM_TYPE_INTEGER, 1, 0, 100);
+	c = fake_ctl_add(&fc, "Read C", SND_CTL_ELEM_TYPE_INTEGER, 1, 0, 100);
+	a->value[0] = 1;
+	a->value[1] = 2;
+	b->value[0] = 3;
+	c->value[0] = 4;
+	v[0] = new_value(a, 0);
+	v[1] = new_value(b, 0);
+	v[2] = new_value(c, 0);
+
+	TEST_CHECK(snd_ctl_elems_read(ctl, v, 3) == 3);
+	TEST_CHECK(snd_ctl_elem_value_get_integer(v[0], 1) == 2);
+	TEST_CHECK(snd_ctl_elem_value_get_integer(v[2], 0) == 4);
+
+	/* the count up to the failing element, then its error */
+	b->access = SND_CTL_EXT_ACCESS_WRITE;
+	TEST_CHECK(snd_ctl_elems_read(ctl, v, 3) == 1);
+	TEST_CHECK(snd_ctl_elems_read(ctl, v + 1, 2) == -EPERM);
+	b->access = SND_CTL_EXT_ACCESS_READWRITE;
+	TEST_CHECK(snd_ctl_elems_read(ctl, v, 0) == 0);
+	free_values(v, 3);
+}
+
+static void test_write_partial(void)
+{
+	struct fake_elem *a, *b, *c;
+	snd_ctl_elem_value_t *v[3];
+
+	a = fake_ctl_add(&fc, "Partial A", SND_CTL_ELEM_TYPE_INTEGER, 1, 0, 100);
+	b = fake_ctl_add(&fc, "Partial B", SND_CTL_ELEM_TYPE_INTEGER, 1, 0, 100);
+	c = fake_ctl_add(&fc, "Partial C", SND_CTL_ELEM_TYPE_INTEGER, 1, 0, 100);
+	v[0] = new_value(a, 10);
+	v[1] = new_value(b, 20);
+	v[2] = new_value(c, 30);
+
+	b->fail_write = -EIO;
+	TEST_CHECK(snd_ctl_elems_write(ctl, v, 3, 0) == 1);
+	TEST_CHECK(a->value[0] == 10 && b->value[0] == 0 && c->value[0] == 0);
+	b->fail_write = -EIO;
+	TEST_CHECK(snd_ctl_elems_write(ctl, v + 1, 2, 0) == -EIO);
+	TEST_CHECK(snd_ctl_elems_write(ctl, v + 1, 2, 0) == 2);
+	TEST_CHECK(b->value[0] == 20 && c->value[0] == 30);
+	free_values(v, 3);
+}
+
+static void test_write_atomic(void)
+{
+	struct fake_elem *a, *wo, *vol, *b, *c;
+	snd_ctl_elem_value_t *v[5];
+
+	a = fake_ctl_add(&fc, "Atomic A", SND_CTL_ELEM_TYPE_INTEGER, 2, 0, 100);
+	wo = fake_ctl_add(&fc, "Atomic Write Only", SND_CTL_ELEM_TYPE_INTEGER, 1, 0, 100);
+	wo->access = SND_CTL_EXT_ACCESS_WRITE;
+	vol = fake_ctl_add(&fc, "Atomic Volatile", SND_CTL_ELEM_TYPE_INTEGER, 1, 0, 100);
+	vol->access |= SND_CTL_EXT_ACCESS_VOLATILE;
+	b = fake_ctl_add(&fc, "Atomic B", SND_CTL_ELEM_TYPE_INTEGER, 1, 0, 100);
+	c = fake_ctl_add(&fc, "Atomic C", SND_CTL_ELEM_TYPE_INTEGER, 1, 0, 100);
+	a->value[0] = a->value[1] = 1;
+	vol->value[0] = 2;
+	b->value[0] = 3;
+	c->value[0] = 4;
+	v[0] = new_value(a, 50);
+	v[1] = new_value(wo, 51);
+	v[2] = new_value(vol, 52);
+	v[3] = new_value(b, 53);
+	v[4] = new_value(c, 54);
+
+	/* the write-only element does not prevent the save */
+	TEST_CHECK(snd_ctl_elems_write(ctl, v, 5, SND_CTL_ELEMS_ATOMIC) == 5);
+	TEST_CHECK(a->value[1] == 50 && wo->value[0] == 51 &&
+		   c->value[0] == 54);
+
+	/* roll back the written elements, except the unsaved ones */
+	snd_ctl_elem_value_set_integer(v[0], 0, 60);
+	snd_ctl_elem_value_set_integer(v[0], 1, 61);
+	snd_ctl_elem_value_set_integer(v[1], 0, 62);
+	snd_ctl_elem_value_set_integer(v[2], 0, 63);
+	snd_ctl_elem_value_set_integer(v[3], 0, 64);
+	snd_ctl_elem_value_set_integer(v[4], 0, 65);
+	c->fail_write = -EBUSY;
+	a->writes = b->writes = c->writes = 0;
+	TEST_CHECK(snd_ctl_elems_write(ctl, v, 5, SND_CTL_ELEMS_ATOMIC) == -EBUSY);
+	TEST_CHECK(a->value[0] == 50 && a->value[1] == 50);
+	TEST_CHECK(a->writes == 2);
+	TEST_CHECK(wo->value[0] == 62);
+	TEST_CHECK(vol->value[0] == 63);
+	TEST_CHECK(b->value[0] == 53 && b->writes == 2);
+	TEST_CHECK(c->value[0] == 54 && c->writes == 0);
+
+	/* nothing was written, nothing to restore */
+	a->fail_write = -EBUSY;
+	a->writes = 0;
+	TEST_CHECK(snd_ctl_elems_write(ctl, v, 5, SND_CTL_ELEMS_ATOMIC) == -EBUSY);
+	TEST_CHECK(a->value[0] == 50 && a->writes == 0);
+	free_values(v, 5);
+}
+
+int main(void)
+{
+	if (ALSA_CHECK(fake_ctl_open(&fc, &ctl)) < 0)
+		return 1;
+	test_read();
+	test_write_partial();
+	test_write_atomic();
+	snd_ctl_close(ctl);
+	return TEST_EXIT_CODE();
+}
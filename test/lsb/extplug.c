@@ -0,0 +1,221 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include <alsa/pcm_extplug.h>
+
+#define BUFFER		64
+#define PERIOD		16
+
+/*
+ * An in-process filter plugin over a null slave, which doubles the
+ * samples and records the areas its transfer callback gets.
+ */
+struct fake_ext {
+	snd_pcm_extplug_t ext;
+	unsigned int transfers;
+	unsigned int inplace;		/* calls with the same src and dst */
+	const void *src_addr, *dst_addr;
+	unsigned int src_step, dst_step;
+	short first_sample;		/* first source sample of the last call */
+};
+
+static short *sample_ptr(const snd_pcm_channel_area_t *area,
+			 snd_pcm_uframes_t ofs)
+{
+	return (short *)((char *)area->addr +
+			 (area->first + ofs * area->step) / 8);
+}
+
+static snd_pcm_sframes_t fake_transfer(snd_pcm_extplug_t *ext,
+				       const snd_pcm_channel_area_t *dst_areas,
+				       snd_pcm_uframes_t dst_offset,
+				       const snd_pcm_channel_area_t *src_areas,
+				       snd_pcm_uframes_t src_offset,
+				       snd_pcm_uframes_t size)
+{
+	struct fake_ext *fe = ext->private_data;
+	snd_pcm_uframes_t i;
+	unsigned int c;
+
+	fe->transfers++;
+	if (src_areas == dst_areas && src_offset == dst_offset)
+		fe->inplace++;
+	fe->src_addr = src_areas[0].addr;
+	fe->dst_addr = dst_areas[0].addr;
+	fe->src_step = src_areas[0].step;
+	fe->dst_step = dst_areas[0].step;
+	fe->first_sample = *sample_ptr(&src_areas[0], src_offset);
+	for (c = 0; c < ext->channels; c++)
+		for (i = 0; i < size; i++)
+			*sample_ptr(&dst_areas[c], dst_offset + i) =
+				*sample_ptr(&src_areas[c], src_offset + i) * 2;
+	return size;
+}
+
+static const snd_pcm_extplug_callback_t fake_callback = {
+	.transfer = fake_transfer,
+};
+
+static snd_pcm_t *fake_open(struct fake_ext *fe, unsigned int flags,
+			    snd_pcm_access_t access, unsigned int channels)
+{
+	static const unsigned int formats[] = { SND_PCM_FORMAT_S16 };
+	snd_config_t *root, *slave;
+	snd_pcm_hw_params_t *hw;
+	snd_input_t *in;
+	snd_pcm_t *pcm;
+	int err;
+
+	memset(fe, 0, sizeof(*fe));
+	fe->ext.version = SND_PCM_EXTPLUG_VERSION;
+	fe->ext.name = "Fake filter plugin";
+	fe->ext.callback = &fake_callback;
+	fe->ext.private_data = fe;
+	fe->ext.flags = flags;
+
+	ALSA_CHECK(snd_config_top(&root));
+	ALSA_CHECK(snd_input_buffer_open(&in, "slave.pcm { type null }", -1));
+	ALSA_CHECK(snd_config_load(root, in));
+	snd_input_close(in);
+	ALSA_CHECK(snd_config_search(root, "slave", &slave));
+	err = ALSA_CHECK(snd_pcm_extplug_create(&fe->ext, "fake", root, slave,
+						SND_PCM_STREAM_PLAYBACK, 0));
+	snd_config_delete(root);
+	if (err < 0)
+		return NULL;
+	pcm = fe->ext.pcm;
+	snd_pcm_extplug_set_param_list(&fe->ext, SND_PCM_EXTPLUG_HW_FORMAT,
+				       1, formats);
+	snd_pcm_extplug_set_slave_param_list(&fe->ext, SND_PCM_EXTPLUG_HW_FORMAT,
+					     1, formats);
+
+	snd_pcm_hw_params_alloca(&hw);
+	ALSA_CHECK(snd_pcm_hw_params_any(pcm, hw));
+	err = snd_pcm_hw_params_set_access(pcm, hw, access);
+	ALSA_CHECK(snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16));
+	ALSA_CHECK(snd_pcm_hw_params_set_channels(pcm, hw, channels));
+	ALSA_CHECK(snd_pcm_hw_params_set_rate(pcm, hw, 48000, 0));
+	ALSA_CHECK(snd_pcm_hw_params_set_period_size(pcm, hw, PERIOD, 0));
+	ALSA_CHECK(snd_pcm_hw_params_set_buffer_size(pcm, hw, BUFFER));
+	if (err < 0 || ALSA_CHECK(snd_pcm_hw_params(pcm, hw)) < 0) {
+		snd_pcm_close(pcm);
+		return NULL;
+	}
+	return pcm;
+}
+
+/* fill the frames from mmap_begin, commit them, return the areas */
+static const snd_pcm_channel_area_t *mmap_write(snd_pcm_t *pcm,
+						unsigned int channels,
+						snd_pcm_uframes_t frames)
+{
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset, i;
+	unsigned int c;
+
+	if (ALSA_CHECK(snd_pcm_mmap_begin(pcm, &areas, &offset, &frames)) < 0)
+		return NULL;
+	for (c = 0; c < channels; c++)
+		for (i = 0; i < frames; i++)
+			*sample_ptr(&areas[c], offset + i) = 100 + c * 1000 + i;
+	TEST_CHECK(snd_pcm_mmap_commit(pcm, offset, frames) ==
+		   (snd_pcm_sframes_t)frames);
+	return areas;
+}
+
+/* matching format and channels: transfer runs on the slave buffer */
+static void test_inplace(void)
+{
+	const snd_pcm_channel_area_t *areas;
+	struct fake_ext fe;
+	short buf[PERIOD * 2];
+	snd_pcm_t *pcm;
+	unsigned int i;
+
+	pcm = fake_open(&fe, SND_PCM_EXTPLUG_FLAG_INPLACE,
+			SND_PCM_ACCESS_MMAP_INTERLEAVED, 2);
+	if (!pcm)
+		return;
+	areas = mmap_write(pcm, 2, PERIOD);
+	TEST_CHECK(fe.transfers == 1 && fe.inplace == 1);
+	/* the client maps the slave buffer itself */
+	TEST_CHECK(areas && areas[0].addr == fe.dst_addr);
+	TEST_CHECK(fe.first_sample == 100);
+	snd_pcm_close(pcm);
+
+	/* written data is copied into the slave buffer first */
+	pcm = fake_open(&fe, SND_PCM_EXTPLUG_FLAG_INPLACE,
+			SND_PCM_ACCESS_RW_INTERLEAVED, 2);
+	if (!pcm)
+		return;
+	for (i = 0; i < PERIOD * 2; i++)
+		buf[i] = 500 + i;
+	TEST_CHECK(snd_pcm_writei(pcm, buf, PERIOD) == PERIOD);
+	TEST_CHECK(fe.transfers == 1 && fe.inplace == 1);
+	TEST_CHECK(fe.src_addr != buf && fe.first_sample == 500);
+	snd_pcm_close(pcm);
+
+	/* a mono interleaved slave is planar, too */
+	pcm = fake_open(&fe, SND_PCM_EXTPLUG_FLAG_INPLACE |
+			SND_PCM_EXTPLUG_FLAG_PLANAR,
+			SND_PCM_ACCESS_MMAP_NONINTERLEAVED, 1);
+	if (!pcm)
+		return;
+	mmap_write(pcm, 1, PERIOD);
+	TEST_CHECK(fe.transfers == 1 && fe.inplace == 1);
+	snd_pcm_close(pcm);
+}
+
+/* an interleaved slave does not fit a planar plugin: own aligned planes */
+static void test_fallback(void)
+{
+	const snd_pcm_channel_area_t *areas;
+	struct fake_ext fe;
+	snd_pcm_t *pcm;
+	unsigned int c;
+
+	pcm = fake_open(&fe, SND_PCM_EXTPLUG_FLAG_INPLACE |
+			SND_PCM_EXTPLUG_FLAG_PLANAR |
+			SND_PCM_EXTPLUG_FLAG_ALIGNED,
+			SND_PCM_ACCESS_MMAP_NONINTERLEAVED, 2);
+	if (!pcm)
+		return;
+	areas = mmap_write(pcm, 2, PERIOD);
+	if (!areas)
+		goto out;
+	for (c = 0; c < 2; c++) {
+		TEST_CHECK((unsigned long)areas[c].addr %
+			   SND_PCM_EXTPLUG_ALIGN == 0);
+		TEST_CHECK(areas[c].first == 0 && areas[c].step == 16);
+	}
+	TEST_CHECK(areas[0].addr != areas[1].addr);
+	TEST_CHECK(fe.transfers == 1 && fe.inplace == 0);
+	TEST_CHECK(fe.src_addr == areas[0].addr && fe.src_step == 16);
+	TEST_CHECK(fe.dst_addr != fe.src_addr && fe.dst_step == 32);
+	TEST_CHECK(fe.first_sample == 100);
+ out:
+	snd_pcm_close(pcm);
+
+	/* a planar plugin has no interleaved client access */
+	TEST_CHECK(fake_open(&fe, SND_PCM_EXTPLUG_FLAG_PLANAR,
+			     SND_PCM_ACCESS_RW_INTERLEAVED, 2) == NULL);
+
+	/* aligned only: an interleaved buffer of its own */
+	pcm = fake_open(&fe, SND_PCM_EXTPLUG_FLAG_ALIGNED,
+			SND_PCM_ACCESS_MMAP_INTERLEAVED, 2);
+	if (!pcm)
+		return;
+	areas = mmap_write(pcm, 2, PERIOD);
+	if (areas)
+		TEST_CHECK((unsigned long)areas[0].addr %
+			   SND_PCM_EXTPLUG_ALIGN == 0);
+	TEST_CHECK(fe.transfers == 1 && fe.inplace == 0);
+	snd_pcm_close(pcm);
+}
+
+int main(void)
+{
+	test_inplace();
+	test_fallback();
+	return TEST_EXIT_CODE();
+}
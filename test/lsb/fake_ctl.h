@@ -0,0 +1,228 @@
+/*
+ * An in-process control device built on the external control plugin
+ * interface, so that the control, hcontrol and mixer layers can be
+ * tested without a sound card.
+ */
+#ifndef FAKE_CTL_H
+#define FAKE_CTL_H
+
+#include <string.h>
+#include <errno.h>
+#include <alsa/asoundlib.h>
+#include <alsa/control_external.h>
+
+#define FAKE_CTL_ELEMS		32
+#define FAKE_CTL_EVENTS		128
+
+struct fake_elem {
+	char name[44];
+	int type;		/* SND_CTL_ELEM_TYPE_INTEGER or _BOOLEAN */
+	unsigned int access;
+	unsigned int count;
+	long min, max;
+	long value[4];
+	int present;
+	int fail_write;		/* error returned by the next write */
+	unsigned int reads, writes;
+};
+
+struct fake_ctl {
+	snd_ctl_ext_t ext;
+	struct fake_elem elems[FAKE_CTL_ELEMS];
+	unsigned int nelems;
+	struct {
+		const char *name;
+		unsigned int mask;
+	} events[FAKE_CTL_EVENTS];
+	unsigned int head, tail;
+};
+
+static struct fake_elem *fake_ctl_nth(struct fake_ctl *fc, unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < fc->nelems; i++) {
+		if (fc->elems[i].present && n-- == 0)
+			return &fc->elems[i];
+	}
+	return NULL;
+}
+
+static int fake_ctl_elem_count(snd_ctl_ext_t *ext)
+{
+	struct fake_ctl *fc = ext->private_data;
+	unsigned int i;
+	int count = 0;
+
+	for (i = 0; i < fc->nelems; i++)
+		count += fc->elems[i].present;
+	return count;
+}
+
+static int fake_ctl_elem_list(snd_ctl_ext_t *ext, unsigned int offset,
+			      snd_ctl_elem_id_t *id)
+{
+	struct fake_elem *e = fake_ctl_nth(ext->private_data, offset);
+
+	if (!e)
+		return -EINVAL;
+	snd_ctl_elem_id_set_interface(id, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name(id, e->name);
+	return 0;
+}
+
+static snd_ctl_ext_key_t fake_ctl_find_elem(snd_ctl_ext_t *ext,
+					    const snd_ctl_elem_id_t *id)
+{
+	struct fake_ctl *fc = ext->private_data;
+	const char *name = snd_ctl_elem_id_get_name(id);
+	unsigned int i;
+
+	for (i = 0; i < fc->nelems; i++) {
+		if (fc->elems[i].present && !strcmp(fc->elems[i].name, name))
+			return i;
+	}
+	return SND_CTL_EXT_KEY_NOT_FOUND;
+}
+
+static int fake_ctl_get_attribute(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key,
+				  int *type, unsigned int *acc,
+				  unsigned int *count)
+{
+	struct fake_ctl *fc = ext->private_data;
+
+	*type = fc->elems[key].type;
+	*acc = fc->elems[key].access;
+	*count = fc->elems[key].count;
+	return 0;
+}
+
+static int fake_ctl_get_integer_info(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key,
+				     long *imin, long *imax, long *istep)
+{
+	struct fake_ctl *fc = ext->private_data;
+
+	*imin = fc->elems[key].min;
+	*imax = fc->elems[key].max;
+	*istep = 0;
+	return 0;
+}
+
+static int fake_ctl_read_integer(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key,
+				 long *value)
+{
+	struct fake_ctl *fc = ext->private_data;
+	struct fake_elem *e = &fc->elems[key];
+
+	if (!(e->access & SND_CTL_EXT_ACCESS_READ))
+		return -EPERM;
+	e->reads++;
+	memcpy(value, e->value, e->count * sizeof(long));
+	return 0;
+}
+
+static int fake_ctl_write_integer(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key,
+				  long *value)
+{
+	struct fake_ctl *fc = ext->private_data;
+	struct fake_elem *e = &fc->elems[key];
+	int err;
+
+	if (!(e->access & SND_CTL_EXT_ACCESS_WRITE))
+		return -EPERM;
+	if (e->fail_write) {
+		err = e->fail_write;
+		e->fail_write = 0;
+		return err;
+	}
+	e->writes++;
+	if (!memcmp(e->value, value, e->count * sizeof(long)))
+		return 0;
+	memcpy(e->value, value, e->count * sizeof(long));
+	return 1;
+}
+
+static int fake_ctl_read_event(snd_ctl_ext_t *ext, snd_ctl_elem_id_t *id,
+			       unsigned int *event_mask)
+{
+	struct fake_ctl *fc = ext->private_data;
+
+	if (fc->head == fc->tail)
+		return -EAGAIN;
+	snd_ctl_elem_id_set_interface(id, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name(id, fc->events[fc->head].name);
+	*event_mask = fc->events[fc->head].mask;
+	fc->head = (fc->head + 1) % FAKE_CTL_EVENTS;
+	return 1;
+}
+
+static const snd_ctl_ext_callback_t fake_ctl_callback = {
+	.elem_count = fake_ctl_elem_count,
+	.elem_list = fake_ctl_elem_list,
+	.find_elem = fake_ctl_find_elem,
+	.get_attribute = fake_ctl_get_attribute,
+	.get_integer_info = fake_ctl_get_integer_info,
+	.read_integer = fake_ctl_read_integer,
+	.write_integer = fake_ctl_write_integer,
+	.read_event = fake_ctl_read_event,
+};
+
+/* add an element, present unless announced later by an ADD event */
+static struct fake_elem *fake_ctl_add(struct fake_ctl *fc, const char *name,
+				      int type, unsigned int count,
+				      long min, long max)
+{
+	struct fake_elem *e = &fc->elems[fc->nelems++];
+
+	memset(e, 0, sizeof(*e));
+	strcpy(e->name, name);
+	e->type = type;
+	e->access = SND_CTL_EXT_ACCESS_READWRITE;
+	e->count = count;
+	e->min = min;
+	e->max = max;
+	e->present = 1;
+	return e;
+}
+
+/* queue an event for the element */
+static void fake_ctl_event(struct fake_ctl *fc, struct fake_elem *e,
+			   unsigned int mask)
+{
+	fc->events[fc->tail].name = e->name;
+	fc->events[fc->tail].mask = mask;
+	fc->tail = (fc->tail + 1) % FAKE_CTL_EVENTS;
+	if (mask == SND_CTL_EVENT_MASK_REMOVE)
+		e->present = 0;
+	else if (mask & SND_CTL_EVENT_MASK_ADD)
+		e->present = 1;
+}
+
+/* change a value behind the back of the library and notify */
+static void fake_ctl_change(struct fake_ctl *fc, struct fake_elem *e,
+			    unsigned int idx, long value)
+{
+	e->value[idx] = value;
+	fake_ctl_event(fc, e, SND_CTL_EVENT_MASK_VALUE);
+}
+
+static int fake_ctl_open(struct fake_ctl *fc, snd_ctl_t **ctlp)
+{
+	int err;
+
+	fc->ext.version = SND_CTL_EXT_VERSION;
+	strcpy(fc->ext.id, "Fake");
+	strcpy(fc->ext.name, "Fake");
+	strcpy(fc->ext.longname, "Fake control device");
+	strcpy(fc->ext.mixername, "Fake");
+	fc->ext.poll_fd = -1;
+	fc->ext.callback = &fake_ctl_callback;
+	fc->ext.private_data = fc;
+	err = snd_ctl_ext_create(&fc->ext, "fake", SND_CTL_NONBLOCK);
+	if (err < 0)
+		return err;
+	*ctlp = fc->ext.handle;
+	return 0;
+}
+
+#endif
@@ -0,0 +1,148 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "fake_ctl.h"
+
+static struct fake_ctl fc;
+static snd_hctl_t *hctl;
+
+static void stats(unsigned long *hits, unsigned long *misses)
+{
+	snd_hctl_get_cache_stats(hctl, hits, misses);
+}
+
+static snd_hctl_elem_t *find(const char *name)
+{
+	snd_ctl_elem_id_t *id;
+
+	snd_ctl_elem_id_alloca(&id);
+	snd_ctl_elem_id_set_interface(id, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name(id, name);
+	return snd_hctl_find_elem(hctl, id);
+}
+
+static long read_value(snd_hctl_elem_t *helem)
+{
+	snd_ctl_elem_value_t *value;
+
+	snd_ctl_elem_value_alloca(&value);
+	ALSA_CHECK(snd_hctl_elem_read(helem, value));
+	return snd_ctl_elem_value_get_integer(value, 0);
+}
+
+static void test_value(struct fake_elem *e, snd_hctl_elem_t *helem)
+{
+	snd_ctl_elem_value_t *value;
+	unsigned long hits, misses;
+
+	snd_ctl_elem_value_alloca(&value);
+	e->value[0] = 5;
+	stats(&hits, &misses);
+	TEST_CHECK(read_value(helem) == 5);
+	TEST_CHECK(read_value(helem) == 5);
+	TEST_CHECK(e->reads == 1);
+	stats(&hits, &misses);
+	TEST_CHECK(hits == 1 && misses == 1);
+
+	/* a change behind the back stays unseen until its event */
+	e->value[0] = 6;
+	TEST_CHECK(read_value(helem) == 5);
+	fake_ctl_event(&fc, e, SND_CTL_EVENT_MASK_VALUE);
+	TEST_CHECK(snd_hctl_handle_events(hctl) == 1);
+	TEST_CHECK(read_value(helem) == 6);
+	stats(&hits, &misses);
+	TEST_CHECK(hits == 2 && misses == 2);
+
+	/* a write through the handle drops the value */
+	snd_ctl_elem_value_set_integer(value, 0, 7);
+	TEST_CHECK(snd_hctl_elem_write(helem, value) == 1);
+	TEST_CHECK(read_value(helem) == 7);
+	TEST_CHECK(read_value(helem) == 7);
+	stats(&hits, &misses);
+	TEST_CHECK(hits == 3 && misses == 3);
+
+	/* an info change drops the value too */
+	fake_ctl_event(&fc, e, SND_CTL_EVENT_MASK_INFO);
+	TEST_CHECK(snd_hctl_handle_events(hctl) == 1);
+	TEST_CHECK(read_value(helem) == 7);
+	stats(&hits, &misses);
+	TEST_CHECK(hits == 3 && misses == 4);
+	TEST_CHECK(e->reads == 4);
+}
+
+static void test_volatile(struct fake_elem *e, snd_hctl_elem_t *helem)
+{
+	unsigned long hits, misses, hits0, misses0;
+
+	stats(&hits0, &misses0);
+	e->value[0] = 1;
+	TEST_CHECK(read_value(helem) == 1);
+	e->value[0] = 2;
+	TEST_CHECK(read_value(helem) == 2);
+	stats(&hits, &misses);
+	TEST_CHECK(hits == hits0 && misses == misses0 + 2);
+}
+
+/*
+ * the info is not served from the cache, the lock state may change
+ * without an event; the fake device cannot lock, so an eventless change
+ * of the inactive flag stands for it
+ */
+static void test_info(struct fake_elem *e, snd_hctl_elem_t *helem)
+{
+	snd_ctl_elem_info_t *info;
+	unsigned long hits, misses, hits0, misses0;
+
+	snd_ctl_elem_info_alloca(&info);
+	stats(&hits0, &misses0);
+	ALSA_CHECK(snd_hctl_elem_info(helem, info));
+	TEST_CHECK(!snd_ctl_elem_info_is_inactive(info));
+	e->access |= SND_CTL_EXT_ACCESS_INACTIVE;
+	ALSA_CHECK(snd_hctl_elem_info(helem, info));
+	TEST_CHECK(snd_ctl_elem_info_is_inactive(info));
+	e->access &= ~SND_CTL_EXT_ACCESS_INACTIVE;
+	stats(&hits, &misses);
+	TEST_CHECK(hits == hits0 && misses == misses0);
+}
+
+/* disabling drops everything */
+static void test_disable(struct fake_elem *e, snd_hctl_elem_t *helem)
+{
+	unsigned long hits, misses, hits0, misses0;
+	unsigned int reads = e->reads;
+
+	ALSA_CHECK(snd_hctl_set_cache(hctl, 0));
+	stats(&hits0, &misses0);
+	read_value(helem);
+	read_value(helem);
+	TEST_CHECK(e->reads == reads + 2);
+	ALSA_CHECK(snd_hctl_set_cache(hctl, 1));
+	read_value(helem);
+	read_value(helem);
+	TEST_CHECK(e->reads == reads + 3);
+	stats(&hits, &misses);
+	TEST_CHECK(hits == hits0 + 1 && misses == misses0 + 1);
+}
+
+int main(void)
+{
+	struct fake_elem *vol, *meter;
+	snd_ctl_t *ctl;
+
+	vol = fake_ctl_add(&fc, "Volume", SND_CTL_ELEM_TYPE_INTEGER, 1, 0, 100);
+	meter = fake_ctl_add(&fc, "Meter", SND_CTL_ELEM_TYPE_INTEGER, 1, 0, 100);
+	meter->access |= SND_CTL_EXT_ACCESS_VOLATILE;
+	if (ALSA_CHECK(fake_ctl_open(&fc, &ctl)) < 0)
+		return 1;
+	ALSA_CHECK(snd_hctl_open_ctl(&hctl, ctl));
+	ALSA_CHECK(snd_hctl_load(hctl));
+	ALSA_CHECK(snd_hctl_set_cache(hctl, 1));
+
+	test_value(vol, find("Volume"));
+	test_volatile(meter, find("Meter"));
+	test_info(vol, find("Volume"));
+	test_disable(vol, find("Volume"));
+
+	snd_hctl_close(hctl);
+	return TEST_EXIT_CODE();
+}
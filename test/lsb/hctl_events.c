@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "fake_ctl.h"
+
+static struct fake_ctl fc;
+static struct fake_elem *a, *b, *c, *d, *e, *f, *g;
+static snd_hctl_t *hctl;
+
+/* the callbacks in order, with the element count seen by each */
+static struct {
+	char what;
+	char name[44];
+	unsigned int count;
+} log_entries[32];
+static unsigned int nlog;
+
+static void log_event(char what, snd_hctl_elem_t *helem)
+{
+	log_entries[nlog].what = what;
+	strcpy(log_entries[nlog].name, snd_hctl_elem_get_name(helem));
+	log_entries[nlog].count = snd_hctl_get_count(hctl);
+	nlog++;
+}
+
+static int elem_callback(snd_hctl_elem_t *helem, unsigned int mask)
+{
+	if (mask == SND_CTL_EVENT_MASK_REMOVE)
+		log_event('-', helem);
+	else if (mask & SND_CTL_EVENT_MASK_VALUE)
+		log_event('=', helem);
+	return 0;
+}
+
+static int hctl_callback(snd_hctl_t *h, unsigned int mask,
+			 snd_hctl_elem_t *helem)
+{
+	if (mask & SND_CTL_EVENT_MASK_ADD) {
+		snd_hctl_elem_set_callback(helem, elem_callback);
+		log_event('+', helem);
+	}
+	(void)h;
+	return 0;
+}
+
+static int check_log(unsigned int i, char what, const char *name,
+		     unsigned int count)
+{
+	if (log_entries[i].what == what && !strcmp(log_entries[i].name, name) &&
+	    log_entries[i].count == count)
+		return 1;
+	fprintf(stderr, "callback %u: %c %s %u\n", i, log_entries[i].what,
+		log_entries[i].name, log_entries[i].count);
+	return 0;
+}
+
+/* the list, forwards and backwards, as the first letters of the names */
+static void check_order(const char *order)
+{
+	snd_hctl_elem_t *helem;
+	char buf[32];
+	unsigned int n = 0;
+
+	for (helem = snd_hctl_first_elem(hctl); helem && n < sizeof(buf) - 1;
+	     helem = snd_hctl_elem_next(helem))
+		buf[n++] = snd_hctl_elem_get_name(helem)[0];
+	buf[n] = 0;
+	TEST_CHECK(!strcmp(buf, order));
+	n = strlen(order);
+	for (helem = snd_hctl_last_elem(hctl); helem && n > 0;
+	     helem = snd_hctl_elem_prev(helem))
+		TEST_CHECK(snd_hctl_elem_get_name(helem)[0] == order[--n]);
+	TEST_CHECK(n == 0 && helem == NULL);
+	TEST_CHECK(snd_hctl_get_count(hctl) == strlen(order));
+}
+
+static int found(const char *name)
+{
+	snd_ctl_elem_id_t *id;
+
+	snd_ctl_elem_id_alloca(&id);
+	snd_ctl_elem_id_set_interface(id, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name(id, name);
+	return snd_hctl_find_elem(hctl, id) != NULL;
+}
+
+static struct fake_elem *add(const char *name, int present)
+{
+	struct fake_elem *elem;
+
+	elem = fake_ctl_add(&fc, name, SND_CTL_ELEM_TYPE_INTEGER, 1, 0, 100);
+	elem->present = present;
+	return elem;
+}
+
+static void test_burst(void)
+{
+	/* a mixed burst; adds are merged before the next remove or change */
+	fake_ctl_event(&fc, a, SND_CTL_EVENT_MASK_ADD);
+	fake_ctl_event(&fc, e, SND_CTL_EVENT_MASK_ADD);
+	fake_ctl_event(&fc, d, SND_CTL_EVENT_MASK_REMOVE);
+	fake_ctl_event(&fc, f, SND_CTL_EVENT_MASK_REMOVE);
+	fake_ctl_change(&fc, e, 0, 10);
+	fake_ctl_event(&fc, c, SND_CTL_EVENT_MASK_ADD);
+	fake_ctl_event(&fc, g, SND_CTL_EVENT_MASK_ADD);
+	fake_ctl_event(&fc, b, SND_CTL_EVENT_MASK_REMOVE);
+	nlog = 0;
+	TEST_CHECK(snd_hctl_handle_events(hctl) == 8);
+	TEST_CHECK(nlog == 8);
+	TEST_CHECK(check_log(0, '+', "A Volume", 5));
+	TEST_CHECK(check_log(1, '+', "E Volume", 5));
+	TEST_CHECK(check_log(2, '-', "D Volume", 5));
+	TEST_CHECK(check_log(3, '-', "F Volume", 4));
+	TEST_CHECK(check_log(4, '=', "E Volume", 3));
+	TEST_CHECK(check_log(5, '+', "C Volume", 5));
+	TEST_CHECK(check_log(6, '+', "G Volume", 5));
+	TEST_CHECK(check_log(7, '-', "B Volume", 5));
+	check_order("ACEG");
+	TEST_CHECK(found("A Volume") && found("G Volume"));
+	TEST_CHECK(!found("B Volume") && !found("D Volume"));
+
+	/* the same id removed and added again in one burst */
+	fake_ctl_event(&fc, c, SND_CTL_EVENT_MASK_REMOVE);
+	fake_ctl_event(&fc, b, SND_CTL_EVENT_MASK_ADD);
+	fake_ctl_event(&fc, c, SND_CTL_EVENT_MASK_ADD);
+	fake_ctl_event(&fc, a, SND_CTL_EVENT_MASK_REMOVE);
+	nlog = 0;
+	TEST_CHECK(snd_hctl_handle_events(hctl) == 4);
+	TEST_CHECK(nlog == 4);
+	TEST_CHECK(check_log(0, '-', "C Volume", 4));
+	TEST_CHECK(check_log(1, '+', "B Volume", 5));
+	TEST_CHECK(check_log(2, '+', "C Volume", 5));
+	TEST_CHECK(check_log(3, '-', "A Volume", 5));
+	check_order("BCEG");
+}
+
+int main(void)
+{
+	snd_ctl_t *ctl;
+
+	/* B, D and F are there from the start */
+	b = add("B Volume", 1);
+	d = add("D Volume", 1);
+	f = add("F Volume", 1);
+	a = add("A Volume", 0);
+	e = add("E Volume", 0);
+	c = add("C Volume", 0);
+	g = add("G Volume", 0);
+	if (ALSA_CHECK(fake_ctl_open(&fc, &ctl)) < 0)
+		return 1;
+	ALSA_CHECK(snd_hctl_open_ctl(&hctl, ctl));
+	snd_hctl_set_callback(hctl, hctl_callback);
+	ALSA_CHECK(snd_hctl_load(hctl));
+	check_order("BDF");
+
+	test_burst();
+
+	snd_hctl_close(hctl);
+	return TEST_EXIT_CODE();
+}
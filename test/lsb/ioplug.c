@@ -0,0 +1,321 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include <alsa/pcm_ioplug.h>
+
+#define CHANNELS	2
+#define BUFFER		64
+#define PERIOD		16
+
+/*
+ * An in-process I/O plugin: the position returned by pointer() is set by
+ * the test, the transferred frames are recorded.
+ */
+struct fake_io {
+	snd_pcm_ioplug_t io;
+	snd_pcm_uframes_t hw;
+	unsigned int pointer_calls;
+	unsigned int transfers;		/* transferv calls */
+	unsigned int nchunks;		/* of the last call */
+	snd_pcm_ioplug_chunk_t chunks[2];
+	short own[BUFFER * CHANNELS];	/* buffer_areas() */
+	short data[256 * CHANNELS];	/* playback: received, capture: sent */
+	unsigned int frames;
+};
+
+static short *frame_ptr(const snd_pcm_channel_area_t *areas,
+			snd_pcm_uframes_t ofs)
+{
+	return (short *)((char *)areas[0].addr +
+			 (areas[0].first + ofs * areas[0].step) / 8);
+}
+
+static int fake_start(snd_pcm_ioplug_t *io)
+{
+	(void)io;
+	return 0;
+}
+
+static int fake_stop(snd_pcm_ioplug_t *io)
+{
+	(void)io;
+	return 0;
+}
+
+static snd_pcm_sframes_t fake_pointer(snd_pcm_ioplug_t *io)
+{
+	struct fake_io *fi = io->private_data;
+
+	fi->pointer_calls++;
+	return fi->hw % io->buffer_size;
+}
+
+static snd_pcm_sframes_t fake_transferv(snd_pcm_ioplug_t *io,
+					const snd_pcm_ioplug_chunk_t *chunks,
+					unsigned int nchunks)
+{
+	struct fake_io *fi = io->private_data;
+	snd_pcm_uframes_t total = 0;
+	unsigned int i;
+
+	fi->transfers++;
+	fi->nchunks = nchunks;
+	for (i = 0; i < nchunks && i < 2; i++) {
+		short *ptr = frame_ptr(chunks[i].areas, chunks[i].offset);
+		size_t bytes = chunks[i].size * CHANNELS * sizeof(short);
+
+		fi->chunks[i] = chunks[i];
+		/* the interleaved areas of the frames are contiguous */
+		if (io->stream == SND_PCM_STREAM_PLAYBACK)
+			memcpy(fi->data + fi->frames * CHANNELS, ptr, bytes);
+		else
+			memcpy(ptr, fi->data + fi->frames * CHANNELS, bytes);
+		fi->frames += chunks[i].size;
+		total += chunks[i].size;
+	}
+	return total;
+}
+
+static int fake_buffer_areas(snd_pcm_ioplug_t *io,
+			     snd_pcm_channel_area_t *areas)
+{
+	struct fake_io *fi = io->private_data;
+	unsigned int c;
+
+	for (c = 0; c < CHANNELS; c++) {
+		areas[c].addr = fi->own;
+		areas[c].first = c * 16;
+		areas[c].step = CHANNELS * 16;
+	}
+	return 0;
+}
+
+static const snd_pcm_ioplug_callback_t fake_callback = {
+	.start = fake_start,
+	.stop = fake_stop,
+	.pointer = fake_pointer,
+	.transferv = fake_transferv,
+};
+
+static const snd_pcm_ioplug_callback_t fake_callback_own = {
+	.start = fake_start,
+	.stop = fake_stop,
+	.pointer = fake_pointer,
+	.transferv = fake_transferv,
+	.buffer_areas = fake_buffer_areas,
+};
+
+static snd_pcm_t *fake_open(struct fake_io *fi, snd_pcm_stream_t stream,
+			    snd_pcm_access_t access, unsigned int flags,
+			    const snd_pcm_ioplug_callback_t *callback)
+{
+	static const unsigned int accesses[] = {
+		SND_PCM_ACCESS_RW_INTERLEAVED,
+		SND_PCM_ACCESS_MMAP_INTERLEAVED,
+	};
+	static const unsigned int formats[] = { SND_PCM_FORMAT_S16 };
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_t *pcm;
+	unsigned int i;
+
+	memset(fi, 0, sizeof(*fi));
+	for (i = 0; i < 256 * CHANNELS; i++)
+		fi->data[i] = i;
+	fi->io.version = SND_PCM_IOPLUG_VERSION;
+	fi->io.name = "Fake I/O plugin";
+	fi->io.flags = flags;
+	fi->io.poll_fd = -1;
+	fi->io.mmap_rw = access == SND_PCM_ACCESS_RW_INTERLEAVED;
+	fi->io.callback = callback;
+	fi->io.private_data = fi;
+	if (ALSA_CHECK(snd_pcm_ioplug_create(&fi->io, "fake", stream,
+					     SND_PCM_NONBLOCK)) < 0)
+		return NULL;
+	pcm = fi->io.pcm;
+	snd_pcm_ioplug_set_param_list(&fi->io, SND_PCM_IOPLUG_HW_ACCESS,
+				      2, accesses);
+	snd_pcm_ioplug_set_param_list(&fi->io, SND_PCM_IOPLUG_HW_FORMAT,
+				      1, formats);
+	snd_pcm_ioplug_set_param_minmax(&fi->io, SND_PCM_IOPLUG_HW_CHANNELS,
+					CHANNELS, CHANNELS);
+	snd_pcm_ioplug_set_param_minmax(&fi->io, SND_PCM_IOPLUG_HW_RATE,
+					48000, 48000);
+	snd_pcm_ioplug_set_param_minmax(&fi->io, SND_PCM_IOPLUG_HW_PERIOD_BYTES,
+					PERIOD * 4, PERIOD * 4);
+	snd_pcm_ioplug_set_param_minmax(&fi->io, SND_PCM_IOPLUG_HW_PERIODS,
+					BUFFER / PERIOD, BUFFER / PERIOD);
+
+	snd_pcm_hw_params_alloca(&hw);
+	ALSA_CHECK(snd_pcm_hw_params_any(pcm, hw));
+	ALSA_CHECK(snd_pcm_hw_params_set_access(pcm, hw, access));
+	ALSA_CHECK(snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16));
+	ALSA_CHECK(snd_pcm_hw_params_set_channels(pcm, hw, CHANNELS));
+	ALSA_CHECK(snd_pcm_hw_params_set_rate(pcm, hw, 48000, 0));
+	if (ALSA_CHECK(snd_pcm_hw_params(pcm, hw)) < 0) {
+		snd_pcm_close(pcm);
+		return NULL;
+	}
+	TEST_CHECK(fi->io.buffer_size == BUFFER);
+	return pcm;
+}
+
+/* writes through the ring buffer hand both sides of a wrap over at once */
+static void test_write_wrap(void)
+{
+	struct fake_io fi;
+	short buf[64 * CHANNELS];
+	snd_pcm_t *pcm;
+	unsigned int i;
+
+	pcm = fake_open(&fi, SND_PCM_STREAM_PLAYBACK,
+			SND_PCM_ACCESS_RW_INTERLEAVED, 0, &fake_callback);
+	if (!pcm)
+		return;
+	for (i = 0; i < 64 * CHANNELS; i++)
+		buf[i] = 1000 + i;
+	TEST_CHECK(snd_pcm_writei(pcm, buf, 48) == 48);
+	TEST_CHECK(fi.transfers == 1 && fi.nchunks == 1);
+	TEST_CHECK(fi.chunks[0].offset == 0 && fi.chunks[0].size == 48);
+
+	/* played 48 frames, the next write wraps */
+	fi.hw = 48;
+	TEST_CHECK(snd_pcm_writei(pcm, buf + 48 * CHANNELS, 16) == 16);
+	TEST_CHECK(fi.transfers == 2 && fi.nchunks == 1);
+	fi.hw = 64;
+	TEST_CHECK(snd_pcm_writei(pcm, buf, 32) == 32);
+	TEST_CHECK(fi.transfers == 3 && fi.nchunks == 1);
+	TEST_CHECK(fi.chunks[0].offset == 0 && fi.chunks[0].size == 32);
+
+	fi.hw = 72;
+	TEST_CHECK(snd_pcm_writei(pcm, buf, 40) == 40);
+	TEST_CHECK(fi.transfers == 4 && fi.nchunks == 2);
+	TEST_CHECK(fi.chunks[0].offset == 32 && fi.chunks[0].size == 32);
+	TEST_CHECK(fi.chunks[1].offset == 0 && fi.chunks[1].size == 8);
+	TEST_CHECK(fi.frames == 136);
+	TEST_CHECK(!memcmp(fi.data, buf, 64 * CHANNELS * sizeof(short)));
+	TEST_CHECK(!memcmp(fi.data + 96 * CHANNELS, buf,
+			   40 * CHANNELS * sizeof(short)));
+	snd_pcm_close(pcm);
+}
+
+/* the capture avail is transferred in one call, split at the buffer end */
+static void test_capture_wrap(void)
+{
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset, frames;
+	struct fake_io fi;
+	snd_pcm_t *pcm;
+
+	pcm = fake_open(&fi, SND_PCM_STREAM_CAPTURE,
+			SND_PCM_ACCESS_MMAP_INTERLEAVED, 0, &fake_callback);
+	if (!pcm)
+		return;
+	ALSA_CHECK(snd_pcm_start(pcm));
+	fi.hw = 48;
+	TEST_CHECK(snd_pcm_avail_update(pcm) == 48);
+	TEST_CHECK(fi.nchunks == 1 && fi.chunks[0].size == 48);
+	frames = 48;
+	ALSA_CHECK(snd_pcm_mmap_begin(pcm, &areas, &offset, &frames));
+	TEST_CHECK(offset == 0 && frames == 48);
+	TEST_CHECK(snd_pcm_mmap_commit(pcm, offset, frames) == 48);
+
+	fi.hw = 80;
+	TEST_CHECK(snd_pcm_avail_update(pcm) == 32);
+	TEST_CHECK(fi.nchunks == 2);
+	TEST_CHECK(fi.chunks[0].offset == 48 && fi.chunks[0].size == 16);
+	TEST_CHECK(fi.chunks[1].offset == 0 && fi.chunks[1].size == 16);
+	frames = 32;
+	ALSA_CHECK(snd_pcm_mmap_begin(pcm, &areas, &offset, &frames));
+	TEST_CHECK(offset == 48 && frames == 16);
+	TEST_CHECK(!memcmp(frame_ptr(areas, 48), fi.data + 48 * CHANNELS,
+			   16 * CHANNELS * sizeof(short)));
+	TEST_CHECK(!memcmp(frame_ptr(areas, 0), fi.data + 64 * CHANNELS,
+			   16 * CHANNELS * sizeof(short)));
+	snd_pcm_close(pcm);
+}
+
+/* pointer() is called once until the next transfer or invalidation */
+static void test_cached_ptr(void)
+{
+	struct fake_io fi;
+	short buf[16 * CHANNELS];
+	snd_pcm_t *pcm;
+
+	pcm = fake_open(&fi, SND_PCM_STREAM_PLAYBACK,
+			SND_PCM_ACCESS_RW_INTERLEAVED,
+			SND_PCM_IOPLUG_FLAG_CACHED_PTR, &fake_callback);
+	if (!pcm)
+		return;
+	memset(buf, 0, sizeof(buf));
+	TEST_CHECK(snd_pcm_writei(pcm, buf, 16) == 16);
+	TEST_CHECK(snd_pcm_state(pcm) == SND_PCM_STATE_RUNNING);
+	fi.pointer_calls = 0;
+	fi.hw = 8;
+	TEST_CHECK(snd_pcm_avail_update(pcm) == BUFFER - 8);
+	fi.hw = 12;
+	TEST_CHECK(snd_pcm_avail_update(pcm) == BUFFER - 8);
+	TEST_CHECK(fi.pointer_calls == 1);
+
+	snd_pcm_ioplug_invalidate_ptr(&fi.io);
+	TEST_CHECK(snd_pcm_avail_update(pcm) == BUFFER - 4);
+	TEST_CHECK(fi.pointer_calls == 2);
+
+	/* a transfer drops it, too */
+	TEST_CHECK(snd_pcm_writei(pcm, buf, 16) == 16);
+	fi.hw = 16;
+	fi.pointer_calls = 0;
+	TEST_CHECK(snd_pcm_avail_update(pcm) == BUFFER - 16);
+	TEST_CHECK(snd_pcm_avail_update(pcm) == BUFFER - 16);
+	TEST_CHECK(fi.pointer_calls == 1);
+	snd_pcm_close(pcm);
+
+	/* without the flag, every update asks the plugin */
+	pcm = fake_open(&fi, SND_PCM_STREAM_PLAYBACK,
+			SND_PCM_ACCESS_RW_INTERLEAVED, 0, &fake_callback);
+	if (!pcm)
+		return;
+	TEST_CHECK(snd_pcm_writei(pcm, buf, 16) == 16);
+	fi.pointer_calls = 0;
+	snd_pcm_avail_update(pcm);
+	snd_pcm_avail_update(pcm);
+	TEST_CHECK(fi.pointer_calls == 2);
+	snd_pcm_close(pcm);
+}
+
+/* the plugin's own buffer is the mmap area, no copy in between */
+static void test_buffer_areas(void)
+{
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset, frames;
+	struct fake_io fi;
+	snd_pcm_t *pcm;
+	short *ptr;
+	unsigned int i;
+
+	pcm = fake_open(&fi, SND_PCM_STREAM_PLAYBACK,
+			SND_PCM_ACCESS_MMAP_INTERLEAVED, 0, &fake_callback_own);
+	if (!pcm)
+		return;
+	frames = 24;
+	ALSA_CHECK(snd_pcm_mmap_begin(pcm, &areas, &offset, &frames));
+	TEST_CHECK(offset == 0 && frames == 24);
+	TEST_CHECK(areas[0].addr == fi.own && areas[1].addr == fi.own);
+	TEST_CHECK(areas[1].first == 16 && areas[1].step == 32);
+	ptr = frame_ptr(areas, offset);
+	for (i = 0; i < 24 * CHANNELS; i++)
+		ptr[i] = 2000 + i;
+	TEST_CHECK(snd_pcm_mmap_commit(pcm, offset, frames) == 24);
+	TEST_CHECK(fi.transfers == 1 && fi.nchunks == 1);
+	TEST_CHECK(fi.chunks[0].areas[0].addr == fi.own);
+	TEST_CHECK(fi.own[47] == 2047 && fi.data[47] == 2047);
+	snd_pcm_close(pcm);
+}
+
+int main(void)
+{
+	test_write_wrap();
+	test_capture_wrap();
+	test_cached_ptr();
+	test_buffer_areas();
+	return TEST_EXIT_CODE();
+}
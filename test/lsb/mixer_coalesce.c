@@ -0,0 +1,208 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "fake_ctl.h"
+
+/*
+ * A class grouping the controls by the first letter of their name, which
+ * records the value events it gets.  Its elements are not simple ones,
+ * the private data is just the name.
+ */
+#define GROUP_ELEM	((snd_mixer_elem_type_t)(SND_MIXER_ELEM_LAST + 1))
+
+static struct {
+	char group;
+	char name[44];
+} value_events[16];
+static unsigned int nvalue_events;
+
+static snd_mixer_elem_t *group_find(snd_mixer_t *mixer, const char *name)
+{
+	snd_mixer_elem_t *melem;
+
+	for (melem = snd_mixer_first_elem(mixer); melem;
+	     melem = snd_mixer_elem_next(melem)) {
+		if (!strncmp(snd_mixer_elem_get_private(melem), name, 1))
+			return melem;
+	}
+	return NULL;
+}
+
+static void group_free(snd_mixer_elem_t *melem)
+{
+	free(snd_mixer_elem_get_private(melem));
+}
+
+static int group_event(snd_mixer_class_t *class, unsigned int mask,
+		       snd_hctl_elem_t *helem, snd_mixer_elem_t *melem)
+{
+	snd_mixer_t *mixer = snd_mixer_class_get_mixer(class);
+	const char *name = snd_hctl_elem_get_name(helem);
+	int err;
+
+	if (mask == SND_CTL_EVENT_MASK_REMOVE)
+		return snd_mixer_elem_detach(melem, helem);
+	if (mask & SND_CTL_EVENT_MASK_ADD) {
+		melem = group_find(mixer, name);
+		if (!melem) {
+			err = snd_mixer_elem_new(&melem, GROUP_ELEM,
+						 0, strdup(name), group_free);
+			if (err < 0)
+				return err;
+			err = snd_mixer_elem_attach(melem, helem);
+			if (err < 0)
+				return err;
+			return snd_mixer_elem_add(melem, class);
+		}
+		return snd_mixer_elem_attach(melem, helem);
+	}
+	if (mask & SND_CTL_EVENT_MASK_VALUE) {
+		value_events[nvalue_events].group =
+			*(char *)snd_mixer_elem_get_private(melem);
+		strcpy(value_events[nvalue_events].name, name);
+		nvalue_events++;
+	}
+	return 0;
+}
+
+static int group_compare(const snd_mixer_elem_t *e1,
+			 const snd_mixer_elem_t *e2)
+{
+	return strcmp(snd_mixer_elem_get_private(e1),
+		      snd_mixer_elem_get_private(e2));
+}
+
+static int check_value_event(unsigned int i, char group, const char *name)
+{
+	return value_events[i].group == group &&
+	       !strcmp(value_events[i].name, name);
+}
+
+/* every changed control of an element reaches the class */
+static void test_class_events(void)
+{
+	static struct fake_ctl fc;
+	struct fake_elem *a_vol, *a_sw, *b_vol;
+	snd_mixer_class_t *class;
+	snd_mixer_t *mixer;
+	snd_hctl_t *hctl;
+	snd_ctl_t *ctl;
+
+	a_vol = fake_ctl_add(&fc, "A Volume", SND_CTL_ELEM_TYPE_INTEGER, 1, 0, 100);
+	a_sw = fake_ctl_add(&fc, "A Switch", SND_CTL_ELEM_TYPE_BOOLEAN, 1, 0, 1);
+	b_vol = fake_ctl_add(&fc, "B Volume", SND_CTL_ELEM_TYPE_INTEGER, 1, 0, 100);
+	if (ALSA_CHECK(fake_ctl_open(&fc, &ctl)) < 0)
+		return;
+	ALSA_CHECK(snd_hctl_open_ctl(&hctl, ctl));
+	ALSA_CHECK(snd_mixer_open(&mixer, 0));
+	ALSA_CHECK(snd_mixer_class_malloc(&class));
+	snd_mixer_class_set_event(class, group_event);
+	snd_mixer_class_set_compare(class, group_compare);
+	ALSA_CHECK(snd_mixer_class_register(class, mixer));
+	ALSA_CHECK(snd_mixer_attach_hctl(mixer, hctl));
+	ALSA_CHECK(snd_mixer_load(mixer));
+	TEST_CHECK(snd_mixer_get_count(mixer) == 2);
+
+	fake_ctl_change(&fc, a_vol, 0, 10);
+	fake_ctl_change(&fc, a_sw, 0, 1);
+	fake_ctl_change(&fc, a_vol, 0, 20);
+	fake_ctl_change(&fc, b_vol, 0, 30);
+	fake_ctl_change(&fc, a_sw, 0, 0);
+	nvalue_events = 0;
+	ALSA_CHECK(snd_mixer_handle_events_coalesce(mixer));
+	TEST_CHECK(nvalue_events == 3);
+	TEST_CHECK(check_value_event(0, 'A', "A Volume"));
+	TEST_CHECK(check_value_event(1, 'A', "A Switch"));
+	TEST_CHECK(check_value_event(2, 'B', "B Volume"));
+
+	/* nothing left over for the next round */
+	fake_ctl_change(&fc, b_vol, 0, 40);
+	nvalue_events = 0;
+	ALSA_CHECK(snd_mixer_handle_events_coalesce(mixer));
+	TEST_CHECK(nvalue_events == 1);
+	TEST_CHECK(check_value_event(0, 'B', "B Volume"));
+
+	/* a removed control is not delivered */
+	fake_ctl_change(&fc, a_vol, 0, 50);
+	fake_ctl_change(&fc, a_sw, 0, 1);
+	fake_ctl_event(&fc, a_vol, SND_CTL_EVENT_MASK_REMOVE);
+	nvalue_events = 0;
+	ALSA_CHECK(snd_mixer_handle_events_coalesce(mixer));
+	TEST_CHECK(nvalue_events == 2);
+	TEST_CHECK(check_value_event(0, 'A', "A Volume"));
+	TEST_CHECK(check_value_event(1, 'A', "A Switch"));
+
+	snd_mixer_close(mixer);
+}
+
+static int simple_changes;
+
+static int simple_callback(snd_mixer_elem_t *melem, unsigned int mask)
+{
+	if (mask & SND_CTL_EVENT_MASK_VALUE)
+		simple_changes++;
+	(void)melem;
+	return 0;
+}
+
+static int simple_add(snd_mixer_t *mixer, unsigned int mask,
+		      snd_mixer_elem_t *melem)
+{
+	if (mask & SND_CTL_EVENT_MASK_ADD)
+		snd_mixer_elem_set_callback(melem, simple_callback);
+	(void)mixer;
+	return 0;
+}
+
+/* a simple element picks up both controls and calls back once */
+static void test_simple_element(void)
+{
+	static struct fake_ctl fc;
+	struct fake_elem *vol, *sw;
+	snd_mixer_elem_t *melem;
+	snd_mixer_t *mixer;
+	snd_hctl_t *hctl;
+	snd_ctl_t *ctl;
+	long value;
+	int on;
+
+	vol = fake_ctl_add(&fc, "Master Playback Volume",
+			   SND_CTL_ELEM_TYPE_INTEGER, 2, 0, 100);
+	sw = fake_ctl_add(&fc, "Master Playback Switch",
+			  SND_CTL_ELEM_TYPE_BOOLEAN, 2, 0, 1);
+	if (ALSA_CHECK(fake_ctl_open(&fc, &ctl)) < 0)
+		return;
+	ALSA_CHECK(snd_hctl_open_ctl(&hctl, ctl));
+	ALSA_CHECK(snd_mixer_open(&mixer, 0));
+	ALSA_CHECK(snd_mixer_selem_register(mixer, NULL, NULL));
+	snd_mixer_set_callback(mixer, simple_add);
+	ALSA_CHECK(snd_mixer_attach_hctl(mixer, hctl));
+	ALSA_CHECK(snd_mixer_load(mixer));
+	melem = snd_mixer_first_elem(mixer);
+	TEST_CHECK(melem != NULL);
+	if (!melem)
+		goto out;
+
+	vol->value[1] = 70;
+	fake_ctl_change(&fc, vol, 0, 70);
+	fake_ctl_change(&fc, sw, 0, 1);
+	sw->value[1] = 1;
+	fake_ctl_event(&fc, sw, SND_CTL_EVENT_MASK_VALUE);
+	simple_changes = 0;
+	TEST_CHECK(snd_mixer_handle_events_coalesce(mixer) == 1);
+	TEST_CHECK(simple_changes == 1);
+	ALSA_CHECK(snd_mixer_selem_get_playback_volume(melem, 0, &value));
+	TEST_CHECK(value == 70);
+	ALSA_CHECK(snd_mixer_selem_get_playback_switch(melem, 1, &on));
+	TEST_CHECK(on == 1);
+
+ out:
+	snd_mixer_close(mixer);
+}
+
+int main(void)
+{
+	test_class_events();
+	test_simple_element();
+	return TEST_EXIT_CODE();
+}
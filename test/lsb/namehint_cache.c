@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include "test.h"
+
+static char config[] = "/tmp/alsa-namehint-XXXXXX";
+
+static const char config_one[] =
+	"pcm.test1 { type null hint { show on description \"Test one\" } }\n"
+	"pcm.test2 { type null hint.description \"Test two\" }\n"
+	"namehint.pcm { extra \"null:|Extra device\" }\n";
+
+/* the same size, so that only the contents differ */
+static const char config_two[] =
+	"pcm.test1 { type null hint { show on description \"Test 111\" } }\n"
+	"pcm.test2 { type null hint.description \"Test 222\" }\n"
+	"namehint.pcm { extra \"null:|Extra device\" }\n";
+
+static void write_config(const char *text, int keep_mtime)
+{
+	struct utimbuf times;
+	struct stat st;
+	int fd;
+
+	TEST_CHECK(stat(config, &st) == 0);
+	/* rewrite in place, the inode stays */
+	fd = open(config, O_WRONLY | O_TRUNC);
+	TEST_CHECK(fd >= 0);
+	if (fd < 0)
+		return;
+	TEST_CHECK(write(fd, text, strlen(text)) == (ssize_t)strlen(text));
+	close(fd);
+	times.actime = st.st_atime;
+	times.modtime = keep_mtime ? st.st_mtime : st.st_mtime + 10;
+	TEST_CHECK(utime(config, &times) == 0);
+}
+
+/* the hints as one string, to compare the runs */
+static char *get_hints(const char *iface)
+{
+	char *res, **h;
+	void **hints;
+	size_t len = 1;
+	int err;
+
+	err = ALSA_CHECK(snd_device_name_hint(-1, iface, &hints));
+	if (err < 0)
+		return strdup("");
+	for (h = (char **)hints; *h; h++)
+		len += strlen(*h) + 1;
+	res = calloc(1, len);
+	for (h = (char **)hints; *h; h++) {
+		strcat(res, *h);
+		strcat(res, "\n");
+	}
+	snd_device_name_free_hint(hints);
+	return res;
+}
+
+static char *get_hints_cold(const char *iface)
+{
+	ALSA_CHECK(snd_config_update_free_global());
+	return get_hints(iface);
+}
+
+static void test_cache(void)
+{
+	char *cold, *hit, *stale, *fresh;
+
+	cold = get_hints_cold("pcm");
+	TEST_CHECK(strstr(cold, "NAMEtest1|DESCTest one\n") != NULL);
+	TEST_CHECK(strstr(cold, "NAMEnull:|Extra device\n") != NULL);
+	hit = get_hints("pcm");
+	TEST_CHECK(strcmp(cold, hit) == 0);
+	free(hit);
+
+	/* undetectable change: served from the cache */
+	write_config(config_two, 1);
+	stale = get_hints("pcm");
+	TEST_CHECK(strcmp(cold, stale) == 0);
+	free(stale);
+	fresh = get_hints_cold("pcm");
+	TEST_CHECK(strstr(fresh, "NAMEtest1|DESCTest 111\n") != NULL);
+	hit = get_hints("pcm");
+	TEST_CHECK(strcmp(fresh, hit) == 0);
+	free(hit);
+
+	/* a modified file drops the entries */
+	write_config(config_one, 0);
+	hit = get_hints("pcm");
+	TEST_CHECK(strcmp(cold, hit) == 0);
+	free(hit);
+	free(fresh);
+
+	/* each interface has its own entry */
+	hit = get_hints("ctl");
+	TEST_CHECK(strcmp(cold, hit) != 0);
+	free(hit);
+	hit = get_hints("pcm");
+	TEST_CHECK(strcmp(cold, hit) == 0);
+	free(hit);
+	free(cold);
+}
+
+int main(void)
+{
+	int fd;
+
+	fd = mkstemp(config);
+	if (fd < 0) {
+		perror("mkstemp");
+		return 1;
+	}
+	close(fd);
+	write_config(config_one, 0);
+	setenv("ALSA_CONFIG_PATH", config, 1);
+
+	test_cache();
+
+	ALSA_CHECK(snd_config_update_free_global());
+	unlink(config);
+	return TEST_EXIT_CODE();
+}
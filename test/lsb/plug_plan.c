@@ -0,0 +1,128 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+/*
+ * Open a plug over a null slave with the given slave parameters, set the
+ * client parameters and compare the passes of the plan shown by
+ * snd_pcm_dump(), from the client to the slave, with the expected ones;
+ * NULL means no passes.
+ */
+static void check_plan(snd_pcm_format_t format, unsigned int channels,
+		       unsigned int rate, const char *slave,
+		       const char *expected)
+{
+	snd_config_t *conf;
+	snd_pcm_hw_params_t *hw;
+	snd_output_t *out;
+	snd_input_t *in;
+	snd_pcm_t *pcm;
+	snd_pcm_uframes_t period = 1024, buffer = 4096;
+	char text[256], *dump, *plan;
+
+	snprintf(text, sizeof(text),
+		 "pcm.test { type plug slave { pcm { type null } %s } }",
+		 slave);
+	if (ALSA_CHECK(snd_config_top(&conf)) < 0)
+		return;
+	ALSA_CHECK(snd_input_buffer_open(&in, text, -1));
+	ALSA_CHECK(snd_config_load(conf, in));
+	snd_input_close(in);
+	if (ALSA_CHECK(snd_pcm_open_lconf(&pcm, "test", SND_PCM_STREAM_PLAYBACK,
+					  0, conf)) < 0) {
+		snd_config_delete(conf);
+		return;
+	}
+
+	snd_pcm_hw_params_alloca(&hw);
+	ALSA_CHECK(snd_pcm_hw_params_any(pcm, hw));
+	ALSA_CHECK(snd_pcm_hw_params_set_access(pcm, hw,
+						SND_PCM_ACCESS_RW_INTERLEAVED));
+	ALSA_CHECK(snd_pcm_hw_params_set_format(pcm, hw, format));
+	ALSA_CHECK(snd_pcm_hw_params_set_channels(pcm, hw, channels));
+	ALSA_CHECK(snd_pcm_hw_params_set_rate(pcm, hw, rate, 0));
+	ALSA_CHECK(snd_pcm_hw_params_set_period_size_near(pcm, hw, &period, 0));
+	ALSA_CHECK(snd_pcm_hw_params_set_buffer_size_near(pcm, hw, &buffer));
+	if (ALSA_CHECK(snd_pcm_hw_params(pcm, hw)) < 0)
+		goto out;
+
+	ALSA_CHECK(snd_output_buffer_open(&out));
+	snd_pcm_dump(pcm, out);
+	snd_output_buffer_string(out, &dump);
+	plan = strstr(dump, "Plug plan: ");
+	if (plan)
+		plan = strchr(plan, '\n') + 1;
+	if (expected ? !plan || strcmp(plan, expected) : plan != NULL) {
+		fprintf(stderr, "%s %uch %uHz over { %s }:\n%s",
+			snd_pcm_format_name(format), channels, rate, slave,
+			plan ? plan : "no passes\n");
+		TEST_CHECK(0);
+	}
+	snd_output_close(out);
+ out:
+	snd_pcm_close(pcm);
+	snd_config_delete(conf);
+}
+
+int main(void)
+{
+	/* nothing to convert */
+	check_plan(SND_PCM_FORMAT_S16_LE, 2, 48000,
+		   "format S16_LE channels 2 rate 48000", NULL);
+
+	/* a single mismatch is a single pass */
+	check_plan(SND_PCM_FORMAT_S16_LE, 2, 48000,
+		   "format S32_LE channels 2 rate 48000",
+		   "  format S16_LE 2ch 48000Hz -> S32_LE 2ch 48000Hz\n");
+	check_plan(SND_PCM_FORMAT_S32_LE, 2, 48000,
+		   "format S16_LE channels 2 rate 48000",
+		   "  format S32_LE 2ch 48000Hz -> S16_LE 2ch 48000Hz\n");
+	check_plan(SND_PCM_FORMAT_S16_LE, 1, 48000,
+		   "format S16_LE channels 2 rate 48000",
+		   "  route  S16_LE 1ch 48000Hz -> S16_LE 2ch 48000Hz\n");
+	check_plan(SND_PCM_FORMAT_S16_LE, 2, 44100,
+		   "format S16_LE channels 2 rate 48000",
+		   "  rate   S16_LE 2ch 44100Hz -> S16_LE 2ch 48000Hz\n");
+
+	/* linear format changes are fused in the route and rate passes */
+	check_plan(SND_PCM_FORMAT_S24_3LE, 2, 44100,
+		   "format S32_LE channels 2 rate 48000",
+		   "  rate   S24_3LE 2ch 44100Hz -> S32_LE 2ch 48000Hz\n");
+
+	/* the rate pass runs on the side with fewer channels */
+	check_plan(SND_PCM_FORMAT_S16_LE, 1, 44100,
+		   "format S32_LE channels 2 rate 48000",
+		   "  rate   S16_LE 1ch 44100Hz -> S16_LE 1ch 48000Hz\n"
+		   "  route  S16_LE 1ch 48000Hz -> S32_LE 2ch 48000Hz\n");
+	check_plan(SND_PCM_FORMAT_S16_LE, 6, 44100,
+		   "format S32_LE channels 2 rate 48000",
+		   "  route  S16_LE 6ch 44100Hz -> S16_LE 2ch 44100Hz\n"
+		   "  rate   S16_LE 2ch 44100Hz -> S32_LE 2ch 48000Hz\n");
+
+	/* separate format passes at the float and non-linear boundaries */
+	check_plan(SND_PCM_FORMAT_FLOAT_LE, 1, 48000,
+		   "format S16_LE channels 2 rate 48000",
+		   "  format FLOAT_LE 1ch 48000Hz -> S16_LE 1ch 48000Hz\n"
+		   "  route  S16_LE 1ch 48000Hz -> S16_LE 2ch 48000Hz\n");
+	check_plan(SND_PCM_FORMAT_FLOAT_LE, 2, 44100,
+		   "format FLOAT_LE channels 2 rate 48000",
+		   "  format FLOAT_LE 2ch 44100Hz -> S32_LE 2ch 44100Hz\n"
+		   "  rate   S32_LE 2ch 44100Hz -> S32_LE 2ch 48000Hz\n"
+		   "  format S32_LE 2ch 48000Hz -> FLOAT_LE 2ch 48000Hz\n");
+	check_plan(SND_PCM_FORMAT_S16_LE, 2, 44100,
+		   "format MU_LAW channels 2 rate 48000",
+		   "  rate   S16_LE 2ch 44100Hz -> S16_LE 2ch 48000Hz\n"
+		   "  format S16_LE 2ch 48000Hz -> MU_LAW 2ch 48000Hz\n");
+	check_plan(SND_PCM_FORMAT_MU_LAW, 1, 8000,
+		   "format S16_LE channels 2 rate 48000",
+		   "  format MU_LAW 1ch 8000Hz -> S16_LE 1ch 8000Hz\n"
+		   "  route  S16_LE 1ch 8000Hz -> S16_LE 2ch 8000Hz\n"
+		   "  rate   S16_LE 2ch 8000Hz -> S16_LE 2ch 48000Hz\n");
+	check_plan(SND_PCM_FORMAT_MU_LAW, 1, 8000,
+		   "format FLOAT_LE channels 2 rate 48000",
+		   "  format MU_LAW 1ch 8000Hz -> S16_LE 1ch 8000Hz\n"
+		   "  route  S16_LE 1ch 8000Hz -> S16_LE 2ch 8000Hz\n"
+		   "  rate   S16_LE 2ch 8000Hz -> S16_LE 2ch 48000Hz\n"
+		   "  format S16_LE 2ch 48000Hz -> FLOAT_LE 2ch 48000Hz\n");
+	return TEST_EXIT_CODE();
+}
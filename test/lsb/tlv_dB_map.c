@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+#define MUTE	0x10000
+#define UNKNOWN_TLVT	0x7f
+
+/* the map must give the results of the one-shot functions */
+static void check(const char *name, unsigned int *tlv, long rangemin,
+		  long rangemax)
+{
+	snd_tlv_dB_map_t *map;
+	long v, db, dbmin, dbmax, r1, r2, mmin, mmax;
+	int e1, e2, xdir, bad = 0;
+
+	if (ALSA_CHECK(snd_tlv_dB_map_new(&map, tlv, rangemin, rangemax)) < 0)
+		return;
+
+	e1 = snd_tlv_get_dB_range(tlv, rangemin, rangemax, &dbmin, &dbmax);
+	e2 = snd_tlv_dB_map_get_range(map, &mmin, &mmax);
+	TEST_CHECK(e1 == e2);
+	if (e1 < 0) {
+		dbmin = -10000;
+		dbmax = 10000;
+	} else
+		TEST_CHECK(dbmin == mmin && dbmax == mmax);
+	if (dbmin <= SND_CTL_TLV_DB_GAIN_MUTE)
+		dbmin = -20000;
+
+	for (v = rangemin - 2; v <= rangemax + 2; v++) {
+		r1 = r2 = 0x5555;
+		e1 = snd_tlv_convert_to_dB(tlv, rangemin, rangemax, v, &r1);
+		e2 = snd_tlv_dB_map_to_dB(map, v, &r2);
+		if (e1 != e2 || (e1 >= 0 && r1 != r2)) {
+			fprintf(stderr, "%s: to_dB(%ld): %d/%ld != %d/%ld\n",
+				name, v, e1, r1, e2, r2);
+			bad++;
+		}
+	}
+	for (xdir = -1; xdir <= 1; xdir += 2) {
+		for (db = dbmin - 300; db <= dbmax + 300; db++) {
+			r1 = r2 = 0x5555;
+			e1 = snd_tlv_convert_from_dB(tlv, rangemin, rangemax,
+						     db, &r1, xdir);
+			e2 = snd_tlv_dB_map_from_dB(map, db, &r2, xdir);
+			if (e1 != e2 || (e1 >= 0 && r1 != r2)) {
+				if (bad++ < 10)
+					fprintf(stderr, "%s: from_dB(%ld, %d): "
+						"%d/%ld != %d/%ld\n", name, db,
+						xdir, e1, r1, e2, r2);
+			}
+		}
+		/* mute */
+		e1 = snd_tlv_convert_from_dB(tlv, rangemin, rangemax,
+					     SND_CTL_TLV_DB_GAIN_MUTE, &r1, xdir);
+		e2 = snd_tlv_dB_map_from_dB(map, SND_CTL_TLV_DB_GAIN_MUTE,
+					    &r2, xdir);
+		if (e1 != e2 || (e1 >= 0 && r1 != r2))
+			bad++;
+	}
+	if (bad)
+		fprintf(stderr, "%s: %d mismatches\n", name, bad);
+	TEST_CHECK(bad == 0);
+	snd_tlv_dB_map_free(map);
+}
+
+int main(void)
+{
+	unsigned int scale[] = { SND_CTL_TLVT_DB_SCALE, 8, -4650, 150 };
+	unsigned int scale_mute[] = { SND_CTL_TLVT_DB_SCALE, 8, -6000, 75 | MUTE };
+	unsigned int minmax[] = { SND_CTL_TLVT_DB_MINMAX, 8, -7200, 600 };
+	unsigned int minmax_mute[] = { SND_CTL_TLVT_DB_MINMAX_MUTE, 8, -5000, 0 };
+	unsigned int linear[] = { SND_CTL_TLVT_DB_LINEAR, 8, -4800, 0 };
+	unsigned int linear_mute[] = {
+		SND_CTL_TLVT_DB_LINEAR, 8, SND_CTL_TLV_DB_GAIN_MUTE, 600
+	};
+	unsigned int range[] = {
+		SND_CTL_TLVT_DB_RANGE, 18 * 4,
+		0, 0, SND_CTL_TLVT_DB_SCALE, 8, -9999, 0 | MUTE,
+		1, 15, SND_CTL_TLVT_DB_SCALE, 8, -6000, 200,
+		16, 31, SND_CTL_TLVT_DB_MINMAX, 8, -2800, -400,
+	};
+	unsigned int range_linear[] = {
+		SND_CTL_TLVT_DB_RANGE, 12 * 4,
+		0, 99, SND_CTL_TLVT_DB_LINEAR, 8, -3000, -1000,
+		100, 199, SND_CTL_TLVT_DB_SCALE, 8, -1000, 10,
+	};
+	/* an item without a dB range in the middle */
+	unsigned int range_bad[] = {
+		SND_CTL_TLVT_DB_RANGE, 18 * 4,
+		0, 9, SND_CTL_TLVT_DB_SCALE, 8, -3000, 100,
+		10, 19, UNKNOWN_TLVT, 8, 0, 0,
+		20, 29, SND_CTL_TLVT_DB_SCALE, 8, -1000, 100,
+	};
+	unsigned int range_bad_first[] = {
+		SND_CTL_TLVT_DB_RANGE, 12 * 4,
+		0, 9, UNKNOWN_TLVT, 8, 0, 0,
+		10, 19, SND_CTL_TLVT_DB_SCALE, 8, -3000, 100,
+	};
+
+	check("scale", scale, 0, 31);
+	check("scale offset", scale, -20, 11);
+	check("scale mute", scale_mute, 0, 80);
+	check("scale large", scale, 0, 10000);
+	check("minmax", minmax, 0, 255);
+	check("minmax mute", minmax_mute, 0, 127);
+	check("minmax empty", minmax, 5, 5);
+	check("linear", linear, 0, 255);
+	check("linear mute", linear_mute, 0, 65535);
+	check("range", range, 0, 31);
+	check("range clipped", range, 0, 20);
+	check("range linear", range_linear, 0, 199);
+	check("range without dB", range_bad, 0, 29);
+	check("range without dB first", range_bad_first, 0, 19);
+	return TEST_EXIT_CODE();
+}
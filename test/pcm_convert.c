@@ -0,0 +1,382 @@
+/*
+ *  Format conversion test
+ *
+ *  Converts every supported pair of formats by the conversion kernel
+ *  and by the generic path the plugins otherwise use, and compares the
+ *  results.  With --bench, the samples are also pushed through the
+ *  linear or lfloat plugin with a null slave and the throughput of the
+ *  plugin, the kernel and the generic path is printed.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <errno.h>
+#include <sys/time.h>
+/* the conversion functions are linked from src/pcm/pcm_conv.c */
+#include "../src/pcm/pcm_local.h"
+#include "../src/pcm/pcm_plugin.h"
+
+static const snd_pcm_format_t formats[] = {
+	SND_PCM_FORMAT_S16_LE,
+	SND_PCM_FORMAT_S16_BE,
+	SND_PCM_FORMAT_S24_3LE,
+	SND_PCM_FORMAT_S24_3BE,
+	SND_PCM_FORMAT_S24_LE,
+	SND_PCM_FORMAT_S24_BE,
+	SND_PCM_FORMAT_S32_LE,
+	SND_PCM_FORMAT_S32_BE,
+	SND_PCM_FORMAT_FLOAT_LE,
+	SND_PCM_FORMAT_FLOAT_BE,
+};
+
+static unsigned int channels = 2;
+static unsigned int frames = 1024 * 1024;
+static snd_pcm_uframes_t period = 1024;
+static unsigned int verify_frames = 65536;
+
+/* valid samples, so that both paths see the same significant bits */
+static void fill_samples(snd_pcm_format_t format, char *data, unsigned int samples)
+{
+	int width = snd_pcm_format_width(format);
+	int bytes = snd_pcm_format_physical_width(format) / 8;
+	int big = snd_pcm_format_big_endian(format);
+	unsigned int i;
+	int b;
+
+	srand(1);
+	for (i = 0; i < samples; i++, data += bytes) {
+		union {
+			float f;
+			unsigned int u;
+		} v;
+		if (snd_pcm_format_float(format)) {
+			/* exceed the range a bit to check the clipping */
+			v.f = (rand() / (float)RAND_MAX) * 2.4f - 1.2f;
+		} else {
+			v.u = ((unsigned int)rand() << 16) ^ (unsigned int)rand();
+			v.u = (unsigned int)((int)v.u >> (32 - width));
+		}
+		for (b = 0; b < bytes; b++)
+			data[big ? bytes - 1 - b : b] = v.u >> (b * 8);
+	}
+}
+
+static int open_pcm(snd_pcm_t **pcmp, snd_pcm_format_t src, snd_pcm_format_t dst)
+{
+	char buf[512];
+	snd_config_t *top;
+	snd_input_t *in;
+	int err;
+
+	snprintf(buf, sizeof(buf),
+		 "pcm.bench { type %s slave { pcm { type null } format %s } }",
+		 snd_pcm_format_float(src) || snd_pcm_format_float(dst) ? "lfloat" : "linear",
+		 snd_pcm_format_name(dst));
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, buf, -1);
+	if (err < 0)
+		goto __end;
+	err = snd_config_load(top, in);
+	snd_input_close(in);
+	if (err < 0)
+		goto __end;
+	err = snd_pcm_open_lconf(pcmp, "bench", SND_PCM_STREAM_PLAYBACK, 0, top);
+	if (err < 0)
+		goto __end;
+	err = snd_pcm_set_params(*pcmp, src, SND_PCM_ACCESS_RW_INTERLEAVED,
+				 channels, 48000, 0, 500000);
+	if (err < 0)
+		snd_pcm_close(*pcmp);
+      __end:
+	snd_config_delete(top);
+	return err;
+}
+
+/* convert count frames through the plugin, return the rate */
+static int convert(snd_pcm_format_t src, snd_pcm_format_t dst,
+		   unsigned int count, double *rate)
+{
+	snd_pcm_t *pcm;
+	struct timeval start, end;
+	unsigned int written = 0;
+	double usec;
+	char *data;
+	size_t size;
+	int err;
+
+	err = open_pcm(&pcm, src, dst);
+	if (err < 0)
+		return err;
+	size = snd_pcm_frames_to_bytes(pcm, period);
+	data = malloc(size);
+	if (data == NULL) {
+		snd_pcm_close(pcm);
+		return -ENOMEM;
+	}
+	fill_samples(src, data, period * channels);
+	gettimeofday(&start, NULL);
+	while (written < count) {
+		snd_pcm_sframes_t res = snd_pcm_writei(pcm, data, period);
+		if (res < 0) {
+			err = snd_pcm_recover(pcm, res, 0);
+			if (err < 0)
+				break;
+			continue;
+		}
+		written += res;
+	}
+	gettimeofday(&end, NULL);
+	usec = (end.tv_sec - start.tv_sec) * 1000000.0 + (end.tv_usec - start.tv_usec);
+	*rate = usec > 0 ? written * (double)channels / usec : 0.0;
+	free(data);
+	snd_pcm_close(pcm);
+	return err < 0 ? err : 0;
+}
+
+/* the generic conversion the linear and lfloat plugins use without kernel */
+static void convert_generic(const snd_pcm_channel_area_t *dst_areas,
+			    const snd_pcm_channel_area_t *src_areas,
+			    snd_pcm_format_t src, snd_pcm_format_t dst,
+			    unsigned int count)
+{
+	if (snd_pcm_format_float(src) || snd_pcm_format_float(dst)) {
+		if (snd_pcm_format_linear(src))
+			snd_pcm_lfloat_convert_integer_float(dst_areas, 0, src_areas, 0,
+				channels, count,
+				snd_pcm_linear_get_index(src, SND_PCM_FORMAT_S32),
+				snd_pcm_lfloat_put_s32_index(dst));
+		else
+			snd_pcm_lfloat_convert_float_integer(dst_areas, 0, src_areas, 0,
+				channels, count,
+				snd_pcm_linear_put_index(SND_PCM_FORMAT_S32, dst),
+				snd_pcm_lfloat_get_s32_index(src));
+	} else if (snd_pcm_format_physical_width(src) == 24 ||
+		   snd_pcm_format_physical_width(dst) == 24) {
+		snd_pcm_linear_getput(dst_areas, 0, src_areas, 0, channels, count,
+				      snd_pcm_linear_get_index(src, SND_PCM_FORMAT_S32),
+				      snd_pcm_linear_put_index(SND_PCM_FORMAT_S32, dst));
+	} else {
+		snd_pcm_linear_convert(dst_areas, 0, src_areas, 0, channels, count,
+				       snd_pcm_linear_convert_index(src, dst));
+	}
+}
+
+static void setup_areas(snd_pcm_channel_area_t *areas, char *data,
+			snd_pcm_format_t format, unsigned int count,
+			int interleaved)
+{
+	unsigned int width = snd_pcm_format_physical_width(format);
+	unsigned int channel;
+
+	for (channel = 0; channel < channels; channel++) {
+		if (interleaved) {
+			areas[channel].addr = data;
+			areas[channel].first = channel * width;
+			areas[channel].step = channels * width;
+		} else {
+			areas[channel].addr = data + channel * count * width / 8;
+			areas[channel].first = 0;
+			areas[channel].step = width;
+		}
+	}
+}
+
+/* convert count frames by the kernel and by the generic path, compare */
+static int verify(snd_pcm_format_t src, snd_pcm_format_t dst, int interleaved)
+{
+	snd_pcm_channel_area_t src_areas[channels], dst_areas[channels];
+	snd_pcm_linear_kernel_t kernel;
+	size_t src_size = snd_pcm_format_size(src, verify_frames * channels);
+	size_t dst_size = snd_pcm_format_size(dst, verify_frames * channels);
+	char *data, *out1, *out2;
+	int err = 0;
+
+	if (snd_pcm_linear_kernel(&kernel, src, dst) < 0)
+		return 0;
+	data = malloc(src_size);
+	out1 = malloc(dst_size);
+	out2 = malloc(dst_size);
+	if (!data || !out1 || !out2) {
+		err = -ENOMEM;
+		goto __end;
+	}
+	fill_samples(src, data, verify_frames * channels);
+	/* the bytes not written must stay the same, too */
+	memset(out1, 0x55, dst_size);
+	memset(out2, 0x55, dst_size);
+	setup_areas(src_areas, data, src, verify_frames, interleaved);
+	setup_areas(dst_areas, out1, dst, verify_frames, interleaved);
+	snd_pcm_linear_kernel_areas(&kernel, dst_areas, 0, src_areas, 0,
+				    channels, verify_frames);
+	setup_areas(dst_areas, out2, dst, verify_frames, interleaved);
+	convert_generic(dst_areas, src_areas, src, dst, verify_frames);
+	if (memcmp(out1, out2, dst_size)) {
+		printf("%-10s -> %-10s: %s kernel differs from the generic path\n",
+		       snd_pcm_format_name(src), snd_pcm_format_name(dst),
+		       interleaved ? "interleaved" : "non-interleaved");
+		err = -EIO;
+	}
+      __end:
+	free(data);
+	free(out1);
+	free(out2);
+	return err;
+}
+
+/* throughput of the kernel or the generic path alone */
+static double bench_direct(snd_pcm_format_t src, snd_pcm_format_t dst, int generic)
+{
+	snd_pcm_channel_area_t src_areas[channels], dst_areas[channels];
+	snd_pcm_linear_kernel_t kernel;
+	struct timeval start, end;
+	unsigned int done;
+	char *data, *out;
+	double usec;
+
+	snd_pcm_linear_kernel(&kernel, src, dst);
+	data = malloc(snd_pcm_format_size(src, period * channels));
+	out = malloc(snd_pcm_format_size(dst, period * channels));
+	if (!data || !out) {
+		free(data);
+		free(out);
+		return 0.0;
+	}
+	fill_samples(src, data, period * channels);
+	setup_areas(src_areas, data, src, period, 1);
+	setup_areas(dst_areas, out, dst, period, 1);
+	gettimeofday(&start, NULL);
+	for (done = 0; done < frames; done += period) {
+		if (generic)
+			convert_generic(dst_areas, src_areas, src, dst, period);
+		else
+			snd_pcm_linear_kernel_areas(&kernel, dst_areas, 0, src_areas, 0,
+						    channels, period);
+	}
+	gettimeofday(&end, NULL);
+	free(data);
+	free(out);
+	usec = (end.tv_sec - start.tv_sec) * 1000000.0 + (end.tv_usec - start.tv_usec);
+	return usec > 0 ? done * (double)channels / usec : 0.0;
+}
+
+static int bench(snd_pcm_format_t src, snd_pcm_format_t dst)
+{
+	double rate;
+	int err;
+
+	if (snd_pcm_format_float(src) == snd_pcm_format_float(dst) &&
+	    snd_pcm_format_float(src))
+		return 0;
+	printf("%-10s -> %-10s: ", snd_pcm_format_name(src),
+	       snd_pcm_format_name(dst));
+	err = convert(src, dst, frames, &rate);
+	if (err < 0) {
+		printf("%s\n", snd_strerror(err));
+		return err;
+	}
+	printf("plugin %8.1f, kernel %8.1f, generic %8.1f Msamples/s\n", rate,
+	       bench_direct(src, dst, 0), bench_direct(src, dst, 1));
+	return 0;
+}
+
+static void help(void)
+{
+	printf(
+"Usage: pcm_convert [OPTION]...\n"
+"-h,--help      help\n"
+"-c,--channels  count of channels in stream\n"
+"-n,--frames    count of frames per format pair to measure\n"
+"-p,--period    frames per write\n"
+"-f,--from      source format (default all)\n"
+"-t,--to        destination format (default all)\n"
+"-b,--bench     measure the throughput\n"
+);
+}
+
+int main(int argc, char *argv[])
+{
+	struct option long_option[] =
+	{
+		{"help", 0, NULL, 'h'},
+		{"channels", 1, NULL, 'c'},
+		{"frames", 1, NULL, 'n'},
+		{"period", 1, NULL, 'p'},
+		{"from", 1, NULL, 'f'},
+		{"to", 1, NULL, 't'},
+		{"bench", 0, NULL, 'b'},
+		{NULL, 0, NULL, 0},
+	};
+	snd_pcm_format_t from = SND_PCM_FORMAT_UNKNOWN;
+	snd_pcm_format_t to = SND_PCM_FORMAT_UNKNOWN;
+	unsigned int i, j;
+	int c, benchmark = 0, res = 0;
+
+	while ((c = getopt_long(argc, argv, "hc:n:p:f:t:b", long_option, NULL)) >= 0) {
+		switch (c) {
+		case 'h':
+			help();
+			return 0;
+		case 'c':
+			channels = atoi(optarg);
+			break;
+		case 'n':
+			frames = atoi(optarg);
+			break;
+		case 'p':
+			period = atoi(optarg);
+			break;
+		case 'f':
+			from = snd_pcm_format_value(optarg);
+			break;
+		case 't':
+			to = snd_pcm_format_value(optarg);
+			break;
+		case 'b':
+			benchmark = 1;
+			break;
+		default:
+			help();
+			return 1;
+		}
+	}
+	if (channels < 1 || period < 1) {
+		help();
+		return 1;
+	}
+	for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+		if (from != SND_PCM_FORMAT_UNKNOWN && formats[i] != from)
+			continue;
+		for (j = 0; j < sizeof(formats) / sizeof(formats[0]); j++) {
+			if (to != SND_PCM_FORMAT_UNKNOWN && formats[j] != to)
+				continue;
+			if (benchmark) {
+				if (bench(formats[i], formats[j]) < 0)
+					res = 1;
+			} else if (verify(formats[i], formats[j], 1) < 0 ||
+				   verify(formats[i], formats[j], 0) < 0) {
+				res = 1;
+			}
+		}
+	}
+	return res;
+}